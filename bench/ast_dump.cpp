@@ -0,0 +1,42 @@
+#include "bench_utils.h"
+
+#include "frontend/ast_dump.h"
+#include "frontend/lexer.h"
+#include "frontend/parser.h"
+
+namespace
+{
+    using talos::bench::BenchCorpus;
+
+    // The large corpus parses into roughly two million nodes
+    void dump_ast(benchmark::State& state, talos::DumpFormat format, BenchCorpus corpus)
+    {
+        const auto& input = talos::bench::input_for(corpus);
+        auto lexer = talos::Lexer{input.source};
+        auto parser = talos::Parser{&lexer};
+        const auto program = parser.parse();
+
+        auto buffer = fmt::memory_buffer{};
+        const auto allocations = talos::bench::allocation_count();
+        for (auto _ : state) {
+            buffer.clear();
+            talos::dump_ast(program, format, buffer);
+            benchmark::DoNotOptimize(buffer.data());
+        }
+        talos::bench::report_counters(state, input, talos::bench::allocation_count() - allocations);
+        state.counters["output_bytes"] = static_cast<double>(buffer.size());
+    }
+
+    BENCHMARK_CAPTURE(dump_ast, text/small, talos::DumpFormat::Text, BenchCorpus::Small);
+    BENCHMARK_CAPTURE(dump_ast, text/medium, talos::DumpFormat::Text, BenchCorpus::Medium);
+    BENCHMARK_CAPTURE(dump_ast, text/large, talos::DumpFormat::Text, BenchCorpus::Large);
+    BENCHMARK_CAPTURE(dump_ast, text/deep_nesting, talos::DumpFormat::Text, BenchCorpus::DeepNesting);
+    BENCHMARK_CAPTURE(dump_ast, json/small, talos::DumpFormat::Json, BenchCorpus::Small);
+    BENCHMARK_CAPTURE(dump_ast, json/medium, talos::DumpFormat::Json, BenchCorpus::Medium);
+    BENCHMARK_CAPTURE(dump_ast, json/large, talos::DumpFormat::Json, BenchCorpus::Large);
+    BENCHMARK_CAPTURE(dump_ast, json/deep_nesting, talos::DumpFormat::Json, BenchCorpus::DeepNesting);
+    BENCHMARK_CAPTURE(dump_ast, binary/small, talos::DumpFormat::Binary, BenchCorpus::Small);
+    BENCHMARK_CAPTURE(dump_ast, binary/medium, talos::DumpFormat::Binary, BenchCorpus::Medium);
+    BENCHMARK_CAPTURE(dump_ast, binary/large, talos::DumpFormat::Binary, BenchCorpus::Large);
+    BENCHMARK_CAPTURE(dump_ast, binary/deep_nesting, talos::DumpFormat::Binary, BenchCorpus::DeepNesting);
+} // namespace
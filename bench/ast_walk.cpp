@@ -0,0 +1,203 @@
+#include "bench_utils.h"
+
+#include "frontend/expression_table.h"
+#include "frontend/lexer.h"
+#include "frontend/node_counter.h"
+#include "frontend/parser.h"
+
+namespace
+{
+    using talos::bench::BenchCorpus;
+
+    // Counts nodes through ASTNode::accept and ASTVisitor::visit, the way
+    // NodeCounter did before it became an ASTWalker
+    class VirtualCounter final : public talos::ASTVisitor
+    {
+    public:
+        talos::NodeCounts counts{};
+
+        void visit(const talos::BinaryExpr& expr) override
+        {
+            count(talos::NodeKind::BinaryExpr);
+            expr.lhs()->accept(*this);
+            expr.rhs()->accept(*this);
+        }
+        void visit(const talos::UnaryExpr& expr) override
+        {
+            count(talos::NodeKind::UnaryExpr);
+            expr.expr()->accept(*this);
+        }
+        void visit(const talos::ParenExpr& expr) override
+        {
+            count(talos::NodeKind::ParenExpr);
+            expr.expr()->accept(*this);
+        }
+        void visit(const talos::IntLiteralExpr&) override { count(talos::NodeKind::IntLiteralExpr); }
+        void visit(const talos::StringLiteralExpr&) override { count(talos::NodeKind::StringLiteralExpr); }
+        void visit(const talos::CharLiteralExpr&) override { count(talos::NodeKind::CharLiteralExpr); }
+        void visit(const talos::FloatingLiteralExpr&) override { count(talos::NodeKind::FloatingLiteralExpr); }
+        void visit(const talos::BoolLiteralExpr&) override { count(talos::NodeKind::BoolLiteralExpr); }
+        void visit(const talos::IdentifierExpr&) override { count(talos::NodeKind::IdentifierExpr); }
+        void visit(const talos::AssignmentExpr& expr) override
+        {
+            count(talos::NodeKind::AssignmentExpr);
+            expr.lhs()->accept(*this);
+            expr.rhs()->accept(*this);
+        }
+        void visit(const talos::CallExpr& expr) override
+        {
+            count(talos::NodeKind::CallExpr);
+            expr.callee()->accept(*this);
+            for (const auto& argument : expr.arguments()) {
+                argument->accept(*this);
+            }
+        }
+        void visit(const talos::FieldExpr& expr) override
+        {
+            count(talos::NodeKind::FieldExpr);
+            expr.object()->accept(*this);
+        }
+        void visit(const talos::IndexExpr& expr) override
+        {
+            count(talos::NodeKind::IndexExpr);
+            expr.array()->accept(*this);
+            expr.index()->accept(*this);
+        }
+        void visit(const talos::ArrayLiteralExpr& expr) override
+        {
+            count(talos::NodeKind::ArrayLiteralExpr);
+            for (const auto& element : expr.elements()) {
+                element->accept(*this);
+            }
+        }
+        void visit(const talos::ExprStatement& stmt) override
+        {
+            count(talos::NodeKind::ExprStatement);
+            stmt.expr()->accept(*this);
+        }
+        void visit(const talos::ReturnStatement& stmt) override
+        {
+            count(talos::NodeKind::ReturnStatement);
+            stmt.return_value()->accept(*this);
+        }
+        void visit(const talos::VarDeclStatement& stmt) override
+        {
+            count(talos::NodeKind::VarDeclStatement);
+            stmt.initializer()->accept(*this);
+        }
+        void visit(const talos::FunDeclStatement& stmt) override
+        {
+            count(talos::NodeKind::FunDeclStatement);
+            for (const auto& statement : stmt.statements()) {
+                statement->accept(*this);
+            }
+        }
+        void visit(const talos::StructDeclStatement&) override { count(talos::NodeKind::StructDeclStatement); }
+        void visit(const talos::BlockStatement& stmt) override
+        {
+            count(talos::NodeKind::BlockStatement);
+            for (const auto& statement : stmt.statements()) {
+                statement->accept(*this);
+            }
+        }
+        void visit(const talos::IfStatement& stmt) override
+        {
+            count(talos::NodeKind::IfStatement);
+            stmt.condition()->accept(*this);
+            stmt.then_branch()->accept(*this);
+            if (stmt.else_branch() != nullptr) {
+                stmt.else_branch()->accept(*this);
+            }
+        }
+        void visit(const talos::WhileStatement& stmt) override
+        {
+            count(talos::NodeKind::WhileStatement);
+            stmt.condition()->accept(*this);
+            stmt.body()->accept(*this);
+        }
+        void visit(const talos::ForStatement& stmt) override
+        {
+            count(talos::NodeKind::ForStatement);
+            if (stmt.initializer() != nullptr) {
+                stmt.initializer()->accept(*this);
+            }
+            if (stmt.condition() != nullptr) {
+                stmt.condition()->accept(*this);
+            }
+            if (stmt.increment() != nullptr) {
+                stmt.increment()->accept(*this);
+            }
+            stmt.body()->accept(*this);
+        }
+        void visit(const talos::ProgramNode& program) override
+        {
+            count(talos::NodeKind::Program);
+            for (const auto& statement : program.statements()) {
+                statement->accept(*this);
+            }
+        }
+
+    private:
+        void count(talos::NodeKind kind) noexcept { ++counts[static_cast<std::size_t>(kind)]; }
+    };
+
+    template<typename Walk>
+    void walk_tree(benchmark::State& state, BenchCorpus corpus, Walk walk)
+    {
+        const auto& input = talos::bench::input_for(corpus);
+        auto lexer = talos::Lexer{input.source};
+        auto parser = talos::Parser{&lexer};
+        const auto program = parser.parse();
+
+        const auto allocations = talos::bench::allocation_count();
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(walk(program));
+        }
+        talos::bench::report_counters(state, input, talos::bench::allocation_count() - allocations);
+    }
+
+    void walk_virtual(benchmark::State& state, BenchCorpus corpus)
+    {
+        walk_tree(state, corpus, [](const talos::ProgramNode& program) {
+            auto counter = VirtualCounter{};
+            program.accept(counter);
+            return counter.counts;
+        });
+    }
+
+    void walk_static(benchmark::State& state, BenchCorpus corpus)
+    {
+        walk_tree(state, corpus, [](const talos::ProgramNode& program) { return talos::count_nodes(program); });
+    }
+
+    BENCHMARK_CAPTURE(walk_virtual, medium, BenchCorpus::Medium);
+    BENCHMARK_CAPTURE(walk_virtual, large, BenchCorpus::Large);
+    BENCHMARK_CAPTURE(walk_virtual, deep_nesting, BenchCorpus::DeepNesting);
+    BENCHMARK_CAPTURE(walk_static, medium, BenchCorpus::Medium);
+    BENCHMARK_CAPTURE(walk_static, large, BenchCorpus::Large);
+    BENCHMARK_CAPTURE(walk_static, deep_nesting, BenchCorpus::DeepNesting);
+
+    // Hash-conses the expressions of each function and reports how many of
+    // their nodes, and bytes of them, sharing identical pure subtrees saves
+    void share_expressions(benchmark::State& state, BenchCorpus corpus)
+    {
+        const auto& input = talos::bench::input_for(corpus);
+        auto lexer = talos::Lexer{input.source};
+        auto parser = talos::Parser{&lexer};
+        const auto program = parser.parse();
+
+        auto sharing = talos::ExpressionSharing{};
+        for (auto _ : state) {
+            sharing = talos::share_expressions(program);
+            benchmark::DoNotOptimize(sharing);
+        }
+        state.counters["expression_nodes"] = static_cast<double>(sharing.nodes);
+        state.counters["unique_nodes"] = static_cast<double>(sharing.unique_nodes);
+        state.counters["node_reduction_pct"] = 100.0 * (1.0 - static_cast<double>(sharing.unique_nodes) / static_cast<double>(sharing.nodes));
+        state.counters["bytes_saved"] = static_cast<double>(sharing.bytes - sharing.unique_bytes);
+        state.counters["nodes"] = benchmark::Counter(static_cast<double>(sharing.nodes), benchmark::Counter::kIsIterationInvariantRate);
+    }
+
+    BENCHMARK_CAPTURE(share_expressions, medium, BenchCorpus::Medium);
+    BENCHMARK_CAPTURE(share_expressions, large, BenchCorpus::Large)->Unit(benchmark::kMillisecond);
+} // namespace
@@ -0,0 +1,104 @@
+#include "bench_utils.h"
+
+#include "frontend/lexer.h"
+#include "frontend/node_counter.h"
+#include "frontend/parser.h"
+#include "tools/corpus_generator.h"
+
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <optional>
+
+namespace
+{
+    std::atomic<std::int64_t> allocations{0};
+} // namespace
+
+void* operator new(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (auto* ptr = std::malloc(size)) {
+        return ptr;
+    }
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+namespace talos::bench
+{
+    namespace
+    {
+        tools::CorpusOptions corpus_options(BenchCorpus corpus)
+        {
+            switch (corpus) {
+                case BenchCorpus::Small:
+                    return {.seed = 1, .target_size = 1024};
+                case BenchCorpus::Medium:
+                    return {.seed = 2, .target_size = 64 * 1024};
+                case BenchCorpus::Large:
+                    return {.seed = 3, .target_size = 16 * 1024 * 1024};
+                case BenchCorpus::DeepNesting:
+                    return {.seed = 4, .target_size = 64 * 1024, .nesting_depth = 1000};
+                case BenchCorpus::Strings:
+                    return {.seed = 5, .target_size = 1024 * 1024, .string_weight = 24, .string_length = {32, 256}, .escape_probability = 0.02};
+            }
+            return {};
+        }
+
+        BenchInput make_input(BenchCorpus corpus)
+        {
+            auto input = BenchInput{.source = tools::generate_corpus(corpus_options(corpus))};
+            input.tokens = count_tokens(input.source);
+            auto lexer = Lexer{input.source};
+            auto parser = Parser{&lexer};
+            input.nodes = static_cast<std::int64_t>(total_nodes(count_nodes(parser.parse())));
+            return input;
+        }
+    } // namespace
+
+    const BenchInput& input_for(BenchCorpus corpus)
+    {
+        // Built lazily so that filtered runs don't pay for the large inputs
+        static auto inputs = std::array<std::optional<BenchInput>, 5>{};
+        auto& input = inputs.at(static_cast<std::size_t>(corpus));
+        if (!input) {
+            input = make_input(corpus);
+        }
+        return *input;
+    }
+
+    std::int64_t count_tokens(std::string_view source)
+    {
+        std::int64_t count = 0;
+        auto lexer = Lexer{source};
+        while (lexer.consume_token().type != TokenType::Eof) {
+            ++count;
+        }
+        return count;
+    }
+
+    std::int64_t allocation_count() noexcept
+    {
+        return allocations.load(std::memory_order_relaxed);
+    }
+
+    void report_counters(benchmark::State& state, const BenchInput& input, std::int64_t allocations)
+    {
+        const auto iterations = static_cast<double>(state.iterations());
+        state.SetBytesProcessed(state.iterations() * static_cast<std::int64_t>(input.source.size()));
+        state.counters["tokens"] = benchmark::Counter(static_cast<double>(input.tokens) * iterations, benchmark::Counter::kIsRate);
+        state.counters["nodes"] = benchmark::Counter(static_cast<double>(input.nodes) * iterations, benchmark::Counter::kIsRate);
+        state.counters["allocs_per_node"] = static_cast<double>(allocations) / (static_cast<double>(input.nodes) * iterations);
+    }
+} // namespace talos::bench
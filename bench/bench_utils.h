@@ -0,0 +1,38 @@
+#pragma once
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace talos::bench
+{
+    // Generated corpora of 1 KiB, 64 KiB and 16 MiB, plus a pathological
+    // one where every function contains a deeply nested expression and a
+    // data-like one of 1 MiB made mostly of long string literals with escapes
+    enum class BenchCorpus {
+        Small,
+        Medium,
+        Large,
+        DeepNesting,
+        Strings,
+    };
+
+    struct BenchInput {
+        std::string source;
+        std::int64_t tokens = 0;
+        std::int64_t nodes = 0;
+    };
+
+    // Inputs are generated once per corpus and cached for the whole run
+    [[nodiscard]] const BenchInput& input_for(BenchCorpus corpus);
+
+    [[nodiscard]] std::int64_t count_tokens(std::string_view source);
+
+    // Number of calls to global operator new since program start
+    [[nodiscard]] std::int64_t allocation_count() noexcept;
+
+    // Reports bytes/s, tokens/s, nodes/s and allocations per node for a finished benchmark run
+    void report_counters(benchmark::State& state, const BenchInput& input, std::int64_t allocations);
+} // namespace talos::bench
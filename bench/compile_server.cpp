@@ -0,0 +1,58 @@
+#include "bench_utils.h"
+
+#include "daemon/compile_server.h"
+#include "talos.h"
+
+#include <unistd.h>
+
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+namespace
+{
+    using talos::bench::BenchCorpus;
+
+    // Round trip of a client compiling an unchanged file on a running server,
+    // against compiling it in process
+    void compile_server_unchanged(benchmark::State& state, BenchCorpus corpus)
+    {
+        const auto directory = std::filesystem::temp_directory_path() / ("talos_bench_server_" + std::to_string(::getpid()));
+        std::filesystem::create_directories(directory);
+        const auto file = (directory / "input.talos").string();
+        std::ofstream{file, std::ios::binary} << talos::bench::input_for(corpus).source;
+        const auto socket = (directory / "socket").string();
+
+        {
+            auto server = talos::daemon::CompileServer{socket};
+            auto thread = std::thread{[&] { server.run(); }};
+            const auto request = talos::daemon::CompileRequest{.path = file};
+            const auto ignore = [](talos::daemon::OutputStream, std::string_view) {};
+            // The first compile fills the cache
+            static_cast<void>(talos::daemon::request_compile(socket, request, ignore));
+            for (auto _ : state) {
+                auto exit_code = talos::daemon::request_compile(socket, request, ignore);
+                benchmark::DoNotOptimize(exit_code);
+            }
+            talos::daemon::request_stop(socket);
+            thread.join();
+        }
+        std::filesystem::remove_all(directory);
+    }
+
+    void compile_in_process(benchmark::State& state, BenchCorpus corpus)
+    {
+        const auto file = (std::filesystem::temp_directory_path() / ("talos_bench_input_" + std::to_string(::getpid()))).string();
+        std::ofstream{file, std::ios::binary} << talos::bench::input_for(corpus).source;
+        auto vm = talos::TalosVM{};
+        for (auto _ : state) {
+            auto result = vm.execute_file(file);
+            benchmark::DoNotOptimize(result);
+        }
+        std::filesystem::remove(file);
+    }
+
+    BENCHMARK_CAPTURE(compile_server_unchanged, medium, BenchCorpus::Medium)->Unit(benchmark::kMicrosecond)->UseRealTime();
+    BENCHMARK_CAPTURE(compile_server_unchanged, large, BenchCorpus::Large)->Unit(benchmark::kMicrosecond)->UseRealTime();
+    BENCHMARK_CAPTURE(compile_in_process, medium, BenchCorpus::Medium)->Unit(benchmark::kMicrosecond);
+} // namespace
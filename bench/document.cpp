@@ -0,0 +1,27 @@
+#include "bench_utils.h"
+
+#include "frontend/document.h"
+
+namespace
+{
+    using talos::bench::BenchCorpus;
+
+    // Latency of a single keystroke in the middle of the document, undone every other iteration
+    void edit_document(benchmark::State& state, BenchCorpus corpus)
+    {
+        const auto& input = talos::bench::input_for(corpus);
+        auto document = talos::Document{input.source};
+        const auto offset = input.source.find("return", input.source.size() / 2);
+        auto inserted = false;
+        for (auto _ : state) {
+            auto change = inserted ? document.apply({.offset = offset, .removed = 1})
+                                   : document.apply({.offset = offset, .inserted = " "});
+            benchmark::DoNotOptimize(change);
+            inserted = !inserted;
+        }
+        state.counters["blocks"] = static_cast<double>(document.block_count());
+    }
+
+    BENCHMARK_CAPTURE(edit_document, medium, BenchCorpus::Medium);
+    BENCHMARK_CAPTURE(edit_document, large, BenchCorpus::Large);
+} // namespace
@@ -0,0 +1,56 @@
+#include "bench_utils.h"
+
+#include "frontend/lexer.h"
+#include "frontend/string_literal.h"
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+    using talos::bench::BenchCorpus;
+
+    void lex_source(benchmark::State& state, BenchCorpus corpus)
+    {
+        const auto& input = talos::bench::input_for(corpus);
+        const auto allocations = talos::bench::allocation_count();
+        for (auto _ : state) {
+            auto lexer = talos::Lexer{input.source};
+            for (auto token = lexer.consume_token(); token.type != talos::TokenType::Eof; token = lexer.consume_token()) {
+                benchmark::DoNotOptimize(token);
+            }
+        }
+        talos::bench::report_counters(state, input, talos::bench::allocation_count() - allocations);
+    }
+
+    BENCHMARK_CAPTURE(lex_source, small, BenchCorpus::Small);
+    BENCHMARK_CAPTURE(lex_source, medium, BenchCorpus::Medium);
+    BENCHMARK_CAPTURE(lex_source, large, BenchCorpus::Large);
+    BENCHMARK_CAPTURE(lex_source, deep_nesting, BenchCorpus::DeepNesting);
+    BENCHMARK_CAPTURE(lex_source, strings, BenchCorpus::Strings);
+
+    // Decodes every string literal of the corpus, as code generation does
+    void decode_strings(benchmark::State& state)
+    {
+        const auto& input = talos::bench::input_for(BenchCorpus::Strings);
+        auto literals = std::vector<std::string_view>{};
+        auto bytes = std::int64_t{0};
+        auto lexer = talos::Lexer{input.source};
+        for (auto token = lexer.consume_token(); token.type != talos::TokenType::Eof; token = lexer.consume_token()) {
+            if (token.type == talos::TokenType::StringLiteral) {
+                literals.push_back(token.string);
+                bytes += static_cast<std::int64_t>(token.string.size());
+            }
+        }
+        for (auto _ : state) {
+            for (const auto literal : literals) {
+                auto decoded = talos::decode_string_literal(literal);
+                benchmark::DoNotOptimize(decoded);
+            }
+        }
+        state.SetBytesProcessed(state.iterations() * bytes);
+    }
+
+    BENCHMARK(decode_strings);
+} // namespace
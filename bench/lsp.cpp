@@ -0,0 +1,132 @@
+#include "bench_utils.h"
+
+#include "lsp/json.h"
+#include "lsp/server.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace
+{
+    using talos::bench::BenchCorpus;
+    using talos::lsp::JsonValue;
+
+    constexpr auto uri = "file:///bench.talos";
+    constexpr auto typed = "fun typed() : i32 {\n    var value = 1;\n    return value;\n}\n";
+
+    JsonValue position(std::int64_t line, std::int64_t character)
+    {
+        return JsonValue::Object{{"line", line}, {"character", character}};
+    }
+
+    std::string notification(std::string_view method, JsonValue params)
+    {
+        return talos::lsp::to_json(JsonValue::Object{{"jsonrpc", "2.0"}, {"method", method}, {"params", std::move(params)}});
+    }
+
+    std::string request(std::string_view method, JsonValue params)
+    {
+        return talos::lsp::to_json(JsonValue::Object{{"jsonrpc", "2.0"}, {"id", 1}, {"method", method}, {"params", std::move(params)}});
+    }
+
+    std::string change(JsonValue start, JsonValue end, std::string_view text)
+    {
+        return notification("textDocument/didChange", JsonValue::Object{
+                                                          {"textDocument", JsonValue::Object{{"uri", uri}}},
+                                                          {"contentChanges", JsonValue::Array{JsonValue::Object{
+                                                                                 {"range", JsonValue::Object{{"start", std::move(start)}, {"end", std::move(end)}}},
+                                                                                 {"text", text},
+                                                                             }}},
+                                                      });
+    }
+
+    // Recorded session typing a function in the middle of the document one
+    // character per change, asking for the definition under the cursor after
+    // every keystroke like an editor's hover does. Brackets are closed as they
+    // are opened, as editors do by default. The last message removes the typed
+    // text again so that the session can be replayed
+    std::vector<std::string> typing_session(std::string_view source)
+    {
+        const auto offset = source.find("\nfun ", source.size() / 2) + 1;
+        const auto first_line = static_cast<std::int64_t>(std::count(source.begin(), source.begin() + static_cast<std::ptrdiff_t>(offset), '\n'));
+
+        auto buffer = std::string{};
+        std::size_t cursor = 0;
+        const auto cursor_position = [&] {
+            const auto before = std::string_view{buffer}.substr(0, cursor);
+            const auto line_start = before.rfind('\n');
+            const auto line = first_line + static_cast<std::int64_t>(std::ranges::count(before, '\n'));
+            const auto character = line_start == std::string_view::npos ? cursor : cursor - line_start - 1;
+            return position(line, static_cast<std::int64_t>(character));
+        };
+
+        auto messages = std::vector<std::string>{};
+        for (const auto typed_character : std::string_view{typed}) {
+            auto inserted = std::string{typed_character};
+            if (typed_character == '(' || typed_character == '{') {
+                inserted.push_back(typed_character == '(' ? ')' : '}');
+            }
+            if ((typed_character == ')' || typed_character == '}') && buffer[cursor] == typed_character) {
+                // Typing over the automatically inserted bracket
+                ++cursor;
+            }
+            else {
+                messages.push_back(change(cursor_position(), cursor_position(), inserted));
+                buffer.insert(cursor, inserted);
+                ++cursor;
+            }
+            messages.push_back(request("textDocument/definition", JsonValue::Object{
+                                                                      {"textDocument", JsonValue::Object{{"uri", uri}}},
+                                                                      {"position", cursor_position()},
+                                                                  }));
+        }
+        cursor = buffer.size();
+        messages.push_back(change(position(first_line, 0), cursor_position(), ""));
+        return messages;
+    }
+
+    talos::lsp::LanguageServer open_server(std::string_view source, std::int64_t& replies)
+    {
+        auto server = talos::lsp::LanguageServer{[&replies](std::string_view message) {
+            benchmark::DoNotOptimize(message.data());
+            ++replies;
+        }};
+        server.handle(notification("textDocument/didOpen", JsonValue::Object{
+                                                               {"textDocument", JsonValue::Object{{"uri", uri}, {"languageId", "talos"}, {"version", 1}, {"text", source}}},
+                                                           }));
+        return server;
+    }
+
+    // Latency per message of the replayed session, including JSON handling
+    void lsp_typing_session(benchmark::State& state, BenchCorpus corpus)
+    {
+        const auto& input = talos::bench::input_for(corpus);
+        std::int64_t replies = 0;
+        auto server = open_server(input.source, replies);
+        const auto messages = typing_session(input.source);
+        for (auto _ : state) {
+            for (const auto& message : messages) {
+                server.handle(message);
+            }
+        }
+        state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(messages.size()));
+        state.counters["replies"] = benchmark::Counter(static_cast<double>(replies), benchmark::Counter::kAvgIterations);
+    }
+
+    // Outline of the whole document, which is proportional to its declarations
+    void lsp_document_symbols(benchmark::State& state, BenchCorpus corpus)
+    {
+        const auto& input = talos::bench::input_for(corpus);
+        std::int64_t replies = 0;
+        auto server = open_server(input.source, replies);
+        const auto message = request("textDocument/documentSymbol", JsonValue::Object{{"textDocument", JsonValue::Object{{"uri", uri}}}});
+        for (auto _ : state) {
+            server.handle(message);
+        }
+    }
+
+    BENCHMARK_CAPTURE(lsp_typing_session, medium, BenchCorpus::Medium)->Unit(benchmark::kMicrosecond);
+    BENCHMARK_CAPTURE(lsp_typing_session, large, BenchCorpus::Large)->Unit(benchmark::kMillisecond);
+    BENCHMARK_CAPTURE(lsp_document_symbols, medium, BenchCorpus::Medium)->Unit(benchmark::kMicrosecond);
+} // namespace
@@ -0,0 +1,28 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <string_view>
+#include <vector>
+
+int main(int argc, char* argv[])
+{
+    // Report as JSON by default so that results can be diffed between versions.
+    // An explicit --benchmark_format on the command line takes precedence.
+    static char json_format[] = "--benchmark_format=json";
+    auto args = std::vector<char*>(argv, argv + argc);
+    const auto has_format = std::ranges::any_of(args, [](std::string_view arg) {
+        return arg.starts_with("--benchmark_format");
+    });
+    if (!has_format) {
+        args.push_back(json_format);
+    }
+
+    auto arg_count = static_cast<int>(args.size());
+    benchmark::Initialize(&arg_count, args.data());
+    if (benchmark::ReportUnrecognizedArguments(arg_count, args.data())) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
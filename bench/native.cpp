@@ -0,0 +1,208 @@
+#include "bench_utils.h"
+
+#include "exceptions.h"
+#include "frontend/lexer.h"
+#include "frontend/parser.h"
+#include "native/assembly.h"
+#include "native/toolchain.h"
+#include "talos.h"
+#include "vm/codegen.h"
+#include "vm/interpreter.h"
+
+#include <benchmark/benchmark.h>
+#include <fmt/format.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+    using talos::bench::BenchCorpus;
+
+    enum class Backend {
+        Interpreter,
+        // Native code that keeps every register in its frame slot
+        NativeFrame,
+        Native,
+    };
+
+    talos::Program compile(std::string_view source)
+    {
+        auto lexer = talos::Lexer{source};
+        auto parser = talos::Parser{&lexer};
+        const auto program = parser.parse();
+        return talos::compile_program(program);
+    }
+
+    // The executable of a program, removed at the end of the benchmark
+    class NativeProgram
+    {
+    public:
+        NativeProgram(const talos::Program& program, const talos::AssemblyOptions& options)
+            : path_(std::filesystem::temp_directory_path() / fmt::format("talos-native-bench-{}", static_cast<const void*>(this)))
+        {
+            const auto runtime = talos::runtime_source(talos::VMOptions::default_stack_size, talos::VMOptions::default_max_call_depth, talos::VMOptions::default_memory_size);
+            talos::build_executable(talos::emit_assembly(program, options), runtime, path_);
+        }
+
+        ~NativeProgram()
+        {
+            auto error = std::error_code{};
+            std::filesystem::remove(path_, error);
+        }
+
+        NativeProgram(const NativeProgram&) = delete;
+        NativeProgram& operator=(const NativeProgram&) = delete;
+
+        [[nodiscard]] const std::filesystem::path& path() const noexcept { return path_; }
+
+    private:
+        std::filesystem::path path_;
+    };
+
+    // Runs main of source in the interpreter, or as a native executable that
+    // is built once and started for each iteration, so that the native times
+    // include starting the process. iterations_per_run is the work main does
+    void run_program(benchmark::State& state, std::string_view source, std::int64_t iterations_per_run, Backend backend)
+    {
+        const auto program = compile(source);
+        if (backend == Backend::Interpreter) {
+            auto interpreter = talos::Interpreter{};
+            for (auto _ : state) {
+                auto result = interpreter.run(program);
+                benchmark::DoNotOptimize(result);
+            }
+        }
+        else {
+            try {
+                const auto options = talos::AssemblyOptions{.machine_registers = backend == Backend::Native ? talos::max_machine_registers : 0};
+                const auto executable = NativeProgram{program, options};
+                const auto arguments = std::vector<std::string>{executable.path().string()};
+                for (auto _ : state) {
+                    auto status = talos::run_command(arguments);
+                    benchmark::DoNotOptimize(status);
+                }
+            } catch (const talos::TalosException& exception) {
+                state.SkipWithError(exception.what());
+                return;
+            }
+        }
+        state.counters["iterations"] = benchmark::Counter(static_cast<double>(iterations_per_run), benchmark::Counter::kIsIterationInvariantRate);
+    }
+
+    // A main that does nothing measures starting the process. The time of the
+    // child process only shows in real time, which all of these report
+    void native_empty(benchmark::State& state, Backend backend)
+    {
+        run_program(state, "fun main() : i32 { return 0; }", 1, backend);
+    }
+
+    // The programs of the interpreter benchmarks, with more work per run
+    void native_calls(benchmark::State& state, Backend backend)
+    {
+        constexpr auto depth = 23;
+        auto source = std::string{"fun f0(x : i64) : i64 { return x + 1; }\n"};
+        for (auto i = 1; i <= depth; ++i) {
+            source += fmt::format("fun f{}(x : i64) : i64 {{ return f{}(x) + f{}(x); }}\n", i, i - 1, i - 1);
+        }
+        source += fmt::format("fun main() : i32 {{ if f{}(0) > 0 {{ return 0; }} return 1; }}\n", depth);
+        run_program(state, source, (std::int64_t{1} << (depth + 1)) - 1, backend);
+    }
+
+    void native_loop_sum(benchmark::State& state, Backend backend)
+    {
+        constexpr auto source = "fun main() : i32 { var total : i64 = 0; for var i : i64 = 0; i < 10000000; i = i + 1 { total = total + i; } "
+                                "if total > 0 { return 0; } return 1; }";
+        run_program(state, source, 10000000, backend);
+    }
+
+    void native_primes(benchmark::State& state, Backend backend)
+    {
+        constexpr auto limit = 200000;
+        const auto source = fmt::format("fun main() : i32 {{ var count = 0; for var n = 2; n < {}; n = n + 1 {{ var prime = true; "
+                                        "for var d = 2; d * d <= n && prime; d = d + 1 {{ if n % d == 0 {{ prime = false; }} }} "
+                                        "if prime {{ count = count + 1; }} }} return count % 256; }}",
+                                        limit);
+        auto iterations = std::int64_t{0};
+        for (auto n = 2; n < limit; ++n) {
+            for (auto d = 2; d * d <= n; ++d) {
+                ++iterations;
+                if (n % d == 0) {
+                    break;
+                }
+            }
+        }
+        run_program(state, source, iterations, backend);
+    }
+
+    // Indexed element loads and stores, each bounds checked
+    void native_array_loop(benchmark::State& state, Backend backend)
+    {
+        constexpr auto source = "fun main() : i32 { var a = [1; 1000]; var total = 0; for var round = 0; round < 10000; round = round + 1 { "
+                                "for var i = 1; i < 1000; i = i + 1 { a[i] = a[i - 1] + i; total = total + a[i] % 7; } } return total % 256; }";
+        run_program(state, source, 10000 * 999, backend);
+    }
+
+    // The field scans of the record benchmarks, whose masses are 8 of the 40
+    // bytes of a particle, strided over or stored as a column when the struct
+    // is soa. The iterations are the particles scanned
+    void native_field_scan(benchmark::State& state, std::string_view modifier, Backend backend)
+    {
+        constexpr auto count = 1 << 20;
+        constexpr auto passes = 64;
+        const auto source = fmt::format("{0}struct Particle {{ x : f64, y : f64, z : f64, mass : f64, id : i32, alive : bool }} "
+                                        "fun main() : i32 {{ var particles = [Particle(0.0, 0.0, 0.0, 0.0, 0, true); {1}]; var mass = 0.0; "
+                                        "for var i = 0; i < particles.length; i = i + 1 {{ particles[i].mass = mass; mass = mass + 1.0; if mass == 7.0 {{ mass = 0.0; }} }} "
+                                        "var total = 0.0; for var pass = 0; pass < {2}; pass = pass + 1 {{ "
+                                        "for var i = 0; i < particles.length; i = i + 1 {{ total = total + particles[i].mass; }} }} "
+                                        "if total > 0.0 {{ return 0; }} return 1; }}",
+                                        modifier, count, passes);
+        run_program(state, source, std::int64_t{count} * passes, backend);
+    }
+
+    BENCHMARK_CAPTURE(native_empty, interpreter, Backend::Interpreter)->UseRealTime();
+    BENCHMARK_CAPTURE(native_empty, native_frame, Backend::NativeFrame)->UseRealTime();
+    BENCHMARK_CAPTURE(native_empty, native, Backend::Native)->UseRealTime();
+    BENCHMARK_CAPTURE(native_calls, interpreter, Backend::Interpreter)->Unit(benchmark::kMillisecond)->UseRealTime();
+    BENCHMARK_CAPTURE(native_calls, native_frame, Backend::NativeFrame)->Unit(benchmark::kMillisecond)->UseRealTime();
+    BENCHMARK_CAPTURE(native_calls, native, Backend::Native)->Unit(benchmark::kMillisecond)->UseRealTime();
+    BENCHMARK_CAPTURE(native_loop_sum, interpreter, Backend::Interpreter)->Unit(benchmark::kMillisecond)->UseRealTime();
+    BENCHMARK_CAPTURE(native_loop_sum, native_frame, Backend::NativeFrame)->Unit(benchmark::kMillisecond)->UseRealTime();
+    BENCHMARK_CAPTURE(native_loop_sum, native, Backend::Native)->Unit(benchmark::kMillisecond)->UseRealTime();
+    BENCHMARK_CAPTURE(native_primes, interpreter, Backend::Interpreter)->Unit(benchmark::kMillisecond)->UseRealTime();
+    BENCHMARK_CAPTURE(native_primes, native_frame, Backend::NativeFrame)->Unit(benchmark::kMillisecond)->UseRealTime();
+    BENCHMARK_CAPTURE(native_primes, native, Backend::Native)->Unit(benchmark::kMillisecond)->UseRealTime();
+    BENCHMARK_CAPTURE(native_array_loop, interpreter, Backend::Interpreter)->Unit(benchmark::kMillisecond)->UseRealTime();
+    BENCHMARK_CAPTURE(native_array_loop, native_frame, Backend::NativeFrame)->Unit(benchmark::kMillisecond)->UseRealTime();
+    BENCHMARK_CAPTURE(native_array_loop, native, Backend::Native)->Unit(benchmark::kMillisecond)->UseRealTime();
+    BENCHMARK_CAPTURE(native_field_scan, aos, "", Backend::Native)->Unit(benchmark::kMillisecond)->UseRealTime();
+    BENCHMARK_CAPTURE(native_field_scan, soa, "soa ", Backend::Native)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+    // Lowers the functions of a corpus with register allocation and reports
+    // how many webs were spilled, and how many fewer machine instructions
+    // there are than with every register in its frame slot
+    void native_register_allocation(benchmark::State& state, BenchCorpus corpus)
+    {
+        const auto program = compile(talos::bench::input_for(corpus).source);
+        auto frame = talos::AssemblyStats{};
+        static_cast<void>(talos::emit_assembly(program, talos::AssemblyOptions{.machine_registers = 0}, &frame));
+        auto stats = talos::AssemblyStats{};
+        for (auto _ : state) {
+            stats = talos::AssemblyStats{};
+            auto assembly = talos::emit_assembly(program, {}, &stats);
+            benchmark::DoNotOptimize(assembly);
+        }
+        state.counters["webs"] = static_cast<double>(stats.candidates);
+        state.counters["spills"] = static_cast<double>(stats.spills);
+        state.counters["coalesced"] = static_cast<double>(stats.coalesced_moves);
+        state.counters["instructions"] = static_cast<double>(stats.instructions);
+        state.counters["frame_instructions"] = static_cast<double>(frame.instructions);
+        state.counters["reduction_pct"] = 100.0 * (1.0 - static_cast<double>(stats.instructions) / static_cast<double>(frame.instructions));
+    }
+
+    BENCHMARK_CAPTURE(native_register_allocation, small, BenchCorpus::Small)->Unit(benchmark::kMillisecond);
+    BENCHMARK_CAPTURE(native_register_allocation, medium, BenchCorpus::Medium)->Unit(benchmark::kMillisecond);
+} // namespace
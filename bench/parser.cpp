@@ -0,0 +1,45 @@
+#include "bench_utils.h"
+
+#include "frontend/lexer.h"
+#include "frontend/parser.h"
+#include "frontend/pipelined_lexer.h"
+
+namespace
+{
+    using talos::bench::BenchCorpus;
+
+    template<typename TokenSource>
+    void parse_with(benchmark::State& state, BenchCorpus corpus)
+    {
+        const auto& input = talos::bench::input_for(corpus);
+        const auto allocations = talos::bench::allocation_count();
+        for (auto _ : state) {
+            auto tokens = TokenSource{input.source};
+            auto parser = talos::Parser{&tokens};
+            auto program = parser.parse();
+            benchmark::DoNotOptimize(program);
+        }
+        talos::bench::report_counters(state, input, talos::bench::allocation_count() - allocations);
+    }
+
+    void parse_source(benchmark::State& state, BenchCorpus corpus)
+    {
+        parse_with<talos::Lexer>(state, corpus);
+    }
+
+    void parse_source_pipelined(benchmark::State& state, BenchCorpus corpus)
+    {
+        parse_with<talos::PipelinedLexer>(state, corpus);
+    }
+
+    BENCHMARK_CAPTURE(parse_source, small, BenchCorpus::Small);
+    BENCHMARK_CAPTURE(parse_source, medium, BenchCorpus::Medium);
+    BENCHMARK_CAPTURE(parse_source, large, BenchCorpus::Large);
+    BENCHMARK_CAPTURE(parse_source, deep_nesting, BenchCorpus::DeepNesting);
+
+    // Lexing happens on another thread, so only wall-clock time is meaningful
+    BENCHMARK_CAPTURE(parse_source_pipelined, small, BenchCorpus::Small)->UseRealTime();
+    BENCHMARK_CAPTURE(parse_source_pipelined, medium, BenchCorpus::Medium)->UseRealTime();
+    BENCHMARK_CAPTURE(parse_source_pipelined, large, BenchCorpus::Large)->UseRealTime();
+    BENCHMARK_CAPTURE(parse_source_pipelined, deep_nesting, BenchCorpus::DeepNesting)->UseRealTime();
+} // namespace
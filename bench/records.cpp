@@ -0,0 +1,66 @@
+#include "frontend/lexer.h"
+#include "frontend/parser.h"
+#include "vm/codegen.h"
+#include "vm/interpreter.h"
+
+#include <benchmark/benchmark.h>
+#include <fmt/format.h>
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace
+{
+    talos::Program compile(std::string_view source)
+    {
+        auto lexer = talos::Lexer{source};
+        auto parser = talos::Parser{&lexer};
+        const auto program = parser.parse();
+        return talos::compile_program(program);
+    }
+
+    constexpr auto particle_count = 1 << 20;
+    constexpr auto scan_passes = 8;
+
+    // Fills an array of particles of 40 bytes, then sums their masses, of
+    // which a scan needs 8 bytes per particle. modifier is that of the struct
+    std::string particle_scan(std::string_view modifier)
+    {
+        return fmt::format("{0}struct Particle {{ x : f64, y : f64, z : f64, mass : f64, id : i32, alive : bool }} "
+                           "fun main() : i32 {{ var particles = [Particle(0.0, 0.0, 0.0, 0.0, 0, true); {1}]; var mass = 0.0; "
+                           "for var i = 0; i < particles.length; i = i + 1 {{ particles[i].mass = mass; mass = mass + 1.0; if mass == 7.0 {{ mass = 0.0; }} }} "
+                           "var total = 0.0; for var pass = 0; pass < {2}; pass = pass + 1 {{ "
+                           "for var i = 0; i < particles.length; i = i + 1 {{ total = total + particles[i].mass; }} }} "
+                           "if total > 0.0 {{ return 0; }} return 1; }}",
+                           modifier, particle_count, scan_passes);
+    }
+
+    // Runs main of source, counting the particles its passes scan
+    void run_scan(benchmark::State& state, const std::string& source)
+    {
+        const auto program = compile(source);
+        auto interpreter = talos::Interpreter{};
+        for (auto _ : state) {
+            auto result = interpreter.run(program);
+            benchmark::DoNotOptimize(result);
+        }
+        const auto records = std::int64_t{particle_count} * scan_passes;
+        state.counters["records"] = benchmark::Counter(static_cast<double>(records), benchmark::Counter::kIsIterationInvariantRate);
+    }
+
+    // Sums one field of every particle, which strides over whole particles
+    void aos_field_scan(benchmark::State& state)
+    {
+        run_scan(state, particle_scan(""));
+    }
+
+    // Sums the same field of a soa struct, stored as a contiguous column
+    void soa_field_scan(benchmark::State& state)
+    {
+        run_scan(state, particle_scan("soa "));
+    }
+
+    BENCHMARK(aos_field_scan)->Unit(benchmark::kMillisecond);
+    BENCHMARK(soa_field_scan)->Unit(benchmark::kMillisecond);
+} // namespace
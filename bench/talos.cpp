@@ -0,0 +1,87 @@
+#include "bench_utils.h"
+
+#include "talos.h"
+
+#include <fmt/format.h>
+
+#include <filesystem>
+#include <string>
+
+namespace
+{
+    using talos::bench::BenchCorpus;
+
+    void execute_string(benchmark::State& state, BenchCorpus corpus)
+    {
+        const auto& input = talos::bench::input_for(corpus);
+        const auto allocations = talos::bench::allocation_count();
+        auto vm = talos::TalosVM{};
+        for (auto _ : state) {
+            auto result = vm.execute_string(input.source);
+            benchmark::DoNotOptimize(result);
+        }
+        talos::bench::report_counters(state, input, talos::bench::allocation_count() - allocations);
+    }
+
+    BENCHMARK_CAPTURE(execute_string, small, BenchCorpus::Small);
+    BENCHMARK_CAPTURE(execute_string, medium, BenchCorpus::Medium);
+    BENCHMARK_CAPTURE(execute_string, large, BenchCorpus::Large);
+    BENCHMARK_CAPTURE(execute_string, deep_nesting, BenchCorpus::DeepNesting);
+
+    void execute_cached(benchmark::State& state, BenchCorpus corpus)
+    {
+        const auto& input = talos::bench::input_for(corpus);
+        const auto directory = std::filesystem::temp_directory_path() / "talos_bench_function_cache";
+        std::filesystem::remove_all(directory);
+        auto vm = talos::TalosVM{talos::VMOptions{.cache_directory = directory.string()}};
+        // Measures the warm cache
+        benchmark::DoNotOptimize(vm.execute_string(input.source));
+        const auto allocations = talos::bench::allocation_count();
+        for (auto _ : state) {
+            auto result = vm.execute_string(input.source);
+            benchmark::DoNotOptimize(result);
+        }
+        talos::bench::report_counters(state, input, talos::bench::allocation_count() - allocations);
+        std::filesystem::remove_all(directory);
+    }
+
+    BENCHMARK_CAPTURE(execute_cached, small, BenchCorpus::Small);
+    BENCHMARK_CAPTURE(execute_cached, medium, BenchCorpus::Medium);
+
+    // A generated library of functions, globals and structs of which main
+    // uses one in a hundred, run with and without leaving out the rest
+    void execute_pruned(benchmark::State& state, talos::Pruning prune)
+    {
+        constexpr auto functions = 5000;
+        constexpr auto used_every = 100;
+        auto source = std::string{};
+        for (auto i = 0; i < functions; ++i) {
+            source += fmt::format("struct Record{0} {{ a : i64, b : i64 }} var global{0} : i64 = {0}; "
+                                  "fun function{0}(x : i64) : i64 {{ let s = Record{0}(x, global{0}); var total : i64 = 0; "
+                                  "for var i : i64 = 0; i < 3; i = i + 1 {{ if s.a > i {{ total = total + s.b * i; }} else {{ total = total - s.a; }} }} return total; }}\n",
+                                  i);
+        }
+        source += "fun main() : i64 { var total : i64 = 0; ";
+        for (auto i = 0; i < functions; i += used_every) {
+            source += fmt::format("total = total + function{}({}); ", i, i);
+        }
+        source += "return total; }\n";
+
+        auto vm = talos::TalosVM{talos::VMOptions{.collect_stats = true, .run = true, .prune = prune}};
+        auto stats = talos::Stats{};
+        for (auto _ : state) {
+            auto result = vm.execute_string(source);
+            if (!result) {
+                state.SkipWithError(result.error().description.c_str());
+                return;
+            }
+            stats = result->stats;
+        }
+        state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * source.size()));
+        state.counters["functions_pruned"] = static_cast<double>(stats.functions_pruned);
+    }
+
+    BENCHMARK_CAPTURE(execute_pruned, none, talos::Pruning::None)->Unit(benchmark::kMillisecond);
+    BENCHMARK_CAPTURE(execute_pruned, unreachable, talos::Pruning::Unreachable)->Unit(benchmark::kMillisecond);
+    BENCHMARK_CAPTURE(execute_pruned, before_parsing, talos::Pruning::BeforeParsing)->Unit(benchmark::kMillisecond);
+} // namespace
@@ -0,0 +1,143 @@
+#include "vm/value.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+namespace
+{
+    using talos::Type;
+
+    // What a value would be if each carried its type the standard way
+    using VariantValue = std::variant<std::int64_t, double, bool, char, const std::string*>;
+
+    constexpr std::size_t value_count = 4096;
+    constexpr std::size_t frame_size = 64;
+
+    VariantValue variant_add(const VariantValue& lhs, const VariantValue& rhs)
+    {
+        return std::visit(
+            [&](const auto& a) -> VariantValue {
+                using T = std::decay_t<decltype(a)>;
+                if constexpr (std::is_same_v<T, std::int64_t> || std::is_same_v<T, double>) {
+                    return a + std::get<T>(rhs);
+                }
+                else {
+                    return a;
+                }
+            },
+            lhs);
+    }
+
+    // The addition of a value that is checked for its type, as the VM did
+    talos::Value tagged_add(const talos::Value& lhs, const talos::Value& rhs)
+    {
+        if (talos::is_floating(lhs.type)) {
+            return talos::Value::of_floating(lhs.type, talos::round_floating(lhs.type, lhs.floating + rhs.floating));
+        }
+        return talos::Value::of_integer(lhs.type, talos::wrap_integer(lhs.type, static_cast<std::int64_t>(static_cast<std::uint64_t>(lhs.integer) + static_cast<std::uint64_t>(rhs.integer))));
+    }
+
+    // The type comes with the instruction instead
+    talos::Word word_add(Type type, talos::Word lhs, talos::Word rhs)
+    {
+        switch (type) {
+            case Type::Int64:
+                return talos::Word{.integer = static_cast<std::int64_t>(static_cast<std::uint64_t>(lhs.integer) + static_cast<std::uint64_t>(rhs.integer))};
+            case Type::Float64:
+                return talos::Word{.floating = lhs.floating + rhs.floating};
+            default:
+                return talos::Word{.integer = talos::wrap_integer(type, static_cast<std::int64_t>(static_cast<std::uint64_t>(lhs.integer) + static_cast<std::uint64_t>(rhs.integer)))};
+        }
+    }
+
+    // Sums registers of mixed i64 and f64, each addition dispatching on a type
+    void values_sum_variant(benchmark::State& state)
+    {
+        auto values = std::vector<VariantValue>{};
+        for (std::size_t i = 0; i < value_count; ++i) {
+            values.emplace_back(i % 2 == 0 ? VariantValue{static_cast<std::int64_t>(i)} : VariantValue{static_cast<double>(i)});
+        }
+        for (auto _ : state) {
+            auto integers = VariantValue{std::int64_t{0}};
+            auto floats = VariantValue{0.0};
+            for (std::size_t i = 0; i < values.size(); i += 2) {
+                integers = variant_add(values[i], integers);
+                floats = variant_add(values[i + 1], floats);
+            }
+            benchmark::DoNotOptimize(integers);
+            benchmark::DoNotOptimize(floats);
+        }
+        state.counters["values"] = benchmark::Counter(static_cast<double>(value_count), benchmark::Counter::kIsIterationInvariantRate);
+    }
+
+    void values_sum_tagged(benchmark::State& state)
+    {
+        auto values = std::vector<talos::Value>{};
+        for (std::size_t i = 0; i < value_count; ++i) {
+            values.push_back(i % 2 == 0 ? talos::Value::of_integer(Type::Int64, static_cast<std::int64_t>(i)) : talos::Value::of_floating(Type::Float64, static_cast<double>(i)));
+        }
+        for (auto _ : state) {
+            auto integers = talos::Value::of_integer(Type::Int64, 0);
+            auto floats = talos::Value::of_floating(Type::Float64, 0.0);
+            for (std::size_t i = 0; i < values.size(); i += 2) {
+                integers = tagged_add(values[i], integers);
+                floats = tagged_add(values[i + 1], floats);
+            }
+            benchmark::DoNotOptimize(integers);
+            benchmark::DoNotOptimize(floats);
+        }
+        state.counters["values"] = benchmark::Counter(static_cast<double>(value_count), benchmark::Counter::kIsIterationInvariantRate);
+    }
+
+    void values_sum_word(benchmark::State& state)
+    {
+        auto values = std::vector<talos::Word>{};
+        // The type of each addition, as the instructions carry it
+        auto types = std::vector<Type>{};
+        for (std::size_t i = 0; i < value_count; ++i) {
+            values.push_back(i % 2 == 0 ? talos::Word{.integer = static_cast<std::int64_t>(i)} : talos::Word{.floating = static_cast<double>(i)});
+            types.push_back(i % 2 == 0 ? Type::Int64 : Type::Float64);
+        }
+        for (auto _ : state) {
+            auto integers = talos::Word{.integer = 0};
+            auto floats = talos::Word{.floating = 0.0};
+            for (std::size_t i = 0; i < values.size(); i += 2) {
+                integers = word_add(types[i], values[i], integers);
+                floats = word_add(types[i + 1], values[i + 1], floats);
+            }
+            benchmark::DoNotOptimize(integers);
+            benchmark::DoNotOptimize(floats);
+        }
+        state.counters["values"] = benchmark::Counter(static_cast<double>(value_count), benchmark::Counter::kIsIterationInvariantRate);
+    }
+
+    // Moves frames of registers down the stack, as calls pass arguments and
+    // return structs
+    template<typename T>
+    void values_frames(benchmark::State& state)
+    {
+        auto stack = std::vector<T>(value_count);
+        for (auto _ : state) {
+            for (std::size_t base = frame_size; base < stack.size(); base += frame_size) {
+                std::copy_n(stack.begin() + static_cast<std::ptrdiff_t>(base), frame_size, stack.begin() + static_cast<std::ptrdiff_t>(base - frame_size));
+            }
+            benchmark::ClobberMemory();
+        }
+        state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * (value_count - frame_size) * sizeof(T)));
+        state.counters["bytes_per_value"] = static_cast<double>(sizeof(T));
+    }
+
+    BENCHMARK(values_sum_variant)->Unit(benchmark::kMicrosecond);
+    BENCHMARK(values_sum_tagged)->Unit(benchmark::kMicrosecond);
+    BENCHMARK(values_sum_word)->Unit(benchmark::kMicrosecond);
+    BENCHMARK(values_frames<VariantValue>)->Name("values_frames/variant")->Unit(benchmark::kMicrosecond);
+    BENCHMARK(values_frames<talos::Value>)->Name("values_frames/tagged")->Unit(benchmark::kMicrosecond);
+    BENCHMARK(values_frames<talos::Word>)->Name("values_frames/word")->Unit(benchmark::kMicrosecond);
+} // namespace
@@ -0,0 +1,174 @@
+#include "bench_utils.h"
+
+#include "frontend/lexer.h"
+#include "frontend/parser.h"
+#include "vm/codegen.h"
+#include "vm/interpreter.h"
+#include "vm/vector_kernels.h"
+
+#include <fmt/format.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+    using talos::bench::BenchCorpus;
+
+    talos::Program compile(std::string_view source)
+    {
+        auto lexer = talos::Lexer{source};
+        auto parser = talos::Parser{&lexer};
+        const auto program = parser.parse();
+        return talos::compile_program(program);
+    }
+
+    void compile_program(benchmark::State& state, BenchCorpus corpus)
+    {
+        const auto& input = talos::bench::input_for(corpus);
+        auto lexer = talos::Lexer{input.source};
+        auto parser = talos::Parser{&lexer};
+        const auto program = parser.parse();
+        const auto allocations = talos::bench::allocation_count();
+        for (auto _ : state) {
+            auto bytecode = talos::compile_program(program);
+            benchmark::DoNotOptimize(bytecode);
+        }
+        talos::bench::report_counters(state, input, talos::bench::allocation_count() - allocations);
+    }
+
+    BENCHMARK_CAPTURE(compile_program, small, BenchCorpus::Small);
+    BENCHMARK_CAPTURE(compile_program, medium, BenchCorpus::Medium);
+
+    // Function N calls function N - 1 twice, so main makes 2^(depth + 1) - 1 calls
+    void calls(benchmark::State& state)
+    {
+        constexpr auto depth = 20;
+        auto source = std::string{"fun f0(x : i64) : i64 { return x + 1; }\n"};
+        for (auto i = 1; i <= depth; ++i) {
+            source += fmt::format("fun f{}(x : i64) : i64 {{ return f{}(x) + f{}(x); }}\n", i, i - 1, i - 1);
+        }
+        source += fmt::format("fun main() : i64 {{ return f{}(0); }}\n", depth);
+        const auto program = compile(source);
+        auto interpreter = talos::Interpreter{};
+        const auto allocations = talos::bench::allocation_count();
+        for (auto _ : state) {
+            auto result = interpreter.run(program);
+            benchmark::DoNotOptimize(result);
+        }
+        const auto calls_per_run = (std::int64_t{1} << (depth + 1)) - 1;
+        state.counters["calls"] = benchmark::Counter(static_cast<double>(calls_per_run), benchmark::Counter::kIsIterationInvariantRate);
+        state.counters["allocs"] = benchmark::Counter(static_cast<double>(talos::bench::allocation_count() - allocations), benchmark::Counter::kAvgIterations);
+    }
+
+    BENCHMARK(calls)->Unit(benchmark::kMillisecond);
+
+    // Runs main of source, which makes the given number of loop iterations
+    void run_loop(benchmark::State& state, std::string_view source, std::int64_t iterations_per_run)
+    {
+        const auto program = compile(source);
+        auto interpreter = talos::Interpreter{};
+        for (auto _ : state) {
+            auto result = interpreter.run(program);
+            benchmark::DoNotOptimize(result);
+        }
+        state.counters["iterations"] = benchmark::Counter(static_cast<double>(iterations_per_run), benchmark::Counter::kIsIterationInvariantRate);
+    }
+
+    void loop_sum(benchmark::State& state)
+    {
+        constexpr auto source = "fun main() : i64 { var total : i64 = 0; for var i : i64 = 0; i < 1000000; i = i + 1 { total = total + i; } return total; }";
+        run_loop(state, source, 1000000);
+    }
+
+    BENCHMARK(loop_sum)->Unit(benchmark::kMillisecond);
+
+    // The inner loop indexes a row major matrix, which strength reduction and
+    // hoisting of the row offset turn into additions
+    void nested_loops(benchmark::State& state)
+    {
+        constexpr auto source = "fun main() : i64 { var total : i64 = 0; let width : i64 = 1000; "
+                                "for var row : i64 = 0; row < 1000; row = row + 1 { "
+                                "for var column : i64 = 0; column < width; column = column + 1 { total = total + row * width + column * 8; } } "
+                                "return total; }";
+        run_loop(state, source, 1000 * 1000);
+    }
+
+    BENCHMARK(nested_loops)->Unit(benchmark::kMillisecond);
+
+    // Counts primes by trial division, the iterations are those of the inner loop
+    void primes(benchmark::State& state)
+    {
+        constexpr auto limit = 20000;
+        const auto source = fmt::format("fun main() : i32 {{ var count = 0; for var n = 2; n < {}; n = n + 1 {{ var prime = true; "
+                                        "for var d = 2; d * d <= n && prime; d = d + 1 {{ if n % d == 0 {{ prime = false; }} }} "
+                                        "if prime {{ count = count + 1; }} }} return count; }}",
+                                        limit);
+        auto iterations = std::int64_t{0};
+        for (auto n = 2; n < limit; ++n) {
+            for (auto d = 2; d * d <= n; ++d) {
+                ++iterations;
+                if (n % d == 0) {
+                    break;
+                }
+            }
+        }
+        run_loop(state, source, iterations);
+    }
+
+    BENCHMARK(primes)->Unit(benchmark::kMillisecond);
+
+    constexpr auto array_length = 65536;
+    constexpr auto array_passes = 100;
+
+    // a = a + b * b on whole arrays, which runs as two vector instructions
+    void array_elementwise(benchmark::State& state)
+    {
+        const auto source = fmt::format("fun main() : i32 {{ var a = [1.5 f32; {0}]; let b = [0.5 f32; {0}]; "
+                                        "for var i = 0; i < {1}; i = i + 1 {{ a = a + b * b; }} return 0; }}",
+                                        array_length, array_passes);
+        run_loop(state, source, std::int64_t{array_length} * array_passes);
+        state.SetLabel(fmt::format("{}", talos::vector_isa()));
+    }
+
+    BENCHMARK(array_elementwise)->Unit(benchmark::kMillisecond);
+
+    // The same computation one element at a time, whose bounds checks are
+    // eliminated
+    void array_element_loop(benchmark::State& state)
+    {
+        const auto source = fmt::format("fun main() : i32 {{ var a = [1.5 f32; {0}]; let b = [0.5 f32; {0}]; "
+                                        "for var i = 0; i < {1}; i = i + 1 {{ "
+                                        "for var j = 0; j < a.length; j = j + 1 {{ a[j] = a[j] + b[j] * b[j]; }} }} return 0; }}",
+                                        array_length, array_passes);
+        run_loop(state, source, std::int64_t{array_length} * array_passes);
+    }
+
+    BENCHMARK(array_element_loop)->Unit(benchmark::kMillisecond);
+
+    // One elementwise kernel on its own, per instruction set
+    void vector_kernel(benchmark::State& state, talos::VectorIsa isa)
+    {
+        if (isa > talos::vector_isa()) {
+            state.SkipWithError("not supported by this CPU");
+            return;
+        }
+        auto lhs = std::vector<float>(array_length, 1.5F);
+        const auto rhs = std::vector<float>(array_length, 0.5F);
+        auto* result = reinterpret_cast<std::byte*>(lhs.data());
+        const auto* operand = reinterpret_cast<const std::byte*>(rhs.data());
+        for (auto _ : state) {
+            auto done = talos::vector_arithmetic(talos::OpCode::Add, talos::Type::Float32, result, result, operand, lhs.size(), isa);
+            benchmark::DoNotOptimize(done);
+            benchmark::ClobberMemory();
+        }
+        state.counters["elements"] = benchmark::Counter(static_cast<double>(array_length), benchmark::Counter::kIsIterationInvariantRate);
+    }
+
+    BENCHMARK_CAPTURE(vector_kernel, scalar, talos::VectorIsa::Scalar)->Unit(benchmark::kMicrosecond);
+    BENCHMARK_CAPTURE(vector_kernel, sse2, talos::VectorIsa::Sse2)->Unit(benchmark::kMicrosecond);
+    BENCHMARK_CAPTURE(vector_kernel, avx2, talos::VectorIsa::Avx2)->Unit(benchmark::kMicrosecond);
+} // namespace
@@ -0,0 +1,27 @@
+// Replaces the global allocation functions of the talos executable so that
+// allocations can be attributed to the active compilation's statistics.
+// Only compiled when TALOS_ENABLE_STATS is defined
+
+#include "stats.h"
+
+#include <cstdlib>
+#include <new>
+
+void* operator new(std::size_t size)
+{
+    talos::record_allocation(size);
+    if (auto* ptr = std::malloc(size)) {
+        return ptr;
+    }
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
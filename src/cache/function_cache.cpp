@@ -0,0 +1,322 @@
+#include "function_cache.h"
+
+#include <fmt/format.h>
+
+#ifdef TALOS_CACHE_MMAP
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#else
+    #include <iterator>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <system_error>
+#include <vector>
+
+namespace talos
+{
+    namespace
+    {
+        // Bumped whenever the entry layout changes, compiled_version covers
+        // the compiled results
+        constexpr std::string_view magic = "TLC\x02";
+
+        void write_varint(std::string& out, std::uint64_t value)
+        {
+            while (value >= 0x80) {
+                out.push_back(static_cast<char>((value & 0x7FU) | 0x80U));
+                value >>= 7U;
+            }
+            out.push_back(static_cast<char>(value));
+        }
+
+        void write_string(std::string& out, std::string_view string)
+        {
+            write_varint(out, string.size());
+            out += string;
+        }
+
+        class Reader
+        {
+        public:
+            explicit Reader(std::string_view data)
+                : data_(data)
+            {
+            }
+
+            [[nodiscard]] std::optional<std::uint64_t> varint() noexcept
+            {
+                std::uint64_t value = 0;
+                for (unsigned shift = 0; shift < 64 && !data_.empty(); shift += 7) {
+                    const auto byte = static_cast<unsigned char>(data_.front());
+                    data_.remove_prefix(1);
+                    value |= static_cast<std::uint64_t>(byte & 0x7FU) << shift;
+                    if ((byte & 0x80U) == 0) {
+                        return value;
+                    }
+                }
+                return std::nullopt;
+            }
+
+            [[nodiscard]] std::optional<std::string> string()
+            {
+                const auto size = varint();
+                if (!size || *size > data_.size()) {
+                    return std::nullopt;
+                }
+                auto string = std::string{data_.substr(0, *size)};
+                data_.remove_prefix(*size);
+                return string;
+            }
+
+            [[nodiscard]] bool consume(std::string_view expected) noexcept
+            {
+                if (!data_.starts_with(expected)) {
+                    return false;
+                }
+                data_.remove_prefix(expected.size());
+                return true;
+            }
+
+            [[nodiscard]] bool empty() const noexcept { return data_.empty(); }
+
+        private:
+            std::string_view data_;
+        };
+
+        // Loads refresh the modification time of older entries, which eviction
+        // treats as their last use
+        constexpr auto touch_interval = std::chrono::minutes{1};
+        // Temporary files are renamed into place within milliseconds, older
+        // ones belong to writers that died
+        constexpr auto abandoned_age = std::chrono::hours{1};
+        constexpr std::string_view temporary_extension = ".tmp";
+
+#ifdef TALOS_CACHE_MMAP
+        class FileDescriptor
+        {
+        public:
+            explicit FileDescriptor(int fd) noexcept
+                : fd_(fd)
+            {
+            }
+            ~FileDescriptor()
+            {
+                if (fd_ >= 0) {
+                    ::close(fd_);
+                }
+            }
+            FileDescriptor(const FileDescriptor&) = delete;
+            FileDescriptor& operator=(const FileDescriptor&) = delete;
+
+            [[nodiscard]] int get() const noexcept { return fd_; }
+
+        private:
+            int fd_;
+        };
+
+        // Read only mapping of a whole file. Entries are replaced by renaming
+        // and never modified in place, so the mapping stays valid and complete
+        // even if the entry is replaced or evicted meanwhile
+        class MappedFile
+        {
+        public:
+            MappedFile(int fd, std::size_t size) noexcept
+                : data_(::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0))
+                , size_(size)
+            {
+            }
+            ~MappedFile()
+            {
+                if (data_ != MAP_FAILED) {
+                    ::munmap(data_, size_);
+                }
+            }
+            MappedFile(const MappedFile&) = delete;
+            MappedFile& operator=(const MappedFile&) = delete;
+
+            [[nodiscard]] bool valid() const noexcept { return data_ != MAP_FAILED; }
+            [[nodiscard]] std::string_view view() const noexcept { return {static_cast<const char*>(data_), size_}; }
+
+        private:
+            void* data_;
+            std::size_t size_;
+        };
+#endif
+    } // namespace
+
+    std::string serialize(const CompiledDeclaration& declaration)
+    {
+        auto out = std::string{magic};
+        write_varint(out, compiled_version);
+        write_varint(out, node_kind_count);
+        write_string(out, declaration.function_name);
+        write_string(out, declaration.return_type);
+        for (const auto count : declaration.nodes) {
+            write_varint(out, count);
+        }
+        write_string(out, declaration.dump);
+        return out;
+    }
+
+    std::optional<CompiledDeclaration> deserialize(std::string_view data)
+    {
+        auto reader = Reader{data};
+        if (!reader.consume(magic) || reader.varint() != compiled_version || reader.varint() != node_kind_count) {
+            return std::nullopt;
+        }
+        auto declaration = CompiledDeclaration{};
+        auto function_name = reader.string();
+        auto return_type = reader.string();
+        if (!function_name || !return_type) {
+            return std::nullopt;
+        }
+        declaration.function_name = std::move(*function_name);
+        declaration.return_type = std::move(*return_type);
+        for (auto& count : declaration.nodes) {
+            const auto value = reader.varint();
+            if (!value) {
+                return std::nullopt;
+            }
+            count = *value;
+        }
+        auto dump = reader.string();
+        // Truncated or trailing data means the entry was not written completely
+        if (!dump || !reader.empty()) {
+            return std::nullopt;
+        }
+        declaration.dump = std::move(*dump);
+        return declaration;
+    }
+
+    FunctionCache::FunctionCache(std::filesystem::path directory, std::uintmax_t max_size)
+        : directory_(std::move(directory))
+        , max_size_(max_size)
+        , random_(std::random_device{}())
+    {
+        auto error = std::error_code{};
+        std::filesystem::create_directories(directory_, error);
+    }
+
+    std::optional<CompiledDeclaration> FunctionCache::load(std::uint64_t key) const
+    {
+        const auto path = entry_path(key);
+#ifdef TALOS_CACHE_MMAP
+        const auto fd = FileDescriptor{::open(path.c_str(), O_RDONLY | O_CLOEXEC)};
+        struct stat status{};
+        if (fd.get() < 0 || ::fstat(fd.get(), &status) != 0 || status.st_size == 0) {
+            return std::nullopt;
+        }
+        auto declaration = std::optional<CompiledDeclaration>{};
+        {
+            const auto file = MappedFile{fd.get(), static_cast<std::size_t>(status.st_size)};
+            if (!file.valid()) {
+                return std::nullopt;
+            }
+            declaration = deserialize(file.view());
+        }
+        const auto age = std::chrono::system_clock::now() - std::chrono::system_clock::from_time_t(status.st_mtime);
+        if (declaration && age > touch_interval) {
+            ::futimens(fd.get(), nullptr);
+        }
+#else
+        auto file = std::ifstream{path, std::ios::binary};
+        if (!file) {
+            return std::nullopt;
+        }
+        const auto data = std::string{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+        auto declaration = deserialize(data);
+        auto error = std::error_code{};
+        const auto now = std::filesystem::file_time_type::clock::now();
+        if (declaration && now - std::filesystem::last_write_time(path, error) > touch_interval) {
+            std::filesystem::last_write_time(path, now, error);
+        }
+#endif
+        return declaration;
+    }
+
+    void FunctionCache::store(std::uint64_t key, const CompiledDeclaration& declaration)
+    {
+        const auto data = serialize(declaration);
+        const auto temporary = directory_ / fmt::format("{:016x}.{:016x}{}", key, random_(), temporary_extension);
+        auto error = std::error_code{};
+        {
+            auto file = std::ofstream{temporary, std::ios::binary | std::ios::trunc};
+            file.write(data.data(), static_cast<std::streamsize>(data.size()));
+            file.close();
+            if (!file) {
+                std::filesystem::remove(temporary, error);
+                return;
+            }
+        }
+        // Atomically replaces an entry another process stored meanwhile, which
+        // holds the same result
+        std::filesystem::rename(temporary, entry_path(key), error);
+        if (error) {
+            std::filesystem::remove(temporary, error);
+            return;
+        }
+
+        // Processes are often too short lived to write max_size / 8 bytes each,
+        // so rather than counting them every byte written starts an eviction
+        // pass with the same probability
+        const auto interval = std::max<std::uintmax_t>(max_size_ / 8, 1);
+        if (std::uniform_int_distribution<std::uintmax_t>{0, interval - 1}(random_) < data.size()) {
+            evict();
+        }
+    }
+
+    void FunctionCache::evict() const
+    {
+        struct Entry {
+            std::filesystem::file_time_type last_use;
+            std::uintmax_t size;
+            std::filesystem::path path;
+        };
+        auto entries = std::vector<Entry>{};
+        std::uintmax_t total_size = 0;
+        const auto now = std::filesystem::file_time_type::clock::now();
+
+        auto error = std::error_code{};
+        for (auto it = std::filesystem::directory_iterator{directory_, error}; !error && it != std::filesystem::directory_iterator{}; it.increment(error)) {
+            // Other processes may remove the entry at any time
+            auto entry_error = std::error_code{};
+            const auto last_use = it->last_write_time(entry_error);
+            const auto size = entry_error ? 0 : it->file_size(entry_error);
+            if (entry_error) {
+                continue;
+            }
+            if (it->path().extension() == temporary_extension) {
+                if (now - last_use > abandoned_age) {
+                    std::filesystem::remove(it->path(), entry_error);
+                }
+                continue;
+            }
+            total_size += size;
+            entries.push_back(Entry{.last_use = last_use, .size = size, .path = it->path()});
+        }
+        if (total_size <= max_size_) {
+            return;
+        }
+
+        // Evicting below the limit leaves room for a while before the next pass
+        const auto target_size = max_size_ / 4 * 3;
+        std::ranges::sort(entries, {}, &Entry::last_use);
+        for (const auto& entry : entries) {
+            if (total_size <= target_size) {
+                break;
+            }
+            std::filesystem::remove(entry.path, error);
+            total_size -= entry.size;
+        }
+    }
+
+    std::filesystem::path FunctionCache::entry_path(std::uint64_t key) const
+    {
+        return directory_ / fmt::format("{:016x}", key);
+    }
+} // namespace talos
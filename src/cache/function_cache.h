@@ -0,0 +1,65 @@
+#pragma once
+
+#include "frontend/node_kind.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+
+namespace talos
+{
+    // Results of compiling a top-level declaration. None depend on where the
+    // declaration appears in the source, so they can be reused after edits
+    // elsewhere
+    struct CompiledDeclaration {
+        // Empty unless the declaration is a function
+        std::string function_name;
+        std::string return_type;
+        NodeCounts nodes{};
+        std::string dump;
+
+        friend bool operator==(const CompiledDeclaration&, const CompiledDeclaration&) = default;
+    };
+
+    // Version of the compiled results, bumped whenever the dump of any
+    // declaration changes. It is part of every key and entry, as is
+    // node_kind_count, so entries of other versions are never loaded
+    inline constexpr std::uint64_t compiled_version = 3;
+
+    [[nodiscard]] std::string serialize(const CompiledDeclaration& declaration);
+    // Returns nullopt if data is not a complete serialized declaration
+    [[nodiscard]] std::optional<CompiledDeclaration> deserialize(std::string_view data);
+
+    // Compiled declarations persisted in a directory that any number of
+    // processes may share, one file per key. Entries are written to a
+    // temporary file and renamed into place, so readers never see a partial
+    // entry and take no locks. Loading an entry marks it as recently used, and
+    // the least recently used entries are evicted once the directory grows
+    // past max_size. The cache is best effort: unreadable entries are misses
+    // and failed writes are ignored. Instances must not be shared by threads
+    class FunctionCache
+    {
+    public:
+        FunctionCache(std::filesystem::path directory, std::uintmax_t max_size);
+
+        [[nodiscard]] std::optional<CompiledDeclaration> load(std::uint64_t key) const;
+        void store(std::uint64_t key, const CompiledDeclaration& declaration);
+        // Removes least recently used entries until the directory is back to
+        // three quarters of max_size, as well as temporary files abandoned by
+        // writers that died. Called by store every max_size / 8 bytes written
+        // on average
+        void evict() const;
+
+        [[nodiscard]] const std::filesystem::path& directory() const noexcept { return directory_; }
+
+    private:
+        [[nodiscard]] std::filesystem::path entry_path(std::uint64_t key) const;
+
+        std::filesystem::path directory_;
+        std::uintmax_t max_size_;
+        std::mt19937_64 random_;
+    };
+} // namespace talos
@@ -0,0 +1,407 @@
+#include "compile_server.h"
+
+#include "talos.h"
+#include "trace.h"
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <system_error>
+
+namespace talos::daemon
+{
+    namespace
+    {
+        // Every message is a frame of a type byte, a native endian 32 bit payload
+        // length and the payload. Client and server always run on the same host
+        enum class FrameType : std::uint8_t {
+            // Request flags byte, dump format byte and path
+            Compile = 1,
+            Stop,
+            Stdout,
+            Stderr,
+            // Exit code as a native endian 32 bit integer, ends the response
+            Exit,
+        };
+
+        // Output is sent in frames of at most this size, and requests only
+        // hold a path. Longer frames are rejected before anything is allocated
+        constexpr std::size_t max_payload = 64 * 1024;
+        constexpr std::uint8_t per_function_flag = 1;
+        constexpr std::uint8_t pipeline_lexer_flag = 2;
+
+        std::system_error socket_error(const char* what)
+        {
+            return std::system_error{errno, std::generic_category(), what};
+        }
+
+        class FileDescriptor
+        {
+        public:
+            explicit FileDescriptor(int fd) noexcept
+                : fd_(fd)
+            {
+            }
+            ~FileDescriptor()
+            {
+                if (fd_ >= 0) {
+                    ::close(fd_);
+                }
+            }
+            FileDescriptor(const FileDescriptor&) = delete;
+            FileDescriptor& operator=(const FileDescriptor&) = delete;
+
+            [[nodiscard]] int get() const noexcept { return fd_; }
+
+        private:
+            int fd_;
+        };
+
+        std::optional<sockaddr_un> socket_address(const std::string& path)
+        {
+            auto address = sockaddr_un{};
+            address.sun_family = AF_UNIX;
+            if (path.size() >= sizeof(address.sun_path)) {
+                return std::nullopt;
+            }
+            std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+            return address;
+        }
+
+        int connect_to(const std::string& path)
+        {
+            const auto address = socket_address(path);
+            if (!address) {
+                return -1;
+            }
+            const auto fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+            if (fd < 0) {
+                return -1;
+            }
+            if (::connect(fd, reinterpret_cast<const sockaddr*>(&*address), sizeof(*address)) != 0) {
+                ::close(fd);
+                return -1;
+            }
+            return fd;
+        }
+
+        // Writes to a peer that went away fail with EPIPE instead of raising
+        // SIGPIPE, which would terminate the process embedding the server
+        bool write_all(int fd, const void* data, std::size_t size) noexcept
+        {
+            const auto* bytes = static_cast<const char*>(data);
+            while (size > 0) {
+                const auto written = ::send(fd, bytes, size, MSG_NOSIGNAL);
+                if (written < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (written <= 0) {
+                    return false;
+                }
+                bytes += written;
+                size -= static_cast<std::size_t>(written);
+            }
+            return true;
+        }
+
+        // Reads and writes on fd fail with EAGAIN once they made no progress for timeout
+        bool set_timeouts(int fd, std::chrono::milliseconds timeout) noexcept
+        {
+            auto value = timeval{};
+            value.tv_sec = static_cast<time_t>(timeout.count() / 1000);
+            value.tv_usec = static_cast<suseconds_t>(timeout.count() % 1000 * 1000);
+            return ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &value, sizeof(value)) == 0 &&
+                   ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &value, sizeof(value)) == 0;
+        }
+
+        bool read_exact(int fd, void* data, std::size_t size) noexcept
+        {
+            auto* bytes = static_cast<char*>(data);
+            while (size > 0) {
+                const auto read = ::read(fd, bytes, size);
+                if (read < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (read <= 0) {
+                    return false;
+                }
+                bytes += read;
+                size -= static_cast<std::size_t>(read);
+            }
+            return true;
+        }
+
+        bool write_frame(int fd, FrameType type, std::string_view payload) noexcept
+        {
+            char header[5];
+            const auto length = static_cast<std::uint32_t>(payload.size());
+            header[0] = static_cast<char>(type);
+            std::memcpy(header + 1, &length, sizeof(length));
+            return write_all(fd, header, sizeof(header)) && write_all(fd, payload.data(), payload.size());
+        }
+
+        // Large output is split so that clients can forward it as it arrives
+        bool write_output(int fd, FrameType type, std::string_view output) noexcept
+        {
+            while (!output.empty()) {
+                const auto chunk = output.substr(0, max_payload);
+                if (!write_frame(fd, type, chunk)) {
+                    return false;
+                }
+                output.remove_prefix(chunk.size());
+            }
+            return true;
+        }
+
+        bool write_exit(int fd, int exit_code) noexcept
+        {
+            const auto code = static_cast<std::int32_t>(exit_code);
+            return write_frame(fd, FrameType::Exit, std::string_view{reinterpret_cast<const char*>(&code), sizeof(code)});
+        }
+
+        std::optional<std::pair<FrameType, std::string>> read_frame(int fd)
+        {
+            char header[5];
+            if (!read_exact(fd, header, sizeof(header))) {
+                return std::nullopt;
+            }
+            std::uint32_t length = 0;
+            std::memcpy(&length, header + 1, sizeof(length));
+            if (length > max_payload) {
+                return std::nullopt;
+            }
+            auto payload = std::string(length, '\0');
+            if (!read_exact(fd, payload.data(), payload.size())) {
+                return std::nullopt;
+            }
+            return std::pair{static_cast<FrameType>(header[0]), std::move(payload)};
+        }
+
+        std::string encode(const CompileRequest& request)
+        {
+            auto payload = std::string{};
+            payload.push_back(static_cast<char>((request.per_function ? per_function_flag : 0) | (request.pipeline_lexer ? pipeline_lexer_flag : 0)));
+            payload.push_back(static_cast<char>(request.dump_ast));
+            payload += request.path;
+            return payload;
+        }
+
+        std::optional<CompileRequest> decode(std::string_view payload)
+        {
+            if (payload.size() < 2 || static_cast<std::uint8_t>(payload[1]) > static_cast<std::uint8_t>(DumpFormat::Binary)) {
+                return std::nullopt;
+            }
+            const auto flags = static_cast<std::uint8_t>(payload[0]);
+            return CompileRequest{
+                .path = std::string{payload.substr(2)},
+                .dump_ast = static_cast<DumpFormat>(payload[1]),
+                .per_function = (flags & per_function_flag) != 0,
+                .pipeline_lexer = (flags & pipeline_lexer_flag) != 0,
+            };
+        }
+
+        // FILE writing into a growing memory buffer
+        class MemoryStream
+        {
+        public:
+            MemoryStream()
+                : file_(open_memstream(&buffer_, &size_))
+            {
+                if (file_ == nullptr) {
+                    throw std::system_error{errno, std::generic_category(), "open_memstream"};
+                }
+            }
+            ~MemoryStream()
+            {
+                std::fclose(file_);
+                std::free(buffer_);
+            }
+            MemoryStream(const MemoryStream&) = delete;
+            MemoryStream& operator=(const MemoryStream&) = delete;
+
+            [[nodiscard]] std::FILE* file() const noexcept { return file_; }
+
+            [[nodiscard]] std::string str()
+            {
+                std::fflush(file_);
+                return std::string{buffer_, size_};
+            }
+
+        private:
+            char* buffer_ = nullptr;
+            std::size_t size_ = 0;
+            std::FILE* file_;
+        };
+
+        CompileResult compile_file(const CompileRequest& request)
+        {
+            TALOS_TRACE_SCOPE("compile_file");
+            // The AST dump is captured instead of going to the server's stdout
+            auto output = MemoryStream{};
+            auto vm = TalosVM{VMOptions{
+                .dump_ast = request.dump_ast,
+                .dump_output = output.file(),
+                .pipeline_lexer = request.pipeline_lexer,
+                .per_function = request.per_function,
+            }};
+            const auto vm_result = vm.execute_file(request.path);
+
+            auto result = CompileResult{.output = output.str()};
+            if (!vm_result) {
+                result.exit_code = static_cast<int>(vm_result.error().code);
+                result.diagnostics = vm_result.error().description + '\n';
+            }
+            return result;
+        }
+    } // namespace
+
+    CompileServer::CompileServer(std::string socket_path, std::chrono::milliseconds timeout)
+        : socket_path_(std::move(socket_path))
+        , timeout_(timeout)
+    {
+        const auto address = socket_address(socket_path_);
+        if (!address) {
+            throw std::system_error{std::make_error_code(std::errc::filename_too_long), "Socket path"};
+        }
+        socket_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (socket_ < 0) {
+            throw socket_error("socket");
+        }
+        auto bound = ::bind(socket_, reinterpret_cast<const sockaddr*>(&*address), sizeof(*address)) == 0;
+        if (!bound && errno == EADDRINUSE) {
+            // Only take over the path if nothing is listening on it any more
+            if (const auto other = connect_to(socket_path_); other >= 0) {
+                ::close(other);
+                errno = EADDRINUSE;
+            }
+            else {
+                ::unlink(socket_path_.c_str());
+                bound = ::bind(socket_, reinterpret_cast<const sockaddr*>(&*address), sizeof(*address)) == 0;
+            }
+        }
+        if (!bound || ::listen(socket_, SOMAXCONN) != 0) {
+            const auto error = socket_error(bound ? "listen" : "bind");
+            ::close(socket_);
+            throw error;
+        }
+    }
+
+    CompileServer::~CompileServer()
+    {
+        ::close(socket_);
+        ::unlink(socket_path_.c_str());
+    }
+
+    void CompileServer::run()
+    {
+        for (;;) {
+            const auto connection = FileDescriptor{::accept(socket_, nullptr, nullptr)};
+            if (connection.get() < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) {
+                    continue;
+                }
+                throw socket_error("accept");
+            }
+            if (!set_timeouts(connection.get(), timeout_)) {
+                continue;
+            }
+            if (!serve(connection.get())) {
+                return;
+            }
+        }
+    }
+
+    const CompileResult& CompileServer::compile(const CompileRequest& request)
+    {
+        TALOS_TRACE_SCOPE("compile_request");
+        auto error = std::error_code{};
+        const auto modified = std::filesystem::last_write_time(request.path, error);
+        const auto size = error ? 0 : std::filesystem::file_size(request.path, error);
+        if (error) {
+            // Not cached, e.g. so that a missing file is found once it is created
+            cache_.erase(request.path);
+            uncached_ = compile_file(request);
+            return uncached_;
+        }
+
+        auto& entry = cache_[request.path];
+        if (entry.request == request && entry.modified == modified && entry.size == size) {
+            ++cache_hits_;
+            return entry.result;
+        }
+        entry = CacheEntry{
+            .request = request,
+            .modified = modified,
+            .size = size,
+            .result = compile_file(request),
+        };
+        return entry.result;
+    }
+
+    bool CompileServer::serve(int connection)
+    {
+        const auto frame = read_frame(connection);
+        if (!frame) {
+            return true;
+        }
+        const auto& [type, payload] = *frame;
+        if (type == FrameType::Stop) {
+            write_exit(connection, 0);
+            return false;
+        }
+        const auto request = type == FrameType::Compile ? decode(payload) : std::nullopt;
+        if (!request) {
+            return true;
+        }
+        const auto& result = compile(*request);
+        static_cast<void>(write_output(connection, FrameType::Stdout, result.output) &&
+                          write_output(connection, FrameType::Stderr, result.diagnostics) &&
+                          write_exit(connection, result.exit_code));
+        return true;
+    }
+
+    std::optional<int> request_compile(const std::string& socket_path, const CompileRequest& request, const OutputCallback& on_output)
+    {
+        const auto connection = FileDescriptor{connect_to(socket_path)};
+        if (connection.get() < 0 || !write_frame(connection.get(), FrameType::Compile, encode(request))) {
+            return std::nullopt;
+        }
+        for (;;) {
+            const auto frame = read_frame(connection.get());
+            if (!frame) {
+                // Output may already have been forwarded, so report rather than retry
+                on_output(OutputStream::Stderr, "Connection to the compile server was lost\n");
+                return static_cast<int>(ReturnCode::ReadError);
+            }
+            const auto& [type, payload] = *frame;
+            switch (type) {
+                case FrameType::Stdout:
+                    on_output(OutputStream::Stdout, payload);
+                    break;
+                case FrameType::Stderr:
+                    on_output(OutputStream::Stderr, payload);
+                    break;
+                case FrameType::Exit: {
+                    std::int32_t code = 0;
+                    std::memcpy(&code, payload.data(), std::min(payload.size(), sizeof(code)));
+                    return code;
+                }
+                default:
+                    break;
+            }
+        }
+    }
+
+    bool request_stop(const std::string& socket_path)
+    {
+        const auto connection = FileDescriptor{connect_to(socket_path)};
+        return connection.get() >= 0 && write_frame(connection.get(), FrameType::Stop, {}) && read_frame(connection.get()).has_value();
+    }
+} // namespace talos::daemon
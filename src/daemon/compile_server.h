@@ -0,0 +1,94 @@
+#pragma once
+
+#include "frontend/ast_dump.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace talos::daemon
+{
+    struct CompileRequest {
+        // Absolute, as the server does not share the client's working directory
+        std::string path;
+        DumpFormat dump_ast = DumpFormat::None;
+        bool per_function = false;
+        bool pipeline_lexer = false;
+
+        friend bool operator==(const CompileRequest&, const CompileRequest&) = default;
+    };
+
+    struct CompileResult {
+        int exit_code = 0;
+        // What a local run writes to stdout and stderr
+        std::string output;
+        std::string diagnostics;
+    };
+
+    enum class OutputStream {
+        Stdout,
+        Stderr,
+    };
+
+    // Long-running compiler listening on a Unix domain socket, so that repeated
+    // short invocations skip process startup and reuse warm state. Results are
+    // cached per file and reused while its size and modification time are
+    // unchanged. Connections are served one at a time, so one that sends or
+    // receives nothing for timeout is dropped rather than blocking the others
+    class CompileServer
+    {
+    public:
+        static constexpr auto default_timeout = std::chrono::milliseconds{5000};
+
+        // Listens on socket_path, replacing a stale socket left behind by a
+        // server that is no longer running. Throws std::system_error on failure
+        explicit CompileServer(std::string socket_path, std::chrono::milliseconds timeout = default_timeout);
+        ~CompileServer();
+
+        CompileServer(const CompileServer&) = delete;
+        CompileServer& operator=(const CompileServer&) = delete;
+
+        // Serves connections until a client requests the server to stop
+        void run();
+
+        // Compiles through the cache, as done for each client request
+        [[nodiscard]] const CompileResult& compile(const CompileRequest& request);
+
+        [[nodiscard]] std::size_t cache_hits() const noexcept { return cache_hits_; }
+
+    private:
+        struct CacheEntry {
+            CompileRequest request;
+            std::filesystem::file_time_type modified;
+            std::uintmax_t size = 0;
+            CompileResult result;
+        };
+
+        // Returns false once the client asked the server to stop
+        bool serve(int connection);
+
+        std::string socket_path_;
+        std::chrono::milliseconds timeout_;
+        int socket_ = -1;
+        std::unordered_map<std::string, CacheEntry> cache_;
+        // Result of the last compile of a file that could not be stat'ed
+        CompileResult uncached_;
+        std::size_t cache_hits_ = 0;
+    };
+
+    using OutputCallback = std::function<void(OutputStream stream, std::string_view data)>;
+
+    // Compiles on the server listening on socket_path, handing output to
+    // on_output as it arrives. Returns the exit code, or nullopt if no server
+    // could be reached
+    [[nodiscard]] std::optional<int> request_compile(const std::string& socket_path, const CompileRequest& request, const OutputCallback& on_output);
+
+    // Returns false if no server could be reached
+    bool request_stop(const std::string& socket_path);
+} // namespace talos::daemon
@@ -22,4 +22,12 @@ namespace talos
     {
         return {ReturnCode::UnexpectedToken, location, std::move(message)};
     }
+    TalosException nesting_too_deep(SourceLocation location, std::string message)
+    {
+        return {ReturnCode::NestingTooDeep, location, std::move(message)};
+    }
+    TalosException type_error(SourceLocation location, std::string message)
+    {
+        return {ReturnCode::TypeError, location, std::move(message)};
+    }
 } // namespace talos
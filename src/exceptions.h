@@ -26,4 +26,6 @@ namespace talos
     TalosException unexpected_eof(SourceLocation location, std::string message = "");
     TalosException syntax_error(SourceLocation location, std::string message = "");
     TalosException unexpected_token(SourceLocation location, std::string message = "");
+    TalosException nesting_too_deep(SourceLocation location, std::string message = "");
+    TalosException type_error(SourceLocation location, std::string message = "");
 } // namespace talos
@@ -1,91 +1,352 @@
 #include "ast.h"
 
+#include "string_literal.h"
+
 namespace talos
 {
+    namespace
+    {
+        // Shallow trees are destroyed by plain recursion, which needs no
+        // allocation. Below this depth descendants go to a work list instead
+        constexpr std::size_t max_recursive_destruction = 256;
+
+        thread_local std::size_t destruction_depth = 0;
+        // Work list of the destruction further up the stack, if any
+        thread_local std::vector<ASTNodePtr>* pending_destruction = nullptr;
+
+        template<typename Node>
+        void destroy(std::unique_ptr<Node> node) noexcept
+        {
+            if (node == nullptr) {
+                return;
+            }
+            if (pending_destruction != nullptr) {
+                pending_destruction->push_back(std::move(node));
+                return;
+            }
+            if (destruction_depth < max_recursive_destruction) {
+                ++destruction_depth;
+                node.reset();
+                --destruction_depth;
+                return;
+            }
+
+            auto pending = std::vector<ASTNodePtr>{};
+            pending.push_back(std::move(node));
+            pending_destruction = &pending;
+            while (!pending.empty()) {
+                // Destroying a node appends its children
+                auto next = std::move(pending.back());
+                pending.pop_back();
+                next.reset();
+            }
+            pending_destruction = nullptr;
+        }
+    } // namespace
+
     BinaryExpr::BinaryExpr(ExprPtr lhs, Token op, ExprPtr rhs)
-        : lhs_(std::move(lhs))
+        : Expr(NodeKind::BinaryExpr)
+        , lhs_(std::move(lhs))
         , op_(op)
         , rhs_(std::move(rhs))
     {
     }
 
+    BinaryExpr::~BinaryExpr()
+    {
+        destroy(std::move(lhs_));
+        destroy(std::move(rhs_));
+    }
+
     UnaryExpr::UnaryExpr(Token unary_op, ExprPtr expr)
-        : unary_op_(unary_op)
+        : Expr(NodeKind::UnaryExpr)
+        , unary_op_(unary_op)
         , expr_(std::move(expr))
     {
     }
 
+    UnaryExpr::~UnaryExpr()
+    {
+        destroy(std::move(expr_));
+    }
+
     ParenExpr::ParenExpr(ExprPtr expr)
-        : expr_(std::move(expr))
+        : Expr(NodeKind::ParenExpr)
+        , expr_(std::move(expr))
+    {
+    }
+
+    ParenExpr::~ParenExpr()
     {
+        destroy(std::move(expr_));
     }
 
     IntLiteralExpr::IntLiteralExpr(Token int_literal, std::optional<Token> suffix)
-        : int_literal_(int_literal)
+        : Expr(NodeKind::IntLiteralExpr)
+        , int_literal_(int_literal)
         , suffix_(suffix)
     {
     }
 
     StringLiteralExpr::StringLiteralExpr(Token string_literal)
-        : string_literal_(string_literal)
+        : Expr(NodeKind::StringLiteralExpr)
+        , string_literal_(string_literal)
     {
     }
 
+    std::string StringLiteralExpr::value() const
+    {
+        return decode_string_literal(string_literal_.string);
+    }
+
     CharLiteralExpr::CharLiteralExpr(Token char_literal)
-        : char_literal_(char_literal)
+        : Expr(NodeKind::CharLiteralExpr)
+        , char_literal_(char_literal)
     {
     }
 
     FloatingLiteralExpr::FloatingLiteralExpr(Token float_literal, std::optional<Token> suffix)
-        : float_literal_(float_literal)
+        : Expr(NodeKind::FloatingLiteralExpr)
+        , float_literal_(float_literal)
         , suffix_(suffix)
     {
     }
 
     BoolLiteralExpr::BoolLiteralExpr(Token bool_literal)
-        : bool_literal_(bool_literal)
+        : Expr(NodeKind::BoolLiteralExpr)
+        , bool_literal_(bool_literal)
     {
     }
 
     IdentifierExpr::IdentifierExpr(Token identifier)
-        : identifier_(identifier)
+        : Expr(NodeKind::IdentifierExpr)
+        , identifier_(identifier)
     {
     }
 
     AssignmentExpr::AssignmentExpr(ExprPtr lhs, ExprPtr rhs)
-        : lhs_(std::move(lhs))
+        : Expr(NodeKind::AssignmentExpr)
+        , lhs_(std::move(lhs))
         , rhs_(std::move(rhs))
     // ippek<3
     {
     }
 
+    AssignmentExpr::~AssignmentExpr()
+    {
+        destroy(std::move(lhs_));
+        destroy(std::move(rhs_));
+    }
+
+    CallExpr::CallExpr(ExprPtr callee, ExprList arguments)
+        : Expr(NodeKind::CallExpr)
+        , callee_(std::move(callee))
+        , arguments_(std::move(arguments))
+    {
+    }
+
+    CallExpr::~CallExpr()
+    {
+        destroy(std::move(callee_));
+        for (auto& argument : arguments_) {
+            destroy(std::move(argument));
+        }
+    }
+
+    FieldExpr::FieldExpr(ExprPtr object, Token field)
+        : Expr(NodeKind::FieldExpr)
+        , object_(std::move(object))
+        , field_(field)
+    {
+    }
+
+    FieldExpr::~FieldExpr()
+    {
+        destroy(std::move(object_));
+    }
+
+    IndexExpr::IndexExpr(ExprPtr array, Token bracket, ExprPtr index)
+        : Expr(NodeKind::IndexExpr)
+        , array_(std::move(array))
+        , bracket_(bracket)
+        , index_(std::move(index))
+    {
+    }
+
+    IndexExpr::~IndexExpr()
+    {
+        destroy(std::move(array_));
+        destroy(std::move(index_));
+    }
+
+    ArrayLiteralExpr::ArrayLiteralExpr(Token bracket, ExprList elements, std::optional<Token> count)
+        : Expr(NodeKind::ArrayLiteralExpr)
+        , bracket_(bracket)
+        , elements_(std::move(elements))
+        , count_(count)
+    {
+    }
+
+    ArrayLiteralExpr::~ArrayLiteralExpr()
+    {
+        for (auto& element : elements_) {
+            destroy(std::move(element));
+        }
+    }
+
     ExprStatement::ExprStatement(ExprPtr expr)
-        : expr_(std::move(expr))
+        : Statement(NodeKind::ExprStatement)
+        , expr_(std::move(expr))
     {
     }
 
     ReturnStatement::ReturnStatement(ExprPtr return_value)
-        : return_value_(std::move(return_value))
+        : Statement(NodeKind::ReturnStatement)
+        , return_value_(std::move(return_value))
     {
     }
 
-    VarDeclStatement::VarDeclStatement(Token decl_type, Token identifier, std::optional<Token> type_spec, ExprPtr initializer)
-        : decl_type_(decl_type)
+    VarDeclStatement::VarDeclStatement(Token decl_type, Token identifier, std::optional<TypeSpec> type_spec, ExprPtr initializer)
+        : Statement(NodeKind::VarDeclStatement)
+        , decl_type_(decl_type)
         , identifier_(identifier)
         , type_specifier_(type_spec)
         , initializer_(std::move(initializer))
     {
     }
 
-    FunDeclStatement::FunDeclStatement(Token identifier, std::optional<Token> type_spec, StatementList statements)
-        : identifier_(identifier)
+    FunDeclStatement::FunDeclStatement(Token identifier, std::vector<Parameter> parameters, std::optional<TypeSpec> type_spec, StatementList statements)
+        : Statement(NodeKind::FunDeclStatement)
+        , identifier_(identifier)
+        , parameters_(std::move(parameters))
         , type_spec_(type_spec)
         , statements_(std::move(statements))
     {
     }
 
+    FunDeclStatement::~FunDeclStatement()
+    {
+        for (auto& statement : statements_) {
+            destroy(std::move(statement));
+        }
+    }
+
+    StructDeclStatement::StructDeclStatement(Token identifier, std::vector<StructField> fields, bool packed, bool soa)
+        : Statement(NodeKind::StructDeclStatement)
+        , identifier_(identifier)
+        , fields_(std::move(fields))
+        , packed_(packed)
+        , soa_(soa)
+    {
+    }
+
+    BlockStatement::BlockStatement(StatementList statements)
+        : Statement(NodeKind::BlockStatement)
+        , statements_(std::move(statements))
+    {
+    }
+
+    BlockStatement::~BlockStatement()
+    {
+        for (auto& statement : statements_) {
+            destroy(std::move(statement));
+        }
+    }
+
+    IfStatement::IfStatement(ExprPtr condition, StatementPtr then_branch, StatementPtr else_branch)
+        : Statement(NodeKind::IfStatement)
+        , condition_(std::move(condition))
+        , then_branch_(std::move(then_branch))
+        , else_branch_(std::move(else_branch))
+    {
+    }
+
+    IfStatement::~IfStatement()
+    {
+        destroy(std::move(condition_));
+        destroy(std::move(then_branch_));
+        destroy(std::move(else_branch_));
+    }
+
+    WhileStatement::WhileStatement(ExprPtr condition, StatementPtr body)
+        : Statement(NodeKind::WhileStatement)
+        , condition_(std::move(condition))
+        , body_(std::move(body))
+    {
+    }
+
+    WhileStatement::~WhileStatement()
+    {
+        destroy(std::move(condition_));
+        destroy(std::move(body_));
+    }
+
+    ForStatement::ForStatement(StatementPtr initializer, ExprPtr condition, ExprPtr increment, StatementPtr body)
+        : Statement(NodeKind::ForStatement)
+        , initializer_(std::move(initializer))
+        , condition_(std::move(condition))
+        , increment_(std::move(increment))
+        , body_(std::move(body))
+    {
+    }
+
+    ForStatement::~ForStatement()
+    {
+        destroy(std::move(initializer_));
+        destroy(std::move(condition_));
+        destroy(std::move(increment_));
+        destroy(std::move(body_));
+    }
+
     ProgramNode::ProgramNode(std::vector<StatementPtr> statements)
-        : statements_(std::move(statements))
+        : ASTNode(NodeKind::Program)
+        , statements_(std::move(statements))
+    {
+    }
+
+    SourceLocation location_of(const Expr& expr) noexcept
     {
+        // Parentheses and assignments keep no tokens of their own
+        const auto* node = &expr;
+        for (;;) {
+            switch (node->kind()) {
+                case NodeKind::BinaryExpr:
+                    node = static_cast<const BinaryExpr*>(node)->lhs();
+                    break;
+                case NodeKind::UnaryExpr:
+                    return static_cast<const UnaryExpr*>(node)->unary_op().location;
+                case NodeKind::ParenExpr:
+                    node = static_cast<const ParenExpr*>(node)->expr();
+                    break;
+                case NodeKind::IntLiteralExpr:
+                    return static_cast<const IntLiteralExpr*>(node)->int_literal().location;
+                case NodeKind::StringLiteralExpr:
+                    return static_cast<const StringLiteralExpr*>(node)->string_literal().location;
+                case NodeKind::CharLiteralExpr:
+                    return static_cast<const CharLiteralExpr*>(node)->char_literal().location;
+                case NodeKind::FloatingLiteralExpr:
+                    return static_cast<const FloatingLiteralExpr*>(node)->float_literal().location;
+                case NodeKind::BoolLiteralExpr:
+                    return static_cast<const BoolLiteralExpr*>(node)->bool_literal().location;
+                case NodeKind::IdentifierExpr:
+                    return static_cast<const IdentifierExpr*>(node)->identifier().location;
+                case NodeKind::AssignmentExpr:
+                    node = static_cast<const AssignmentExpr*>(node)->lhs();
+                    break;
+                case NodeKind::CallExpr:
+                    node = static_cast<const CallExpr*>(node)->callee();
+                    break;
+                case NodeKind::FieldExpr:
+                    node = static_cast<const FieldExpr*>(node)->object();
+                    break;
+                case NodeKind::IndexExpr:
+                    node = static_cast<const IndexExpr*>(node)->array();
+                    break;
+                case NodeKind::ArrayLiteralExpr:
+                    return static_cast<const ArrayLiteralExpr*>(node)->bracket().location;
+                default:
+                    return {};
+            }
+        }
     }
 } // namespace talos
@@ -1,10 +1,12 @@
 #pragma once
 
+#include "node_kind.h"
 #include "token.h"
 
 #include <memory>
 #include <optional>
 #include <span>
+#include <string>
 #include <vector>
 
 namespace talos
@@ -21,17 +23,27 @@ namespace talos
     class BoolLiteralExpr;
     class IdentifierExpr;
     class AssignmentExpr;
+    class CallExpr;
+    class FieldExpr;
+    class IndexExpr;
+    class ArrayLiteralExpr;
     class Statement;
     class ExprStatement;
     class ReturnStatement;
     class VarDeclStatement;
     class FunDeclStatement;
+    class StructDeclStatement;
+    class BlockStatement;
+    class IfStatement;
+    class WhileStatement;
+    class ForStatement;
     class ProgramNode;
 
     using ASTNodePtr = std::unique_ptr<ASTNode>;
     using ExprPtr = std::unique_ptr<Expr>;
     using StatementPtr = std::unique_ptr<Statement>;
     using StatementList = std::vector<StatementPtr>;
+    using ExprList = std::vector<ExprPtr>;
 
     class ASTVisitor
     {
@@ -49,10 +61,19 @@ namespace talos
         virtual void visit(const BoolLiteralExpr& expr) = 0;
         virtual void visit(const IdentifierExpr& expr) = 0;
         virtual void visit(const AssignmentExpr& expr) = 0;
+        virtual void visit(const CallExpr& expr) = 0;
+        virtual void visit(const FieldExpr& expr) = 0;
+        virtual void visit(const IndexExpr& expr) = 0;
+        virtual void visit(const ArrayLiteralExpr& expr) = 0;
         virtual void visit(const ExprStatement& stmt) = 0;
         virtual void visit(const ReturnStatement& stmt) = 0;
         virtual void visit(const VarDeclStatement& stmt) = 0;
         virtual void visit(const FunDeclStatement& stmt) = 0;
+        virtual void visit(const StructDeclStatement& stmt) = 0;
+        virtual void visit(const BlockStatement& stmt) = 0;
+        virtual void visit(const IfStatement& stmt) = 0;
+        virtual void visit(const WhileStatement& stmt) = 0;
+        virtual void visit(const ForStatement& stmt) = 0;
         virtual void visit(const ProgramNode& program) = 0;
 
     protected:
@@ -62,31 +83,43 @@ namespace talos
         ASTVisitor& operator=(ASTVisitor&&) noexcept = default;
     };
 
+    // Destroying a tree takes bounded stack whatever its depth: past a few
+    // hundred levels nodes are destroyed from a heap allocated work list
     class ASTNode
     {
     public:
-        ASTNode() = default;
         virtual ~ASTNode() = default;
 
+        // Identifies the concrete node type without a virtual call, see ASTWalker
+        [[nodiscard]] NodeKind kind() const noexcept { return kind_; }
+
         virtual void accept(ASTVisitor&) const = 0;
 
     protected:
+        explicit ASTNode(NodeKind kind) noexcept
+            : kind_(kind)
+        {
+        }
         ASTNode(const ASTNode&) = default;
         ASTNode(ASTNode&&) noexcept = default;
         ASTNode& operator=(const ASTNode&) = default;
         ASTNode& operator=(ASTNode&&) noexcept = default;
+
+    private:
+        NodeKind kind_;
     };
 
     class Expr : public ASTNode
     {
-    public:
-        Expr() = default;
+    protected:
+        using ASTNode::ASTNode;
     };
 
     class BinaryExpr : public Expr
     {
     public:
         BinaryExpr(ExprPtr lhs, Token op, ExprPtr rhs);
+        ~BinaryExpr() override;
 
         [[nodiscard]] const Expr* lhs() const noexcept { return lhs_.get(); }
         [[nodiscard]] Token op() const noexcept { return op_; }
@@ -104,6 +137,7 @@ namespace talos
     {
     public:
         UnaryExpr(Token unary_op, ExprPtr expr);
+        ~UnaryExpr() override;
 
         [[nodiscard]] Token unary_op() const noexcept { return unary_op_; }
         [[nodiscard]] const Expr* expr() const noexcept { return expr_.get(); }
@@ -119,6 +153,7 @@ namespace talos
     {
     public:
         explicit ParenExpr(ExprPtr expr);
+        ~ParenExpr() override;
 
         [[nodiscard]] const Expr* expr() const noexcept { return expr_.get(); }
 
@@ -148,7 +183,10 @@ namespace talos
     public:
         explicit StringLiteralExpr(Token string_literal);
 
+        // The token as written, with quotes and escape sequences
         [[nodiscard]] auto string_literal() const noexcept { return string_literal_; }
+        // The contents, decoded on each call
+        [[nodiscard]] std::string value() const;
 
         void accept(ASTVisitor& visitor) const override { visitor.visit(*this); }
 
@@ -214,6 +252,7 @@ namespace talos
     {
     public:
         AssignmentExpr(ExprPtr lhs, ExprPtr rhs);
+        ~AssignmentExpr() override;
 
         [[nodiscard]] auto* lhs() const noexcept { return lhs_.get(); }
         [[nodiscard]] auto* rhs() const noexcept { return rhs_.get(); }
@@ -225,8 +264,82 @@ namespace talos
         ExprPtr rhs_;
     };
 
+    class CallExpr : public Expr
+    {
+    public:
+        CallExpr(ExprPtr callee, ExprList arguments);
+        ~CallExpr() override;
+
+        [[nodiscard]] const Expr* callee() const noexcept { return callee_.get(); }
+        [[nodiscard]] auto arguments() const noexcept { return std::span{arguments_}; }
+
+        void accept(ASTVisitor& visitor) const override { visitor.visit(*this); }
+
+    private:
+        ExprPtr callee_;
+        ExprList arguments_;
+    };
+
+    // object.field
+    class FieldExpr : public Expr
+    {
+    public:
+        FieldExpr(ExprPtr object, Token field);
+        ~FieldExpr() override;
+
+        [[nodiscard]] const Expr* object() const noexcept { return object_.get(); }
+        [[nodiscard]] Token field() const noexcept { return field_; }
+
+        void accept(ASTVisitor& visitor) const override { visitor.visit(*this); }
+
+    private:
+        ExprPtr object_;
+        Token field_;
+    };
+
+    // array[index]
+    class IndexExpr : public Expr
+    {
+    public:
+        IndexExpr(ExprPtr array, Token bracket, ExprPtr index);
+        ~IndexExpr() override;
+
+        [[nodiscard]] const Expr* array() const noexcept { return array_.get(); }
+        [[nodiscard]] Token bracket() const noexcept { return bracket_; }
+        [[nodiscard]] const Expr* index() const noexcept { return index_.get(); }
+
+        void accept(ASTVisitor& visitor) const override { visitor.visit(*this); }
+
+    private:
+        ExprPtr array_;
+        Token bracket_;
+        ExprPtr index_;
+    };
+
+    // [a, b, c], or [value; count] for count copies of one element
+    class ArrayLiteralExpr : public Expr
+    {
+    public:
+        ArrayLiteralExpr(Token bracket, ExprList elements, std::optional<Token> count);
+        ~ArrayLiteralExpr() override;
+
+        [[nodiscard]] Token bracket() const noexcept { return bracket_; }
+        [[nodiscard]] auto elements() const noexcept { return std::span{elements_}; }
+        // The integer literal of a repeated element
+        [[nodiscard]] auto count() const noexcept { return count_; }
+
+        void accept(ASTVisitor& visitor) const override { visitor.visit(*this); }
+
+    private:
+        Token bracket_;
+        ExprList elements_;
+        std::optional<Token> count_;
+    };
+
     class Statement : public ASTNode
     {
+    protected:
+        using ASTNode::ASTNode;
     };
 
     class ExprStatement : public Statement
@@ -255,10 +368,17 @@ namespace talos
         ExprPtr return_value_;
     };
 
+    // A type keyword or struct name, or [length]name for a fixed-size array
+    // of that element type
+    struct TypeSpec {
+        Token name;
+        std::optional<Token> length;
+    };
+
     class VarDeclStatement : public Statement
     {
     public:
-        VarDeclStatement(Token decl_type, Token identifier, std::optional<Token> type_spec, ExprPtr initializer);
+        VarDeclStatement(Token decl_type, Token identifier, std::optional<TypeSpec> type_spec, ExprPtr initializer);
 
         [[nodiscard]] auto decl_type() const noexcept { return decl_type_; }
         [[nodiscard]] auto identifier() const noexcept { return identifier_; }
@@ -270,16 +390,23 @@ namespace talos
     private:
         Token decl_type_;
         Token identifier_;
-        std::optional<Token> type_specifier_;
+        std::optional<TypeSpec> type_specifier_;
         ExprPtr initializer_;
     };
 
+    struct Parameter {
+        Token identifier;
+        TypeSpec type_spec;
+    };
+
     class FunDeclStatement : public Statement
     {
     public:
-        FunDeclStatement(Token identifier, std::optional<Token> type_spec, StatementList statements);
+        FunDeclStatement(Token identifier, std::vector<Parameter> parameters, std::optional<TypeSpec> type_spec, StatementList statements);
+        ~FunDeclStatement() override;
 
         [[nodiscard]] auto identifier() const noexcept { return identifier_; }
+        [[nodiscard]] auto parameters() const noexcept { return std::span{parameters_}; }
         [[nodiscard]] auto type_spec() const noexcept { return type_spec_; }
         [[nodiscard]] auto statements() const noexcept { return std::span{statements_}; }
 
@@ -287,10 +414,114 @@ namespace talos
 
     private:
         Token identifier_;
-        std::optional<Token> type_spec_;
+        std::vector<Parameter> parameters_;
+        std::optional<TypeSpec> type_spec_;
+        StatementList statements_;
+    };
+
+    struct StructField {
+        Token identifier;
+        TypeSpec type_spec;
+    };
+
+    // struct Name { field : type, ... }, packed struct to lay the fields out
+    // without padding, or soa struct to store arrays of it a field at a time
+    class StructDeclStatement : public Statement
+    {
+    public:
+        StructDeclStatement(Token identifier, std::vector<StructField> fields, bool packed, bool soa);
+
+        [[nodiscard]] auto identifier() const noexcept { return identifier_; }
+        [[nodiscard]] auto fields() const noexcept { return std::span{fields_}; }
+        [[nodiscard]] bool packed() const noexcept { return packed_; }
+        [[nodiscard]] bool soa() const noexcept { return soa_; }
+
+        void accept(ASTVisitor& visitor) const override { visitor.visit(*this); }
+
+    private:
+        Token identifier_;
+        std::vector<StructField> fields_;
+        bool packed_;
+        bool soa_;
+    };
+
+    // Statements in braces, which scope the variables declared in them
+    class BlockStatement : public Statement
+    {
+    public:
+        explicit BlockStatement(StatementList statements);
+        ~BlockStatement() override;
+
+        [[nodiscard]] auto statements() const noexcept { return std::span{statements_}; }
+
+        void accept(ASTVisitor& visitor) const override { visitor.visit(*this); }
+
+    private:
         StatementList statements_;
     };
 
+    class IfStatement : public Statement
+    {
+    public:
+        IfStatement(ExprPtr condition, StatementPtr then_branch, StatementPtr else_branch);
+        ~IfStatement() override;
+
+        [[nodiscard]] const Expr* condition() const noexcept { return condition_.get(); }
+        // A BlockStatement
+        [[nodiscard]] const Statement* then_branch() const noexcept { return then_branch_.get(); }
+        // A BlockStatement, an IfStatement for else if, or null
+        [[nodiscard]] const Statement* else_branch() const noexcept { return else_branch_.get(); }
+
+        void accept(ASTVisitor& visitor) const override { visitor.visit(*this); }
+
+    private:
+        ExprPtr condition_;
+        StatementPtr then_branch_;
+        StatementPtr else_branch_;
+    };
+
+    class WhileStatement : public Statement
+    {
+    public:
+        WhileStatement(ExprPtr condition, StatementPtr body);
+        ~WhileStatement() override;
+
+        [[nodiscard]] const Expr* condition() const noexcept { return condition_.get(); }
+        // A BlockStatement
+        [[nodiscard]] const Statement* body() const noexcept { return body_.get(); }
+
+        void accept(ASTVisitor& visitor) const override { visitor.visit(*this); }
+
+    private:
+        ExprPtr condition_;
+        StatementPtr body_;
+    };
+
+    // for initializer; condition; increment { body }, where each of the three
+    // clauses may be left out. Variables of the initializer are scoped to the loop
+    class ForStatement : public Statement
+    {
+    public:
+        ForStatement(StatementPtr initializer, ExprPtr condition, ExprPtr increment, StatementPtr body);
+        ~ForStatement() override;
+
+        // A VarDeclStatement, an ExprStatement or null
+        [[nodiscard]] const Statement* initializer() const noexcept { return initializer_.get(); }
+        // Null if the loop only ends by returning
+        [[nodiscard]] const Expr* condition() const noexcept { return condition_.get(); }
+        [[nodiscard]] const Expr* increment() const noexcept { return increment_.get(); }
+        // A BlockStatement
+        [[nodiscard]] const Statement* body() const noexcept { return body_.get(); }
+
+        void accept(ASTVisitor& visitor) const override { visitor.visit(*this); }
+
+    private:
+        StatementPtr initializer_;
+        ExprPtr condition_;
+        ExprPtr increment_;
+        StatementPtr body_;
+    };
+
     class ProgramNode : public ASTNode
     {
     public:
@@ -303,4 +534,7 @@ namespace talos
     private:
         std::vector<StatementPtr> statements_;
     };
+
+    // Location of the first token of expr
+    [[nodiscard]] SourceLocation location_of(const Expr& expr) noexcept;
 } // namespace talos
@@ -0,0 +1,271 @@
+#include "ast_binary_writer.h"
+
+#include "node_kind.h"
+
+namespace talos
+{
+    ASTBinaryWriter::ASTBinaryWriter(fmt::memory_buffer& out)
+        : out_(&out)
+    {
+    }
+
+    void ASTBinaryWriter::write(const ASTNode& node)
+    {
+        out_->append(magic.data(), magic.data() + magic.size());
+        byte(version);
+        node.accept(*this);
+    }
+
+    void ASTBinaryWriter::visit(const BinaryExpr& expr)
+    {
+        byte(static_cast<std::uint8_t>(NodeKind::BinaryExpr));
+        token(expr.op());
+        expr.lhs()->accept(*this);
+        expr.rhs()->accept(*this);
+    }
+
+    void ASTBinaryWriter::visit(const UnaryExpr& expr)
+    {
+        byte(static_cast<std::uint8_t>(NodeKind::UnaryExpr));
+        token(expr.unary_op());
+        expr.expr()->accept(*this);
+    }
+
+    void ASTBinaryWriter::visit(const ParenExpr& expr)
+    {
+        byte(static_cast<std::uint8_t>(NodeKind::ParenExpr));
+        expr.expr()->accept(*this);
+    }
+
+    void ASTBinaryWriter::visit(const IntLiteralExpr& expr)
+    {
+        byte(static_cast<std::uint8_t>(NodeKind::IntLiteralExpr));
+        token(expr.int_literal());
+        optional_token(expr.suffix());
+    }
+
+    void ASTBinaryWriter::visit(const StringLiteralExpr& expr)
+    {
+        byte(static_cast<std::uint8_t>(NodeKind::StringLiteralExpr));
+        token(expr.string_literal());
+    }
+
+    void ASTBinaryWriter::visit(const CharLiteralExpr& expr)
+    {
+        byte(static_cast<std::uint8_t>(NodeKind::CharLiteralExpr));
+        token(expr.char_literal());
+    }
+
+    void ASTBinaryWriter::visit(const FloatingLiteralExpr& expr)
+    {
+        byte(static_cast<std::uint8_t>(NodeKind::FloatingLiteralExpr));
+        token(expr.float_literal());
+        optional_token(expr.suffix());
+    }
+
+    void ASTBinaryWriter::visit(const BoolLiteralExpr& expr)
+    {
+        byte(static_cast<std::uint8_t>(NodeKind::BoolLiteralExpr));
+        token(expr.bool_literal());
+    }
+
+    void ASTBinaryWriter::visit(const IdentifierExpr& expr)
+    {
+        byte(static_cast<std::uint8_t>(NodeKind::IdentifierExpr));
+        token(expr.identifier());
+    }
+
+    void ASTBinaryWriter::visit(const AssignmentExpr& expr)
+    {
+        byte(static_cast<std::uint8_t>(NodeKind::AssignmentExpr));
+        expr.lhs()->accept(*this);
+        expr.rhs()->accept(*this);
+    }
+
+    void ASTBinaryWriter::visit(const CallExpr& expr)
+    {
+        byte(static_cast<std::uint8_t>(NodeKind::CallExpr));
+        expr.callee()->accept(*this);
+        expressions(expr.arguments());
+    }
+
+    void ASTBinaryWriter::visit(const FieldExpr& expr)
+    {
+        byte(static_cast<std::uint8_t>(NodeKind::FieldExpr));
+        expr.object()->accept(*this);
+        token(expr.field());
+    }
+
+    void ASTBinaryWriter::visit(const IndexExpr& expr)
+    {
+        byte(static_cast<std::uint8_t>(NodeKind::IndexExpr));
+        expr.array()->accept(*this);
+        token(expr.bracket());
+        expr.index()->accept(*this);
+    }
+
+    void ASTBinaryWriter::visit(const ArrayLiteralExpr& expr)
+    {
+        byte(static_cast<std::uint8_t>(NodeKind::ArrayLiteralExpr));
+        token(expr.bracket());
+        expressions(expr.elements());
+        optional_token(expr.count());
+    }
+
+    void ASTBinaryWriter::visit(const ExprStatement& stmt)
+    {
+        byte(static_cast<std::uint8_t>(NodeKind::ExprStatement));
+        stmt.expr()->accept(*this);
+    }
+
+    void ASTBinaryWriter::visit(const ReturnStatement& stmt)
+    {
+        byte(static_cast<std::uint8_t>(NodeKind::ReturnStatement));
+        stmt.return_value()->accept(*this);
+    }
+
+    void ASTBinaryWriter::visit(const VarDeclStatement& stmt)
+    {
+        byte(static_cast<std::uint8_t>(NodeKind::VarDeclStatement));
+        token(stmt.decl_type());
+        token(stmt.identifier());
+        optional_type_spec(stmt.type_specifier());
+        stmt.initializer()->accept(*this);
+    }
+
+    void ASTBinaryWriter::visit(const FunDeclStatement& stmt)
+    {
+        byte(static_cast<std::uint8_t>(NodeKind::FunDeclStatement));
+        token(stmt.identifier());
+        varint(stmt.parameters().size());
+        for (const auto& parameter : stmt.parameters()) {
+            token(parameter.identifier);
+            type_spec(parameter.type_spec);
+        }
+        optional_type_spec(stmt.type_spec());
+        statements(stmt.statements());
+    }
+
+    void ASTBinaryWriter::visit(const StructDeclStatement& stmt)
+    {
+        byte(static_cast<std::uint8_t>(NodeKind::StructDeclStatement));
+        token(stmt.identifier());
+        byte(stmt.packed() ? 1 : 0);
+        byte(stmt.soa() ? 1 : 0);
+        varint(stmt.fields().size());
+        for (const auto& field : stmt.fields()) {
+            token(field.identifier);
+            type_spec(field.type_spec);
+        }
+    }
+
+    void ASTBinaryWriter::visit(const BlockStatement& stmt)
+    {
+        byte(static_cast<std::uint8_t>(NodeKind::BlockStatement));
+        statements(stmt.statements());
+    }
+
+    void ASTBinaryWriter::visit(const IfStatement& stmt)
+    {
+        byte(static_cast<std::uint8_t>(NodeKind::IfStatement));
+        stmt.condition()->accept(*this);
+        stmt.then_branch()->accept(*this);
+        optional_node(stmt.else_branch());
+    }
+
+    void ASTBinaryWriter::visit(const WhileStatement& stmt)
+    {
+        byte(static_cast<std::uint8_t>(NodeKind::WhileStatement));
+        stmt.condition()->accept(*this);
+        stmt.body()->accept(*this);
+    }
+
+    void ASTBinaryWriter::visit(const ForStatement& stmt)
+    {
+        byte(static_cast<std::uint8_t>(NodeKind::ForStatement));
+        optional_node(stmt.initializer());
+        optional_node(stmt.condition());
+        optional_node(stmt.increment());
+        stmt.body()->accept(*this);
+    }
+
+    void ASTBinaryWriter::visit(const ProgramNode& program)
+    {
+        byte(static_cast<std::uint8_t>(NodeKind::Program));
+        statements(program.statements());
+    }
+
+    void ASTBinaryWriter::byte(std::uint8_t value)
+    {
+        out_->push_back(static_cast<char>(value));
+    }
+
+    void ASTBinaryWriter::varint(std::uint64_t value)
+    {
+        while (value >= 0x80) {
+            byte(static_cast<std::uint8_t>(value | 0x80U));
+            value >>= 7U;
+        }
+        byte(static_cast<std::uint8_t>(value));
+    }
+
+    void ASTBinaryWriter::string(std::string_view string)
+    {
+        varint(string.size());
+        out_->append(string.data(), string.data() + string.size());
+    }
+
+    void ASTBinaryWriter::token(const Token& token)
+    {
+        byte(token.type == TokenType::Invalid ? 0xFF : static_cast<std::uint8_t>(token.type));
+        varint(static_cast<std::uint64_t>(token.location.line));
+        varint(static_cast<std::uint64_t>(token.location.column));
+        string(token.string);
+    }
+
+    void ASTBinaryWriter::optional_token(const std::optional<Token>& token)
+    {
+        byte(token.has_value() ? 1 : 0);
+        if (token) {
+            this->token(*token);
+        }
+    }
+
+    void ASTBinaryWriter::type_spec(const TypeSpec& type_spec)
+    {
+        token(type_spec.name);
+        optional_token(type_spec.length);
+    }
+
+    void ASTBinaryWriter::optional_type_spec(const std::optional<TypeSpec>& type_spec)
+    {
+        byte(type_spec.has_value() ? 1 : 0);
+        if (type_spec) {
+            this->type_spec(*type_spec);
+        }
+    }
+
+    void ASTBinaryWriter::optional_node(const ASTNode* node)
+    {
+        byte(node != nullptr ? 1 : 0);
+        if (node != nullptr) {
+            node->accept(*this);
+        }
+    }
+
+    void ASTBinaryWriter::expressions(std::span<const ExprPtr> expressions)
+    {
+        varint(expressions.size());
+        for (const auto& expr : expressions) {
+            expr->accept(*this);
+        }
+    }
+
+    void ASTBinaryWriter::statements(std::span<const StatementPtr> statements)
+    {
+        varint(statements.size());
+        for (const auto& statement : statements) {
+            statement->accept(*this);
+        }
+    }
+} // namespace talos
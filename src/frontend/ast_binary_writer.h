@@ -0,0 +1,100 @@
+#pragma once
+
+#include "ast.h"
+
+#include <fmt/format.h>
+
+#include <cstdint>
+#include <string_view>
+
+namespace talos
+{
+    // Compact binary AST encoding for tools.
+    //
+    // The stream starts with the magic bytes "TAST" and a version byte, followed by
+    // the root node. Nodes are written in pre-order as their NodeKind byte followed
+    // by their fields in declaration order:
+    //   - unsigned integers are LEB128 varints
+    //   - strings are a varint length followed by the raw bytes
+    //   - tokens are a TokenType byte (0xFF for Invalid), line, column and string
+    //   - optional tokens are a 0/1 presence byte followed by the token if present
+    //   - types are the token naming the type or element type, followed by the
+    //     optional token of the array length
+    //   - optional types are a 0/1 presence byte followed by the type if present
+    //   - optional nodes are a 0/1 presence byte followed by the node if present
+    //   - expression and statement lists are a varint count followed by the nodes
+    //
+    // BinaryExpr:          op, lhs, rhs
+    // UnaryExpr:           op, expr
+    // ParenExpr:           expr
+    // IntLiteralExpr:      literal, optional suffix
+    // FloatingLiteralExpr: literal, optional suffix
+    // String/Char/Bool:    literal
+    // IdentifierExpr:      identifier
+    // AssignmentExpr:      lhs, rhs
+    // CallExpr:            callee, arguments
+    // FieldExpr:           object, field
+    // IndexExpr:           array, bracket, index
+    // ArrayLiteralExpr:    bracket, elements, optional count
+    // ExprStatement:       expr
+    // ReturnStatement:     value
+    // VarDeclStatement:    decl keyword, identifier, optional type, initializer
+    // FunDeclStatement:    identifier, parameters, optional return type, statements
+    // StructDeclStatement: identifier, packed byte, soa byte, fields
+    // BlockStatement:      statements
+    // IfStatement:         condition, then block, optional else
+    // WhileStatement:      condition, body
+    // ForStatement:        optional initializer, optional condition, optional increment, body
+    //
+    // Parameters and fields are a varint count followed by the identifier and type of each
+    // Program:             statements
+    class ASTBinaryWriter : public ASTVisitor
+    {
+    public:
+        static constexpr std::string_view magic = "TAST";
+        static constexpr std::uint8_t version = 6;
+
+        explicit ASTBinaryWriter(fmt::memory_buffer& out);
+
+        void write(const ASTNode& node);
+
+    private:
+        void visit(const BinaryExpr& expr) override;
+        void visit(const UnaryExpr& expr) override;
+        void visit(const ParenExpr& expr) override;
+        void visit(const IntLiteralExpr& expr) override;
+        void visit(const StringLiteralExpr& expr) override;
+        void visit(const CharLiteralExpr& expr) override;
+        void visit(const FloatingLiteralExpr& expr) override;
+        void visit(const BoolLiteralExpr& expr) override;
+        void visit(const IdentifierExpr& expr) override;
+        void visit(const AssignmentExpr& expr) override;
+        void visit(const CallExpr& expr) override;
+        void visit(const FieldExpr& expr) override;
+        void visit(const IndexExpr& expr) override;
+        void visit(const ArrayLiteralExpr& expr) override;
+        void visit(const ExprStatement& stmt) override;
+        void visit(const ReturnStatement& stmt) override;
+        void visit(const VarDeclStatement& stmt) override;
+        void visit(const FunDeclStatement& stmt) override;
+        void visit(const StructDeclStatement& stmt) override;
+        void visit(const BlockStatement& stmt) override;
+        void visit(const IfStatement& stmt) override;
+        void visit(const WhileStatement& stmt) override;
+        void visit(const ForStatement& stmt) override;
+        void visit(const ProgramNode& program) override;
+
+        void byte(std::uint8_t value);
+        void varint(std::uint64_t value);
+        void string(std::string_view string);
+        void token(const Token& token);
+        void optional_token(const std::optional<Token>& token);
+        void type_spec(const TypeSpec& type_spec);
+        void optional_type_spec(const std::optional<TypeSpec>& type_spec);
+        void optional_node(const ASTNode* node);
+        void expressions(std::span<const ExprPtr> expressions);
+        void statements(std::span<const StatementPtr> statements);
+
+        fmt::memory_buffer* out_;
+    };
+} // namespace talos
@@ -0,0 +1,54 @@
+#include "ast_dump.h"
+
+#include "ast_binary_writer.h"
+#include "ast_json_writer.h"
+#include "ast_printer.h"
+
+namespace talos
+{
+    std::optional<DumpFormat> parse_dump_format(std::string_view string) noexcept
+    {
+        for (const auto format : {DumpFormat::None, DumpFormat::Text, DumpFormat::Json, DumpFormat::Binary}) {
+            if (string == format_as(format)) {
+                return format;
+            }
+        }
+        return std::nullopt;
+    }
+
+    void dump_ast(const ASTNode& node, DumpFormat format, fmt::memory_buffer& out)
+    {
+        switch (format) {
+            case DumpFormat::None:
+                break;
+            case DumpFormat::Text: {
+                auto printer = ASTPrinter{out};
+                printer.print(node);
+                break;
+            }
+            case DumpFormat::Json: {
+                auto writer = ASTJsonWriter{out};
+                writer.write(node);
+                break;
+            }
+            case DumpFormat::Binary: {
+                auto writer = ASTBinaryWriter{out};
+                writer.write(node);
+                break;
+            }
+        }
+    }
+
+    std::string type_specifier_string(const std::optional<TypeSpec>& type_spec)
+    {
+        if (!type_spec) {
+            return "Inferred";
+        }
+        const auto& token = type_spec->name;
+        const auto name = token.type == TokenType::Identifier ? token.string : std::string_view{format_as(token.type)};
+        if (type_spec->length) {
+            return fmt::format("[{}]{}", type_spec->length->string, name);
+        }
+        return std::string{name};
+    }
+} // namespace talos
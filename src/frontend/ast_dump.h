@@ -0,0 +1,45 @@
+#pragma once
+
+#include "ast.h"
+
+#include <fmt/format.h>
+
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace talos
+{
+    enum class DumpFormat {
+        None,
+        // Indented human readable tree
+        Text,
+        // Nested JSON objects, one per node
+        Json,
+        // Compact pre-order encoding, see ast_binary_writer.h
+        Binary,
+    };
+
+    constexpr auto format_as(DumpFormat format)
+    {
+        switch (format) {
+            case DumpFormat::None:
+                return "none";
+            case DumpFormat::Text:
+                return "text";
+            case DumpFormat::Json:
+                return "json";
+            case DumpFormat::Binary:
+                return "binary";
+        }
+        return "unknown";
+    }
+
+    [[nodiscard]] std::optional<DumpFormat> parse_dump_format(std::string_view string) noexcept;
+
+    // Appends node to out in the requested format. Nothing is written for DumpFormat::None
+    void dump_ast(const ASTNode& node, DumpFormat format, fmt::memory_buffer& out);
+
+    // Inferred without a type specifier, e.g. Int32 for i32 or [4]Float32 for [4]f32
+    [[nodiscard]] std::string type_specifier_string(const std::optional<TypeSpec>& type_spec);
+} // namespace talos
@@ -0,0 +1,399 @@
+#include "ast_json_writer.h"
+
+#include <iterator>
+
+namespace talos
+{
+    ASTJsonWriter::ASTJsonWriter(fmt::memory_buffer& out)
+        : out_(&out)
+    {
+    }
+
+    void ASTJsonWriter::write(const ASTNode& node)
+    {
+        node.accept(*this);
+    }
+
+    void ASTJsonWriter::visit(const BinaryExpr& expr)
+    {
+        begin_node("BinaryExpr");
+        key("op");
+        string(format_as(expr.op().type));
+        key("lhs");
+        expr.lhs()->accept(*this);
+        key("rhs");
+        expr.rhs()->accept(*this);
+        raw("}");
+    }
+
+    void ASTJsonWriter::visit(const UnaryExpr& expr)
+    {
+        begin_node("UnaryExpr");
+        key("op");
+        string(format_as(expr.unary_op().type));
+        key("expr");
+        expr.expr()->accept(*this);
+        raw("}");
+    }
+
+    void ASTJsonWriter::visit(const ParenExpr& expr)
+    {
+        begin_node("ParenExpr");
+        key("expr");
+        expr.expr()->accept(*this);
+        raw("}");
+    }
+
+    void ASTJsonWriter::visit(const IntLiteralExpr& expr)
+    {
+        begin_node("IntLiteralExpr");
+        key("value");
+        string(expr.int_literal().string);
+        key("suffix");
+        optional_string(expr.suffix());
+        raw("}");
+    }
+
+    void ASTJsonWriter::visit(const StringLiteralExpr& expr)
+    {
+        begin_node("StringLiteralExpr");
+        key("value");
+        string(expr.string_literal().string);
+        raw("}");
+    }
+
+    void ASTJsonWriter::visit(const CharLiteralExpr& expr)
+    {
+        begin_node("CharLiteralExpr");
+        key("value");
+        string(expr.char_literal().string);
+        raw("}");
+    }
+
+    void ASTJsonWriter::visit(const FloatingLiteralExpr& expr)
+    {
+        begin_node("FloatingLiteralExpr");
+        key("value");
+        string(expr.float_literal().string);
+        key("suffix");
+        optional_string(expr.suffix());
+        raw("}");
+    }
+
+    void ASTJsonWriter::visit(const BoolLiteralExpr& expr)
+    {
+        begin_node("BoolLiteralExpr");
+        key("value");
+        string(expr.bool_literal().string);
+        raw("}");
+    }
+
+    void ASTJsonWriter::visit(const IdentifierExpr& expr)
+    {
+        begin_node("IdentifierExpr");
+        key("name");
+        string(expr.identifier().string);
+        raw("}");
+    }
+
+    void ASTJsonWriter::visit(const AssignmentExpr& expr)
+    {
+        begin_node("AssignmentExpr");
+        key("lhs");
+        expr.lhs()->accept(*this);
+        key("rhs");
+        expr.rhs()->accept(*this);
+        raw("}");
+    }
+
+    void ASTJsonWriter::visit(const CallExpr& expr)
+    {
+        begin_node("CallExpr");
+        key("callee");
+        expr.callee()->accept(*this);
+        key("arguments");
+        expressions(expr.arguments());
+        raw("}");
+    }
+
+    void ASTJsonWriter::visit(const FieldExpr& expr)
+    {
+        begin_node("FieldExpr");
+        key("object");
+        expr.object()->accept(*this);
+        key("field");
+        string(expr.field().string);
+        raw("}");
+    }
+
+    void ASTJsonWriter::visit(const IndexExpr& expr)
+    {
+        begin_node("IndexExpr");
+        key("array");
+        expr.array()->accept(*this);
+        key("index");
+        expr.index()->accept(*this);
+        raw("}");
+    }
+
+    void ASTJsonWriter::visit(const ArrayLiteralExpr& expr)
+    {
+        begin_node("ArrayLiteralExpr");
+        key("elements");
+        expressions(expr.elements());
+        key("count");
+        raw(expr.count() ? expr.count()->string : "null");
+        raw("}");
+    }
+
+    void ASTJsonWriter::visit(const ExprStatement& stmt)
+    {
+        begin_node("ExprStatement");
+        key("expr");
+        stmt.expr()->accept(*this);
+        raw("}");
+    }
+
+    void ASTJsonWriter::visit(const ReturnStatement& stmt)
+    {
+        begin_node("ReturnStatement");
+        key("value");
+        stmt.return_value()->accept(*this);
+        raw("}");
+    }
+
+    void ASTJsonWriter::visit(const VarDeclStatement& stmt)
+    {
+        begin_node("VarDeclStatement");
+        key("decl");
+        string(stmt.decl_type().string);
+        key("name");
+        string(stmt.identifier().string);
+        key("type");
+        optional_type_spec(stmt.type_specifier());
+        key("initializer");
+        stmt.initializer()->accept(*this);
+        raw("}");
+    }
+
+    void ASTJsonWriter::visit(const FunDeclStatement& stmt)
+    {
+        begin_node("FunDeclStatement");
+        key("name");
+        string(stmt.identifier().string);
+        key("parameters");
+        out_->push_back('[');
+        bool first = true;
+        for (const auto& parameter : stmt.parameters()) {
+            if (!first) {
+                out_->push_back(',');
+            }
+            first = false;
+            raw(R"({"name":)");
+            string(parameter.identifier.string);
+            key("type");
+            type_spec(parameter.type_spec);
+            raw("}");
+        }
+        out_->push_back(']');
+        key("return_type");
+        optional_type_spec(stmt.type_spec());
+        key("body");
+        statements(stmt.statements());
+        raw("}");
+    }
+
+    void ASTJsonWriter::visit(const StructDeclStatement& stmt)
+    {
+        begin_node("StructDeclStatement");
+        key("name");
+        string(stmt.identifier().string);
+        key("packed");
+        raw(stmt.packed() ? "true" : "false");
+        key("soa");
+        raw(stmt.soa() ? "true" : "false");
+        key("fields");
+        out_->push_back('[');
+        bool first = true;
+        for (const auto& field : stmt.fields()) {
+            if (!first) {
+                out_->push_back(',');
+            }
+            first = false;
+            raw(R"({"name":)");
+            string(field.identifier.string);
+            key("type");
+            type_spec(field.type_spec);
+            raw("}");
+        }
+        out_->push_back(']');
+        raw("}");
+    }
+
+    void ASTJsonWriter::visit(const BlockStatement& stmt)
+    {
+        begin_node("BlockStatement");
+        key("body");
+        statements(stmt.statements());
+        raw("}");
+    }
+
+    void ASTJsonWriter::visit(const IfStatement& stmt)
+    {
+        begin_node("IfStatement");
+        key("condition");
+        stmt.condition()->accept(*this);
+        key("then");
+        stmt.then_branch()->accept(*this);
+        key("else");
+        optional_node(stmt.else_branch());
+        raw("}");
+    }
+
+    void ASTJsonWriter::visit(const WhileStatement& stmt)
+    {
+        begin_node("WhileStatement");
+        key("condition");
+        stmt.condition()->accept(*this);
+        key("body");
+        stmt.body()->accept(*this);
+        raw("}");
+    }
+
+    void ASTJsonWriter::visit(const ForStatement& stmt)
+    {
+        begin_node("ForStatement");
+        key("initializer");
+        optional_node(stmt.initializer());
+        key("condition");
+        optional_node(stmt.condition());
+        key("increment");
+        optional_node(stmt.increment());
+        key("body");
+        stmt.body()->accept(*this);
+        raw("}");
+    }
+
+    void ASTJsonWriter::visit(const ProgramNode& program)
+    {
+        begin_node("Program");
+        key("statements");
+        statements(program.statements());
+        raw("}\n");
+    }
+
+    void ASTJsonWriter::raw(std::string_view string)
+    {
+        out_->append(string.data(), string.data() + string.size());
+    }
+
+    void ASTJsonWriter::string(std::string_view string)
+    {
+        out_->push_back('"');
+        for (const auto character : string) {
+            switch (character) {
+                case '"':
+                    raw("\\\"");
+                    break;
+                case '\\':
+                    raw("\\\\");
+                    break;
+                case '\n':
+                    raw("\\n");
+                    break;
+                case '\t':
+                    raw("\\t");
+                    break;
+                default:
+                    if (static_cast<unsigned char>(character) < 0x20) {
+                        fmt::format_to(std::back_inserter(*out_), "\\u{:04x}", static_cast<int>(character));
+                    }
+                    else {
+                        out_->push_back(character);
+                    }
+                    break;
+            }
+        }
+        out_->push_back('"');
+    }
+
+    void ASTJsonWriter::optional_string(const std::optional<Token>& token)
+    {
+        if (token) {
+            string(token->string);
+        }
+        else {
+            raw("null");
+        }
+    }
+
+    void ASTJsonWriter::type_spec(const TypeSpec& type_spec)
+    {
+        if (type_spec.length) {
+            string(fmt::format("[{}]{}", type_spec.length->string, type_spec.name.string));
+        }
+        else {
+            string(type_spec.name.string);
+        }
+    }
+
+    void ASTJsonWriter::optional_type_spec(const std::optional<TypeSpec>& type_spec)
+    {
+        if (type_spec) {
+            this->type_spec(*type_spec);
+        }
+        else {
+            raw("null");
+        }
+    }
+
+    void ASTJsonWriter::optional_node(const ASTNode* node)
+    {
+        if (node == nullptr) {
+            raw("null");
+            return;
+        }
+        node->accept(*this);
+    }
+
+    void ASTJsonWriter::key(std::string_view name)
+    {
+        out_->push_back(',');
+        string(name);
+        out_->push_back(':');
+    }
+
+    void ASTJsonWriter::begin_node(std::string_view kind)
+    {
+        raw(R"({"kind":)");
+        string(kind);
+    }
+
+    void ASTJsonWriter::expressions(std::span<const ExprPtr> expressions)
+    {
+        out_->push_back('[');
+        bool first = true;
+        for (const auto& expr : expressions) {
+            if (!first) {
+                out_->push_back(',');
+            }
+            first = false;
+            expr->accept(*this);
+        }
+        out_->push_back(']');
+    }
+
+    void ASTJsonWriter::statements(std::span<const StatementPtr> statements)
+    {
+        out_->push_back('[');
+        bool first = true;
+        for (const auto& statement : statements) {
+            if (!first) {
+                out_->push_back(',');
+            }
+            first = false;
+            statement->accept(*this);
+        }
+        out_->push_back(']');
+    }
+} // namespace talos
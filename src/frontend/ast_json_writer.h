@@ -0,0 +1,61 @@
+#pragma once
+
+#include "ast.h"
+
+#include <fmt/format.h>
+
+#include <string_view>
+
+namespace talos
+{
+    // Writes every node as a JSON object with a "kind" member naming its NodeKind,
+    // e.g. {"kind":"BinaryExpr","op":"Plus","lhs":{...},"rhs":{...}}
+    class ASTJsonWriter : public ASTVisitor
+    {
+    public:
+        explicit ASTJsonWriter(fmt::memory_buffer& out);
+
+        void write(const ASTNode& node);
+
+    private:
+        void visit(const BinaryExpr& expr) override;
+        void visit(const UnaryExpr& expr) override;
+        void visit(const ParenExpr& expr) override;
+        void visit(const IntLiteralExpr& expr) override;
+        void visit(const StringLiteralExpr& expr) override;
+        void visit(const CharLiteralExpr& expr) override;
+        void visit(const FloatingLiteralExpr& expr) override;
+        void visit(const BoolLiteralExpr& expr) override;
+        void visit(const IdentifierExpr& expr) override;
+        void visit(const AssignmentExpr& expr) override;
+        void visit(const CallExpr& expr) override;
+        void visit(const FieldExpr& expr) override;
+        void visit(const IndexExpr& expr) override;
+        void visit(const ArrayLiteralExpr& expr) override;
+        void visit(const ExprStatement& stmt) override;
+        void visit(const ReturnStatement& stmt) override;
+        void visit(const VarDeclStatement& stmt) override;
+        void visit(const FunDeclStatement& stmt) override;
+        void visit(const StructDeclStatement& stmt) override;
+        void visit(const BlockStatement& stmt) override;
+        void visit(const IfStatement& stmt) override;
+        void visit(const WhileStatement& stmt) override;
+        void visit(const ForStatement& stmt) override;
+        void visit(const ProgramNode& program) override;
+
+        void raw(std::string_view string);
+        void string(std::string_view string);
+        void optional_string(const std::optional<Token>& token);
+        // As spelled in the source, e.g. "[4]f32"
+        void type_spec(const TypeSpec& type_spec);
+        void optional_type_spec(const std::optional<TypeSpec>& type_spec);
+        // Writes null for a clause that was left out
+        void optional_node(const ASTNode* node);
+        void key(std::string_view name);
+        void begin_node(std::string_view kind);
+        void expressions(std::span<const ExprPtr> expressions);
+        void statements(std::span<const StatementPtr> statements);
+
+        fmt::memory_buffer* out_;
+    };
+} // namespace talos
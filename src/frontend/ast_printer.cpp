@@ -1,151 +1,190 @@
 #include "ast_printer.h"
 
-#include <fmt/format.h>
+#include "ast_dump.h"
 
-#include <string_view>
+#include <string>
 
 namespace talos
 {
-    std::string_view type_specifier_string(const std::optional<Token>& type_spec)
+    ASTPrinter::ASTPrinter(fmt::memory_buffer& out)
+        : out_(&out)
     {
-        if (!type_spec) {
-            return "Inferred";
-        }
-        const auto& token = *type_spec;
-        if (token.type == TokenType::Identifier) {
-            return token.string;
-        }
-        return format_as(token.type);
     }
 
-    template<typename... Args>
-    void print_indented(int indent, std::string_view format_str, Args&&... args)
+    void ASTPrinter::print(const ASTNode& node)
     {
-        fmt::print("{:{}}", "", indent);
-        fmt::print("{}\n", fmt::format(fmt::runtime(format_str), std::forward<Args>(args)...));
+        walk(node);
     }
 
-    void ASTPrinter::print(const ASTNode& node)
+    Walk ASTPrinter::pre(const BinaryExpr& expr)
+    {
+        print_node("BinaryExpr");
+        walk(*expr.lhs());
+        print_indented("BinaryOp {}", expr.op().type);
+        walk(*expr.rhs());
+        return Walk::SkipChildren;
+    }
+
+    void ASTPrinter::pre(const UnaryExpr& expr)
+    {
+        print_node("UnaryExpr");
+        print_indented("UnaryOp {}", expr.unary_op().type);
+    }
+
+    void ASTPrinter::pre(const ParenExpr&)
+    {
+        print_node("ParenExpr");
+    }
+
+    void ASTPrinter::pre(const IntLiteralExpr& expr)
+    {
+        print_node("IntLiteral {} (suffix: {})",
+                   expr.int_literal().string,
+                   expr.suffix().has_value() ? expr.suffix()->string : "None");
+    }
+
+    void ASTPrinter::pre(const StringLiteralExpr& expr)
     {
-        node.accept(*this);
+        print_node("StringLiteral {}", expr.string_literal().string);
     }
 
-    void ASTPrinter::visit(const BinaryExpr& expr)
+    void ASTPrinter::pre(const CharLiteralExpr& expr)
     {
-        print_indented(level_, "BinaryExpr");
-        ++level_;
-        expr.lhs()->accept(*this);
-        print_indented(level_, "BinaryOp {}", expr.op().type);
-        expr.rhs()->accept(*this);
-        --level_;
+        print_node("CharacterLiteral {}", expr.char_literal().string);
     }
 
-    void ASTPrinter::visit(const UnaryExpr& expr)
+    void ASTPrinter::pre(const FloatingLiteralExpr& expr)
     {
-        print_indented(level_, "UnaryExpr");
-        ++level_;
-        print_indented(level_, "UnaryOp {}", expr.unary_op().type);
-        expr.expr()->accept(*this);
+        print_node("FloatingLiteral {} (suffix: {})",
+                   expr.float_literal().string,
+                   expr.suffix().has_value() ? expr.suffix()->string : "None");
     }
 
-    void ASTPrinter::visit(const ParenExpr& expr)
+    void ASTPrinter::pre(const BoolLiteralExpr& expr)
     {
-        print_indented(level_, "ParenExpr");
-        ++level_;
-        expr.expr()->accept(*this);
-        --level_;
+        print_node("BoolLiteral {}", expr.bool_literal().string);
     }
 
-    void ASTPrinter::visit(const IntLiteralExpr& expr)
+    void ASTPrinter::pre(const IdentifierExpr& expr)
     {
-        print_indented(level_, "IntLiteral {} (suffix: {})",
-                       expr.int_literal().string,
-                       expr.suffix().has_value() ? expr.suffix()->string : "None");
+        print_node("Identifier '{}'", expr.identifier().string);
     }
 
-    void ASTPrinter::visit(const StringLiteralExpr& expr)
+    Walk ASTPrinter::pre(const AssignmentExpr& expr)
     {
-        print_indented(level_, "StringLiteral {}", expr.string_literal().string);
+        print_node("Assignment");
+        walk(*expr.lhs());
+        print_indented("operator=");
+        walk(*expr.rhs());
+        return Walk::SkipChildren;
     }
 
-    void ASTPrinter::visit(const CharLiteralExpr& expr)
+    void ASTPrinter::pre(const CallExpr&)
     {
-        print_indented(level_, "CharacterLiteral {}", expr.char_literal().string);
+        // The callee followed by the arguments
+        print_node("Call");
     }
 
-    void ASTPrinter::visit(const FloatingLiteralExpr& expr)
+    void ASTPrinter::pre(const FieldExpr& expr)
     {
-        print_indented(level_, "FloatingLiteral {} (suffix: {})",
-                       expr.float_literal().string,
-                       expr.suffix().has_value() ? expr.suffix()->string : "None");
+        // The field name followed by the object
+        print_node("Field '{}'", expr.field().string);
     }
 
-    void ASTPrinter::visit(const BoolLiteralExpr& expr)
+    void ASTPrinter::pre(const IndexExpr&)
     {
-        print_indented(level_, "BoolLiteral {}", expr.bool_literal().string);
+        // The array followed by the index
+        print_node("Index");
     }
 
-    void ASTPrinter::visit(const IdentifierExpr& expr)
+    void ASTPrinter::pre(const ArrayLiteralExpr& expr)
     {
-        print_indented(level_, "Identifier '{}'", expr.identifier().string);
+        print_node("ArrayLiteral (count: {})", expr.count().has_value() ? expr.count()->string : "None");
     }
 
-    void ASTPrinter::visit(const AssignmentExpr& expr)
+    void ASTPrinter::pre(const ExprStatement&)
     {
-        print_indented(level_, "Assignment");
-        ++level_;
-        expr.lhs()->accept(*this);
-        print_indented(level_, "operator=");
-        expr.rhs()->accept(*this);
-        --level_;
+        print_node("ExprStatement");
     }
 
-    void ASTPrinter::visit(const ExprStatement& stmt)
+    void ASTPrinter::pre(const VarDeclStatement& stmt)
     {
-        print_indented(level_, "ExprStatement");
-        ++level_;
-        stmt.expr()->accept(*this);
-        --level_;
+        print_node("VarDecl '{} {} : ({})'",
+                   stmt.decl_type().string,
+                   stmt.identifier().string,
+                   type_specifier_string(stmt.type_specifier()));
     }
 
-    void ASTPrinter::visit(const VarDeclStatement& stmt)
+    void ASTPrinter::pre(const FunDeclStatement& stmt)
     {
-        print_indented(level_, "VarDecl '{} {} : ({})'",
-                       stmt.decl_type().string,
-                       stmt.identifier().string,
-                       type_specifier_string(stmt.type_specifier()));
-        ++level_;
-        stmt.initializer()->accept(*this);
-        --level_;
+        auto parameters = std::string{};
+        for (const auto& parameter : stmt.parameters()) {
+            if (!parameters.empty()) {
+                parameters += ", ";
+            }
+            fmt::format_to(std::back_inserter(parameters), "{} : {}", parameter.identifier.string, type_specifier_string(parameter.type_spec));
+        }
+        print_node("FunDecl '{}({}) : ({})'",
+                   stmt.identifier().string,
+                   parameters,
+                   type_specifier_string(stmt.type_spec()));
     }
 
-    void ASTPrinter::visit(const FunDeclStatement& stmt)
+    void ASTPrinter::pre(const StructDeclStatement& stmt)
     {
-        print_indented(level_, "FunDecl '{}() : ({})'",
-                       stmt.identifier().string,
-                       type_specifier_string(stmt.type_spec()));
-        ++level_;
-        for (const auto& statement : stmt.statements()) {
-            statement->accept(*this);
+        auto fields = std::string{};
+        for (const auto& field : stmt.fields()) {
+            if (!fields.empty()) {
+                fields += ", ";
+            }
+            fmt::format_to(std::back_inserter(fields), "{} : {}", field.identifier.string, type_specifier_string(field.type_spec));
         }
-        --level_;
+        const auto* modifier = stmt.packed() ? "packed " : stmt.soa() ? "soa " : "";
+        print_node("StructDecl '{}{} {{ {} }}'", modifier, stmt.identifier().string, fields);
+    }
+
+    void ASTPrinter::pre(const BlockStatement&)
+    {
+        print_node("Block");
+    }
+
+    void ASTPrinter::pre(const IfStatement&)
+    {
+        // The condition, the then block and the else block or if, if any
+        print_node("IfStatement");
+    }
+
+    void ASTPrinter::pre(const WhileStatement&)
+    {
+        print_node("WhileStatement");
     }
 
-    void ASTPrinter::visit(const ReturnStatement& stmt)
+    Walk ASTPrinter::pre(const ForStatement& stmt)
     {
-        print_indented(level_, "ReturnStatement");
-        ++level_;
-        stmt.return_value()->accept(*this);
-        --level_;
+        print_node("ForStatement");
+        walk_clause(stmt.initializer());
+        walk_clause(stmt.condition());
+        walk_clause(stmt.increment());
+        walk(*stmt.body());
+        return Walk::SkipChildren;
     }
 
-    void ASTPrinter::visit(const ProgramNode& program)
+    void ASTPrinter::walk_clause(const ASTNode* clause)
     {
-        print_indented(level_, "Program");
-        ++level_;
-        for (const auto& statement : program.statements()) {
-            statement->accept(*this);
+        if (clause == nullptr) {
+            print_indented("Empty");
+            return;
         }
-        --level_;
+        walk(*clause);
+    }
+
+    void ASTPrinter::pre(const ReturnStatement&)
+    {
+        print_node("ReturnStatement");
+    }
+
+    void ASTPrinter::pre(const ProgramNode&)
+    {
+        print_node("Program");
     }
 } // namespace talos
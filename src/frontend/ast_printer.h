@@ -1,31 +1,74 @@
 #pragma once
 
 #include "ast.h"
+#include "ast_walker.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <iterator>
 
 namespace talos
 {
-    class ASTPrinter : public ASTVisitor
+    class ASTPrinter : public ASTWalker<ASTPrinter>
     {
     public:
+        explicit ASTPrinter(fmt::memory_buffer& out);
+
+        // Appends an indented text representation of node to the output buffer
         void print(const ASTNode& node);
 
     private:
-        void visit(const BinaryExpr& expr) override;
-        void visit(const UnaryExpr& expr) override;
-        void visit(const ParenExpr& expr) override;
-        void visit(const IntLiteralExpr& expr) override;
-        void visit(const StringLiteralExpr& expr) override;
-        void visit(const CharLiteralExpr& expr) override;
-        void visit(const FloatingLiteralExpr& expr) override;
-        void visit(const BoolLiteralExpr& expr) override;
-        void visit(const IdentifierExpr& expr) override;
-        void visit(const AssignmentExpr& expr) override;
-        void visit(const ExprStatement& stmt) override;
-        void visit(const ReturnStatement& stmt) override;
-        void visit(const VarDeclStatement& stmt) override;
-        void visit(const FunDeclStatement& stmt) override;
-        void visit(const ProgramNode& program) override;
+        friend class ASTWalker<ASTPrinter>;
+
+        // Each node is printed on its own line, its children one level deeper
+        Walk pre(const BinaryExpr& expr);
+        void pre(const UnaryExpr& expr);
+        void pre(const ParenExpr& expr);
+        void pre(const IntLiteralExpr& expr);
+        void pre(const StringLiteralExpr& expr);
+        void pre(const CharLiteralExpr& expr);
+        void pre(const FloatingLiteralExpr& expr);
+        void pre(const BoolLiteralExpr& expr);
+        void pre(const IdentifierExpr& expr);
+        Walk pre(const AssignmentExpr& expr);
+        void pre(const CallExpr& expr);
+        void pre(const FieldExpr& expr);
+        void pre(const IndexExpr& expr);
+        void pre(const ArrayLiteralExpr& expr);
+        void pre(const ExprStatement& stmt);
+        void pre(const ReturnStatement& stmt);
+        void pre(const VarDeclStatement& stmt);
+        void pre(const FunDeclStatement& stmt);
+        void pre(const StructDeclStatement& stmt);
+        void pre(const BlockStatement& stmt);
+        void pre(const IfStatement& stmt);
+        void pre(const WhileStatement& stmt);
+        Walk pre(const ForStatement& stmt);
+        void pre(const ProgramNode& program);
+        void post(const ASTNode&) noexcept { --level_; }
+
+        // Prints "Empty" in place of a clause that was left out
+        void walk_clause(const ASTNode* clause);
+
+        template<typename... Args>
+        void print_node(fmt::format_string<Args...> format_str, Args&&... args)
+        {
+            print_indented(format_str, std::forward<Args>(args)...);
+            ++level_;
+        }
+
+        template<typename... Args>
+        void print_indented(fmt::format_string<Args...> format_str, Args&&... args)
+        {
+            const auto indent = out_->size();
+            out_->resize(indent + static_cast<std::size_t>(level_));
+            std::fill_n(out_->data() + indent, level_, ' ');
+            fmt::format_to(std::back_inserter(*out_), format_str, std::forward<Args>(args)...);
+            out_->push_back('\n');
+        }
 
+        fmt::memory_buffer* out_;
         int level_ = 0;
     };
 } // namespace talos
@@ -0,0 +1,168 @@
+#pragma once
+
+#include "ast.h"
+
+#include <array>
+#include <cstddef>
+#include <type_traits>
+
+namespace talos
+{
+    // Returned by the hooks of an ASTWalker to steer the walk
+    enum class Walk {
+        Continue,
+        // From pre: leave out the children of the node, post is still called
+        SkipChildren,
+        // End the whole walk, no further hooks are called
+        Stop,
+    };
+
+    // Static counterpart of ASTVisitor. Dispatches on ASTNode::kind with one
+    // call through a table instead of two virtual calls per node, inlines the
+    // hooks of the pass and recurses into the children of every node by
+    // default. Passes only define the hooks they need, for single node types
+    // or as templates:
+    //
+    //   Walk pre(const BinaryExpr&);    // Before the children
+    //   void post(const auto& node);    // After the children
+    //
+    // Hooks return void or a Walk, and must be accessible to ASTWalker<Derived>.
+    // A pre hook that walks the children itself, e.g. to emit something between
+    // them, returns SkipChildren
+    template<typename Derived>
+    class ASTWalker
+    {
+    public:
+        // Returns false if a hook stopped the walk
+        bool walk(const ASTNode& node)
+        {
+            return dispatch_table[static_cast<std::size_t>(node.kind())](*this, node);
+        }
+
+    protected:
+        // Walks the children of node in source order
+        bool walk_children(const BinaryExpr& expr) { return walk(*expr.lhs()) && walk(*expr.rhs()); }
+        bool walk_children(const UnaryExpr& expr) { return walk(*expr.expr()); }
+        bool walk_children(const ParenExpr& expr) { return walk(*expr.expr()); }
+        bool walk_children(const AssignmentExpr& expr) { return walk(*expr.lhs()) && walk(*expr.rhs()); }
+        bool walk_children(const CallExpr& expr) { return walk(*expr.callee()) && walk_expressions(expr.arguments()); }
+        bool walk_children(const FieldExpr& expr) { return walk(*expr.object()); }
+        bool walk_children(const IndexExpr& expr) { return walk(*expr.array()) && walk(*expr.index()); }
+        bool walk_children(const ArrayLiteralExpr& expr) { return walk_expressions(expr.elements()); }
+        bool walk_children(const ExprStatement& stmt) { return walk(*stmt.expr()); }
+        bool walk_children(const ReturnStatement& stmt) { return walk(*stmt.return_value()); }
+        bool walk_children(const VarDeclStatement& stmt) { return walk(*stmt.initializer()); }
+        bool walk_children(const FunDeclStatement& stmt) { return walk_statements(stmt.statements()); }
+        bool walk_children(const StructDeclStatement&) { return true; }
+        bool walk_children(const BlockStatement& stmt) { return walk_statements(stmt.statements()); }
+        bool walk_children(const IfStatement& stmt)
+        {
+            return walk(*stmt.condition()) && walk(*stmt.then_branch()) && walk_optional(stmt.else_branch());
+        }
+        bool walk_children(const WhileStatement& stmt) { return walk(*stmt.condition()) && walk(*stmt.body()); }
+        bool walk_children(const ForStatement& stmt)
+        {
+            return walk_optional(stmt.initializer()) && walk_optional(stmt.condition()) && walk_optional(stmt.increment()) && walk(*stmt.body());
+        }
+        bool walk_children(const ProgramNode& program) { return walk_statements(program.statements()); }
+        // Literals and identifiers are leaves
+        bool walk_children(const Expr&) { return true; }
+
+    private:
+        using Dispatch = bool (*)(ASTWalker&, const ASTNode&);
+
+        template<typename Node>
+        static bool dispatch(ASTWalker& walker, const ASTNode& node)
+        {
+            return walker.walk_node(static_cast<const Node&>(node));
+        }
+
+        // One walk function per node kind. Calling through the table rather
+        // than a switch leaves an indirect call at every place a child is
+        // walked, which the branch predictor tells apart far better than a
+        // single shared jump
+        static constexpr auto dispatch_table = [] {
+            auto table = std::array<Dispatch, node_kind_count>{};
+            const auto set = [&](NodeKind kind, Dispatch walk) { table[static_cast<std::size_t>(kind)] = walk; };
+            set(NodeKind::BinaryExpr, &dispatch<BinaryExpr>);
+            set(NodeKind::UnaryExpr, &dispatch<UnaryExpr>);
+            set(NodeKind::ParenExpr, &dispatch<ParenExpr>);
+            set(NodeKind::IntLiteralExpr, &dispatch<IntLiteralExpr>);
+            set(NodeKind::StringLiteralExpr, &dispatch<StringLiteralExpr>);
+            set(NodeKind::CharLiteralExpr, &dispatch<CharLiteralExpr>);
+            set(NodeKind::FloatingLiteralExpr, &dispatch<FloatingLiteralExpr>);
+            set(NodeKind::BoolLiteralExpr, &dispatch<BoolLiteralExpr>);
+            set(NodeKind::IdentifierExpr, &dispatch<IdentifierExpr>);
+            set(NodeKind::AssignmentExpr, &dispatch<AssignmentExpr>);
+            set(NodeKind::CallExpr, &dispatch<CallExpr>);
+            set(NodeKind::FieldExpr, &dispatch<FieldExpr>);
+            set(NodeKind::IndexExpr, &dispatch<IndexExpr>);
+            set(NodeKind::ArrayLiteralExpr, &dispatch<ArrayLiteralExpr>);
+            set(NodeKind::ExprStatement, &dispatch<ExprStatement>);
+            set(NodeKind::ReturnStatement, &dispatch<ReturnStatement>);
+            set(NodeKind::VarDeclStatement, &dispatch<VarDeclStatement>);
+            set(NodeKind::FunDeclStatement, &dispatch<FunDeclStatement>);
+            set(NodeKind::StructDeclStatement, &dispatch<StructDeclStatement>);
+            set(NodeKind::BlockStatement, &dispatch<BlockStatement>);
+            set(NodeKind::IfStatement, &dispatch<IfStatement>);
+            set(NodeKind::WhileStatement, &dispatch<WhileStatement>);
+            set(NodeKind::ForStatement, &dispatch<ForStatement>);
+            set(NodeKind::Program, &dispatch<ProgramNode>);
+            return table;
+        }();
+
+        template<typename Node>
+        bool walk_node(const Node& node)
+        {
+            auto& self = static_cast<Derived&>(*this);
+            if constexpr (requires { self.pre(node); }) {
+                if constexpr (std::is_void_v<decltype(self.pre(node))>) {
+                    self.pre(node);
+                }
+                else if (const auto action = self.pre(node); action == Walk::Stop) {
+                    return false;
+                }
+                else if (action == Walk::SkipChildren) {
+                    return call_post(self, node);
+                }
+            }
+            return walk_children(node) && call_post(self, node);
+        }
+
+        template<typename Node>
+        static bool call_post(Derived& self, const Node& node)
+        {
+            if constexpr (requires { self.post(node); }) {
+                if constexpr (std::is_void_v<decltype(self.post(node))>) {
+                    self.post(node);
+                }
+                else {
+                    return self.post(node) != Walk::Stop;
+                }
+            }
+            return true;
+        }
+
+        bool walk_optional(const ASTNode* node) { return node == nullptr || walk(*node); }
+
+        bool walk_expressions(std::span<const ExprPtr> expressions)
+        {
+            for (const auto& expr : expressions) {
+                if (!walk(*expr)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        bool walk_statements(std::span<const StatementPtr> statements)
+        {
+            for (const auto& statement : statements) {
+                if (!walk(*statement)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+} // namespace talos
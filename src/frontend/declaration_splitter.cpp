@@ -0,0 +1,134 @@
+#include "declaration_splitter.h"
+
+#include "exceptions.h"
+
+#include <utility>
+
+namespace talos
+{
+    namespace
+    {
+        // 64 bit FNV-1a
+        constexpr std::uint64_t hash_offset = 14695981039346656037ULL;
+        constexpr std::uint64_t hash_prime = 1099511628211ULL;
+
+        constexpr std::uint64_t hash_byte(std::uint64_t hash, unsigned char byte) noexcept
+        {
+            return (hash ^ byte) * hash_prime;
+        }
+
+        constexpr std::uint64_t hash_token(std::uint64_t hash, const Token& token) noexcept
+        {
+            hash = hash_byte(hash, static_cast<unsigned char>(token.type));
+            for (const auto character : token.string) {
+                hash = hash_byte(hash, static_cast<unsigned char>(character));
+            }
+            // Separates the spellings of adjacent tokens
+            return hash_byte(hash, 0xFF);
+        }
+
+        bool ends_at_brace(TokenType first) noexcept
+        {
+            switch (first) {
+                case TokenType::Fun:
+                case TokenType::Struct:
+                case TokenType::Packed:
+                case TokenType::Soa:
+                case TokenType::If:
+                case TokenType::While:
+                case TokenType::For:
+                case TokenType::LeftBrace:
+                    return true;
+                default:
+                    return false;
+            }
+        }
+    } // namespace
+
+    DeclarationSplitter::DeclarationSplitter(TokenSource& tokens)
+        : tokens_(tokens)
+    {
+    }
+
+    bool DeclarationSplitter::next(DeclarationTokens& declaration)
+    {
+        declaration.tokens.clear();
+        declaration.hash = hash_offset;
+        declaration.error = nullptr;
+        if (done_) {
+            return false;
+        }
+
+        auto braced = false;
+        auto is_if = false;
+        auto depth = 0;
+        for (;;) {
+            auto token = Token{};
+            try {
+                token = lookahead_ ? *std::exchange(lookahead_, std::nullopt) : tokens_.consume_token();
+            } catch (const TalosException&) {
+                // Left to the parser, which reports it unless it fails earlier
+                declaration.error = std::current_exception();
+                done_ = true;
+                return true;
+            }
+            if (token.type == TokenType::Eof) {
+                declaration.end = token.location;
+                done_ = true;
+                return !declaration.tokens.empty();
+            }
+
+            if (declaration.tokens.empty()) {
+                braced = ends_at_brace(token.type);
+                is_if = token.type == TokenType::If;
+            }
+            declaration.tokens.push_back(token);
+            declaration.hash = hash_token(declaration.hash, token);
+
+            // Brackets too, the ';' of an array literal [x; n] ends nothing
+            if (token.type == TokenType::LeftBrace || token.type == TokenType::LeftBracket) {
+                ++depth;
+            }
+            else if (token.type == TokenType::RightBrace || token.type == TokenType::RightBracket) {
+                --depth;
+            }
+            const auto ends = braced ? token.type == TokenType::RightBrace : token.type == TokenType::Semicolon;
+            if (!ends || depth != 0) {
+                continue;
+            }
+            if (is_if) {
+                // Ends unless continued by else, the token read past the brace
+                // starts the next declaration otherwise
+                try {
+                    lookahead_ = tokens_.consume_token();
+                } catch (const TalosException&) {
+                    declaration.end = token.location;
+                    declaration.error = std::current_exception();
+                    done_ = true;
+                    return true;
+                }
+                if (lookahead_->type == TokenType::Else) {
+                    continue;
+                }
+            }
+            declaration.end = token.location;
+            return true;
+        }
+    }
+
+    DeclarationTokenSource::DeclarationTokenSource(const DeclarationTokens& declaration)
+        : declaration_(declaration)
+    {
+    }
+
+    Token DeclarationTokenSource::consume_token()
+    {
+        if (position_ < declaration_.tokens.size()) {
+            return declaration_.tokens[position_++];
+        }
+        if (declaration_.error) {
+            std::rethrow_exception(declaration_.error);
+        }
+        return Token{.type = TokenType::Eof, .location = declaration_.end};
+    }
+} // namespace talos
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "source_location.h"
+#include "token.h"
+#include "token_buffer.h"
+#include "token_source.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <optional>
+#include <vector>
+
+namespace talos
+{
+    // Tokens of a single top-level declaration
+    struct DeclarationTokens {
+        std::vector<Token> tokens;
+        // Hash of the token types and spellings, so independent of whitespace
+        // and of where the declaration appears in the source
+        std::uint64_t hash = 0;
+        // Lexer error raised after the last token, rethrown when replaying them
+        std::exception_ptr error;
+        // Location of the Eof token ending the replay
+        SourceLocation end;
+    };
+
+    // Splits a token stream into top-level declarations without parsing it:
+    // functions, structs and control flow statements end at the brace closing
+    // their body, unless an if is continued by else, anything else at the next
+    // semicolon outside of braces and brackets. Parsing the tokens of a
+    // declaration on their own fails exactly where parsing the whole stream
+    // would, as the grammar cannot continue a declaration past either token
+    class DeclarationSplitter
+    {
+    public:
+        explicit DeclarationSplitter(TokenSource& tokens);
+
+        // Reads the next declaration, returns false at the end of the input
+        bool next(DeclarationTokens& declaration);
+
+    private:
+        TokenBuffer tokens_;
+        // Read to find out whether an if statement continues with else
+        std::optional<Token> lookahead_;
+        bool done_ = false;
+    };
+
+    // Replays the tokens of a declaration followed by Eof, or by its lexer error
+    class DeclarationTokenSource final : public TokenSource
+    {
+    public:
+        explicit DeclarationTokenSource(const DeclarationTokens& declaration);
+
+        [[nodiscard]] Token consume_token() override;
+
+    private:
+        const DeclarationTokens& declaration_;
+        std::size_t position_ = 0;
+    };
+} // namespace talos
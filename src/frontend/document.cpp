@@ -0,0 +1,217 @@
+#include "document.h"
+
+#include "lexer.h"
+#include "parser.h"
+
+#include <stdexcept>
+
+namespace talos
+{
+    namespace
+    {
+        // Lexer that keeps every token it returns
+        class RecordingLexer final : public TokenSource
+        {
+        public:
+            RecordingLexer(std::string_view source, std::vector<Token>& tokens)
+                : lexer_(source)
+                , tokens_(&tokens)
+            {
+            }
+
+            [[nodiscard]] Token consume_token() override
+            {
+                return tokens_->emplace_back(lexer_.consume_token());
+            }
+
+            [[nodiscard]] SourceLocation location() const noexcept { return lexer_.location(); }
+
+        private:
+            Lexer lexer_;
+            std::vector<Token>* tokens_;
+        };
+
+        // Location past the end of text when it cannot be lexed to the end
+        SourceLocation scan_end(std::string_view text) noexcept
+        {
+            auto location = SourceLocation{};
+            for (const auto character : text) {
+                if (character == '\n') {
+                    location.advance_line();
+                }
+                else {
+                    location.column += character == '\t' ? 4 : 1;
+                }
+            }
+            return location;
+        }
+
+        bool is_whitespace_only(const DocumentBlock& block) noexcept
+        {
+            return block.declaration() == nullptr && !block.error();
+        }
+    } // namespace
+
+    Document::Document() = default;
+
+    Document::Document(std::string_view text)
+    {
+        apply(TextEdit{.inserted = text});
+    }
+
+    DocumentChange Document::apply(const TextEdit& edit)
+    {
+        if (edit.offset > size_ || edit.removed > size_ - edit.offset) {
+            throw std::out_of_range("Edit is outside of the document");
+        }
+
+        // Find the blocks [first, last) touched by the edit. Insertions at a block
+        // boundary belong to the following block, as blocks own their leading whitespace
+        std::size_t first = 0;
+        std::size_t fragment_start = 0;
+        while (first + 1 < blocks_.size() && edit.offset >= fragment_start + blocks_[first]->text_.size()) {
+            fragment_start += blocks_[first]->text_.size();
+            ++first;
+        }
+        std::size_t last = first;
+        auto last_end = fragment_start;
+        while (last < blocks_.size() && (last == first || edit.offset + edit.removed > last_end)) {
+            last_end += blocks_[last]->text_.size();
+            ++last;
+        }
+
+        // Text that failed to parse may be completed by this edit
+        while (first > 0 && blocks_[first - 1]->error_) {
+            --first;
+            fragment_start -= blocks_[first]->text_.size();
+        }
+        while (last < blocks_.size() && blocks_[last]->error_) {
+            ++last;
+        }
+
+        std::string fragment;
+        for (auto i = first; i < last; ++i) {
+            fragment += blocks_[i]->text_;
+        }
+        fragment.replace(edit.offset - fragment_start, edit.removed, edit.inserted);
+
+        for (;;) {
+            auto parsed = parse_blocks(fragment, last == blocks_.size());
+            if (!parsed) {
+                fragment += blocks_[last]->text_;
+                ++last;
+                continue;
+            }
+            // Trailing whitespace is merged into the preceding declaration
+            if (parsed->size() == 1 && is_whitespace_only(*parsed->front()) && first > 0) {
+                --first;
+                fragment.insert(0, blocks_[first]->text_);
+                continue;
+            }
+
+            const auto change = DocumentChange{
+                .first = first,
+                .removed = last - first,
+                .inserted = parsed->size(),
+            };
+            blocks_.erase(blocks_.begin() + static_cast<std::ptrdiff_t>(first), blocks_.begin() + static_cast<std::ptrdiff_t>(last));
+            blocks_.insert(blocks_.begin() + static_cast<std::ptrdiff_t>(first),
+                           std::make_move_iterator(parsed->begin()),
+                           std::make_move_iterator(parsed->end()));
+            size_ = size_ - edit.removed + edit.inserted.size();
+            return change;
+        }
+    }
+
+    std::string Document::text() const
+    {
+        std::string text;
+        text.reserve(size_);
+        for (const auto& block : blocks_) {
+            text += block->text_;
+        }
+        return text;
+    }
+
+    SourceLocation Document::block_start(std::size_t index) const
+    {
+        auto location = SourceLocation{};
+        for (std::size_t i = 0; i < index; ++i) {
+            const auto end = blocks_.at(i)->end_;
+            if (end.line == 1) {
+                location.column += end.column - 1;
+            }
+            else {
+                location.line += end.line - 1;
+                location.column = end.column;
+            }
+        }
+        return location;
+    }
+
+    std::optional<std::vector<Document::BlockPtr>> Document::parse_blocks(const std::string& text, bool at_end)
+    {
+        // Find where each declaration ends
+        std::vector<std::size_t> ends;
+        {
+            std::vector<Token> tokens;
+            auto lexer = RecordingLexer{text, tokens};
+            auto parser = Parser{&lexer};
+            try {
+                parser.parse([&](StatementPtr) {
+                    // The parser has already read one token past the declaration
+                    const auto& last = tokens[tokens.size() - 2];
+                    ends.push_back(static_cast<std::size_t>(last.string.data() - text.data()) + last.string.size());
+                });
+            } catch (const TalosException& exception) {
+                // Errors at the end of the text may go away once more of it is included
+                const auto at_text_end = exception.code() == ReturnCode::UnexpectedEof ||
+                                         (!tokens.empty() && tokens.back().type == TokenType::Eof && exception.location() == tokens.back().location);
+                if (at_text_end && !at_end) {
+                    return std::nullopt;
+                }
+
+                auto block = std::make_unique<DocumentBlock>();
+                block->text_ = text;
+                block->error_ = exception;
+                block->end_ = scan_end(block->text_);
+                try {
+                    auto block_lexer = RecordingLexer{block->text_, block->tokens_};
+                    while (block_lexer.consume_token().type != TokenType::Eof) {
+                    }
+                } catch (const TalosException&) {
+                    // Tokens up to the lexer error are kept
+                }
+                auto blocks = std::vector<BlockPtr>{};
+                blocks.push_back(std::move(block));
+                return blocks;
+            }
+        }
+        // Whitespace belongs to the following declaration, only at the end of
+        // the document does it go to the last one
+        if (ends.empty() || ends.back() != text.size()) {
+            if (!at_end) {
+                return std::nullopt;
+            }
+            if (ends.empty()) {
+                ends.push_back(text.size());
+            }
+            ends.back() = text.size();
+        }
+
+        // Each declaration is parsed again on its own so that its locations are relative to the block
+        auto blocks = std::vector<BlockPtr>{};
+        std::size_t start = 0;
+        for (const auto end : ends) {
+            auto block = std::make_unique<DocumentBlock>();
+            block->text_ = text.substr(start, end - start);
+            auto lexer = RecordingLexer{block->text_, block->tokens_};
+            auto parser = Parser{&lexer};
+            parser.parse([&](StatementPtr declaration) { block->declaration_ = std::move(declaration); });
+            block->end_ = lexer.location();
+            blocks.push_back(std::move(block));
+            start = end;
+        }
+        return blocks;
+    }
+} // namespace talos
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "ast.h"
+#include "exceptions.h"
+
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace talos
+{
+    struct TextEdit {
+        // Byte offset into the document at which the edit applies
+        std::size_t offset = 0;
+        // Number of bytes removed starting at offset
+        std::size_t removed = 0;
+        std::string_view inserted;
+    };
+
+    // Blocks replaced by an edit: removed blocks starting at first were replaced
+    // by inserted freshly parsed blocks
+    struct DocumentChange {
+        std::size_t first = 0;
+        std::size_t removed = 0;
+        std::size_t inserted = 0;
+    };
+
+    // A top-level declaration together with the whitespace preceding it.
+    // Tokens and AST locations are relative to the start of the block, so blocks
+    // are untouched by edits elsewhere in the document
+    class DocumentBlock
+    {
+    public:
+        [[nodiscard]] std::string_view text() const noexcept { return text_; }
+        // Tokens of the block, ending with Eof
+        [[nodiscard]] std::span<const Token> tokens() const noexcept { return tokens_; }
+        // Null if the block does not parse or only holds whitespace
+        [[nodiscard]] const Statement* declaration() const noexcept { return declaration_.get(); }
+        [[nodiscard]] const std::optional<TalosException>& error() const noexcept { return error_; }
+        // Location just past the end of the block, relative to its start
+        [[nodiscard]] SourceLocation end() const noexcept { return end_; }
+
+    private:
+        friend class Document;
+
+        std::string text_;
+        std::vector<Token> tokens_;
+        StatementPtr declaration_;
+        std::optional<TalosException> error_;
+        SourceLocation end_;
+    };
+
+    // Source buffer kept split into top-level declarations for editors and hot
+    // reloading. An edit only re-lexes and re-parses the blocks it touches,
+    // growing the region while the edit leaves it incomplete (e.g. an
+    // unterminated literal or block) until it parses on its own again. Text that
+    // cannot be parsed is kept as a block holding the error
+    class Document
+    {
+    public:
+        Document();
+        explicit Document(std::string_view text);
+
+        // Throws std::out_of_range if the edited range is outside the document
+        DocumentChange apply(const TextEdit& edit);
+
+        [[nodiscard]] std::size_t size() const noexcept { return size_; }
+        [[nodiscard]] std::string text() const;
+
+        [[nodiscard]] std::size_t block_count() const noexcept { return blocks_.size(); }
+        [[nodiscard]] const DocumentBlock& block(std::size_t index) const { return *blocks_.at(index); }
+        // Location of the start of the block in the document
+        [[nodiscard]] SourceLocation block_start(std::size_t index) const;
+
+    private:
+        using BlockPtr = std::unique_ptr<DocumentBlock>;
+
+        // Parses text into blocks, or returns nullopt if it has to be extended
+        // with the following block first
+        [[nodiscard]] static std::optional<std::vector<BlockPtr>> parse_blocks(const std::string& text, bool at_end);
+
+        std::vector<BlockPtr> blocks_;
+        std::size_t size_ = 0;
+    };
+} // namespace talos
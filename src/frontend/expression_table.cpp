@@ -0,0 +1,274 @@
+#include "expression_table.h"
+
+#include "ast_walker.h"
+
+#include <algorithm>
+#include <concepts>
+#include <optional>
+#include <span>
+
+namespace talos
+{
+    namespace
+    {
+        // 64 bit FNV-1a, as for the hashes of declarations
+        constexpr std::uint64_t hash_offset = 14695981039346656037ULL;
+        constexpr std::uint64_t hash_prime = 1099511628211ULL;
+
+        constexpr std::uint64_t hash_byte(std::uint64_t hash, unsigned char byte) noexcept
+        {
+            return (hash ^ byte) * hash_prime;
+        }
+
+        constexpr std::uint64_t hash_text(std::uint64_t hash, std::string_view text) noexcept
+        {
+            for (const auto character : text) {
+                hash = hash_byte(hash, static_cast<unsigned char>(character));
+            }
+            return hash_byte(hash, 0xFF);
+        }
+
+        constexpr std::uint64_t hash_word(std::uint64_t hash, std::uint64_t word) noexcept
+        {
+            for (auto i = 0U; i < 64U; i += 8U) {
+                hash = hash_byte(hash, static_cast<unsigned char>(word >> i));
+            }
+            return hash;
+        }
+
+        std::string_view spelling(const std::optional<Token>& token) noexcept
+        {
+            return token ? token->string : std::string_view{};
+        }
+
+        std::size_t node_size(const Expr& expr) noexcept
+        {
+            switch (expr.kind()) {
+                case NodeKind::BinaryExpr:
+                    return sizeof(BinaryExpr);
+                case NodeKind::UnaryExpr:
+                    return sizeof(UnaryExpr);
+                case NodeKind::ParenExpr:
+                    return sizeof(ParenExpr);
+                case NodeKind::IntLiteralExpr:
+                    return sizeof(IntLiteralExpr);
+                case NodeKind::StringLiteralExpr:
+                    return sizeof(StringLiteralExpr);
+                case NodeKind::CharLiteralExpr:
+                    return sizeof(CharLiteralExpr);
+                case NodeKind::FloatingLiteralExpr:
+                    return sizeof(FloatingLiteralExpr);
+                case NodeKind::BoolLiteralExpr:
+                    return sizeof(BoolLiteralExpr);
+                case NodeKind::IdentifierExpr:
+                    return sizeof(IdentifierExpr);
+                case NodeKind::AssignmentExpr:
+                    return sizeof(AssignmentExpr);
+                case NodeKind::CallExpr:
+                    return sizeof(CallExpr);
+                case NodeKind::FieldExpr:
+                    return sizeof(FieldExpr);
+                case NodeKind::IndexExpr:
+                    return sizeof(IndexExpr);
+                case NodeKind::ArrayLiteralExpr:
+                    return sizeof(ArrayLiteralExpr);
+                default:
+                    return 0;
+            }
+        }
+
+        // Adds the expressions of each function to a table of its own
+        class SharingCounter : public ASTWalker<SharingCounter>
+        {
+        public:
+            SharingCounter() { tables_.emplace_back(); }
+
+            [[nodiscard]] ExpressionSharing finish()
+            {
+                count(tables_.back());
+                return sharing_;
+            }
+
+        private:
+            friend class ASTWalker<SharingCounter>;
+
+            void pre(const FunDeclStatement&) { tables_.emplace_back(); }
+            void post(const FunDeclStatement&)
+            {
+                count(tables_.back());
+                tables_.pop_back();
+            }
+
+            // The table walks the subtrees of expressions itself
+            template<std::derived_from<Expr> Node>
+            Walk pre(const Node& expr)
+            {
+                static_cast<void>(tables_.back().add(expr));
+                return Walk::SkipChildren;
+            }
+
+            void count(const ExpressionTable& table)
+            {
+                sharing_.nodes += table.nodes();
+                sharing_.unique_nodes += table.size();
+                sharing_.bytes += table.bytes();
+                sharing_.unique_bytes += table.unique_bytes();
+            }
+
+            std::vector<ExpressionTable> tables_;
+            ExpressionSharing sharing_;
+        };
+    } // namespace
+
+    ExpressionTable::Id ExpressionTable::add(const Expr& expr)
+    {
+        if (const auto found = ids_.find(&expr); found != ids_.end()) {
+            return found->second;
+        }
+        ++nodes_;
+        bytes_ += node_size(expr);
+        auto entry = Entry{.expr = &expr};
+        // Ids of the children are pushed above those of the children of the
+        // expressions being added around this one
+        const auto first_child = pending_.size();
+        const auto child = [&](const Expr& node) {
+            const auto id = add(node);
+            pending_.push_back(id);
+        };
+        switch (expr.kind()) {
+            case NodeKind::ParenExpr: {
+                const auto id = add(*static_cast<const ParenExpr&>(expr).expr());
+                ids_.emplace(&expr, id);
+                return id;
+            }
+            case NodeKind::BinaryExpr: {
+                const auto& binary = static_cast<const BinaryExpr&>(expr);
+                entry.op = binary.op().type;
+                child(*binary.lhs());
+                child(*binary.rhs());
+                break;
+            }
+            case NodeKind::UnaryExpr: {
+                const auto& unary = static_cast<const UnaryExpr&>(expr);
+                entry.op = unary.unary_op().type;
+                child(*unary.expr());
+                break;
+            }
+            case NodeKind::IntLiteralExpr: {
+                const auto& literal = static_cast<const IntLiteralExpr&>(expr);
+                entry.text = literal.int_literal().string;
+                entry.suffix = spelling(literal.suffix());
+                break;
+            }
+            case NodeKind::FloatingLiteralExpr: {
+                const auto& literal = static_cast<const FloatingLiteralExpr&>(expr);
+                entry.text = literal.float_literal().string;
+                entry.suffix = spelling(literal.suffix());
+                break;
+            }
+            case NodeKind::StringLiteralExpr:
+                entry.text = static_cast<const StringLiteralExpr&>(expr).string_literal().string;
+                break;
+            case NodeKind::CharLiteralExpr:
+                entry.text = static_cast<const CharLiteralExpr&>(expr).char_literal().string;
+                break;
+            case NodeKind::BoolLiteralExpr:
+                entry.text = static_cast<const BoolLiteralExpr&>(expr).bool_literal().string;
+                break;
+            case NodeKind::IdentifierExpr:
+                entry.text = static_cast<const IdentifierExpr&>(expr).identifier().string;
+                break;
+            case NodeKind::AssignmentExpr: {
+                const auto& assignment = static_cast<const AssignmentExpr&>(expr);
+                child(*assignment.lhs());
+                child(*assignment.rhs());
+                entry.pure = false;
+                break;
+            }
+            case NodeKind::CallExpr: {
+                // Calls may assign to globals, also those of struct constructors
+                // are not told apart from functions here
+                const auto& call = static_cast<const CallExpr&>(expr);
+                child(*call.callee());
+                for (const auto& argument : call.arguments()) {
+                    child(*argument);
+                }
+                entry.pure = false;
+                break;
+            }
+            case NodeKind::FieldExpr: {
+                const auto& field = static_cast<const FieldExpr&>(expr);
+                entry.text = field.field().string;
+                child(*field.object());
+                break;
+            }
+            case NodeKind::IndexExpr: {
+                const auto& index = static_cast<const IndexExpr&>(expr);
+                child(*index.array());
+                child(*index.index());
+                break;
+            }
+            case NodeKind::ArrayLiteralExpr: {
+                const auto& literal = static_cast<const ArrayLiteralExpr&>(expr);
+                entry.text = spelling(literal.count());
+                for (const auto& element : literal.elements()) {
+                    child(*element);
+                }
+                break;
+            }
+            default:
+                break;
+        }
+
+        auto hash = hash_byte(hash_offset, static_cast<unsigned char>(expr.kind()));
+        hash = hash_byte(hash, static_cast<unsigned char>(entry.op));
+        hash = hash_text(hash_text(hash, entry.text), entry.suffix);
+        const auto children = std::span{pending_}.subspan(first_child);
+        for (const auto id : children) {
+            hash = hash_word(hash, entries_[id].hash);
+            entry.pure = entry.pure && entries_[id].pure;
+        }
+        entry.hash = hash;
+        const auto id = intern(entry, children);
+        pending_.resize(first_child);
+        ids_.emplace(&expr, id);
+        return id;
+    }
+
+    ExpressionTable::Id ExpressionTable::intern(Entry entry, std::span<const Id> children)
+    {
+        if (entry.pure) {
+            const auto [first, last] = pure_ids_.equal_range(entry.hash);
+            for (auto iter = first; iter != last; ++iter) {
+                if (same(entries_[iter->second], entry, children)) {
+                    return iter->second;
+                }
+            }
+        }
+        const auto id = static_cast<Id>(entries_.size());
+        unique_bytes_ += node_size(*entry.expr);
+        if (entry.pure) {
+            pure_ids_.emplace(entry.hash, id);
+        }
+        entry.first_child = static_cast<std::uint32_t>(children_.size());
+        entry.child_count = static_cast<std::uint32_t>(children.size());
+        children_.insert(children_.end(), children.begin(), children.end());
+        entries_.push_back(entry);
+        return id;
+    }
+
+    // The children of both are already interned, so comparing their ids
+    // compares the whole subtrees
+    bool ExpressionTable::same(const Entry& entry, const Entry& other, std::span<const Id> children) const noexcept
+    {
+        return entry.expr->kind() == other.expr->kind() && entry.op == other.op && entry.text == other.text && entry.suffix == other.suffix &&
+               std::ranges::equal(std::span{children_}.subspan(entry.first_child, entry.child_count), children);
+    }
+
+    ExpressionSharing share_expressions(const ProgramNode& program)
+    {
+        auto counter = SharingCounter{};
+        static_cast<void>(counter.walk(program));
+        return counter.finish();
+    }
+} // namespace talos
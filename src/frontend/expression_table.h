@@ -0,0 +1,86 @@
+#pragma once
+
+#include "ast.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace talos
+{
+    // Hash-consing of expression subtrees. Structurally equal pure subtrees,
+    // the same operators, literal spellings, names and children, get the same
+    // id, regardless of parentheses and locations. Subtrees that call or
+    // assign may have a different value each time and get an id of their own.
+    // Names are compared by spelling, so subtrees only have the same value if
+    // their names refer to the same variables, e.g. within a scope. Ids are
+    // dense, so results of an analysis can be memoized in a vector indexed by
+    // them
+    class ExpressionTable
+    {
+    public:
+        using Id = std::uint32_t;
+
+        // Adds expr and its subtrees if they are not in the table yet, returns the id of expr
+        Id add(const Expr& expr);
+
+        // Id of an added expression
+        [[nodiscard]] Id id(const Expr& expr) const { return ids_.at(&expr); }
+        // Hash of the structure of the subtrees with an id, the same in every table
+        [[nodiscard]] std::uint64_t hash(Id id) const { return entries_[id].hash; }
+        [[nodiscard]] bool is_pure(Id id) const { return entries_[id].pure; }
+        // The first expression added with an id
+        [[nodiscard]] const Expr& representative(Id id) const { return *entries_[id].expr; }
+        [[nodiscard]] std::size_t size() const noexcept { return entries_.size(); }
+
+        // Expression nodes added, including parentheses, and the bytes of
+        // those nodes and of the representatives
+        [[nodiscard]] std::size_t nodes() const noexcept { return nodes_; }
+        [[nodiscard]] std::size_t bytes() const noexcept { return bytes_; }
+        [[nodiscard]] std::size_t unique_bytes() const noexcept { return unique_bytes_; }
+
+    private:
+        struct Entry {
+            const Expr* expr = nullptr;
+            std::uint64_t hash = 0;
+            // Operator of unary and binary expressions
+            TokenType op = TokenType::Invalid;
+            // Spelling of literals and names, and of the field of a FieldExpr
+            // or the count of an ArrayLiteralExpr
+            std::string_view text;
+            std::string_view suffix;
+            // Range of the ids of the children in children_
+            std::uint32_t first_child = 0;
+            std::uint32_t child_count = 0;
+            bool pure = true;
+        };
+
+        [[nodiscard]] Id intern(Entry entry, std::span<const Id> children);
+        [[nodiscard]] bool same(const Entry& entry, const Entry& other, std::span<const Id> children) const noexcept;
+
+        std::vector<Entry> entries_;
+        std::vector<Id> children_;
+        // Ids of the children of the expressions being added
+        std::vector<Id> pending_;
+        std::unordered_map<const Expr*, Id> ids_;
+        // Ids of pure entries by hash
+        std::unordered_multimap<std::uint64_t, Id> pure_ids_;
+        std::size_t nodes_ = 0;
+        std::size_t bytes_ = 0;
+        std::size_t unique_bytes_ = 0;
+    };
+
+    // How much smaller the expressions of a program are with identical pure
+    // subtrees shared within each function, and within the top-level code
+    struct ExpressionSharing {
+        std::size_t nodes = 0;
+        std::size_t unique_nodes = 0;
+        std::size_t bytes = 0;
+        std::size_t unique_bytes = 0;
+    };
+
+    [[nodiscard]] ExpressionSharing share_expressions(const ProgramNode& program);
+} // namespace talos
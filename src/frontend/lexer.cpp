@@ -1,10 +1,13 @@
 #include "lexer.h"
 
 #include "exceptions.h"
+#include "string_literal.h"
 
 #include <fmt/format.h>
 
 #include <cctype>
+#include <cstddef>
+#include <cstdint>
 #include <iterator>
 #include <unordered_map>
 
@@ -41,6 +44,13 @@ namespace talos
         const auto keywords = std::unordered_map{
             std::make_pair("fun"sv, TokenType::Fun),
             std::make_pair("return"sv, TokenType::Return),
+            std::make_pair("if"sv, TokenType::If),
+            std::make_pair("else"sv, TokenType::Else),
+            std::make_pair("while"sv, TokenType::While),
+            std::make_pair("for"sv, TokenType::For),
+            std::make_pair("struct"sv, TokenType::Struct),
+            std::make_pair("packed"sv, TokenType::Packed),
+            std::make_pair("soa"sv, TokenType::Soa),
             std::make_pair("var"sv, TokenType::Var),
             std::make_pair("let"sv, TokenType::Let),
             std::make_pair("i8"sv, TokenType::Int8),
@@ -61,6 +71,13 @@ namespace talos
     {
     }
 
+    Lexer::Lexer(std::string_view source, SourceLocation start)
+        : source_(source)
+        , current_position_(source_.begin())
+        , current_location_(start)
+    {
+    }
+
     Token Lexer::consume_token()
     {
         for (;;) {
@@ -97,15 +114,33 @@ namespace talos
                 return make_token(token_type);
             };
             auto make_string = [&]() {
-                while (peek() != '"') {
+                for (;;) {
+                    // Skip to the next character that needs a look
+                    const auto rest = source_.substr(static_cast<std::size_t>(std::distance(source_.begin(), current_position_)));
+                    const auto run = find_string_special(rest);
+                    current_position_ += static_cast<std::ptrdiff_t>(run);
+                    current_location_.column += static_cast<std::int32_t>(run);
                     if (is_eof()) {
                         throw unexpected_eof(location, "Expected terminating \"");
                     }
-                    consume_char();
+                    const auto escape_location = current_location_;
+                    switch (consume_char()) {
+                        case '"':
+                            return make_token(TokenType::StringLiteral);
+                        case '\n':
+                            advance_line();
+                            break;
+                        default: {
+                            const auto length = decode_escape(rest.substr(run + 1), nullptr);
+                            if (length == 0) {
+                                throw TalosException(ReturnCode::InvalidEscape, escape_location, "Expected \\n, \\t, \\\\, \\\", \\xNN or \\u{N...}");
+                            }
+                            current_position_ += static_cast<std::ptrdiff_t>(length);
+                            current_location_.column += static_cast<std::int32_t>(length);
+                            break;
+                        }
+                    }
                 }
-                // Consume closing quote
-                consume_char();
-                return make_token(TokenType::StringLiteral);
             };
             auto make_char = [&]() {
                 if (peek() == '\'') {
@@ -123,6 +158,14 @@ namespace talos
                 consume_char();
                 return make_token(TokenType::CharLiteral);
             };
+            // Token of one character, or of two if the second is next
+            auto make_operator = [&](char second, TokenType single, TokenType pair) {
+                if (peek() == second) {
+                    consume_char();
+                    return make_token(pair);
+                }
+                return make_token(single);
+            };
             auto make_keyword_or_identifier = [&]() {
                 while (is_identifier_char(peek())) {
                     consume_char();
@@ -157,10 +200,38 @@ namespace talos
                     return make_token(TokenType::LeftBrace);
                 case '}':
                     return make_token(TokenType::RightBrace);
+                case '[':
+                    return make_token(TokenType::LeftBracket);
+                case ']':
+                    return make_token(TokenType::RightBracket);
+                case '%':
+                    return make_token(TokenType::Percent);
                 case '=':
-                    return make_token(TokenType::Equal);
+                    return make_operator('=', TokenType::Equal, TokenType::EqualEqual);
+                case '!':
+                    return make_operator('=', TokenType::Bang, TokenType::BangEqual);
+                case '<':
+                    return make_operator('=', TokenType::Less, TokenType::LessEqual);
+                case '>':
+                    return make_operator('=', TokenType::Greater, TokenType::GreaterEqual);
+                case '&':
+                    if (peek() != '&') {
+                        break;
+                    }
+                    consume_char();
+                    return make_token(TokenType::AmpAmp);
+                case '|':
+                    if (peek() != '|') {
+                        break;
+                    }
+                    consume_char();
+                    return make_token(TokenType::PipePipe);
                 case ':':
                     return make_token(TokenType::Colon);
+                case '.':
+                    return make_token(TokenType::Dot);
+                case ',':
+                    return make_token(TokenType::Comma);
                 case ' ':
                     continue;
                 case '\t':
@@ -3,15 +3,22 @@
 #include "return_code.h"
 #include "source_location.h"
 #include "token.h"
+#include "token_source.h"
 
 namespace talos
 {
-    class Lexer
+    class Lexer final : public TokenSource
     {
     public:
         explicit Lexer(std::string_view source);
+        // Lexes source as if it started at start, e.g. when it is a segment of a larger input
+        Lexer(std::string_view source, SourceLocation start);
 
-        [[nodiscard]] Token consume_token();
+        [[nodiscard]] Token consume_token() override;
+        [[nodiscard]] bool allows_read_ahead() const noexcept override { return true; }
+
+        // Location of the next character to be lexed
+        [[nodiscard]] SourceLocation location() const noexcept { return current_location_; }
 
     private:
         [[nodiscard]] bool is_eof() const noexcept { return current_position_ == source_.end(); }
@@ -0,0 +1,18 @@
+#include "node_counter.h"
+
+#include <numeric>
+
+namespace talos
+{
+    NodeCounts count_nodes(const ASTNode& node)
+    {
+        auto counter = NodeCounter{};
+        counter.walk(node);
+        return counter.counts();
+    }
+
+    std::uint64_t total_nodes(const NodeCounts& counts) noexcept
+    {
+        return std::accumulate(counts.begin(), counts.end(), std::uint64_t{0});
+    }
+} // namespace talos
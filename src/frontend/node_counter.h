@@ -0,0 +1,24 @@
+#pragma once
+
+#include "ast.h"
+#include "ast_walker.h"
+#include "node_kind.h"
+
+namespace talos
+{
+    class NodeCounter : public ASTWalker<NodeCounter>
+    {
+    public:
+        [[nodiscard]] const NodeCounts& counts() const noexcept { return counts_; }
+
+    private:
+        friend class ASTWalker<NodeCounter>;
+
+        void pre(const ASTNode& node) noexcept { ++counts_[static_cast<std::size_t>(node.kind())]; }
+
+        NodeCounts counts_{};
+    };
+
+    [[nodiscard]] NodeCounts count_nodes(const ASTNode& node);
+    [[nodiscard]] std::uint64_t total_nodes(const NodeCounts& counts) noexcept;
+} // namespace talos
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace talos
+{
+    enum class NodeKind {
+        BinaryExpr,
+        UnaryExpr,
+        ParenExpr,
+        IntLiteralExpr,
+        StringLiteralExpr,
+        CharLiteralExpr,
+        FloatingLiteralExpr,
+        BoolLiteralExpr,
+        IdentifierExpr,
+        AssignmentExpr,
+        CallExpr,
+        FieldExpr,
+        IndexExpr,
+        ArrayLiteralExpr,
+        ExprStatement,
+        ReturnStatement,
+        VarDeclStatement,
+        FunDeclStatement,
+        StructDeclStatement,
+        BlockStatement,
+        IfStatement,
+        WhileStatement,
+        ForStatement,
+        Program,
+    };
+
+    inline constexpr std::size_t node_kind_count = static_cast<std::size_t>(NodeKind::Program) + 1;
+
+    // Number of nodes of each kind, indexed by NodeKind
+    using NodeCounts = std::array<std::uint64_t, node_kind_count>;
+
+    constexpr auto format_as(NodeKind kind)
+    {
+        switch (kind) {
+            case NodeKind::BinaryExpr:
+                return "BinaryExpr";
+            case NodeKind::UnaryExpr:
+                return "UnaryExpr";
+            case NodeKind::ParenExpr:
+                return "ParenExpr";
+            case NodeKind::IntLiteralExpr:
+                return "IntLiteralExpr";
+            case NodeKind::StringLiteralExpr:
+                return "StringLiteralExpr";
+            case NodeKind::CharLiteralExpr:
+                return "CharLiteralExpr";
+            case NodeKind::FloatingLiteralExpr:
+                return "FloatingLiteralExpr";
+            case NodeKind::BoolLiteralExpr:
+                return "BoolLiteralExpr";
+            case NodeKind::IdentifierExpr:
+                return "IdentifierExpr";
+            case NodeKind::AssignmentExpr:
+                return "AssignmentExpr";
+            case NodeKind::CallExpr:
+                return "CallExpr";
+            case NodeKind::FieldExpr:
+                return "FieldExpr";
+            case NodeKind::IndexExpr:
+                return "IndexExpr";
+            case NodeKind::ArrayLiteralExpr:
+                return "ArrayLiteralExpr";
+            case NodeKind::ExprStatement:
+                return "ExprStatement";
+            case NodeKind::ReturnStatement:
+                return "ReturnStatement";
+            case NodeKind::VarDeclStatement:
+                return "VarDeclStatement";
+            case NodeKind::FunDeclStatement:
+                return "FunDeclStatement";
+            case NodeKind::StructDeclStatement:
+                return "StructDeclStatement";
+            case NodeKind::BlockStatement:
+                return "BlockStatement";
+            case NodeKind::IfStatement:
+                return "IfStatement";
+            case NodeKind::WhileStatement:
+                return "WhileStatement";
+            case NodeKind::ForStatement:
+                return "ForStatement";
+            case NodeKind::Program:
+                return "Program";
+        }
+        return "Unknown";
+    }
+} // namespace talos
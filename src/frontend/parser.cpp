@@ -1,8 +1,11 @@
 #include "parser.h"
 
 #include "exceptions.h"
+#include "stats.h"
+#include "trace.h"
 
 #include <algorithm>
+#include <array>
 
 #include <fmt/ranges.h>
 
@@ -21,21 +24,53 @@ namespace talos
         {
             return is_type_keyword(token) || token.type == TokenType::Identifier;
         }
+
+        TalosException too_deep(SourceLocation location, std::size_t max_depth)
+        {
+            return nesting_too_deep(location, fmt::format("Nesting exceeds the maximum depth of {}", max_depth));
+        }
     } // namespace
 
-    Parser::Parser(Lexer* lexer)
-        : lexer_(lexer)
+    class Parser::Nesting
+    {
+    public:
+        explicit Nesting(Parser& parser)
+            : parser_(parser)
+        {
+            if (parser_.depth_ + 1 >= parser_.max_depth_) {
+                throw too_deep(parser_.location(), parser_.max_depth_);
+            }
+            ++parser_.depth_;
+        }
+        ~Nesting() { --parser_.depth_; }
+        Nesting(const Nesting&) = delete;
+        Nesting& operator=(const Nesting&) = delete;
+
+    private:
+        Parser& parser_;
+    };
+
+    Parser::Parser(TokenSource* tokens, std::size_t max_depth)
+        : tokens_(*tokens)
+        , max_depth_(max_depth)
     {
     }
 
     ProgramNode Parser::parse()
     {
-        consume_token();
         std::vector<StatementPtr> statements;
+        parse([&](StatementPtr statement) { statements.push_back(std::move(statement)); });
+        return ProgramNode{std::move(statements)};
+    }
+
+    void Parser::parse(const std::function<void(StatementPtr)>& on_declaration)
+    {
+        TALOS_TRACE_SCOPE("parse");
+        TALOS_TIME_PHASE(Phase::Parse);
+        consume_token();
         while (!is_eof()) {
-            statements.push_back(declaration());
+            on_declaration(declaration());
         }
-        return ProgramNode{std::move(statements)};
     }
 
     std::unique_ptr<Statement> Parser::declaration()
@@ -46,6 +81,18 @@ namespace talos
         if (expect_and_consume(TokenType::Fun)) {
             return fun_decl();
         }
+        if (next_token_.type == TokenType::Struct || next_token_.type == TokenType::Packed || next_token_.type == TokenType::Soa) {
+            if (depth_ > 0) {
+                throw syntax_error(location(), "Structs must be declared at the top level");
+            }
+            static constexpr auto modifiers = std::array{TokenType::Packed, TokenType::Soa};
+            const auto modifier = expect_and_consume(modifiers);
+            if (!expect_and_consume(TokenType::Struct)) {
+                throw syntax_error(location(), fmt::format("Expected 'struct' after '{}'", modifier->string));
+            }
+            const auto has = [&](TokenType type) { return modifier && modifier->type == type; };
+            return struct_decl(has(TokenType::Packed), has(TokenType::Soa));
+        }
         return statement();
     }
 
@@ -59,9 +106,9 @@ namespace talos
             throw syntax_error(location(), "Expected variable identifier");
         }
 
-        std::optional<Token> type_spec;
+        std::optional<TypeSpec> type_spec;
         if (expect_and_consume(TokenType::Colon)) {
-            type_spec = consume_if(is_type_specifier);
+            type_spec = type_specifier();
             if (!type_spec.has_value()) {
                 throw syntax_error(location(), "Expected type specifier after ':'");
             }
@@ -75,6 +122,7 @@ namespace talos
         if (!expect_and_consume(TokenType::Semicolon)) {
             throw syntax_error(location(), "Expected ';' after variable");
         }
+        set_height(height_);
 
         return std::make_unique<VarDeclStatement>(decl_type, *identifier, type_spec, std::move(value));
     }
@@ -89,14 +137,11 @@ namespace talos
         if (!expect_and_consume(TokenType::LeftParen)) {
             throw syntax_error(location(), "Expected '(' after function name");
         }
-        // TODO: Function parameters
-        if (!expect_and_consume(TokenType::RightParen)) {
-            throw syntax_error(location(), "Expected ')' after parameter list");
-        }
+        auto parameters = parameter_list();
 
-        std::optional<Token> type_spec;
+        std::optional<TypeSpec> type_spec;
         if (expect_and_consume(TokenType::Colon)) {
-            type_spec = consume_if(is_type_specifier);
+            type_spec = type_specifier();
             if (!type_spec.has_value()) {
                 throw syntax_error(location(), "Expected type specifier after ':'");
             }
@@ -107,13 +152,103 @@ namespace talos
             throw syntax_error(location(), "Expected '{' to begin function block");
         }
 
+        const auto nesting = Nesting{*this};
+        std::size_t body_height = 0;
         while (!expect_and_consume(TokenType::RightBrace)) {
             if (is_eof()) {
                 throw unexpected_eof(location(), "Unexpected EOF. Expected '}' to end function block");
             }
             statements.push_back(declaration());
+            body_height = std::max(body_height, height_);
+        }
+        set_height(body_height);
+        return std::make_unique<FunDeclStatement>(*identifier, std::move(parameters), type_spec, std::move(statements));
+    }
+
+    std::vector<Parameter> Parser::parameter_list()
+    {
+        std::vector<Parameter> parameters;
+        if (expect_and_consume(TokenType::RightParen)) {
+            return parameters;
+        }
+        do {
+            auto identifier = expect_and_consume(TokenType::Identifier);
+            if (!identifier) {
+                throw syntax_error(location(), "Expected parameter identifier");
+            }
+            if (!expect_and_consume(TokenType::Colon)) {
+                throw syntax_error(location(), "Expected ':' after parameter identifier");
+            }
+            // Parameters have no initializer to infer their type from
+            auto type_spec = type_specifier();
+            if (!type_spec) {
+                throw syntax_error(location(), "Expected type specifier after ':'");
+            }
+            parameters.push_back(Parameter{.identifier = *identifier, .type_spec = *type_spec});
+        } while (expect_and_consume(TokenType::Comma));
+
+        if (!expect_and_consume(TokenType::RightParen)) {
+            throw syntax_error(location(), "Expected ')' after parameter list");
         }
-        return std::make_unique<FunDeclStatement>(*identifier, type_spec, std::move(statements));
+        return parameters;
+    }
+
+    std::unique_ptr<Statement> Parser::struct_decl(bool packed, bool soa)
+    {
+        auto identifier = expect_and_consume(TokenType::Identifier);
+        if (!identifier) {
+            throw syntax_error(location(), "Expected struct identifier after struct");
+        }
+        if (!expect_and_consume(TokenType::LeftBrace)) {
+            throw syntax_error(location(), "Expected '{' after struct name");
+        }
+
+        std::vector<StructField> fields;
+        while (!expect_and_consume(TokenType::RightBrace)) {
+            auto field = expect_and_consume(TokenType::Identifier);
+            if (!field) {
+                throw syntax_error(location(), "Expected field identifier");
+            }
+            if (!expect_and_consume(TokenType::Colon)) {
+                throw syntax_error(location(), "Expected ':' after field identifier");
+            }
+            auto type_spec = type_specifier();
+            if (!type_spec) {
+                throw syntax_error(location(), "Expected type specifier after ':'");
+            }
+            fields.push_back(StructField{.identifier = *field, .type_spec = *type_spec});
+            // The last field may be followed by a comma
+            if (!expect_and_consume(TokenType::Comma) && next_token_.type != TokenType::RightBrace) {
+                throw syntax_error(location(), "Expected ',' or '}' after field");
+            }
+        }
+        if (fields.empty()) {
+            throw syntax_error(identifier->location, "Structs must have at least one field");
+        }
+        height_ = 1;
+        return std::make_unique<StructDeclStatement>(*identifier, std::move(fields), packed, soa);
+    }
+
+    std::optional<TypeSpec> Parser::type_specifier()
+    {
+        if (!expect_and_consume(TokenType::LeftBracket)) {
+            if (auto name = consume_if(is_type_specifier)) {
+                return TypeSpec{.name = *name};
+            }
+            return std::nullopt;
+        }
+        auto length = expect_and_consume(TokenType::IntLiteral);
+        if (!length) {
+            throw syntax_error(location(), "Expected array length after '['");
+        }
+        if (!expect_and_consume(TokenType::RightBracket)) {
+            throw syntax_error(location(), "Expected ']' after array length");
+        }
+        auto element = consume_if(is_type_specifier);
+        if (!element) {
+            throw syntax_error(location(), "Expected element type after ']'");
+        }
+        return TypeSpec{.name = *element, .length = *length};
     }
 
     std::unique_ptr<Statement> Parser::statement()
@@ -121,15 +256,118 @@ namespace talos
         if (expect_and_consume(TokenType::Return)) {
             return return_statement();
         }
+        if (expect_and_consume(TokenType::If)) {
+            return if_statement();
+        }
+        if (expect_and_consume(TokenType::While)) {
+            return while_statement();
+        }
+        if (expect_and_consume(TokenType::For)) {
+            return for_statement();
+        }
+        if (expect_and_consume(TokenType::LeftBrace)) {
+            return block();
+        }
         return expr_statement();
     }
 
+    std::unique_ptr<Statement> Parser::block()
+    {
+        const auto nesting = Nesting{*this};
+        StatementList statements;
+        std::size_t body_height = 0;
+        while (!expect_and_consume(TokenType::RightBrace)) {
+            if (is_eof()) {
+                throw unexpected_eof(location(), "Unexpected EOF. Expected '}' to end block");
+            }
+            if (next_token_.type == TokenType::Fun) {
+                throw syntax_error(location(), "Functions cannot be declared inside blocks");
+            }
+            if (next_token_.type == TokenType::Struct || next_token_.type == TokenType::Packed || next_token_.type == TokenType::Soa) {
+                throw syntax_error(location(), "Structs must be declared at the top level");
+            }
+            statements.push_back(expect_and_consume({{TokenType::Var, TokenType::Let}}) ? var_decl() : statement());
+            body_height = std::max(body_height, height_);
+        }
+        set_height(body_height);
+        return std::make_unique<BlockStatement>(std::move(statements));
+    }
+
+    std::unique_ptr<Statement> Parser::expect_block(std::string_view after)
+    {
+        if (!expect_and_consume(TokenType::LeftBrace)) {
+            throw syntax_error(location(), fmt::format("Expected '{{' after {}", after));
+        }
+        return block();
+    }
+
+    std::unique_ptr<Statement> Parser::if_statement()
+    {
+        // Chains of else if nest without a block in between
+        const auto nesting = Nesting{*this};
+        auto condition = expression();
+        auto height = height_;
+        auto then_branch = expect_block("if condition");
+        height = std::max(height, height_);
+
+        StatementPtr else_branch;
+        if (expect_and_consume(TokenType::Else)) {
+            else_branch = expect_and_consume(TokenType::If) ? if_statement() : expect_block("else");
+            height = std::max(height, height_);
+        }
+        set_height(height);
+        return std::make_unique<IfStatement>(std::move(condition), std::move(then_branch), std::move(else_branch));
+    }
+
+    std::unique_ptr<Statement> Parser::while_statement()
+    {
+        auto condition = expression();
+        const auto condition_height = height_;
+        auto body = expect_block("while condition");
+        set_height(std::max(condition_height, height_));
+        return std::make_unique<WhileStatement>(std::move(condition), std::move(body));
+    }
+
+    std::unique_ptr<Statement> Parser::for_statement()
+    {
+        std::size_t height = 0;
+        StatementPtr initializer;
+        if (expect_and_consume({{TokenType::Var, TokenType::Let}})) {
+            initializer = var_decl();
+            height = height_;
+        }
+        else if (!expect_and_consume(TokenType::Semicolon)) {
+            initializer = expr_statement();
+            height = height_;
+        }
+
+        ExprPtr condition;
+        if (!expect_and_consume(TokenType::Semicolon)) {
+            condition = expression();
+            height = std::max(height, height_);
+            if (!expect_and_consume(TokenType::Semicolon)) {
+                throw syntax_error(location(), "Expected ';' after for condition");
+            }
+        }
+
+        ExprPtr increment;
+        if (next_token_.type != TokenType::LeftBrace) {
+            increment = expression();
+            height = std::max(height, height_);
+        }
+
+        auto body = expect_block("for clauses");
+        set_height(std::max(height, height_));
+        return std::make_unique<ForStatement>(std::move(initializer), std::move(condition), std::move(increment), std::move(body));
+    }
+
     std::unique_ptr<Statement> Parser::return_statement()
     {
         auto return_value = expression();
         if (!expect_and_consume(TokenType::Semicolon)) {
             throw syntax_error(location(), "Expected ';' after return statement");
         }
+        set_height(height_);
 
         return std::make_unique<ReturnStatement>(std::move(return_value));
     }
@@ -140,6 +378,7 @@ namespace talos
         if (!expect_and_consume(TokenType::Semicolon)) {
             throw syntax_error(location(), "Expected ';' after statement");
         }
+        set_height(height_);
         return std::make_unique<ExprStatement>(std::move(expr));
     }
 
@@ -150,41 +389,121 @@ namespace talos
 
     std::unique_ptr<Expr> Parser::assignment_expr()
     {
-        auto expr = additive_expr();
+        auto expr = logical_or_expr();
         while (expect_and_consume(TokenType::Equal)) {
-            expr = std::make_unique<AssignmentExpr>(std::move(expr), assignment_expr());
+            const auto lhs_height = height_;
+            const auto nesting = Nesting{*this};
+            auto rhs = assignment_expr();
+            set_height(std::max(lhs_height, height_));
+            expr = std::make_unique<AssignmentExpr>(std::move(expr), std::move(rhs));
         }
         return expr;
     }
 
+    std::unique_ptr<Expr> Parser::logical_or_expr()
+    {
+        return binary_expr({{TokenType::PipePipe}}, &Parser::logical_and_expr);
+    }
+
+    std::unique_ptr<Expr> Parser::logical_and_expr()
+    {
+        return binary_expr({{TokenType::AmpAmp}}, &Parser::equality_expr);
+    }
+
+    std::unique_ptr<Expr> Parser::equality_expr()
+    {
+        return binary_expr({{TokenType::EqualEqual, TokenType::BangEqual}}, &Parser::comparison_expr);
+    }
+
+    std::unique_ptr<Expr> Parser::comparison_expr()
+    {
+        return binary_expr({{TokenType::Less, TokenType::LessEqual, TokenType::Greater, TokenType::GreaterEqual}}, &Parser::additive_expr);
+    }
+
     std::unique_ptr<Expr> Parser::additive_expr()
     {
-        auto expr = factor_expr();
-        while (auto binary_op = expect_and_consume({{TokenType::Plus, TokenType::Minus}})) {
-            expr = std::make_unique<BinaryExpr>(std::move(expr), *binary_op, factor_expr());
-        }
-        return expr;
+        return binary_expr({{TokenType::Plus, TokenType::Minus}}, &Parser::factor_expr);
     }
 
     std::unique_ptr<Expr> Parser::factor_expr()
     {
-        auto expr = unary_expr();
-        while (auto binary_op = expect_and_consume({{TokenType::Star, TokenType::Slash}})) {
-            expr = std::make_unique<BinaryExpr>(std::move(expr), *binary_op, unary_expr());
+        return binary_expr({{TokenType::Star, TokenType::Slash, TokenType::Percent}}, &Parser::unary_expr);
+    }
+
+    std::unique_ptr<Expr> Parser::binary_expr(std::span<const TokenType> operators, std::unique_ptr<Expr> (Parser::*operand)())
+    {
+        auto expr = (this->*operand)();
+        while (auto binary_op = expect_and_consume(operators)) {
+            const auto lhs_height = height_;
+            auto rhs = (this->*operand)();
+            set_height(std::max(lhs_height, height_));
+            expr = std::make_unique<BinaryExpr>(std::move(expr), *binary_op, std::move(rhs));
         }
         return expr;
     }
 
     std::unique_ptr<Expr> Parser::unary_expr()
     {
-        if (auto unary_op = expect_and_consume({{TokenType::Minus}})) {
-            return std::make_unique<UnaryExpr>(*unary_op, unary_expr());
+        if (auto unary_op = expect_and_consume({{TokenType::Minus, TokenType::Bang}})) {
+            const auto nesting = Nesting{*this};
+            auto expr = unary_expr();
+            set_height(height_);
+            return std::make_unique<UnaryExpr>(*unary_op, std::move(expr));
         }
-        return literal_expr();
+        return call_expr();
+    }
+
+    std::unique_ptr<Expr> Parser::call_expr()
+    {
+        auto expr = literal_expr();
+        for (;;) {
+            if (expect_and_consume(TokenType::Dot)) {
+                auto field = expect_and_consume(TokenType::Identifier);
+                if (!field) {
+                    throw syntax_error(location(), "Expected field name after '.'");
+                }
+                set_height(height_);
+                expr = std::make_unique<FieldExpr>(std::move(expr), *field);
+                continue;
+            }
+            if (auto bracket = expect_and_consume(TokenType::LeftBracket)) {
+                auto height = height_;
+                const auto nesting = Nesting{*this};
+                auto index = expression();
+                height = std::max(height, height_);
+                if (!expect_and_consume(TokenType::RightBracket)) {
+                    throw syntax_error(location(), "Expected ']' after index");
+                }
+                set_height(height);
+                expr = std::make_unique<IndexExpr>(std::move(expr), *bracket, std::move(index));
+                continue;
+            }
+            if (!expect_and_consume(TokenType::LeftParen)) {
+                break;
+            }
+            auto height = height_;
+            const auto nesting = Nesting{*this};
+            ExprList arguments;
+            if (!expect_and_consume(TokenType::RightParen)) {
+                do {
+                    arguments.push_back(expression());
+                    height = std::max(height, height_);
+                } while (expect_and_consume(TokenType::Comma));
+
+                if (!expect_and_consume(TokenType::RightParen)) {
+                    throw syntax_error(location(), "Expected ')' after arguments");
+                }
+            }
+            set_height(height);
+            expr = std::make_unique<CallExpr>(std::move(expr), std::move(arguments));
+        }
+        return expr;
     }
 
     std::unique_ptr<Expr> Parser::literal_expr()
     {
+        // Literals are leaves
+        height_ = 1;
         if (auto integer = expect_and_consume(TokenType::IntLiteral)) {
             return std::make_unique<IntLiteralExpr>(*integer, consume_if(is_type_keyword));
         }
@@ -203,16 +522,58 @@ namespace talos
         if (auto identifier = expect_and_consume(TokenType::Identifier)) {
             return std::make_unique<IdentifierExpr>(*identifier);
         }
+        if (auto bracket = expect_and_consume(TokenType::LeftBracket)) {
+            return array_literal(*bracket);
+        }
         if (expect_and_consume(TokenType::LeftParen)) {
+            const auto nesting = Nesting{*this};
             auto expr = expression();
             if (!expect_and_consume(TokenType::RightParen)) {
                 throw syntax_error(location(), "Expected ')' after expression");
             }
+            set_height(height_);
             return std::make_unique<ParenExpr>(std::move(expr));
         }
         throw syntax_error(location(), "Expected expression");
     }
 
+    std::unique_ptr<Expr> Parser::array_literal(Token bracket)
+    {
+        const auto nesting = Nesting{*this};
+        if (next_token_.type == TokenType::RightBracket) {
+            throw syntax_error(location(), "Array literals must have at least one element");
+        }
+        ExprList elements;
+        std::optional<Token> count;
+        elements.push_back(expression());
+        auto height = height_;
+        if (expect_and_consume(TokenType::Semicolon)) {
+            count = expect_and_consume(TokenType::IntLiteral);
+            if (!count) {
+                throw syntax_error(location(), "Expected element count after ';'");
+            }
+        }
+        else {
+            while (expect_and_consume(TokenType::Comma)) {
+                elements.push_back(expression());
+                height = std::max(height, height_);
+            }
+        }
+        if (!expect_and_consume(TokenType::RightBracket)) {
+            throw syntax_error(location(), "Expected ']' after array elements");
+        }
+        set_height(height);
+        return std::make_unique<ArrayLiteralExpr>(bracket, std::move(elements), count);
+    }
+
+    void Parser::set_height(std::size_t child_height)
+    {
+        height_ = child_height + 1;
+        if (height_ > max_depth_) {
+            throw too_deep(location(), max_depth_);
+        }
+    }
+
     bool Parser::is_eof() const noexcept
     {
         return next_token_.type == TokenType::Eof;
@@ -226,7 +587,8 @@ namespace talos
     Token Parser::consume_token()
     {
         current_token_ = next_token_;
-        next_token_ = lexer_->consume_token();
+        next_token_ = tokens_.consume_token();
+        TALOS_STATS_ADD(tokens, 1);
         return current_token_;
     }
 
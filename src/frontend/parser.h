@@ -1,33 +1,70 @@
 #pragma once
 
 #include "ast.h"
-#include "lexer.h"
+#include "token_buffer.h"
+#include "token_source.h"
 
+#include <cstddef>
+#include <functional>
 #include <span>
 #include <string>
+#include <string_view>
 
 namespace talos
 {
     class Parser
     {
     public:
-        explicit Parser(Lexer* lexer);
+        // Keeps the recursion of the parser and of the passes over its AST well
+        // within the default 8 MiB stack of the main thread
+        static constexpr std::size_t default_max_depth = 2048;
+
+        // Inputs nesting deeper than max_depth AST nodes fail with NestingTooDeep
+        explicit Parser(TokenSource* tokens, std::size_t max_depth = default_max_depth);
 
         ProgramNode parse();
+        // Parses the whole input, handing each top-level declaration to
+        // on_declaration as soon as it is complete instead of building a ProgramNode
+        void parse(const std::function<void(StatementPtr)>& on_declaration);
 
     private:
+        // Counts a nested declaration or expression being parsed by recursion
+        class Nesting;
+
         std::unique_ptr<Statement> declaration();
         std::unique_ptr<Statement> var_decl();
         std::unique_ptr<Statement> fun_decl();
+        std::vector<Parameter> parameter_list();
+        std::unique_ptr<Statement> struct_decl(bool packed, bool soa);
+        // nullopt if the next token cannot start a type specifier
+        std::optional<TypeSpec> type_specifier();
         std::unique_ptr<Statement> statement();
         std::unique_ptr<Statement> return_statement();
+        // After the opening brace
+        std::unique_ptr<Statement> block();
+        std::unique_ptr<Statement> expect_block(std::string_view after);
+        std::unique_ptr<Statement> if_statement();
+        std::unique_ptr<Statement> while_statement();
+        std::unique_ptr<Statement> for_statement();
         std::unique_ptr<Statement> expr_statement();
         std::unique_ptr<Expr> expression();
         std::unique_ptr<Expr> assignment_expr();
+        std::unique_ptr<Expr> logical_or_expr();
+        std::unique_ptr<Expr> logical_and_expr();
+        std::unique_ptr<Expr> equality_expr();
+        std::unique_ptr<Expr> comparison_expr();
         std::unique_ptr<Expr> additive_expr();
         std::unique_ptr<Expr> factor_expr();
+        // Left-associative chain of operands separated by one of operators
+        std::unique_ptr<Expr> binary_expr(std::span<const TokenType> operators, std::unique_ptr<Expr> (Parser::*operand)());
         std::unique_ptr<Expr> unary_expr();
+        std::unique_ptr<Expr> call_expr();
         std::unique_ptr<Expr> literal_expr();
+        // After the opening bracket
+        std::unique_ptr<Expr> array_literal(Token bracket);
+
+        // Records the height of a node whose tallest child is child_height high
+        void set_height(std::size_t child_height);
 
         [[nodiscard]] bool is_eof() const noexcept;
         [[nodiscard]] SourceLocation location() const noexcept;
@@ -45,8 +82,14 @@ namespace talos
             return std::nullopt;
         }
 
-        Lexer* lexer_;
+        TokenBuffer tokens_;
         Token current_token_;
         Token next_token_;
+        std::size_t max_depth_;
+        // Recursion depth, which bounds the stack used by the parser
+        std::size_t depth_ = 0;
+        // Height of the node parsed last. Chains of binary operators are parsed
+        // by iteration but nest in the AST, so the height is tracked separately
+        std::size_t height_ = 0;
     };
 } // namespace talos
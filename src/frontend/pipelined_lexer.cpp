@@ -0,0 +1,103 @@
+#include "pipelined_lexer.h"
+
+#include "lexer.h"
+#include "trace.h"
+
+namespace talos
+{
+    namespace
+    {
+        constexpr std::uint64_t ring_mask = PipelinedLexer::ring_capacity - 1;
+        static_assert((PipelinedLexer::ring_capacity & ring_mask) == 0, "ring_capacity must be a power of two");
+    } // namespace
+
+    PipelinedLexer::PipelinedLexer(std::string_view source)
+        : ring_(std::make_unique<std::array<Batch, ring_capacity>>())
+        , thread_([this, source] { produce(source); })
+    {
+    }
+
+    PipelinedLexer::~PipelinedLexer()
+    {
+        // The parser may stop early (e.g. on a syntax error) while the lexer is
+        // blocked on a full ring. Moving the read index wakes it up to exit
+        cancelled_.store(true, std::memory_order_relaxed);
+        read_index_.fetch_add(ring_capacity, std::memory_order_release);
+        read_index_.notify_one();
+        thread_.join();
+    }
+
+    Token PipelinedLexer::consume_token()
+    {
+        if (batch_ == nullptr || position_ == batch_->size) {
+            next_batch();
+        }
+        const auto& token = batch_->tokens[position_];
+        // Keep returning Eof like Lexer does
+        if (token.type != TokenType::Eof) {
+            ++position_;
+        }
+        return token;
+    }
+
+    void PipelinedLexer::next_batch()
+    {
+        if (batch_ != nullptr) {
+            if (batch_->failed) {
+                std::rethrow_exception(error_);
+            }
+            read_index_.store(++read_, std::memory_order_release);
+            read_index_.notify_one();
+        }
+        while (read_ == available_) {
+            write_index_.wait(available_, std::memory_order_acquire);
+            available_ = write_index_.load(std::memory_order_acquire);
+        }
+        batch_ = &(*ring_)[read_ & ring_mask];
+        position_ = 0;
+        if (batch_->size == 0) {
+            // Only a failed batch can be empty
+            std::rethrow_exception(error_);
+        }
+    }
+
+    void PipelinedLexer::produce(std::string_view source)
+    {
+#ifdef TALOS_ENABLE_TRACING
+        trace::set_thread_name("lexer");
+#endif
+        TALOS_TRACE_SCOPE("lex");
+        auto lexer = Lexer{source};
+        std::uint64_t write = 0;
+        auto done = false;
+        while (!done) {
+            auto read = read_index_.load(std::memory_order_acquire);
+            while (write - read >= ring_capacity && !cancelled_.load(std::memory_order_relaxed)) {
+                read_index_.wait(read, std::memory_order_acquire);
+                read = read_index_.load(std::memory_order_acquire);
+            }
+            if (cancelled_.load(std::memory_order_relaxed)) {
+                return;
+            }
+
+            auto& batch = (*ring_)[write & ring_mask];
+            batch.size = 0;
+            try {
+                while (batch.size < batch_size) {
+                    const auto token = lexer.consume_token();
+                    batch.tokens[batch.size++] = token;
+                    if (token.type == TokenType::Eof) {
+                        done = true;
+                        break;
+                    }
+                }
+            } catch (...) {
+                error_ = std::current_exception();
+                batch.failed = true;
+                done = true;
+            }
+            write_index_.store(++write, std::memory_order_release);
+            write_index_.notify_one();
+        }
+    }
+} // namespace talos
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "token_source.h"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <string_view>
+#include <thread>
+
+namespace talos
+{
+    // Runs a Lexer on a background thread so that lexing overlaps with parsing.
+    // Tokens are handed over in batches through a bounded single-producer/
+    // single-consumer ring: the lexer blocks while the ring is full and the
+    // consumer blocks while it is empty. Lexer errors are rethrown from
+    // consume_token once every token preceding the error has been consumed.
+    // source must outlive the PipelinedLexer and every token it returns
+    class PipelinedLexer final : public TokenSource
+    {
+    public:
+        static constexpr std::size_t batch_size = 512;
+        // Number of batches in the ring, must be a power of two
+        static constexpr std::size_t ring_capacity = 16;
+
+        explicit PipelinedLexer(std::string_view source);
+        ~PipelinedLexer() override;
+
+        PipelinedLexer(const PipelinedLexer&) = delete;
+        PipelinedLexer(PipelinedLexer&&) = delete;
+        PipelinedLexer& operator=(const PipelinedLexer&) = delete;
+        PipelinedLexer& operator=(PipelinedLexer&&) = delete;
+
+        [[nodiscard]] Token consume_token() override;
+        [[nodiscard]] bool allows_read_ahead() const noexcept override { return true; }
+
+    private:
+        struct Batch {
+            std::array<Token, batch_size> tokens;
+            std::size_t size = 0;
+            // Set on the last batch if lexing stopped with an exception
+            bool failed = false;
+        };
+
+        void produce(std::string_view source);
+        void next_batch();
+
+        std::unique_ptr<std::array<Batch, ring_capacity>> ring_;
+        // Written by the lexer thread before publishing the failed batch
+        std::exception_ptr error_;
+        std::atomic<bool> cancelled_{false};
+        // Number of batches published by the lexer and released by the parser.
+        // Kept on separate cache lines so the threads do not contend on them
+        alignas(64) std::atomic<std::uint64_t> write_index_{0};
+        alignas(64) std::atomic<std::uint64_t> read_index_{0};
+
+        // Consumer side state
+        std::uint64_t read_ = 0;
+        std::uint64_t available_ = 0;
+        const Batch* batch_ = nullptr;
+        std::size_t position_ = 0;
+
+        // Started last, once everything the lexer thread touches is initialized
+        std::thread thread_;
+    };
+} // namespace talos
@@ -0,0 +1,184 @@
+#include "reachability.h"
+
+#include "ast_walker.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+
+namespace talos
+{
+    namespace
+    {
+        class UseCollector : public ASTWalker<UseCollector>
+        {
+        public:
+            explicit UseCollector(DeclarationUses& uses) noexcept
+                : uses_(uses)
+            {
+            }
+
+            [[nodiscard]] bool may_fail() const noexcept { return may_fail_; }
+
+        private:
+            friend class ASTWalker<UseCollector>;
+
+            void pre(const IdentifierExpr& expr) { uses_.uses.push_back(expr.identifier().string); }
+            void pre(const VarDeclStatement& stmt) { use(stmt.type_specifier()); }
+            void pre(const FunDeclStatement& stmt)
+            {
+                for (const auto& parameter : stmt.parameters()) {
+                    use(parameter.type_spec);
+                }
+                use(stmt.type_spec());
+            }
+            void pre(const StructDeclStatement& stmt)
+            {
+                for (const auto& field : stmt.fields()) {
+                    use(field.type_spec);
+                }
+            }
+            void pre(const CallExpr&) noexcept { may_fail_ = true; }
+            void pre(const IndexExpr&) noexcept { may_fail_ = true; }
+            void pre(const BinaryExpr& expr) noexcept
+            {
+                const auto op = expr.op().type;
+                may_fail_ = may_fail_ || op == TokenType::Slash || op == TokenType::Percent;
+            }
+
+            void use(const std::optional<TypeSpec>& type_spec)
+            {
+                if (type_spec && type_spec->name.type == TokenType::Identifier) {
+                    uses_.uses.push_back(type_spec->name.string);
+                }
+            }
+
+            DeclarationUses& uses_;
+            // Calls, indexing, division or modulo, anything that may not
+            // complete or that has an effect
+            bool may_fail_ = false;
+        };
+
+        // Kind of a declaration from its first token, and the offset of the
+        // token naming it, 0 for statements
+        std::pair<DeclarationKind, std::size_t> kind_of(std::span<const Token> tokens) noexcept
+        {
+            if (tokens.empty()) {
+                return {DeclarationKind::Statement, 0};
+            }
+            switch (tokens.front().type) {
+                case TokenType::Fun:
+                    return {DeclarationKind::Function, 1};
+                case TokenType::Var:
+                case TokenType::Let:
+                    return {DeclarationKind::Global, 1};
+                case TokenType::Struct:
+                    return {DeclarationKind::Struct, 1};
+                case TokenType::Packed:
+                case TokenType::Soa:
+                    return {DeclarationKind::Struct, 2};
+                default:
+                    return {DeclarationKind::Statement, 0};
+            }
+        }
+    } // namespace
+
+    DeclarationUses declaration_uses(const Statement& statement)
+    {
+        auto uses = DeclarationUses{};
+        auto collector = UseCollector{uses};
+        collector.walk(statement);
+        if (const auto* function = dynamic_cast<const FunDeclStatement*>(&statement)) {
+            uses.kind = DeclarationKind::Function;
+            uses.name = function->identifier().string;
+        }
+        else if (const auto* global = dynamic_cast<const VarDeclStatement*>(&statement)) {
+            uses.kind = DeclarationKind::Global;
+            uses.name = global->identifier().string;
+            uses.root = collector.may_fail();
+        }
+        else if (const auto* structure = dynamic_cast<const StructDeclStatement*>(&statement)) {
+            uses.kind = DeclarationKind::Struct;
+            uses.name = structure->identifier().string;
+        }
+        else {
+            uses.root = true;
+        }
+        return uses;
+    }
+
+    DeclarationUses declaration_uses(const DeclarationTokens& declaration)
+    {
+        const auto tokens = std::span{declaration.tokens};
+        const auto [kind, offset] = kind_of(tokens);
+        auto uses = DeclarationUses{.kind = kind};
+        // Statements, and declarations too malformed to name anything, which
+        // are kept so that their errors are reported
+        if (offset == 0 || offset >= tokens.size() || tokens[offset].type != TokenType::Identifier || declaration.error) {
+            uses.root = true;
+        }
+        else {
+            uses.name = tokens[offset].string;
+        }
+        const auto global = kind == DeclarationKind::Global;
+        for (std::size_t i = 0; i < tokens.size(); ++i) {
+            const auto type = tokens[i].type;
+            if (type == TokenType::Identifier && (uses.name.empty() || i != offset)) {
+                uses.uses.push_back(tokens[i].string);
+            }
+            if (!global || i == 0) {
+                continue;
+            }
+            const auto previous = tokens[i - 1].type;
+            const auto call = type == TokenType::LeftParen && previous == TokenType::Identifier;
+            const auto index = type == TokenType::LeftBracket && (previous == TokenType::Identifier || previous == TokenType::RightBracket || previous == TokenType::RightParen);
+            if (call || index || type == TokenType::Slash || type == TokenType::Percent) {
+                uses.root = true;
+            }
+        }
+        return uses;
+    }
+
+    std::vector<bool> reachable_declarations(std::span<const DeclarationUses> declarations, std::span<const std::string> entry_points)
+    {
+        // A name may be declared more than once, which type checking reports
+        // as long as all of the declarations are kept
+        auto declared = std::unordered_map<std::string_view, std::vector<std::size_t>>{};
+        for (std::size_t i = 0; i < declarations.size(); ++i) {
+            if (!declarations[i].name.empty()) {
+                declared[declarations[i].name].push_back(i);
+            }
+        }
+
+        auto reachable = std::vector<bool>(declarations.size(), false);
+        auto worklist = std::vector<std::size_t>{};
+        const auto reach = [&](std::string_view name) {
+            if (const auto found = declared.find(name); found != declared.end()) {
+                for (const auto i : found->second) {
+                    if (!reachable[i]) {
+                        reachable[i] = true;
+                        worklist.push_back(i);
+                    }
+                }
+            }
+        };
+        for (std::size_t i = 0; i < declarations.size(); ++i) {
+            if (declarations[i].root) {
+                reachable[i] = true;
+                worklist.push_back(i);
+            }
+        }
+        reach("main");
+        for (const auto& entry_point : entry_points) {
+            reach(entry_point);
+        }
+        while (!worklist.empty()) {
+            const auto i = worklist.back();
+            worklist.pop_back();
+            std::ranges::for_each(declarations[i].uses, reach);
+        }
+        return reachable;
+    }
+} // namespace talos
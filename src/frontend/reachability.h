@@ -0,0 +1,44 @@
+#pragma once
+
+#include "ast.h"
+#include "declaration_splitter.h"
+
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace talos
+{
+    enum class DeclarationKind {
+        // Any other top-level statement
+        Statement,
+        Function,
+        Global,
+        Struct,
+    };
+
+    // A top-level declaration as a node of the graph of which declarations
+    // use which. Names are resolved by spelling alone, so a local variable
+    // that shadows a global still counts as a use of it
+    struct DeclarationUses {
+        DeclarationKind kind = DeclarationKind::Statement;
+        // Function, global or struct the declaration defines, empty for statements
+        std::string_view name;
+        // Names it refers to, which may include names of no declaration
+        std::vector<std::string_view> uses;
+        // Kept even if nothing uses it: statements, and globals whose
+        // initializer may call a function or fail, so that running the
+        // initializer of the program does the same with and without pruning
+        bool root = false;
+    };
+
+    [[nodiscard]] DeclarationUses declaration_uses(const Statement& statement);
+    // The same from the tokens of a declaration, without parsing it. Every
+    // identifier counts as a use, e.g. also parameter and field names
+    [[nodiscard]] DeclarationUses declaration_uses(const DeclarationTokens& declaration);
+
+    // Whether each declaration is reachable from the roots, from the functions
+    // named main and from the declarations named in entry_points
+    [[nodiscard]] std::vector<bool> reachable_declarations(std::span<const DeclarationUses> declarations, std::span<const std::string> entry_points);
+} // namespace talos
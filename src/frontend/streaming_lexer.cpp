@@ -0,0 +1,116 @@
+#include "streaming_lexer.h"
+
+#include "exceptions.h"
+#include "stats.h"
+#include "trace.h"
+
+namespace talos
+{
+    StreamingLexer::StreamingLexer(std::FILE* file, std::size_t chunk_size)
+        : file_(file)
+        , chunk_size_(chunk_size)
+    {
+    }
+
+    Token StreamingLexer::consume_token()
+    {
+        for (;;) {
+            if (lexer_) {
+                const auto token = segment_tokens_->consume_token();
+                if (token.type != TokenType::Eof) {
+                    return token;
+                }
+                location_ = lexer_->location();
+            }
+            if (!next_segment()) {
+                return Token{.type = TokenType::Eof, .location = location_};
+            }
+        }
+    }
+
+    void StreamingLexer::release_consumed() noexcept
+    {
+        while (segments_.size() > 1) {
+            resident_bytes_ -= segments_.front().size();
+            segments_.pop_front();
+        }
+    }
+
+    bool StreamingLexer::next_segment()
+    {
+        while (safe_cut_ == 0 && !input_done_) {
+            read_chunk();
+        }
+        const auto cut = safe_cut_ != 0 ? safe_cut_ : pending_.size();
+        if (cut == 0) {
+            return false;
+        }
+
+        // Everything up to the cut is scanned, so only the state after it is kept
+        auto& segment = segments_.emplace_back(pending_, 0, cut);
+        pending_.erase(0, cut);
+        scanned_ -= cut;
+        safe_cut_ = 0;
+        lexer_.emplace(segment, location_);
+        segment_tokens_.emplace(*lexer_);
+        return true;
+    }
+
+    void StreamingLexer::read_chunk()
+    {
+        TALOS_TRACE_SCOPE("read");
+        TALOS_TIME_PHASE(Phase::Read);
+        const auto offset = pending_.size();
+        pending_.resize(offset + chunk_size_);
+        const auto read = std::fread(pending_.data() + offset, 1, chunk_size_, file_);
+        pending_.resize(offset + read);
+        resident_bytes_ += read;
+        TALOS_STATS_ADD(bytes_read, read);
+        TALOS_STATS_MAX(peak_source_bytes, resident_bytes_);
+        if (read < chunk_size_) {
+            if (std::ferror(file_) != 0) {
+                throw TalosException(ReturnCode::ReadError, location_);
+            }
+            input_done_ = true;
+        }
+        scan_pending();
+    }
+
+    void StreamingLexer::scan_pending() noexcept
+    {
+        for (; scanned_ < pending_.size(); ++scanned_) {
+            const auto c = pending_[scanned_];
+            switch (scan_state_) {
+                case ScanState::Code:
+                    if (c == '"') {
+                        scan_state_ = ScanState::String;
+                    }
+                    else if (c == '\'') {
+                        // The lexer takes the next two characters as the value and the closing quote
+                        scan_state_ = ScanState::Char;
+                        char_remaining_ = 2;
+                    }
+                    else if (c == ' ' || c == '\t' || c == '\n') {
+                        safe_cut_ = scanned_ + 1;
+                    }
+                    break;
+                case ScanState::String:
+                    if (c == '"') {
+                        scan_state_ = ScanState::Code;
+                    }
+                    else if (c == '\\') {
+                        scan_state_ = ScanState::StringEscape;
+                    }
+                    break;
+                case ScanState::StringEscape:
+                    scan_state_ = ScanState::String;
+                    break;
+                case ScanState::Char:
+                    if (--char_remaining_ == 0) {
+                        scan_state_ = ScanState::Code;
+                    }
+                    break;
+            }
+        }
+    }
+} // namespace talos
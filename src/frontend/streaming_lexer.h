@@ -0,0 +1,67 @@
+#pragma once
+
+#include "lexer.h"
+#include "token_buffer.h"
+
+#include <cstddef>
+#include <cstdio>
+#include <deque>
+#include <optional>
+#include <string>
+
+namespace talos
+{
+    // Lexes input read from a file (or stdin) in fixed-size chunks, so the
+    // whole source never has to be resident at once.
+    // Chunks are cut into segments at whitespace outside of string and character
+    // literals, so no token ever crosses a segment boundary and each segment is
+    // lexed by a plain Lexer. Tokens point into their segment, which stays alive
+    // until release_consumed is called
+    class StreamingLexer final : public TokenSource
+    {
+    public:
+        // file is read lazily and is not closed by the lexer
+        StreamingLexer(std::FILE* file, std::size_t chunk_size);
+
+        [[nodiscard]] Token consume_token() override;
+
+        // Frees every segment before the one holding the most recently returned token
+        void release_consumed() noexcept override;
+
+        // Bytes of source currently held in memory
+        [[nodiscard]] std::size_t resident_bytes() const noexcept { return resident_bytes_; }
+
+    private:
+        enum class ScanState {
+            Code,
+            String,
+            // After a backslash in a string, whose next character can't end it
+            StringEscape,
+            Char,
+        };
+
+        [[nodiscard]] bool next_segment();
+        void read_chunk();
+        void scan_pending() noexcept;
+
+        std::FILE* file_;
+        std::size_t chunk_size_;
+        bool input_done_ = false;
+
+        // Bytes read past the last segment cut
+        std::string pending_;
+        // Number of pending bytes already scanned and the literal state after them
+        std::size_t scanned_ = 0;
+        ScanState scan_state_ = ScanState::Code;
+        int char_remaining_ = 0;
+        // End of the last whitespace outside a literal in pending_, 0 if none
+        std::size_t safe_cut_ = 0;
+
+        std::deque<std::string> segments_;
+        std::size_t resident_bytes_ = 0;
+        std::optional<Lexer> lexer_;
+        // Tokens of the segment, lexed ahead within it
+        std::optional<TokenBuffer> segment_tokens_;
+        SourceLocation location_;
+    };
+} // namespace talos
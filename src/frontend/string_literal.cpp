@@ -0,0 +1,156 @@
+#include "string_literal.h"
+
+#include <bit>
+#include <cstdint>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace talos
+{
+    namespace
+    {
+        constexpr bool is_string_special(char c)
+        {
+            return c == '"' || c == '\\' || c == '\n';
+        }
+
+        // Value of a hex digit, or -1
+        constexpr int hex_digit(char c)
+        {
+            if (c >= '0' && c <= '9') {
+                return c - '0';
+            }
+            if (c >= 'a' && c <= 'f') {
+                return c - 'a' + 10;
+            }
+            if (c >= 'A' && c <= 'F') {
+                return c - 'A' + 10;
+            }
+            return -1;
+        }
+
+        void append_utf8(std::string& out, std::uint32_t code_point)
+        {
+            if (code_point < 0x80) {
+                out.push_back(static_cast<char>(code_point));
+            }
+            else if (code_point < 0x800) {
+                out.push_back(static_cast<char>(0xC0 | (code_point >> 6)));
+                out.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+            }
+            else if (code_point < 0x10000) {
+                out.push_back(static_cast<char>(0xE0 | (code_point >> 12)));
+                out.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+                out.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+            }
+            else {
+                out.push_back(static_cast<char>(0xF0 | (code_point >> 18)));
+                out.push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3F)));
+                out.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+                out.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+            }
+        }
+
+        // Appends the escaped character unless out is null, returning length
+        std::size_t escaped(char c, std::size_t length, std::string* out)
+        {
+            if (out != nullptr) {
+                out->push_back(c);
+            }
+            return length;
+        }
+    } // namespace
+
+    std::size_t find_string_special(std::string_view text) noexcept
+    {
+        auto i = std::size_t{0};
+#if defined(__SSE2__)
+        const auto quote = _mm_set1_epi8('"');
+        const auto backslash = _mm_set1_epi8('\\');
+        const auto newline = _mm_set1_epi8('\n');
+        for (; i + 16 <= text.size(); i += 16) {
+            const auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + i));
+            const auto matches = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)), _mm_cmpeq_epi8(chunk, newline));
+            if (const auto mask = static_cast<unsigned>(_mm_movemask_epi8(matches)); mask != 0) {
+                return i + static_cast<std::size_t>(std::countr_zero(mask));
+            }
+        }
+#endif
+        for (; i < text.size(); ++i) {
+            if (is_string_special(text[i])) {
+                return i;
+            }
+        }
+        return text.size();
+    }
+
+    std::size_t decode_escape(std::string_view text, std::string* out)
+    {
+        if (text.empty()) {
+            return 0;
+        }
+        switch (text[0]) {
+            case 'n':
+                return escaped('\n', 1, out);
+            case 't':
+                return escaped('\t', 1, out);
+            case '\\':
+                return escaped('\\', 1, out);
+            case '"':
+                return escaped('"', 1, out);
+            case 'x': {
+                if (text.size() < 3 || hex_digit(text[1]) < 0 || hex_digit(text[2]) < 0) {
+                    return 0;
+                }
+                return escaped(static_cast<char>((hex_digit(text[1]) * 16) + hex_digit(text[2])), 3, out);
+            }
+            case 'u': {
+                if (text.size() < 2 || text[1] != '{') {
+                    return 0;
+                }
+                auto code_point = std::uint32_t{0};
+                auto length = std::size_t{2};
+                for (; length < text.size() && hex_digit(text[length]) >= 0; ++length) {
+                    if (length - 2 == 6) {
+                        return 0;
+                    }
+                    code_point = (code_point * 16) + static_cast<std::uint32_t>(hex_digit(text[length]));
+                }
+                const auto is_surrogate = code_point >= 0xD800 && code_point <= 0xDFFF;
+                if (length == 2 || length == text.size() || text[length] != '}' || code_point > 0x10FFFF || is_surrogate) {
+                    return 0;
+                }
+                if (out != nullptr) {
+                    append_utf8(*out, code_point);
+                }
+                return length + 1;
+            }
+            default:
+                return 0;
+        }
+    }
+
+    std::string decode_string_literal(std::string_view token)
+    {
+        auto contents = token.substr(1, token.size() - 2);
+        auto result = std::string{};
+        result.reserve(contents.size());
+        for (;;) {
+            // Unescaped runs are copied whole
+            const auto run = find_string_special(contents);
+            result.append(contents.substr(0, run));
+            if (run == contents.size()) {
+                return result;
+            }
+            if (contents[run] == '\\') {
+                contents.remove_prefix(run + 1 + decode_escape(contents.substr(run + 1), &result));
+            }
+            else {
+                result.push_back(contents[run]);
+                contents.remove_prefix(run + 1);
+            }
+        }
+    }
+} // namespace talos
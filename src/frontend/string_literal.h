@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace talos
+{
+    // Offset of the first '"', '\\' or newline in text, or text.size() if it
+    // has none. Scans 16 bytes at a time where SSE2 is available, since
+    // string literals are mostly long runs of other characters
+    [[nodiscard]] std::size_t find_string_special(std::string_view text) noexcept;
+
+    // Decodes the escape sequence at the start of text, which follows a
+    // backslash: \n, \t, \\, \", \xNN (a byte) or \u{N...} (a code point of
+    // 1 to 6 hex digits, appended as UTF-8). Appends the result to out unless
+    // it is null and returns the length of the sequence, or 0 if it is invalid
+    [[nodiscard]] std::size_t decode_escape(std::string_view text, std::string* out);
+
+    // Contents of a string literal token, without the quotes and with its
+    // escape sequences decoded. The lexer has already validated them
+    [[nodiscard]] std::string decode_string_literal(std::string_view token);
+} // namespace talos
@@ -0,0 +1,43 @@
+#include "token_buffer.h"
+
+#include "exceptions.h"
+#include "stats.h"
+
+namespace talos
+{
+    TokenBuffer::TokenBuffer(TokenSource& source)
+        : source_(&source)
+        , read_ahead_(source.allows_read_ahead())
+    {
+    }
+
+    Token TokenBuffer::consume_token()
+    {
+        if (!read_ahead_) {
+            return source_->consume_token();
+        }
+        if (position_ == tokens_.size()) {
+            if (!error_) {
+                fill();
+            }
+            if (position_ == tokens_.size()) {
+                std::rethrow_exception(error_);
+            }
+        }
+        return tokens_[position_++];
+    }
+
+    void TokenBuffer::fill()
+    {
+        TALOS_TIME_PHASE(Phase::Lex);
+        tokens_.clear();
+        position_ = 0;
+        try {
+            do {
+                tokens_.push_back(source_->consume_token());
+            } while (tokens_.size() < batch_size && tokens_.back().type != TokenType::Eof);
+        } catch (const TalosException&) {
+            error_ = std::current_exception();
+        }
+    }
+} // namespace talos
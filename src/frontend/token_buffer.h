@@ -0,0 +1,36 @@
+#pragma once
+
+#include "token.h"
+#include "token_source.h"
+
+#include <cstddef>
+#include <exception>
+#include <vector>
+
+namespace talos
+{
+    // Reads the tokens of a source for the parser and the declaration
+    // splitter. Sources allowing it are read a batch at a time, with lexing
+    // timed once per batch rather than per token. A lexer error is rethrown
+    // once every token preceding it has been consumed. Other sources are read
+    // one token at a time and time their lexing themselves, if at all
+    class TokenBuffer
+    {
+    public:
+        static constexpr std::size_t batch_size = 256;
+
+        explicit TokenBuffer(TokenSource& source);
+
+        [[nodiscard]] Token consume_token();
+
+    private:
+        void fill();
+
+        TokenSource* source_;
+        bool read_ahead_;
+        std::vector<Token> tokens_;
+        std::size_t position_ = 0;
+        // Raised while reading the batch, after its last token
+        std::exception_ptr error_;
+    };
+} // namespace talos
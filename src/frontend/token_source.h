@@ -0,0 +1,32 @@
+#pragma once
+
+#include "token.h"
+
+namespace talos
+{
+    // Stream of tokens consumed by the parser
+    class TokenSource
+    {
+    public:
+        virtual ~TokenSource() = default;
+
+        // Returns the next token, or Eof once the input is exhausted
+        [[nodiscard]] virtual Token consume_token() = 0;
+
+        // Lets the source free input backing tokens returned before the most
+        // recent one. Those tokens must no longer be used afterwards
+        virtual void release_consumed() noexcept {}
+
+        // Whether tokens may be read ahead of the parser, in batches. Not for
+        // sources whose input release_consumed frees, as tokens read ahead
+        // would point into it, nor for those tracking what the parser has read
+        [[nodiscard]] virtual bool allows_read_ahead() const noexcept { return false; }
+
+    protected:
+        TokenSource() = default;
+        TokenSource(const TokenSource&) = default;
+        TokenSource(TokenSource&&) = default;
+        TokenSource& operator=(const TokenSource&) = default;
+        TokenSource& operator=(TokenSource&&) = default;
+    };
+} // namespace talos
@@ -0,0 +1,439 @@
+#include "analyzed_document.h"
+
+#include "return_code.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <span>
+
+namespace talos::lsp
+{
+    namespace
+    {
+        // UTF-16 code units encoded by a UTF-8 byte: continuation bytes add nothing
+        // and four byte sequences need a surrogate pair
+        constexpr std::uint32_t utf16_units(char character) noexcept
+        {
+            const auto byte = static_cast<unsigned char>(character);
+            if ((byte & 0xC0U) == 0x80U) {
+                return 0;
+            }
+            return byte >= 0xF0U ? 2 : 1;
+        }
+
+        constexpr std::uint32_t utf16_length(std::string_view text) noexcept
+        {
+            std::uint32_t units = 0;
+            for (const auto character : text) {
+                units += utf16_units(character);
+            }
+            return units;
+        }
+
+        // Absolute position of a position relative to the start of a block
+        constexpr Position compose(Position block_start, Position relative) noexcept
+        {
+            if (relative.line == 0) {
+                return {block_start.line, block_start.character + relative.character};
+            }
+            return {block_start.line + relative.line, relative.character};
+        }
+
+        constexpr Range compose(Position block_start, Range relative) noexcept
+        {
+            return {compose(block_start, relative.start), compose(block_start, relative.end)};
+        }
+
+        // Maps byte offsets within a block to positions relative to its start
+        class LineTable
+        {
+        public:
+            explicit LineTable(std::string_view text)
+                : text_(text)
+            {
+                for (std::size_t i = 0; i < text.size(); ++i) {
+                    if (text[i] == '\n') {
+                        line_starts_.push_back(i + 1);
+                    }
+                }
+            }
+
+            [[nodiscard]] Position position(std::size_t offset) const noexcept
+            {
+                const auto line = std::ranges::upper_bound(line_starts_, offset) - line_starts_.begin() - 1;
+                const auto line_start = line_starts_[static_cast<std::size_t>(line)];
+                return {static_cast<std::uint32_t>(line), utf16_length(text_.substr(line_start, offset - line_start))};
+            }
+
+            [[nodiscard]] Range range(std::size_t begin, std::size_t end) const noexcept
+            {
+                return {position(begin), position(end)};
+            }
+
+        private:
+            std::string_view text_;
+            std::vector<std::size_t> line_starts_{0};
+        };
+
+        std::size_t offset_in(std::string_view text, const Token& token) noexcept
+        {
+            return static_cast<std::size_t>(token.string.data() - text.data());
+        }
+
+        // Index of the token starting at offset
+        std::size_t token_index(std::span<const Token> tokens, std::string_view text, std::size_t offset) noexcept
+        {
+            const auto iter = std::ranges::lower_bound(tokens, offset, {}, [&](const Token& token) { return offset_in(text, token); });
+            return static_cast<std::size_t>(iter - tokens.begin());
+        }
+
+        // End of the first token of the given type after start, outside of nested braces
+        std::size_t end_of(std::span<const Token> tokens, std::string_view text, std::size_t start, TokenType type) noexcept
+        {
+            auto depth = 0;
+            for (auto i = start; i < tokens.size() && tokens[i].type != TokenType::Eof; ++i) {
+                const auto& token = tokens[i];
+                if (token.type == TokenType::LeftBrace) {
+                    ++depth;
+                }
+                else if (token.type == TokenType::RightBrace) {
+                    --depth;
+                }
+                if (token.type == type && depth == 0) {
+                    return offset_in(text, token) + token.string.size();
+                }
+            }
+            return text.size();
+        }
+    } // namespace
+
+    AnalyzedDocument::AnalyzedDocument(std::string_view text)
+        : document_(text)
+    {
+        blocks_.reserve(document_.block_count());
+        for (std::size_t i = 0; i < document_.block_count(); ++i) {
+            blocks_.push_back(analyze(document_.block(i)));
+            error_blocks_ += blocks_.back().error ? 1 : 0;
+        }
+    }
+
+    void AnalyzedDocument::apply_change(const std::optional<Range>& range, std::string_view text)
+    {
+        auto edit = TextEdit{.offset = 0, .removed = document_.size(), .inserted = text};
+        if (range && !blocks_.empty()) {
+            const auto begin = offset_of(range->start).absolute;
+            const auto end = offset_of(range->end).absolute;
+            edit.offset = std::min(begin, end);
+            edit.removed = std::max(begin, end) - edit.offset;
+        }
+        const auto change = document_.apply(edit);
+
+        const auto first = blocks_.begin() + static_cast<std::ptrdiff_t>(change.first);
+        const auto last = first + static_cast<std::ptrdiff_t>(change.removed);
+        error_blocks_ -= static_cast<std::size_t>(std::count_if(first, last, [](const BlockInfo& info) { return info.error; }));
+        blocks_.erase(first, last);
+
+        auto inserted = std::vector<BlockInfo>{};
+        inserted.reserve(change.inserted);
+        for (auto i = change.first; i < change.first + change.inserted; ++i) {
+            inserted.push_back(analyze(document_.block(i)));
+            error_blocks_ += inserted.back().error ? 1 : 0;
+        }
+        blocks_.insert(blocks_.begin() + static_cast<std::ptrdiff_t>(change.first),
+                       std::make_move_iterator(inserted.begin()),
+                       std::make_move_iterator(inserted.end()));
+    }
+
+    std::vector<Diagnostic> AnalyzedDocument::diagnostics() const
+    {
+        auto diagnostics = std::vector<Diagnostic>{};
+        if (error_blocks_ == 0) {
+            return diagnostics;
+        }
+
+        auto start = Position{};
+        for (std::size_t i = 0; i < blocks_.size(); ++i) {
+            if (blocks_[i].error) {
+                const auto& block = document_.block(i);
+                const auto& error = *block.error();
+                const auto text = block.text();
+                const auto tokens = block.tokens();
+
+                // Parser errors point at a token, lexer errors at the first character
+                // after the last token produced
+                auto begin = std::size_t{0};
+                auto end = std::size_t{0};
+                const auto token = std::ranges::find(tokens, error.location(), &Token::location);
+                if (token != tokens.end()) {
+                    begin = offset_in(text, *token);
+                    end = begin + token->string.size();
+                }
+                else {
+                    const auto last = std::ranges::find_if(tokens.rbegin(), tokens.rend(), [](const Token& t) { return t.type != TokenType::Eof; });
+                    begin = last == tokens.rend() ? 0 : offset_in(text, *last) + last->string.size();
+                    begin = std::min(text.find_first_not_of(" \t\n", begin), text.size());
+                    end = begin;
+                }
+                end = std::min(std::max(end, begin + 1), text.size());
+
+                const auto lines = LineTable{text};
+                diagnostics.push_back(Diagnostic{
+                    .range = compose(start, lines.range(begin, end)),
+                    .message = fmt::format("{}: {}", return_code_str(error.code()), error.what()),
+                });
+            }
+            start = advance(start, blocks_[i]);
+        }
+        return diagnostics;
+    }
+
+    std::vector<Symbol> AnalyzedDocument::symbols() const
+    {
+        const auto to_symbol = [](auto& self, const BlockSymbol& symbol, Position block_start, const LineTable& lines) -> Symbol {
+            auto result = Symbol{
+                .name = symbol.name,
+                .kind = symbol.kind,
+                .range = compose(block_start, lines.range(symbol.begin, symbol.end)),
+                .selection_range = compose(block_start, lines.range(symbol.name_begin, symbol.name_end)),
+            };
+            result.children.reserve(symbol.children.size());
+            for (const auto& child : symbol.children) {
+                result.children.push_back(self(self, child, block_start, lines));
+            }
+            return result;
+        };
+
+        auto symbols = std::vector<Symbol>{};
+        auto start = Position{};
+        for (std::size_t i = 0; i < blocks_.size(); ++i) {
+            if (!blocks_[i].symbols.empty()) {
+                const auto lines = LineTable{document_.block(i).text()};
+                for (const auto& symbol : blocks_[i].symbols) {
+                    symbols.push_back(to_symbol(to_symbol, symbol, start, lines));
+                }
+            }
+            start = advance(start, blocks_[i]);
+        }
+        return symbols;
+    }
+
+    std::optional<Range> AnalyzedDocument::definition(Position position) const
+    {
+        if (blocks_.empty()) {
+            return std::nullopt;
+        }
+        const auto at = offset_of(position);
+        const auto& block = document_.block(at.block);
+        const auto text = block.text();
+        const auto tokens = block.tokens();
+
+        // The cursor may sit anywhere in or directly after the identifier
+        const auto next = std::ranges::upper_bound(tokens, at.offset, {}, [&](const Token& token) { return offset_in(text, token); });
+        if (next == tokens.begin()) {
+            return std::nullopt;
+        }
+        auto index = static_cast<std::size_t>(next - tokens.begin()) - 1;
+        const auto ends_at_cursor = [&](const Token& token) { return offset_in(text, token) + token.string.size() == at.offset; };
+        if (tokens[index].type != TokenType::Identifier && index > 0 && ends_at_cursor(tokens[index - 1])) {
+            --index;
+        }
+        const auto& token = tokens[index];
+        if (token.type != TokenType::Identifier || offset_in(text, token) + token.string.size() < at.offset) {
+            return std::nullopt;
+        }
+
+        // Innermost local declared before the use
+        const BlockSymbol* local = nullptr;
+        auto scope = std::span<const BlockSymbol>{blocks_[at.block].symbols};
+        for (auto searching = true; searching;) {
+            searching = false;
+            for (const auto& symbol : scope) {
+                if (symbol.kind != SymbolKind::Function || symbol.begin > at.offset || at.offset >= symbol.end) {
+                    continue;
+                }
+                for (const auto& child : symbol.children) {
+                    if (child.name == token.string && child.name_begin <= at.offset) {
+                        local = &child;
+                    }
+                }
+                scope = symbol.children;
+                searching = true;
+                break;
+            }
+        }
+        if (local != nullptr) {
+            const auto lines = LineTable{text};
+            return compose(block_start(at.block), lines.range(local->name_begin, local->name_end));
+        }
+
+        // Otherwise the first top-level declaration with that name
+        auto start = Position{};
+        for (std::size_t i = 0; i < blocks_.size(); ++i) {
+            for (const auto& symbol : blocks_[i].symbols) {
+                if (symbol.name == token.string) {
+                    const auto lines = LineTable{document_.block(i).text()};
+                    return compose(start, lines.range(symbol.name_begin, symbol.name_end));
+                }
+            }
+            start = advance(start, blocks_[i]);
+        }
+        return std::nullopt;
+    }
+
+    AnalyzedDocument::BlockInfo AnalyzedDocument::analyze(const DocumentBlock& block)
+    {
+        const auto text = block.text();
+        auto info = BlockInfo{};
+        const auto last_newline = text.rfind('\n');
+        info.newlines = static_cast<std::uint32_t>(std::ranges::count(text, '\n'));
+        info.last_line_units = utf16_length(last_newline == std::string_view::npos ? text : text.substr(last_newline + 1));
+        info.error = block.error().has_value();
+
+        const auto tokens = block.tokens();
+        auto collect = [&](auto& self, const Statement& statement, std::vector<BlockSymbol>& symbols) -> void {
+            if (const auto* function = dynamic_cast<const FunDeclStatement*>(&statement)) {
+                const auto identifier = function->identifier();
+                const auto name_begin = offset_in(text, identifier);
+                const auto index = token_index(tokens, text, name_begin);
+                auto symbol = BlockSymbol{
+                    .name = std::string{identifier.string},
+                    .kind = SymbolKind::Function,
+                    // From the fun keyword to the closing brace
+                    .begin = index > 0 ? offset_in(text, tokens[index - 1]) : name_begin,
+                    .end = end_of(tokens, text, index + 1, TokenType::RightBrace),
+                    .name_begin = name_begin,
+                    .name_end = name_begin + identifier.string.size(),
+                };
+                for (const auto& parameter : function->parameters()) {
+                    const auto parameter_begin = offset_in(text, parameter.identifier);
+                    symbol.children.push_back(BlockSymbol{
+                        .name = std::string{parameter.identifier.string},
+                        .kind = SymbolKind::Variable,
+                        .begin = parameter_begin,
+                        .end = offset_in(text, parameter.type_spec.name) + parameter.type_spec.name.string.size(),
+                        .name_begin = parameter_begin,
+                        .name_end = parameter_begin + parameter.identifier.string.size(),
+                    });
+                }
+                for (const auto& child : function->statements()) {
+                    self(self, *child, symbol.children);
+                }
+                symbols.push_back(std::move(symbol));
+            }
+            else if (const auto* variable = dynamic_cast<const VarDeclStatement*>(&statement)) {
+                const auto identifier = variable->identifier();
+                const auto name_begin = offset_in(text, identifier);
+                symbols.push_back(BlockSymbol{
+                    .name = std::string{identifier.string},
+                    .kind = variable->decl_type().type == TokenType::Let ? SymbolKind::Constant : SymbolKind::Variable,
+                    .begin = offset_in(text, variable->decl_type()),
+                    .end = end_of(tokens, text, token_index(tokens, text, name_begin), TokenType::Semicolon),
+                    .name_begin = name_begin,
+                    .name_end = name_begin + identifier.string.size(),
+                });
+            }
+            else if (const auto* struct_declaration = dynamic_cast<const StructDeclStatement*>(&statement)) {
+                const auto identifier = struct_declaration->identifier();
+                const auto name_begin = offset_in(text, identifier);
+                const auto index = token_index(tokens, text, name_begin);
+                // From the struct keyword, or the packed or soa before it, to the closing brace
+                const auto keywords = struct_declaration->packed() || struct_declaration->soa() ? 2U : 1U;
+                auto symbol = BlockSymbol{
+                    .name = std::string{identifier.string},
+                    .kind = SymbolKind::Struct,
+                    .begin = index >= keywords ? offset_in(text, tokens[index - keywords]) : name_begin,
+                    .end = end_of(tokens, text, index + 1, TokenType::RightBrace),
+                    .name_begin = name_begin,
+                    .name_end = name_begin + identifier.string.size(),
+                };
+                for (const auto& field : struct_declaration->fields()) {
+                    const auto field_begin = offset_in(text, field.identifier);
+                    symbol.children.push_back(BlockSymbol{
+                        .name = std::string{field.identifier.string},
+                        .kind = SymbolKind::Field,
+                        .begin = field_begin,
+                        .end = offset_in(text, field.type_spec.name) + field.type_spec.name.string.size(),
+                        .name_begin = field_begin,
+                        .name_end = field_begin + field.identifier.string.size(),
+                    });
+                }
+                symbols.push_back(std::move(symbol));
+            }
+            // Variables declared in blocks are listed with the enclosing function
+            else if (const auto* block_statement = dynamic_cast<const BlockStatement*>(&statement)) {
+                for (const auto& child : block_statement->statements()) {
+                    self(self, *child, symbols);
+                }
+            }
+            else if (const auto* if_statement = dynamic_cast<const IfStatement*>(&statement)) {
+                self(self, *if_statement->then_branch(), symbols);
+                if (if_statement->else_branch() != nullptr) {
+                    self(self, *if_statement->else_branch(), symbols);
+                }
+            }
+            else if (const auto* while_statement = dynamic_cast<const WhileStatement*>(&statement)) {
+                self(self, *while_statement->body(), symbols);
+            }
+            else if (const auto* for_statement = dynamic_cast<const ForStatement*>(&statement)) {
+                if (for_statement->initializer() != nullptr) {
+                    self(self, *for_statement->initializer(), symbols);
+                }
+                self(self, *for_statement->body(), symbols);
+            }
+        };
+        if (const auto* declaration = block.declaration()) {
+            collect(collect, *declaration, info.symbols);
+        }
+        return info;
+    }
+
+    Position AnalyzedDocument::advance(Position start, const BlockInfo& info) noexcept
+    {
+        return compose(start, Position{info.newlines, info.last_line_units});
+    }
+
+    Position AnalyzedDocument::block_start(std::size_t index) const noexcept
+    {
+        auto start = Position{};
+        for (std::size_t i = 0; i < index; ++i) {
+            start = advance(start, blocks_[i]);
+        }
+        return start;
+    }
+
+    AnalyzedDocument::Offset AnalyzedDocument::offset_of(Position position) const noexcept
+    {
+        auto start = Position{};
+        std::size_t absolute = 0;
+        for (std::size_t i = 0; i < blocks_.size(); ++i) {
+            const auto end = advance(start, blocks_[i]);
+            const auto text = document_.block(i).text();
+            if (position < end || i + 1 == blocks_.size()) {
+                // Positions past the end of a line are clamped to it
+                auto current = start;
+                std::size_t offset = 0;
+                while (offset < text.size() && current < position) {
+                    if (text[offset] == '\n') {
+                        if (current.line == position.line) {
+                            break;
+                        }
+                        ++current.line;
+                        current.character = 0;
+                    }
+                    else {
+                        current.character += utf16_units(text[offset]);
+                    }
+                    ++offset;
+                }
+                while (offset < text.size() && utf16_units(text[offset]) == 0) {
+                    ++offset;
+                }
+                return {i, offset, absolute + offset};
+            }
+            start = end;
+            absolute += text.size();
+        }
+        return {0, 0, 0};
+    }
+} // namespace talos::lsp
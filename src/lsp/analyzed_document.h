@@ -0,0 +1,111 @@
+#pragma once
+
+#include "frontend/document.h"
+
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace talos::lsp
+{
+    // Zero based line and UTF-16 code unit offset, as used by LSP
+    struct Position {
+        std::uint32_t line = 0;
+        std::uint32_t character = 0;
+
+        friend auto operator<=>(const Position&, const Position&) = default;
+    };
+
+    struct Range {
+        Position start;
+        Position end;
+
+        friend bool operator==(const Range&, const Range&) = default;
+    };
+
+    // Values match the LSP SymbolKind enumeration
+    enum class SymbolKind {
+        Field = 8,
+        Function = 12,
+        Variable = 13,
+        Constant = 14,
+        Struct = 23,
+    };
+
+    struct Symbol {
+        std::string name;
+        SymbolKind kind;
+        Range range;
+        // Range of the symbol's name
+        Range selection_range;
+        std::vector<Symbol> children;
+    };
+
+    struct Diagnostic {
+        Range range;
+        std::string message;
+    };
+
+    // An open document together with analysis results cached per declaration
+    // block. Edits only re-analyze the blocks re-parsed by the Document, every
+    // query is answered from the cached state
+    class AnalyzedDocument
+    {
+    public:
+        explicit AnalyzedDocument(std::string_view text);
+
+        // Replaces range with text, or the whole document if range is nullopt
+        void apply_change(const std::optional<Range>& range, std::string_view text);
+
+        [[nodiscard]] std::string text() const { return document_.text(); }
+        [[nodiscard]] std::vector<Diagnostic> diagnostics() const;
+        // fun, var and let declarations, with parameters and declarations inside
+        // functions as children
+        [[nodiscard]] std::vector<Symbol> symbols() const;
+        // Range of the declaration the identifier at position refers to
+        [[nodiscard]] std::optional<Range> definition(Position position) const;
+
+    private:
+        // Symbol with byte offsets relative to its block
+        struct BlockSymbol {
+            std::string name;
+            SymbolKind kind;
+            std::size_t begin;
+            std::size_t end;
+            std::size_t name_begin;
+            std::size_t name_end;
+            std::vector<BlockSymbol> children;
+        };
+
+        struct BlockInfo {
+            std::uint32_t newlines = 0;
+            // UTF-16 code units after the last newline of the block
+            std::uint32_t last_line_units = 0;
+            bool error = false;
+            std::vector<BlockSymbol> symbols;
+        };
+
+        [[nodiscard]] static BlockInfo analyze(const DocumentBlock& block);
+
+        // Position of the start of each block is accumulated front to back
+        [[nodiscard]] static Position advance(Position start, const BlockInfo& info) noexcept;
+        [[nodiscard]] Position block_start(std::size_t index) const noexcept;
+
+        struct Offset {
+            std::size_t block;
+            // Byte offset within the block
+            std::size_t offset;
+            // Byte offset within the document
+            std::size_t absolute;
+        };
+        [[nodiscard]] Offset offset_of(Position position) const noexcept;
+
+        Document document_;
+        std::vector<BlockInfo> blocks_;
+        std::size_t error_blocks_ = 0;
+    };
+} // namespace talos::lsp
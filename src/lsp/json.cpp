@@ -0,0 +1,374 @@
+#include "json.h"
+
+#include <fmt/format.h>
+
+#include <charconv>
+#include <cmath>
+#include <iterator>
+
+namespace talos::lsp
+{
+    namespace
+    {
+        class JsonParser
+        {
+        public:
+            explicit JsonParser(std::string_view text)
+                : text_(text)
+            {
+            }
+
+            std::optional<JsonValue> parse_document()
+            {
+                auto value = parse_value(0);
+                skip_whitespace();
+                if (!value || position_ != text_.size()) {
+                    return std::nullopt;
+                }
+                return value;
+            }
+
+        private:
+            // Deeper documents are rejected rather than risking the stack
+            static constexpr int max_depth = 256;
+
+            std::optional<JsonValue> parse_value(int depth)
+            {
+                if (depth > max_depth) {
+                    return std::nullopt;
+                }
+                skip_whitespace();
+                if (position_ == text_.size()) {
+                    return std::nullopt;
+                }
+                switch (text_[position_]) {
+                    case '{':
+                        return parse_object(depth);
+                    case '[':
+                        return parse_array(depth);
+                    case '"': {
+                        auto string = parse_string();
+                        if (!string) {
+                            return std::nullopt;
+                        }
+                        return JsonValue{std::move(*string)};
+                    }
+                    case 't':
+                        return parse_literal("true", JsonValue{true});
+                    case 'f':
+                        return parse_literal("false", JsonValue{false});
+                    case 'n':
+                        return parse_literal("null", JsonValue{});
+                    default:
+                        return parse_number();
+                }
+            }
+
+            std::optional<JsonValue> parse_object(int depth)
+            {
+                ++position_;
+                auto object = JsonValue::Object{};
+                skip_whitespace();
+                if (consume('}')) {
+                    return JsonValue{std::move(object)};
+                }
+                for (;;) {
+                    skip_whitespace();
+                    auto key = parse_string();
+                    skip_whitespace();
+                    if (!key || !consume(':')) {
+                        return std::nullopt;
+                    }
+                    auto value = parse_value(depth + 1);
+                    if (!value) {
+                        return std::nullopt;
+                    }
+                    object.emplace_back(std::move(*key), std::move(*value));
+                    skip_whitespace();
+                    if (consume('}')) {
+                        return JsonValue{std::move(object)};
+                    }
+                    if (!consume(',')) {
+                        return std::nullopt;
+                    }
+                }
+            }
+
+            std::optional<JsonValue> parse_array(int depth)
+            {
+                ++position_;
+                auto array = JsonValue::Array{};
+                skip_whitespace();
+                if (consume(']')) {
+                    return JsonValue{std::move(array)};
+                }
+                for (;;) {
+                    auto value = parse_value(depth + 1);
+                    if (!value) {
+                        return std::nullopt;
+                    }
+                    array.push_back(std::move(*value));
+                    skip_whitespace();
+                    if (consume(']')) {
+                        return JsonValue{std::move(array)};
+                    }
+                    if (!consume(',')) {
+                        return std::nullopt;
+                    }
+                }
+            }
+
+            std::optional<std::string> parse_string()
+            {
+                if (!consume('"')) {
+                    return std::nullopt;
+                }
+                std::string string;
+                while (position_ < text_.size()) {
+                    const auto character = text_[position_++];
+                    if (character == '"') {
+                        return string;
+                    }
+                    if (character != '\\') {
+                        string.push_back(character);
+                        continue;
+                    }
+                    if (position_ == text_.size()) {
+                        return std::nullopt;
+                    }
+                    switch (text_[position_++]) {
+                        case '"':
+                            string.push_back('"');
+                            break;
+                        case '\\':
+                            string.push_back('\\');
+                            break;
+                        case '/':
+                            string.push_back('/');
+                            break;
+                        case 'b':
+                            string.push_back('\b');
+                            break;
+                        case 'f':
+                            string.push_back('\f');
+                            break;
+                        case 'n':
+                            string.push_back('\n');
+                            break;
+                        case 'r':
+                            string.push_back('\r');
+                            break;
+                        case 't':
+                            string.push_back('\t');
+                            break;
+                        case 'u': {
+                            auto code_point = parse_hex4();
+                            if (!code_point) {
+                                return std::nullopt;
+                            }
+                            // Combine surrogate pairs
+                            if (*code_point >= 0xD800 && *code_point < 0xDC00 && text_.substr(position_, 2) == "\\u") {
+                                position_ += 2;
+                                const auto low = parse_hex4();
+                                if (!low || *low < 0xDC00 || *low >= 0xE000) {
+                                    return std::nullopt;
+                                }
+                                *code_point = 0x10000 + ((*code_point - 0xD800) << 10U) + (*low - 0xDC00);
+                            }
+                            append_utf8(string, *code_point);
+                            break;
+                        }
+                        default:
+                            return std::nullopt;
+                    }
+                }
+                return std::nullopt;
+            }
+
+            std::optional<std::uint32_t> parse_hex4()
+            {
+                if (text_.size() - position_ < 4) {
+                    return std::nullopt;
+                }
+                std::uint32_t value = 0;
+                const auto* begin = text_.data() + position_;
+                const auto [end, error] = std::from_chars(begin, begin + 4, value, 16);
+                if (error != std::errc{} || end != begin + 4) {
+                    return std::nullopt;
+                }
+                position_ += 4;
+                return value;
+            }
+
+            static void append_utf8(std::string& out, std::uint32_t code_point)
+            {
+                if (code_point < 0x80) {
+                    out.push_back(static_cast<char>(code_point));
+                }
+                else if (code_point < 0x800) {
+                    out.push_back(static_cast<char>(0xC0U | (code_point >> 6U)));
+                    out.push_back(static_cast<char>(0x80U | (code_point & 0x3FU)));
+                }
+                else if (code_point < 0x10000) {
+                    out.push_back(static_cast<char>(0xE0U | (code_point >> 12U)));
+                    out.push_back(static_cast<char>(0x80U | ((code_point >> 6U) & 0x3FU)));
+                    out.push_back(static_cast<char>(0x80U | (code_point & 0x3FU)));
+                }
+                else {
+                    out.push_back(static_cast<char>(0xF0U | (code_point >> 18U)));
+                    out.push_back(static_cast<char>(0x80U | ((code_point >> 12U) & 0x3FU)));
+                    out.push_back(static_cast<char>(0x80U | ((code_point >> 6U) & 0x3FU)));
+                    out.push_back(static_cast<char>(0x80U | (code_point & 0x3FU)));
+                }
+            }
+
+            std::optional<JsonValue> parse_number()
+            {
+                const auto* begin = text_.data() + position_;
+                double value = 0;
+                const auto [end, error] = std::from_chars(begin, text_.data() + text_.size(), value);
+                if (error != std::errc{}) {
+                    return std::nullopt;
+                }
+                position_ += static_cast<std::size_t>(end - begin);
+                return JsonValue{value};
+            }
+
+            std::optional<JsonValue> parse_literal(std::string_view literal, JsonValue value)
+            {
+                if (text_.substr(position_, literal.size()) != literal) {
+                    return std::nullopt;
+                }
+                position_ += literal.size();
+                return value;
+            }
+
+            void skip_whitespace() noexcept
+            {
+                while (position_ < text_.size() && (text_[position_] == ' ' || text_[position_] == '\t' || text_[position_] == '\n' || text_[position_] == '\r')) {
+                    ++position_;
+                }
+            }
+
+            bool consume(char expected) noexcept
+            {
+                if (position_ < text_.size() && text_[position_] == expected) {
+                    ++position_;
+                    return true;
+                }
+                return false;
+            }
+
+            std::string_view text_;
+            std::size_t position_ = 0;
+        };
+
+        void write_string(std::string_view string, std::string& out)
+        {
+            out.push_back('"');
+            for (const auto character : string) {
+                switch (character) {
+                    case '"':
+                        out += "\\\"";
+                        break;
+                    case '\\':
+                        out += "\\\\";
+                        break;
+                    case '\n':
+                        out += "\\n";
+                        break;
+                    case '\r':
+                        out += "\\r";
+                        break;
+                    case '\t':
+                        out += "\\t";
+                        break;
+                    default:
+                        if (static_cast<unsigned char>(character) < 0x20) {
+                            fmt::format_to(std::back_inserter(out), "\\u{:04x}", static_cast<unsigned>(character));
+                        }
+                        else {
+                            out.push_back(character);
+                        }
+                        break;
+                }
+            }
+            out.push_back('"');
+        }
+    } // namespace
+
+    const JsonValue* JsonValue::find(std::string_view key) const noexcept
+    {
+        const auto* object = std::get_if<Object>(&value_);
+        if (object == nullptr) {
+            return nullptr;
+        }
+        for (const auto& [name, value] : *object) {
+            if (name == key) {
+                return &value;
+            }
+        }
+        return nullptr;
+    }
+
+    std::optional<JsonValue> parse_json(std::string_view text)
+    {
+        return JsonParser{text}.parse_document();
+    }
+
+    void write_json(const JsonValue& value, std::string& out)
+    {
+        if (value.is_null()) {
+            out += "null";
+        }
+        else if (value.is_bool()) {
+            out += value.as_bool() ? "true" : "false";
+        }
+        else if (value.is_number()) {
+            const auto number = value.as_number();
+            // Integral values (ids, positions) are written without a fraction
+            if (std::trunc(number) == number && std::abs(number) < 9007199254740992.0) {
+                fmt::format_to(std::back_inserter(out), "{}", static_cast<std::int64_t>(number));
+            }
+            else {
+                fmt::format_to(std::back_inserter(out), "{}", number);
+            }
+        }
+        else if (value.is_string()) {
+            write_string(value.as_string(), out);
+        }
+        else if (value.is_array()) {
+            out.push_back('[');
+            auto first = true;
+            for (const auto& element : value.as_array()) {
+                if (!first) {
+                    out.push_back(',');
+                }
+                first = false;
+                write_json(element, out);
+            }
+            out.push_back(']');
+        }
+        else {
+            out.push_back('{');
+            auto first = true;
+            for (const auto& [key, member] : value.as_object()) {
+                if (!first) {
+                    out.push_back(',');
+                }
+                first = false;
+                write_string(key, out);
+                out.push_back(':');
+                write_json(member, out);
+            }
+            out.push_back('}');
+        }
+    }
+
+    std::string to_json(const JsonValue& value)
+    {
+        std::string out;
+        write_json(value, out);
+        return out;
+    }
+} // namespace talos::lsp
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace talos::lsp
+{
+    // Minimal JSON document model for the language server protocol
+    class JsonValue
+    {
+    public:
+        using Array = std::vector<JsonValue>;
+        // Keys keep their insertion order, lookups are linear as LSP objects are small
+        using Object = std::vector<std::pair<std::string, JsonValue>>;
+
+        JsonValue() = default;
+        JsonValue(std::nullptr_t) {}
+        JsonValue(bool value)
+            : value_(value)
+        {
+        }
+        JsonValue(double value)
+            : value_(value)
+        {
+        }
+        JsonValue(std::int64_t value)
+            : value_(static_cast<double>(value))
+        {
+        }
+        JsonValue(int value)
+            : value_(static_cast<double>(value))
+        {
+        }
+        JsonValue(std::size_t value)
+            : value_(static_cast<double>(value))
+        {
+        }
+        JsonValue(std::string value)
+            : value_(std::move(value))
+        {
+        }
+        JsonValue(std::string_view value)
+            : value_(std::string{value})
+        {
+        }
+        JsonValue(const char* value)
+            : value_(std::string{value})
+        {
+        }
+        JsonValue(Array value)
+            : value_(std::move(value))
+        {
+        }
+        JsonValue(Object value)
+            : value_(std::move(value))
+        {
+        }
+
+        [[nodiscard]] bool is_null() const noexcept { return std::holds_alternative<std::nullptr_t>(value_); }
+        [[nodiscard]] bool is_bool() const noexcept { return std::holds_alternative<bool>(value_); }
+        [[nodiscard]] bool is_number() const noexcept { return std::holds_alternative<double>(value_); }
+        [[nodiscard]] bool is_string() const noexcept { return std::holds_alternative<std::string>(value_); }
+        [[nodiscard]] bool is_array() const noexcept { return std::holds_alternative<Array>(value_); }
+        [[nodiscard]] bool is_object() const noexcept { return std::holds_alternative<Object>(value_); }
+
+        // Accessors throw std::bad_variant_access on a type mismatch
+        [[nodiscard]] bool as_bool() const { return std::get<bool>(value_); }
+        [[nodiscard]] double as_number() const { return std::get<double>(value_); }
+        [[nodiscard]] const std::string& as_string() const { return std::get<std::string>(value_); }
+        [[nodiscard]] const Array& as_array() const { return std::get<Array>(value_); }
+        [[nodiscard]] const Object& as_object() const { return std::get<Object>(value_); }
+        [[nodiscard]] Array& as_array() { return std::get<Array>(value_); }
+        [[nodiscard]] Object& as_object() { return std::get<Object>(value_); }
+
+        // Member of an object, null if absent or if this is not an object
+        [[nodiscard]] const JsonValue* find(std::string_view key) const noexcept;
+
+    private:
+        std::variant<std::nullptr_t, bool, double, std::string, Array, Object> value_;
+    };
+
+    // Returns nullopt if text is not a single valid JSON value
+    [[nodiscard]] std::optional<JsonValue> parse_json(std::string_view text);
+
+    void write_json(const JsonValue& value, std::string& out);
+    [[nodiscard]] std::string to_json(const JsonValue& value);
+} // namespace talos::lsp
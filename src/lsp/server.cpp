@@ -0,0 +1,403 @@
+#include "server.h"
+
+#include "trace.h"
+
+#include <fmt/format.h>
+
+#include <cstdlib>
+#include <stdexcept>
+#include <utility>
+#include <variant>
+
+namespace talos::lsp
+{
+    namespace
+    {
+        // JSON-RPC error codes
+        constexpr int parse_error = -32700;
+        constexpr int invalid_request = -32600;
+        constexpr int method_not_found = -32601;
+        constexpr int invalid_params = -32602;
+
+        // Thrown for required members that are missing or have the wrong type
+        class InvalidParams : public std::runtime_error
+        {
+        public:
+            using std::runtime_error::runtime_error;
+        };
+
+        const JsonValue& member(const JsonValue& object, std::string_view key)
+        {
+            const auto* value = object.find(key);
+            if (value == nullptr) {
+                throw InvalidParams{fmt::format("Missing member '{}'", key)};
+            }
+            return *value;
+        }
+
+        std::uint32_t to_uint(const JsonValue& value)
+        {
+            const auto number = value.as_number();
+            if (number < 0 || number > 4294967295.0) {
+                throw InvalidParams{"Position out of range"};
+            }
+            return static_cast<std::uint32_t>(number);
+        }
+
+        Position to_position(const JsonValue& value)
+        {
+            return {to_uint(member(value, "line")), to_uint(member(value, "character"))};
+        }
+
+        Range to_range(const JsonValue& value)
+        {
+            return {to_position(member(value, "start")), to_position(member(value, "end"))};
+        }
+
+        JsonValue from_position(Position position)
+        {
+            return JsonValue::Object{{"line", std::int64_t{position.line}}, {"character", std::int64_t{position.character}}};
+        }
+
+        JsonValue from_range(Range range)
+        {
+            return JsonValue::Object{{"start", from_position(range.start)}, {"end", from_position(range.end)}};
+        }
+
+        JsonValue from_symbol(const Symbol& symbol)
+        {
+            auto children = JsonValue::Array{};
+            children.reserve(symbol.children.size());
+            for (const auto& child : symbol.children) {
+                children.push_back(from_symbol(child));
+            }
+            auto object = JsonValue::Object{
+                {"name", symbol.name},
+                {"kind", static_cast<int>(symbol.kind)},
+                {"range", from_range(symbol.range)},
+                {"selectionRange", from_range(symbol.selection_range)},
+            };
+            // Members moved in after the initializer list, which would copy them
+            object.emplace_back("children", std::move(children));
+            return object;
+        }
+
+        const std::string& document_uri(const JsonValue& params)
+        {
+            return member(member(params, "textDocument"), "uri").as_string();
+        }
+    } // namespace
+
+    LanguageServer::LanguageServer(Sink sink)
+        : sink_(std::move(sink))
+    {
+    }
+
+    void LanguageServer::handle(std::string_view message)
+    {
+        TALOS_TRACE_SCOPE("lsp_message");
+        const auto json = parse_json(message);
+        if (!json || !json->is_object()) {
+            respond_error(JsonValue{}, parse_error, "Invalid JSON");
+            return;
+        }
+        const auto* id = json->find("id");
+        const auto* method = json->find("method");
+        const auto* params = json->find("params");
+        if (method == nullptr || !method->is_string()) {
+            // Responses to server requests are not expected
+            if (id != nullptr) {
+                respond_error(*id, invalid_request, "Missing method");
+            }
+            return;
+        }
+
+        if (id == nullptr) {
+            // Notifications have no response, so their errors are logged instead
+            try {
+                handle_notification(method->as_string(), params);
+            }
+            catch (const InvalidParams& error) {
+                log_error(fmt::format("{}: {}", method->as_string(), error.what()));
+            }
+            catch (const std::bad_variant_access&) {
+                log_error(fmt::format("{}: Invalid parameter type", method->as_string()));
+            }
+            return;
+        }
+        try {
+            handle_request(*id, method->as_string(), params);
+        }
+        catch (const InvalidParams& error) {
+            respond_error(*id, invalid_params, error.what());
+        }
+        catch (const std::bad_variant_access&) {
+            respond_error(*id, invalid_params, "Invalid parameter type");
+        }
+    }
+
+    const AnalyzedDocument* LanguageServer::document(const std::string& uri) const
+    {
+        const auto iter = documents_.find(uri);
+        return iter == documents_.end() ? nullptr : &iter->second.document;
+    }
+
+    void LanguageServer::handle_request(const JsonValue& id, const std::string& method, const JsonValue* params)
+    {
+        if (shutdown_) {
+            respond_error(id, invalid_request, "Server is shut down");
+        }
+        else if (method == "initialize") {
+            respond(id, initialize());
+        }
+        else if (method == "shutdown") {
+            shutdown_ = true;
+            respond(id, JsonValue{});
+        }
+        else if (params == nullptr) {
+            respond_error(id, invalid_params, "Missing params");
+        }
+        else if (method == "textDocument/documentSymbol") {
+            respond(id, document_symbols(*params));
+        }
+        else if (method == "textDocument/definition") {
+            respond(id, definition(*params));
+        }
+        else {
+            respond_error(id, method_not_found, fmt::format("Unsupported method '{}'", method));
+        }
+    }
+
+    void LanguageServer::handle_notification(const std::string& method, const JsonValue* params)
+    {
+        if (method == "exit") {
+            exited_ = true;
+        }
+        else if (params == nullptr) {
+            return;
+        }
+        else if (method == "textDocument/didOpen") {
+            did_open(*params);
+        }
+        else if (method == "textDocument/didChange") {
+            did_change(*params);
+        }
+        else if (method == "textDocument/didClose") {
+            did_close(*params);
+        }
+        // Other notifications, e.g. initialized or $/cancelRequest, need no action
+    }
+
+    JsonValue LanguageServer::initialize() const
+    {
+        return JsonValue::Object{
+            {"capabilities", JsonValue::Object{
+                                 // Full open/close notifications and incremental changes
+                                 {"textDocumentSync", JsonValue::Object{{"openClose", true}, {"change", 2}}},
+                                 {"documentSymbolProvider", true},
+                                 {"definitionProvider", true},
+                             }},
+            {"serverInfo", JsonValue::Object{{"name", "talos"}}},
+        };
+    }
+
+    JsonValue LanguageServer::document_symbols(const JsonValue& params) const
+    {
+        const auto* document = this->document(document_uri(params));
+        if (document == nullptr) {
+            return JsonValue{};
+        }
+        auto symbols = JsonValue::Array{};
+        for (const auto& symbol : document->symbols()) {
+            symbols.push_back(from_symbol(symbol));
+        }
+        return symbols;
+    }
+
+    JsonValue LanguageServer::definition(const JsonValue& params) const
+    {
+        const auto& uri = document_uri(params);
+        const auto position = to_position(member(params, "position"));
+        const auto* document = this->document(uri);
+        if (document == nullptr) {
+            return JsonValue{};
+        }
+        const auto range = document->definition(position);
+        if (!range) {
+            return JsonValue{};
+        }
+        return JsonValue::Object{{"uri", uri}, {"range", from_range(*range)}};
+    }
+
+    void LanguageServer::did_open(const JsonValue& params)
+    {
+        const auto& text_document = member(params, "textDocument");
+        const auto& uri = member(text_document, "uri").as_string();
+        const auto& text = member(text_document, "text").as_string();
+        auto [iter, inserted] = documents_.insert_or_assign(uri, OpenDocument{.document = AnalyzedDocument{text}});
+        publish_diagnostics(iter->first, iter->second);
+    }
+
+    void LanguageServer::did_change(const JsonValue& params)
+    {
+        const auto iter = documents_.find(document_uri(params));
+        if (iter == documents_.end()) {
+            return;
+        }
+        auto& open = iter->second;
+        for (const auto& change : member(params, "contentChanges").as_array()) {
+            const auto* range = change.find("range");
+            // Incremental changes cannot apply to a text out of sync with the
+            // client, only replacing all of it does
+            if (range != nullptr && open.stale) {
+                continue;
+            }
+            // Until the change is applied, an error leaves the text out of sync
+            open.stale = true;
+            try {
+                open.document.apply_change(range != nullptr ? std::optional{to_range(*range)} : std::nullopt, member(change, "text").as_string());
+            }
+            catch (const std::out_of_range&) {
+                throw InvalidParams{"Change outside of the document"};
+            }
+            open.stale = false;
+        }
+        if (!open.stale) {
+            publish_diagnostics(iter->first, open);
+        }
+    }
+
+    void LanguageServer::did_close(const JsonValue& params)
+    {
+        const auto& uri = document_uri(params);
+        const auto iter = documents_.find(uri);
+        if (iter == documents_.end()) {
+            return;
+        }
+        // Clear the diagnostics shown for the closed document
+        if (iter->second.has_diagnostics) {
+            send(JsonValue::Object{
+                {"jsonrpc", "2.0"},
+                {"method", "textDocument/publishDiagnostics"},
+                {"params", JsonValue::Object{{"uri", uri}, {"diagnostics", JsonValue::Array{}}}},
+            });
+        }
+        documents_.erase(iter);
+    }
+
+    void LanguageServer::publish_diagnostics(const std::string& uri, OpenDocument& open)
+    {
+        const auto diagnostics = open.document.diagnostics();
+        // Unchanged empty diagnostics are not sent again on every keystroke
+        if (diagnostics.empty() && !open.has_diagnostics) {
+            return;
+        }
+        open.has_diagnostics = !diagnostics.empty();
+
+        auto array = JsonValue::Array{};
+        array.reserve(diagnostics.size());
+        for (const auto& diagnostic : diagnostics) {
+            array.push_back(JsonValue::Object{
+                {"range", from_range(diagnostic.range)},
+                // Error
+                {"severity", 1},
+                {"source", "talos"},
+                {"message", diagnostic.message},
+            });
+        }
+        auto params = JsonValue::Object{{"uri", uri}};
+        params.emplace_back("diagnostics", std::move(array));
+        auto notification = JsonValue::Object{{"jsonrpc", "2.0"}, {"method", "textDocument/publishDiagnostics"}};
+        notification.emplace_back("params", std::move(params));
+        send(notification);
+    }
+
+    void LanguageServer::send(const JsonValue& message) const
+    {
+        sink_(to_json(message));
+    }
+
+    void LanguageServer::log_error(std::string_view message) const
+    {
+        send(JsonValue::Object{
+            {"jsonrpc", "2.0"},
+            {"method", "window/logMessage"},
+            // Error
+            {"params", JsonValue::Object{{"type", 1}, {"message", message}}},
+        });
+    }
+
+    void LanguageServer::respond(const JsonValue& id, JsonValue result) const
+    {
+        auto response = JsonValue::Object{{"jsonrpc", "2.0"}, {"id", id}};
+        response.emplace_back("result", std::move(result));
+        send(response);
+    }
+
+    void LanguageServer::respond_error(const JsonValue& id, int code, std::string_view message) const
+    {
+        send(JsonValue::Object{
+            {"jsonrpc", "2.0"},
+            {"id", id},
+            {"error", JsonValue::Object{{"code", code}, {"message", message}}},
+        });
+    }
+
+    namespace
+    {
+        // Reads the headers of the next message, returning its Content-Length or
+        // nullopt at the end of input
+        std::optional<std::size_t> read_content_length(std::FILE* in)
+        {
+            auto length = std::optional<std::size_t>{};
+            std::string line;
+            for (;;) {
+                const auto character = std::getc(in);
+                if (character == EOF) {
+                    return std::nullopt;
+                }
+                if (character != '\n') {
+                    line.push_back(static_cast<char>(character));
+                    continue;
+                }
+                if (!line.empty() && line.back() == '\r') {
+                    line.pop_back();
+                }
+                if (line.empty()) {
+                    if (length) {
+                        return length;
+                    }
+                    // Skip stray blank lines between messages
+                    continue;
+                }
+                constexpr auto header = std::string_view{"Content-Length:"};
+                if (std::string_view{line}.starts_with(header)) {
+                    length = std::strtoull(line.c_str() + header.size(), nullptr, 10);
+                }
+                line.clear();
+            }
+        }
+    } // namespace
+
+    int serve_stdio(std::FILE* in, std::FILE* out)
+    {
+        auto server = LanguageServer{[out](std::string_view message) {
+            fmt::print(out, "Content-Length: {}\r\n\r\n{}", message.size(), message);
+            std::fflush(out);
+        }};
+
+        std::string body;
+        while (!server.exited()) {
+            const auto length = read_content_length(in);
+            if (!length) {
+                break;
+            }
+            body.resize(*length);
+            if (std::fread(body.data(), 1, body.size(), in) != body.size()) {
+                break;
+            }
+            server.handle(body);
+        }
+        return server.exit_code();
+    }
+} // namespace talos::lsp
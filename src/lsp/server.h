@@ -0,0 +1,71 @@
+#pragma once
+
+#include "analyzed_document.h"
+#include "json.h"
+
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace talos::lsp
+{
+    // Language server for talos sources. Open documents are kept analyzed in
+    // memory and updated incrementally on every change, requests are answered
+    // from that state without running the pipeline
+    class LanguageServer
+    {
+    public:
+        // Receives every outgoing message without its transport framing
+        using Sink = std::function<void(std::string_view message)>;
+
+        explicit LanguageServer(Sink sink);
+
+        // Handles a single JSON-RPC message
+        void handle(std::string_view message);
+
+        [[nodiscard]] bool exited() const noexcept { return exited_; }
+        // 0 if the client shut the server down before the exit notification
+        [[nodiscard]] int exit_code() const noexcept { return shutdown_ ? 0 : 1; }
+
+        // Null if the document is not open
+        [[nodiscard]] const AnalyzedDocument* document(const std::string& uri) const;
+
+    private:
+        struct OpenDocument {
+            AnalyzedDocument document;
+            // Whether the last published diagnostics were non-empty
+            bool has_diagnostics = false;
+            // Whether a change failed to apply, leaving the text out of sync
+            // with the client until a change replaces all of it
+            bool stale = false;
+        };
+
+        void handle_request(const JsonValue& id, const std::string& method, const JsonValue* params);
+        void handle_notification(const std::string& method, const JsonValue* params);
+
+        [[nodiscard]] JsonValue initialize() const;
+        [[nodiscard]] JsonValue document_symbols(const JsonValue& params) const;
+        [[nodiscard]] JsonValue definition(const JsonValue& params) const;
+
+        void did_open(const JsonValue& params);
+        void did_change(const JsonValue& params);
+        void did_close(const JsonValue& params);
+        void publish_diagnostics(const std::string& uri, OpenDocument& open);
+
+        void send(const JsonValue& message) const;
+        void log_error(std::string_view message) const;
+        void respond(const JsonValue& id, JsonValue result) const;
+        void respond_error(const JsonValue& id, int code, std::string_view message) const;
+
+        Sink sink_;
+        std::unordered_map<std::string, OpenDocument> documents_;
+        bool shutdown_ = false;
+        bool exited_ = false;
+    };
+
+    // Serves the language server protocol with Content-Length framing until the
+    // exit notification or the end of input, returning the process exit code
+    int serve_stdio(std::FILE* in, std::FILE* out);
+} // namespace talos::lsp
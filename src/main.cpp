@@ -1,20 +1,121 @@
+#include "lsp/server.h"
 #include "talos.h"
+#include "trace.h"
 
+#ifdef TALOS_ENABLE_DAEMON
+    #include "daemon/compile_server.h"
+#endif
+
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
 #include <iostream>
+#include <optional>
 #include <string>
+#include <string_view>
+
+struct Flags {
+    bool time_phases = false;
+    bool stats = false;
+    bool pipeline_lexer = false;
+    bool stream = false;
+    bool per_function = false;
+    bool lsp = false;
+    bool run = false;
+    talos::NativeOutput native = talos::NativeOutput::None;
+    talos::Pruning prune = talos::Pruning::None;
+    // Of the assembly or executable
+    std::string output;
+    std::string trace_file;
+    std::string cache_directory;
+    std::uint64_t cache_max_size = talos::VMOptions::default_cache_max_size;
+    // Unix socket of the compile server to run, forward to or stop
+    std::string server_socket;
+    std::string connect_socket;
+    std::string stop_socket;
+    talos::DumpFormat dump_ast = talos::DumpFormat::None;
+};
+
+void print_stats(const talos::VMSuccess& success, const Flags& flags)
+{
+    if (flags.time_phases) {
+        std::cerr << talos::format_phase_times(success.stats);
+    }
+    if (flags.stats) {
+        std::cerr << talos::format_stats(success.stats);
+    }
+}
 
-int run_file(talos::TalosVM& vm, const char* filename)
+int run_file(talos::TalosVM& vm, const char* filename, const Flags& flags)
 {
-    const auto result = vm.execute_file(filename);
+    // "-" streams the program from stdin
+    const auto result = std::string_view{filename} == "-" ? vm.execute_stream(stdin) : vm.execute_file(filename);
     if (!result) {
         const auto& error = result.error();
         std::cerr << error.description << '\n';
         return static_cast<int>(error.code);
     }
-    return 0;
+    print_stats(*result, flags);
+    // The exit code of a program is what its main function returns
+    return static_cast<int>(result->main_result.value_or(0));
+}
+
+// Compiles on a running compile server, or returns nullopt if there is none
+std::optional<int> run_on_server(const char* filename, const Flags& flags)
+{
+#ifdef TALOS_ENABLE_DAEMON
+    // stdin cannot be forwarded
+    if (std::string_view{filename} == "-") {
+        return std::nullopt;
+    }
+    auto error = std::error_code{};
+    const auto path = std::filesystem::absolute(filename, error);
+    if (error) {
+        return std::nullopt;
+    }
+    const auto request = talos::daemon::CompileRequest{
+        .path = path.string(),
+        .dump_ast = flags.dump_ast,
+        .per_function = flags.per_function,
+        .pipeline_lexer = flags.pipeline_lexer,
+    };
+    return talos::daemon::request_compile(flags.connect_socket, request, [](talos::daemon::OutputStream stream, std::string_view data) {
+        std::fwrite(data.data(), 1, data.size(), stream == talos::daemon::OutputStream::Stdout ? stdout : stderr);
+    });
+#else
+    static_cast<void>(filename);
+    static_cast<void>(flags);
+    return std::nullopt;
+#endif
+}
+
+int run_server(const Flags& flags)
+{
+#ifdef TALOS_ENABLE_DAEMON
+    try {
+        if (!flags.stop_socket.empty()) {
+            if (!talos::daemon::request_stop(flags.stop_socket)) {
+                std::cerr << "No compile server is listening on '" << flags.stop_socket << "'\n";
+                return -1;
+            }
+            return 0;
+        }
+        auto server = talos::daemon::CompileServer{flags.server_socket};
+        server.run();
+        return 0;
+    } catch (const std::system_error& error) {
+        std::cerr << "Could not run the compile server: " << error.what() << '\n';
+        return -1;
+    }
+#else
+    static_cast<void>(flags);
+    std::cerr << "The compile server is unavailable, talos was built without Unix socket support\n";
+    return -1;
+#endif
 }
 
-int run_repl(talos::TalosVM& vm)
+int run_repl(talos::TalosVM& vm, const Flags& flags)
 {
     std::string input;
     for (;;) {
@@ -29,19 +130,161 @@ int run_repl(talos::TalosVM& vm)
             return static_cast<int>(error.code);
         }
         std::cout << result->output << '\n';
+        print_stats(*result, flags);
     }
     return 0;
 }
 
 int main(int argc, const char* argv[])
 {
-    auto talos_vm = talos::TalosVM{};
-    if (argc == 1) {
-        return run_repl(talos_vm);
+    auto flags = Flags{};
+    const char* filename = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        const auto arg = std::string_view{argv[i]};
+        if (i == 1 && arg == "build") {
+            // talos build [-o executable] filename
+            flags.native = talos::NativeOutput::Executable;
+        }
+        else if (arg == "-o" && i + 1 < argc) {
+            flags.output = argv[++i];
+        }
+        else if (arg.starts_with("--emit=")) {
+            if (arg.substr(std::string_view{"--emit="}.size()) != "asm") {
+                std::cerr << "Invalid output format '" << arg << "'. Expected asm\n";
+                return -1;
+            }
+            flags.native = talos::NativeOutput::Assembly;
+        }
+        else if (arg == "--time-phases") {
+            flags.time_phases = true;
+        }
+        else if (arg == "--stats") {
+            flags.stats = true;
+        }
+        else if (arg == "--pipeline-lexer") {
+            flags.pipeline_lexer = true;
+        }
+        else if (arg == "--stream") {
+            flags.stream = true;
+        }
+        else if (arg == "--per-function") {
+            flags.per_function = true;
+        }
+        else if (arg == "--run") {
+            flags.run = true;
+        }
+        else if (arg == "--prune") {
+            flags.prune = talos::Pruning::Unreachable;
+        }
+        else if (arg == "--prune=parse") {
+            flags.prune = talos::Pruning::BeforeParsing;
+        }
+        else if (arg == "--lsp") {
+            flags.lsp = true;
+        }
+        else if (arg.starts_with("--cache=")) {
+            flags.cache_directory = arg.substr(std::string_view{"--cache="}.size());
+        }
+        else if (arg.starts_with("--cache-size=")) {
+            const auto value = arg.substr(std::string_view{"--cache-size="}.size());
+            auto megabytes = std::uint64_t{};
+            const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), megabytes);
+            if (error != std::errc{} || end != value.data() + value.size()) {
+                std::cerr << "Invalid cache size '" << arg << "'. Expected a number of MiB\n";
+                return -1;
+            }
+            flags.cache_max_size = megabytes * 1024 * 1024;
+        }
+        else if (arg.starts_with("--server=")) {
+            flags.server_socket = arg.substr(std::string_view{"--server="}.size());
+        }
+        else if (arg.starts_with("--connect=")) {
+            flags.connect_socket = arg.substr(std::string_view{"--connect="}.size());
+        }
+        else if (arg.starts_with("--stop-server=")) {
+            flags.stop_socket = arg.substr(std::string_view{"--stop-server="}.size());
+        }
+        else if (arg == "--dump-ast") {
+            flags.dump_ast = talos::DumpFormat::Text;
+        }
+        else if (arg.starts_with("--dump-ast=")) {
+            const auto format = talos::parse_dump_format(arg.substr(std::string_view{"--dump-ast="}.size()));
+            if (!format) {
+                std::cerr << "Invalid AST dump format '" << arg << "'. Expected none, text, json or binary\n";
+                return -1;
+            }
+            flags.dump_ast = *format;
+        }
+        else if (arg.starts_with("--trace=")) {
+            flags.trace_file = arg.substr(std::string_view{"--trace="}.size());
+        }
+        else if (!arg.starts_with("--") && filename == nullptr) {
+            filename = argv[i];
+        }
+        else {
+            std::cerr << "Invalid arguments. Usage:\ntalos [build] [--time-phases] [--stats] [--pipeline-lexer] [--stream] [--per-function] [--run] [--prune[=parse]] [--cache=dir] [--cache-size=MiB] [--lsp] [--server=socket] [--connect=socket] [--stop-server=socket] [--dump-ast[=text|json|binary]] [--emit=asm] [-o file] [--trace=file] [filename|-]\n";
+            return -1;
+        }
     }
-    else if (argc == 2) {
-        return run_file(talos_vm, argv[1]);
+
+    if ((flags.time_phases || flags.stats) && !talos::stats_enabled) {
+        std::cerr << "Statistics are unavailable, talos was built without TALOS_STATS\n";
+        flags.time_phases = false;
+        flags.stats = false;
     }
-    std::cerr << "Invalid arguments. Usage:\ntalos [filename]\n";
-    return -1;
+
+    // The cache only holds parsed and dumped declarations, not checked or
+    // compiled ones, so it would silently do nothing
+    if (!flags.cache_directory.empty() && (flags.run || flags.native != talos::NativeOutput::None)) {
+        std::cerr << "--cache only caches parsing and dumping, it cannot be combined with --run, build or --emit\n";
+        return -1;
+    }
+
+    if (!flags.trace_file.empty()) {
+        talos::trace::start();
+        talos::trace::set_thread_name("main");
+    }
+
+    // The compile server only parses and dumps, with none of the options of a
+    // CompileRequest beyond the dump format, per_function and the pipelined
+    // lexer. Anything else is done locally rather than ignored
+    const auto forward = filename != nullptr && !flags.connect_socket.empty() && !flags.run && flags.native == talos::NativeOutput::None &&
+                         flags.prune == talos::Pruning::None && !flags.stats && !flags.time_phases && !flags.stream && flags.cache_directory.empty();
+    auto return_code = 0;
+    if (flags.lsp) {
+        // Language server protocol over stdin and stdout
+        return_code = talos::lsp::serve_stdio(stdin, stdout);
+    }
+    else if (!flags.server_socket.empty() || !flags.stop_socket.empty()) {
+        return_code = run_server(flags);
+    }
+    else if (flags.native != talos::NativeOutput::None && filename == nullptr) {
+        std::cerr << "Compiling to native code needs a filename\n";
+        return_code = -1;
+    }
+    else if (const auto remote = forward ? run_on_server(filename, flags) : std::nullopt) {
+        return_code = *remote;
+    }
+    else {
+        // Also the fallback when no compile server is running
+        auto talos_vm = talos::TalosVM{talos::VMOptions{
+            .collect_stats = flags.time_phases || flags.stats,
+            .dump_ast = flags.dump_ast,
+            .pipeline_lexer = flags.pipeline_lexer,
+            .stream_chunk_size = flags.stream ? talos::VMOptions::default_stream_chunk_size : 0,
+            .per_function = flags.per_function,
+            .cache_directory = flags.cache_directory,
+            .cache_max_size = flags.cache_max_size,
+            .run = flags.run,
+            .native = flags.native,
+            .native_output = flags.output,
+            .prune = flags.prune,
+        }};
+        return_code = filename == nullptr ? run_repl(talos_vm, flags) : run_file(talos_vm, filename, flags);
+    }
+
+    if (!flags.trace_file.empty() && !talos::trace::stop(flags.trace_file)) {
+        std::cerr << "Could not write trace to '" << flags.trace_file << "'\n";
+    }
+    return return_code;
 }
@@ -0,0 +1,902 @@
+#include "assembly.h"
+
+#include "register_allocator.h"
+#include "return_code.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace talos
+{
+    namespace
+    {
+        // Labels of the constants that functions share
+        struct DataLabels {
+            std::unordered_map<const std::string*, std::size_t> strings;
+            std::unordered_map<const std::byte*, std::size_t> arrays;
+        };
+
+        // Call to talos_fail after the code of the function, which a failed
+        // check jumps to with the index it checked in %rdx
+        struct Failure {
+            ReturnCode code;
+            // As the interpreter would report it. A printf format of the index
+            // for IndexOutOfBounds
+            std::string message;
+        };
+
+        // text as the operand of .ascii
+        std::string quoted(std::string_view text)
+        {
+            auto result = std::string{"\""};
+            for (const auto c : text) {
+                const auto byte = static_cast<unsigned char>(c);
+                if (c == '"' || c == '\\') {
+                    result.push_back('\\');
+                    result.push_back(c);
+                }
+                else if (byte < 0x20 || byte >= 0x7F) {
+                    result += fmt::format("\\{:03o}", byte);
+                }
+                else {
+                    result.push_back(c);
+                }
+            }
+            result.push_back('"');
+            return result;
+        }
+
+        // Names of the machine registers allocate_registers assigns, those
+        // that functions preserve first
+        constexpr auto machine_registers = std::array<std::string_view, max_machine_registers>{"%rbp", "%r14", "%r15", "%r10", "%r11"};
+        constexpr std::size_t preserved_registers = 3;
+
+        std::string function_label(std::size_t index)
+        {
+            return fmt::format("talos_fn{}", index);
+        }
+
+        // Frame slot of register r of the running function
+        std::string slot(std::uint32_t r)
+        {
+            return fmt::format("{}(%rbx)", std::uint64_t{8} * r);
+        }
+
+        // A struct is returned as its first scalar, see Interpreter::run
+        Type result_type(const Program& program, Type type)
+        {
+            if (is_struct(type)) {
+                const auto& slots = program.structs[struct_index(type)].slots;
+                return slots.empty() ? Type::Void : slots.front().type;
+            }
+            return type;
+        }
+
+        // The low bytes of a 64-bit register, which are named differently for
+        // the registers x86-64 added
+        std::string narrow(std::string_view reg, std::size_t bytes)
+        {
+            if (reg.size() > 2 && reg[2] >= '0' && reg[2] <= '9') {
+                return fmt::format("{}{}", reg, bytes == 4 ? "d" : bytes == 2 ? "w" : "b");
+            }
+            const auto name = reg.substr(2);
+            switch (bytes) {
+                case 4:
+                    return fmt::format("%e{}", name);
+                case 2:
+                    return fmt::format("%{}", name);
+                default:
+                    return name.ends_with('x') ? fmt::format("%{}l", name.substr(0, 1)) : fmt::format("%{}l", name);
+            }
+        }
+
+        // Suffix of the scaled index addressing elements of the given size,
+        // which must be 1, 2, 4 or 8
+        std::string_view scale(std::size_t size)
+        {
+            switch (size) {
+                case 2:
+                    return ",2";
+                case 4:
+                    return ",4";
+                case 8:
+                    return ",8";
+                default:
+                    return "";
+            }
+        }
+
+        class FunctionEmitter
+        {
+        public:
+            FunctionEmitter(const Program& program, const DataLabels& data, std::uint32_t index, const AssemblyOptions& options, fmt::memory_buffer& text,
+                            fmt::memory_buffer& rodata)
+                : program_(program),
+                  data_(data),
+                  index_(index),
+                  function_(program.functions[index]),
+                  text_(text),
+                  rodata_(rodata)
+            {
+                const auto count = std::min(options.machine_registers, max_machine_registers);
+                allocation_ = allocate_registers(program, function_, RegisterFile{.count = count, .preserved = std::min(count, preserved_registers)});
+                for (std::size_t m = 0; m < std::min(count, preserved_registers); ++m) {
+                    if (allocation_.used[m]) {
+                        saved_.push_back(machine_registers[m]);
+                    }
+                }
+            }
+
+            void emit()
+            {
+                auto targets = std::vector<bool>(function_.code.size() + 1, false);
+                for (const auto& instruction : function_.code) {
+                    if (const auto target = jump_target(instruction)) {
+                        targets[*target] = true;
+                    }
+                }
+
+                const auto label = function_label(index_);
+                raw("\n# fun {}\n\t.p2align 4\n\t.type {}, @function\n{}:\n", function_.name, label, label);
+                for (const auto name : saved_) {
+                    line("pushq {}", name);
+                }
+                // Aligns the stack for the calls into the runtime
+                if (saved_.size() % 2 == 0) {
+                    line("subq $8, %rsp");
+                }
+                for (const auto r : allocation_.live_in) {
+                    line("movq {}, {}", slot(r), operand(r));
+                }
+                for (std::size_t i = 0; i < function_.code.size(); ++i) {
+                    if (targets[i]) {
+                        raw(".L{}_{}:\n", index_, i);
+                    }
+                    current_ = i;
+                    instruction(i);
+                }
+                if (targets.back()) {
+                    raw(".L{}_{}:\n", index_, function_.code.size());
+                }
+                for (std::size_t i = 0; i < failures_.size(); ++i) {
+                    raw(".L{}_fail{}:\n", index_, i);
+                    line("movl ${}, %edi", static_cast<int>(failures_[i].code));
+                    line("leaq .L{}_message{}(%rip), %rsi", index_, i);
+                    line("call talos_fail");
+                    fmt::format_to(std::back_inserter(rodata_), ".L{}_message{}:\n\t.asciz {}\n", index_, i, quoted(failures_[i].message));
+                }
+                raw("\t.size {}, .-{}\n", label, label);
+            }
+
+            void add_stats(AssemblyStats& stats) const
+            {
+                stats.candidates += allocation_.candidates;
+                stats.spills += allocation_.spills;
+                stats.coalesced_moves += allocation_.coalesced_moves;
+                stats.instructions += instructions_;
+            }
+
+        private:
+            template<typename... Args>
+            void raw(fmt::format_string<Args...> format, Args&&... args)
+            {
+                fmt::format_to(std::back_inserter(text_), format, std::forward<Args>(args)...);
+            }
+
+            template<typename... Args>
+            void line(fmt::format_string<Args...> format, Args&&... args)
+            {
+                ++instructions_;
+                text_.push_back('\t');
+                fmt::format_to(std::back_inserter(text_), format, std::forward<Args>(args)...);
+                text_.push_back('\n');
+            }
+
+            static std::optional<std::size_t> jump_target(const Instruction& instruction)
+            {
+                switch (instruction.op) {
+                    case OpCode::Jump:
+                        return instruction.a;
+                    case OpCode::JumpIfTrue:
+                    case OpCode::JumpIfFalse:
+                        return instruction.b;
+                    case OpCode::JumpIfEqual:
+                    case OpCode::JumpIfNotEqual:
+                    case OpCode::JumpIfLess:
+                    case OpCode::JumpIfNotLess:
+                    case OpCode::JumpIfLessEqual:
+                    case OpCode::JumpIfNotLessEqual:
+                        return instruction.c;
+                    default:
+                        return std::nullopt;
+                }
+            }
+
+            std::string target(std::size_t instruction) const
+            {
+                return fmt::format(".L{}_{}", index_, instruction);
+            }
+
+            // Where the instruction being emitted reads register r, a machine
+            // register or its frame slot
+            std::string operand(Register r) const { return place(r, allocation_.read(r, current_)); }
+
+            // Where it writes register r
+            std::string result(Register r) const { return place(r, allocation_.written(r, current_)); }
+
+            static std::string place(Register r, std::uint8_t location)
+            {
+                return location == RegisterAllocation::in_frame ? slot(r) : std::string{machine_registers[location]};
+            }
+
+            static bool is_register(std::string_view place) { return place.starts_with('%'); }
+
+            // Copies a word, through %rax unless either end is a register
+            void move(const std::string& from, const std::string& to)
+            {
+                if (from == to) {
+                    return;
+                }
+                if (is_register(from) || is_register(to)) {
+                    line("movq {}, {}", from, to);
+                    return;
+                }
+                line("movq {}, %rax", from);
+                line("movq %rax, {}", to);
+            }
+
+            // Register r if it is in one, or r loaded into scratch
+            std::string load(Register r, std::string_view scratch)
+            {
+                auto from = operand(r);
+                if (is_register(from)) {
+                    return from;
+                }
+                line("movq {}, {}", from, scratch);
+                return std::string{scratch};
+            }
+
+            void load_float(Register r, std::string_view xmm)
+            {
+                const auto from = operand(r);
+                line("{} {}, {}", is_register(from) ? "movq" : "movsd", from, xmm);
+            }
+
+            // Operand of an instruction on scalar doubles, which cannot be a
+            // general purpose register
+            std::string float_operand(Register r)
+            {
+                auto from = operand(r);
+                if (!is_register(from)) {
+                    return from;
+                }
+                line("movq {}, %xmm1", from);
+                return "%xmm1";
+            }
+
+            void store_float(Register r)
+            {
+                const auto to = result(r);
+                line("{} %xmm0, {}", is_register(to) ? "movq" : "movsd", to);
+            }
+
+            // Restores the saved registers and returns
+            void epilogue()
+            {
+                if (saved_.size() % 2 == 0) {
+                    line("addq $8, %rsp");
+                }
+                for (auto name = saved_.rbegin(); name != saved_.rend(); ++name) {
+                    line("popq {}", *name);
+                }
+                line("ret");
+            }
+
+            // Label of a new failure of the instruction at index
+            std::string fail(std::size_t index, ReturnCode code, std::string_view message)
+            {
+                const auto location = function_.locations[index];
+                failures_.push_back(Failure{.code = code, .message = fmt::format("{} ({}): {}", return_code_str(code), location, message)});
+                return fmt::format(".L{}_fail{}", index_, failures_.size() - 1);
+            }
+
+            // Sign extends reg, %rax unless given, from the width of integer type
+            void wrap(Type type, std::string_view reg = "%rax")
+            {
+                switch (type) {
+                    case Type::Int8:
+                        line("movsbq {}, {}", narrow(reg, 1), reg);
+                        break;
+                    case Type::Int16:
+                        line("movswq {}, {}", narrow(reg, 2), reg);
+                        break;
+                    case Type::Int32:
+                        line("movslq {}, {}", narrow(reg, 4), reg);
+                        break;
+                    default:
+                        break;
+                }
+            }
+
+            // Rounds %xmm0 to the precision of floating point type
+            void round(Type type)
+            {
+                if (type == Type::Float32) {
+                    line("cvtsd2ss %xmm0, %xmm0");
+                    line("cvtss2sd %xmm0, %xmm0");
+                }
+            }
+
+            void load_constant(Register target, const Value& value)
+            {
+                if (is_array(value.type) || value.type == Type::String) {
+                    const auto word = value.word();
+                    const auto target_place = result(target);
+                    const auto to = is_register(target_place) ? target_place : std::string{"%rax"};
+                    if (value.type == Type::String) {
+                        line("leaq .Lstring{}(%rip), {}", data_.strings.at(word.string), to);
+                    }
+                    else {
+                        line("leaq .Larray{}(%rip), {}", data_.arrays.at(word.elements), to);
+                    }
+                    move(to, target_place);
+                    return;
+                }
+                // Floats as their bits
+                const auto bits = value.word().integer;
+                if (bits >= std::numeric_limits<std::int32_t>::min() && bits <= std::numeric_limits<std::int32_t>::max()) {
+                    line("movq ${}, {}", bits, result(target));
+                    return;
+                }
+                const auto target_place = result(target);
+                const auto to = is_register(target_place) ? target_place : std::string{"%rax"};
+                line("movabsq ${}, {}", bits, to);
+                move(to, target_place);
+            }
+
+            void arithmetic(std::size_t index, const Instruction& instruction)
+            {
+                const auto type = operand_type(instruction);
+                if (is_floating(type)) {
+                    static constexpr auto mnemonics = std::array{"addsd", "subsd", "mulsd", "divsd", "divsd"};
+                    load_float(instruction.b, "%xmm0");
+                    line("{} {}, %xmm0", mnemonics[static_cast<std::size_t>(instruction.op) - static_cast<std::size_t>(OpCode::Add)], float_operand(instruction.c));
+                    round(type);
+                    store_float(instruction.a);
+                    return;
+                }
+                switch (instruction.op) {
+                    case OpCode::Add:
+                    case OpCode::Subtract:
+                    case OpCode::Multiply: {
+                        const auto mnemonic = instruction.op == OpCode::Add ? "addq" : instruction.op == OpCode::Subtract ? "subq" : "imulq";
+                        // Computed in the register of the result if it does not hold the other operand
+                        const auto to = result(instruction.a);
+                        if (is_register(to) && to != operand(instruction.c)) {
+                            move(operand(instruction.b), to);
+                            line("{} {}, {}", mnemonic, operand(instruction.c), to);
+                            wrap(type, to);
+                            return;
+                        }
+                        line("movq {}, %rax", operand(instruction.b));
+                        line("{} {}, %rax", mnemonic, operand(instruction.c));
+                        break;
+                    }
+                    default: {
+                        line("movq {}, %rcx", operand(instruction.c));
+                        line("testq %rcx, %rcx");
+                        line("jz {}", fail(index, ReturnCode::DivisionByZero, fmt::format("Division by zero in '{}'", function_.name)));
+                        line("movq {}, %rax", operand(instruction.b));
+                        // idiv traps on the only quotient that overflows, which wraps around instead
+                        line("cmpq $-1, %rcx");
+                        line("jne 1f");
+                        line("{}", instruction.op == OpCode::Divide ? "negq %rax" : "xorl %eax, %eax");
+                        line("jmp 2f");
+                        raw("1:\n");
+                        line("cqto");
+                        line("idivq %rcx");
+                        if (instruction.op == OpCode::Modulo) {
+                            line("movq %rdx, %rax");
+                        }
+                        raw("2:\n");
+                        break;
+                    }
+                }
+                wrap(type);
+                line("movq %rax, {}", result(instruction.a));
+            }
+
+            void compare(const Instruction& instruction)
+            {
+                const auto type = operand_type(instruction);
+                if (!is_floating(type)) {
+                    static constexpr auto conditions = std::array{"e", "ne", "l", "le"};
+                    line("cmpq {}, {}", operand(instruction.c), load(instruction.b, "%rax"));
+                    line("set{} %al", conditions[static_cast<std::size_t>(instruction.op) - static_cast<std::size_t>(OpCode::Equal)]);
+                }
+                else {
+                    // Unordered operands set the parity flag, and the carry flag
+                    // that the swapped operands of Less and LessEqual test
+                    switch (instruction.op) {
+                        case OpCode::Equal:
+                        case OpCode::NotEqual: {
+                            const auto equal = instruction.op == OpCode::Equal;
+                            load_float(instruction.b, "%xmm0");
+                            line("ucomisd {}, %xmm0", float_operand(instruction.c));
+                            line("{}", equal ? "sete %al" : "setne %al");
+                            line("{}", equal ? "setnp %cl" : "setp %cl");
+                            line("{}", equal ? "andb %cl, %al" : "orb %cl, %al");
+                            break;
+                        }
+                        default:
+                            load_float(instruction.c, "%xmm0");
+                            line("ucomisd {}, %xmm0", float_operand(instruction.b));
+                            line("{}", instruction.op == OpCode::Less ? "seta %al" : "setae %al");
+                            break;
+                    }
+                }
+                line("movzbl %al, %eax");
+                line("movq %rax, {}", result(instruction.a));
+            }
+
+            void compare_jump(const Instruction& instruction)
+            {
+                const auto type = operand_type(instruction);
+                const auto to = target(instruction.c);
+                const auto op = static_cast<std::size_t>(instruction.op) - static_cast<std::size_t>(OpCode::JumpIfEqual);
+                if (!is_floating(type)) {
+                    static constexpr auto conditions = std::array{"e", "ne", "l", "ge", "le", "g"};
+                    line("cmpq {}, {}", operand(instruction.b), load(instruction.a, "%rax"));
+                    line("j{} {}", conditions[op], to);
+                    return;
+                }
+                switch (instruction.op) {
+                    case OpCode::JumpIfEqual:
+                        load_float(instruction.a, "%xmm0");
+                        line("ucomisd {}, %xmm0", float_operand(instruction.b));
+                        line("jp 1f");
+                        line("je {}", to);
+                        raw("1:\n");
+                        break;
+                    case OpCode::JumpIfNotEqual:
+                        load_float(instruction.a, "%xmm0");
+                        line("ucomisd {}, %xmm0", float_operand(instruction.b));
+                        line("jp {}", to);
+                        line("jne {}", to);
+                        break;
+                    default: {
+                        // b > a and b >= a, and their negations that are true for NaN
+                        static constexpr auto conditions = std::array{"", "", "a", "be", "ae", "b"};
+                        load_float(instruction.b, "%xmm0");
+                        line("ucomisd {}, %xmm0", float_operand(instruction.a));
+                        line("j{} {}", conditions[op], to);
+                        break;
+                    }
+                }
+            }
+
+            void call(std::size_t index, const Instruction& instruction)
+            {
+                const auto& callee = program_.functions[instruction.b];
+                const auto overflow = fail(index, ReturnCode::StackOverflow, fmt::format("Calling from '{}' exceeds the VM stack", function_.name));
+                line("leaq {}(%rbx), %rax", std::uint64_t{8} * (std::uint64_t{instruction.a} + callee.register_count));
+                line("cmpq talos_stack_limit(%rip), %rax");
+                line("ja {}", overflow);
+                if (callee.memory_size != 0) {
+                    line("leaq {}(%r12), %rax", function_.memory_size + callee.memory_size);
+                    line("cmpq talos_memory_limit(%rip), %rax");
+                    line("ja {}", overflow);
+                }
+                line("decq %r13");
+                line("jz {}", overflow);
+                // The callee finds its arguments in its frame, and leaves its result there
+                for (Register r = instruction.a; r < instruction.a + instruction.c; ++r) {
+                    move(operand(r), slot(r));
+                }
+                const auto base_offset = std::uint64_t{8} * instruction.a;
+                if (base_offset != 0) {
+                    line("addq ${}, %rbx", base_offset);
+                }
+                if (function_.memory_size != 0) {
+                    line("addq ${}, %r12", function_.memory_size);
+                }
+                line("call {}", function_label(instruction.b));
+                if (base_offset != 0) {
+                    line("subq ${}, %rbx", base_offset);
+                }
+                if (function_.memory_size != 0) {
+                    line("subq ${}, %r12", function_.memory_size);
+                }
+                line("incq %r13");
+                for (std::size_t i = 0; i < result_slots(program_, callee); ++i) {
+                    const auto r = static_cast<Register>(instruction.a + i);
+                    move(slot(r), result(r));
+                }
+            }
+
+            void load_index(const Instruction& instruction)
+            {
+                const auto element = operand_type(instruction);
+                const auto array = load(instruction.b, "%rax");
+                load_element(element, instruction.a, fmt::format("({},{}{})", array, load(instruction.c, "%rcx"), scale(scalar_size(element))));
+            }
+
+            // Address of the scalar in column of the element of the array in
+            // register array at the index in register index, through %rax and %rcx
+            std::string column_address(const ColumnLayout& column, Register array, Register index)
+            {
+                const auto elements = load(array, "%rax");
+                const auto displacement = column.offset != 0 ? fmt::format("{}", column.offset) : std::string{};
+                if (column.stride == 1 || column.stride == 2 || column.stride == 4 || column.stride == 8) {
+                    return fmt::format("{}({},{}{})", displacement, elements, load(index, "%rcx"), scale(column.stride));
+                }
+                line("imulq ${}, {}, %rcx", column.stride, operand(index));
+                return fmt::format("{}({},%rcx)", displacement, elements);
+            }
+
+            // Loads the scalar of element type at address into register r
+            void load_element(Type element, Register r, std::string_view address)
+            {
+                const auto to = result(r);
+                const auto value = is_register(to) ? to : std::string{"%rdx"};
+                switch (element) {
+                    case Type::Int8:
+                    case Type::Char:
+                        line("movsbq {}, {}", address, value);
+                        break;
+                    case Type::Bool:
+                        line("movzbl {}, {}", address, narrow(value, 4));
+                        break;
+                    case Type::Int16:
+                        line("movswq {}, {}", address, value);
+                        break;
+                    case Type::Int32:
+                        line("movslq {}, {}", address, value);
+                        break;
+                    case Type::Float32:
+                        line("cvtss2sd {}, %xmm0", address);
+                        store_float(r);
+                        return;
+                    default:
+                        line("movq {}, {}", address, value);
+                        break;
+                }
+                move(value, to);
+            }
+
+            // Stores the scalar of element type in %rdx, or in %xmm0 as an f32,
+            // to address
+            void store_element(Type element, std::string_view address)
+            {
+                switch (element) {
+                    case Type::Int8:
+                    case Type::Char:
+                    case Type::Bool:
+                        line("movb %dl, {}", address);
+                        break;
+                    case Type::Int16:
+                        line("movw %dx, {}", address);
+                        break;
+                    case Type::Int32:
+                        line("movl %edx, {}", address);
+                        break;
+                    case Type::Float32:
+                        line("movss %xmm0, {}", address);
+                        break;
+                    default:
+                        line("movq %rdx, {}", address);
+                        break;
+                }
+            }
+
+            // Loads register r into %rdx, or %xmm0, as store_element takes it
+            void load_element_value(Type element, Register r)
+            {
+                if (element == Type::Float32) {
+                    load_float(r, "%xmm0");
+                    line("cvtsd2ss %xmm0, %xmm0");
+                    return;
+                }
+                line("movq {}, %rdx", operand(r));
+                if (element == Type::Bool) {
+                    line("testq %rdx, %rdx");
+                    line("setne %dl");
+                }
+            }
+
+            void instruction(std::size_t index)
+            {
+                const auto& instruction = function_.code[index];
+                switch (instruction.op) {
+                    case OpCode::LoadConst:
+                        load_constant(instruction.a, function_.constants[instruction.b]);
+                        break;
+                    case OpCode::Move:
+                        move(operand(instruction.b), result(instruction.a));
+                        break;
+                    case OpCode::LoadGlobal:
+                        move(fmt::format(".Lglobals+{}(%rip)", std::uint64_t{8} * instruction.b), result(instruction.a));
+                        break;
+                    case OpCode::StoreGlobal:
+                        move(operand(instruction.b), fmt::format(".Lglobals+{}(%rip)", std::uint64_t{8} * instruction.a));
+                        break;
+                    case OpCode::Add:
+                    case OpCode::Subtract:
+                    case OpCode::Multiply:
+                    case OpCode::Divide:
+                    case OpCode::Modulo:
+                        arithmetic(index, instruction);
+                        break;
+                    case OpCode::Equal:
+                    case OpCode::NotEqual:
+                    case OpCode::Less:
+                    case OpCode::LessEqual:
+                        compare(instruction);
+                        break;
+                    case OpCode::Negate: {
+                        const auto to = result(instruction.a);
+                        const auto value = is_register(to) ? to : std::string{"%rax"};
+                        move(operand(instruction.b), value);
+                        if (is_floating(operand_type(instruction))) {
+                            line("btcq $63, {}", value);
+                        }
+                        else {
+                            line("negq {}", value);
+                            wrap(operand_type(instruction), value);
+                        }
+                        move(value, to);
+                        break;
+                    }
+                    case OpCode::Not:
+                        line("cmpq $0, {}", operand(instruction.b));
+                        line("sete %al");
+                        line("movzbl %al, %eax");
+                        line("movq %rax, {}", result(instruction.a));
+                        break;
+                    case OpCode::Jump:
+                        line("jmp {}", target(instruction.a));
+                        break;
+                    case OpCode::JumpIfTrue:
+                    case OpCode::JumpIfFalse:
+                        line("cmpq $0, {}", operand(instruction.a));
+                        line("{} {}", instruction.op == OpCode::JumpIfTrue ? "jne" : "je", target(instruction.b));
+                        break;
+                    case OpCode::JumpIfEqual:
+                    case OpCode::JumpIfNotEqual:
+                    case OpCode::JumpIfLess:
+                    case OpCode::JumpIfNotLess:
+                    case OpCode::JumpIfLessEqual:
+                    case OpCode::JumpIfNotLessEqual:
+                        compare_jump(instruction);
+                        break;
+                    case OpCode::Call:
+                        call(index, instruction);
+                        break;
+                    case OpCode::Return:
+                    case OpCode::ReturnSlots:
+                    case OpCode::ReturnVoid: {
+                        // The caller finds the result where it put the first argument
+                        const auto count = instruction.op == OpCode::Return ? 1U : instruction.op == OpCode::ReturnSlots ? std::uint32_t{instruction.b} : 0U;
+                        for (std::uint32_t i = 0; i < count; ++i) {
+                            move(operand(static_cast<Register>(instruction.a + i)), slot(i));
+                        }
+                        epilogue();
+                        break;
+                    }
+                    case OpCode::FrameArray: {
+                        const auto to = result(instruction.a);
+                        const auto scratch = is_register(to) ? to : std::string{"%rax"};
+                        line("leaq {}(%r12), {}", function_.constants[instruction.c].integer, scratch);
+                        move(scratch, to);
+                        break;
+                    }
+                    case OpCode::LoadIndex:
+                        load_index(instruction);
+                        break;
+                    case OpCode::StoreIndex: {
+                        const auto element = operand_type(instruction);
+                        load_element_value(element, instruction.c);
+                        const auto array = load(instruction.a, "%rax");
+                        store_element(element, fmt::format("({},{}{})", array, load(instruction.b, "%rcx"), scale(scalar_size(element))));
+                        break;
+                    }
+                    case OpCode::CheckIndex: {
+                        // Negative indexes are too large unsigned
+                        const auto length = program_.arrays[instruction.c].length;
+                        line("movq {}, %rdx", operand(instruction.b));
+                        line("cmpq ${}, %rdx", length);
+                        line("jae {}", fail(index, ReturnCode::IndexOutOfBounds, fmt::format("Index %lld is outside of an array of length {} in '{}'", length, function_.name)));
+                        break;
+                    }
+                    case OpCode::CopyArray:
+                        if (const auto size = program_.arrays[instruction.c].size; size != 0) {
+                            line("movq {}, %rdi", operand(instruction.a));
+                            line("movq {}, %rsi", operand(instruction.b));
+                            line("movq ${}, %rdx", size);
+                            line("call memmove@PLT");
+                        }
+                        break;
+                    case OpCode::FillArray: {
+                        const auto& layout = program_.arrays[instruction.c];
+                        if (layout.length == 0) {
+                            break;
+                        }
+                        load_element_value(layout.element, instruction.b);
+                        line("movq {}, %rax", operand(instruction.a));
+                        line("xorl %ecx, %ecx");
+                        raw("1:\n");
+                        store_element(layout.element, fmt::format("(%rax,%rcx{})", scale(scalar_size(layout.element))));
+                        line("incq %rcx");
+                        line("cmpq ${}, %rcx", layout.length);
+                        line("jb 1b");
+                        break;
+                    }
+                    case OpCode::LoadColumn: {
+                        const auto& extra = function_.code[index + 1];
+                        const auto& column = program_.arrays[extra.a].columns[extra.b];
+                        load_element(column.type, instruction.a, column_address(column, instruction.b, instruction.c));
+                        break;
+                    }
+                    case OpCode::StoreColumn: {
+                        const auto& extra = function_.code[index + 1];
+                        const auto& column = program_.arrays[extra.a].columns[extra.b];
+                        load_element_value(column.type, instruction.c);
+                        store_element(column.type, column_address(column, instruction.a, instruction.b));
+                        break;
+                    }
+                    case OpCode::FillColumn: {
+                        const auto& extra = function_.code[index + 1];
+                        const auto& layout = program_.arrays[extra.a];
+                        const auto& column = layout.columns[extra.b];
+                        if (layout.length == 0) {
+                            break;
+                        }
+                        load_element_value(column.type, instruction.b);
+                        line("movq {}, %rax", operand(instruction.a));
+                        if (column.offset != 0) {
+                            line("addq ${}, %rax", column.offset);
+                        }
+                        line("xorl %ecx, %ecx");
+                        raw("1:\n");
+                        store_element(column.type, "(%rax)");
+                        line("addq ${}, %rax", column.stride);
+                        line("incq %rcx");
+                        line("cmpq ${}, %rcx", layout.length);
+                        line("jb 1b");
+                        break;
+                    }
+                    case OpCode::VecAdd:
+                    case OpCode::VecSubtract:
+                    case OpCode::VecMultiply:
+                    case OpCode::VecDivide: {
+                        const auto& layout = program_.arrays[function_.code[index + 1].a];
+                        line("movl ${}, %edi", static_cast<int>(instruction.op) - static_cast<int>(OpCode::VecAdd));
+                        line("movl ${}, %esi", static_cast<int>(layout.element));
+                        line("movq {}, %rdx", operand(instruction.a));
+                        line("movq {}, %rcx", operand(instruction.b));
+                        line("movq {}, %r8", operand(instruction.c));
+                        line("movq ${}, %r9", layout.length);
+                        line("call talos_vector");
+                        line("testb %al, %al");
+                        line("jz {}", fail(index, ReturnCode::DivisionByZero, fmt::format("Division by zero in '{}'", function_.name)));
+                        break;
+                    }
+                    case OpCode::ExtraArg:
+                        break;
+                }
+            }
+
+            const Program& program_;
+            const DataLabels& data_;
+            std::uint32_t index_;
+            const Function& function_;
+            fmt::memory_buffer& text_;
+            fmt::memory_buffer& rodata_;
+            std::vector<Failure> failures_;
+            RegisterAllocation allocation_;
+            // Preserved machine registers the function uses, which it saves
+            std::vector<std::string_view> saved_;
+            std::size_t instructions_ = 0;
+            // Index of the instruction being emitted
+            std::size_t current_ = 0;
+        };
+
+        // Sets up the frames and globals, runs the initializer and main and
+        // returns the integer main returns, or 0
+        void emit_start(const Program& program, fmt::memory_buffer& text, fmt::memory_buffer& rodata)
+        {
+            const auto output = std::back_inserter(text);
+            fmt::format_to(output, "\n\t.p2align 4\n\t.globl talos_start\n\t.type talos_start, @function\ntalos_start:\n");
+            fmt::format_to(output, "\tpushq %rbx\n\tpushq %r12\n\tpushq %r13\n");
+            fmt::format_to(output, "\tmovq %rdi, %rbx\n\tmovq %rsi, %r12\n\tmovq %rdx, %r13\n");
+            auto offset = std::size_t{0};
+            for (std::size_t i = 0; i < program.globals.size(); ++i) {
+                if (is_array(program.globals[i])) {
+                    fmt::format_to(output, "\tleaq .Lglobal_memory+{}(%rip), %rax\n\tmovq %rax, .Lglobals+{}(%rip)\n", offset, 8 * i);
+                    offset += program.arrays[array_index(program.globals[i])].aligned_size();
+                }
+            }
+            auto entries = std::vector<std::uint32_t>{program.initializer};
+            if (program.main) {
+                entries.push_back(*program.main);
+            }
+            for (const auto entry : entries) {
+                const auto& function = program.functions[entry];
+                fmt::format_to(output, "\tleaq {}(%rbx), %rax\n\tcmpq talos_stack_limit(%rip), %rax\n\tja .Lentry_fail{}\n", 8 * std::size_t{function.register_count}, entry);
+                fmt::format_to(output, "\tleaq {}(%r12), %rax\n\tcmpq talos_memory_limit(%rip), %rax\n\tja .Lentry_fail{}\n", function.memory_size, entry);
+                fmt::format_to(output, "\tcall {}\n", function_label(entry));
+            }
+            const auto main_type = program.main ? result_type(program, program.functions[*program.main].return_type) : Type::Void;
+            fmt::format_to(output, "\t{}\n", is_integer(main_type) ? "movq (%rbx), %rax" : "xorl %eax, %eax");
+            fmt::format_to(output, "\tpopq %r13\n\tpopq %r12\n\tpopq %rbx\n\tret\n");
+            for (const auto entry : entries) {
+                fmt::format_to(output, ".Lentry_fail{}:\n\tmovl ${}, %edi\n\tleaq .Lentry_message{}(%rip), %rsi\n\tcall talos_fail\n", entry,
+                               static_cast<int>(ReturnCode::StackOverflow), entry);
+                const auto message = fmt::format("{} ({}): '{}' does not fit on the VM stack", return_code_str(ReturnCode::StackOverflow), SourceLocation{},
+                                                 program.functions[entry].name);
+                fmt::format_to(std::back_inserter(rodata), ".Lentry_message{}:\n\t.asciz {}\n", entry, quoted(message));
+            }
+            fmt::format_to(output, "\t.size talos_start, .-talos_start\n");
+        }
+    } // namespace
+
+    std::string emit_assembly(const Program& program, const AssemblyOptions& options, AssemblyStats* stats)
+    {
+        auto text = fmt::memory_buffer{};
+        auto rodata = fmt::memory_buffer{};
+        const auto data_output = std::back_inserter(rodata);
+
+        // Constants first, so that functions can refer to their labels
+        auto data = DataLabels{};
+        for (const auto& string : program.strings) {
+            const auto label = data.strings.size();
+            data.strings.emplace(&string, label);
+            fmt::format_to(data_output, ".Lstring{}:\n\t.asciz {}\n", label, quoted(string));
+        }
+        for (const auto& elements : program.array_constants) {
+            const auto label = data.arrays.size();
+            data.arrays.emplace(elements.data(), label);
+            fmt::format_to(data_output, "\t.p2align 5\n.Larray{}:\n", label);
+            constexpr auto bytes_per_line = std::size_t{32};
+            for (std::size_t i = 0; i < elements.size(); ++i) {
+                fmt::format_to(data_output, "{}{}", i % bytes_per_line == 0 ? "\t.byte " : ",", static_cast<unsigned>(elements[i]));
+                if (i % bytes_per_line == bytes_per_line - 1 || i + 1 == elements.size()) {
+                    rodata.push_back('\n');
+                }
+            }
+        }
+
+        fmt::format_to(std::back_inserter(text), "# Generated by talos\n\t.text\n");
+        for (std::uint32_t i = 0; i < program.functions.size(); ++i) {
+            auto emitter = FunctionEmitter{program, data, i, options, text, rodata};
+            emitter.emit();
+            if (stats != nullptr) {
+                emitter.add_stats(*stats);
+            }
+        }
+        emit_start(program, text, rodata);
+
+        auto global_memory = std::size_t{0};
+        for (const auto type : program.globals) {
+            if (is_array(type)) {
+                global_memory += program.arrays[array_index(type)].aligned_size();
+            }
+        }
+        const auto output = std::back_inserter(text);
+        fmt::format_to(output, "\n\t.section .rodata\n{}", fmt::to_string(rodata));
+        fmt::format_to(output, "\n\t.bss\n\t.p2align 5\n.Lglobals:\n\t.zero {}\n", std::max<std::size_t>(8 * program.globals.size(), 8));
+        fmt::format_to(output, "\t.p2align 5\n.Lglobal_memory:\n\t.zero {}\n", std::max<std::size_t>(global_memory, 8));
+        fmt::format_to(output, "\n\t.section .note.GNU-stack,\"\",@progbits\n");
+        return fmt::to_string(text);
+    }
+} // namespace talos
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "vm/bytecode.h"
+
+#include <cstddef>
+#include <string>
+
+namespace talos
+{
+    // Machine registers that can hold bytecode registers: %rbp, %r14 and %r15,
+    // which functions preserve, then %r10 and %r11
+    inline constexpr std::size_t max_machine_registers = 5;
+
+    struct AssemblyOptions {
+        // How many of the machine registers to allocate, 0 keeps every
+        // bytecode register in its frame slot
+        std::size_t machine_registers = max_machine_registers;
+    };
+
+    // Totals over all functions, see allocate_registers
+    struct AssemblyStats {
+        std::size_t candidates = 0;
+        std::size_t spills = 0;
+        std::size_t coalesced_moves = 0;
+        // Machine instructions in the functions
+        std::size_t instructions = 0;
+    };
+
+    // Lowers program to x86-64 assembly for the GNU assembler, in AT&T syntax
+    // and for the System V ABI. Each instruction becomes a few machine
+    // instructions on the same frames the interpreter uses: the registers of
+    // the running function are words at %rbx unless allocate_registers puts
+    // them in machine registers, the memory for its arrays is at %r12 and %r13
+    // counts the calls that may still be nested. Runtime errors and
+    // elementwise arithmetic call into the runtime, see runtime_source, whose
+    // main calls talos_start. Adds to stats if given
+    [[nodiscard]] std::string emit_assembly(const Program& program, const AssemblyOptions& options = {}, AssemblyStats* stats = nullptr);
+} // namespace talos
@@ -0,0 +1,543 @@
+#include "register_allocator.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <iterator>
+#include <limits>
+#include <optional>
+
+namespace talos
+{
+    namespace
+    {
+        // Index of the segment of list, sorted by start, that contains position
+        std::optional<std::size_t> find_segment(const std::vector<RegisterAllocation::Segment>& list, std::size_t position)
+        {
+            const auto found = std::upper_bound(list.begin(), list.end(), position, [](std::size_t p, const RegisterAllocation::Segment& segment) { return p < segment.start; });
+            if (found == list.begin() || std::prev(found)->end < position) {
+                return std::nullopt;
+            }
+            return static_cast<std::size_t>(std::prev(found) - list.begin());
+        }
+
+        // Registers an instruction reads and writes. Calls and multi-slot
+        // returns read or write a range of registers
+        struct Operands {
+            std::array<Register, 3> uses{};
+            std::size_t use_count = 0;
+            std::optional<Register> def;
+            Register range = 0;
+            std::size_t range_uses = 0;
+            std::size_t range_defs = 0;
+        };
+
+        Operands operands(const Program& program, const Instruction& instruction)
+        {
+            auto result = Operands{};
+            const auto use = [&](Register r) { result.uses[result.use_count++] = r; };
+            switch (instruction.op) {
+                case OpCode::LoadConst:
+                case OpCode::LoadGlobal:
+                case OpCode::FrameArray:
+                    result.def = instruction.a;
+                    break;
+                case OpCode::Move:
+                case OpCode::Negate:
+                case OpCode::Not:
+                    result.def = instruction.a;
+                    use(instruction.b);
+                    break;
+                case OpCode::StoreGlobal:
+                    use(instruction.b);
+                    break;
+                case OpCode::Add:
+                case OpCode::Subtract:
+                case OpCode::Multiply:
+                case OpCode::Divide:
+                case OpCode::Modulo:
+                case OpCode::Equal:
+                case OpCode::NotEqual:
+                case OpCode::Less:
+                case OpCode::LessEqual:
+                case OpCode::LoadIndex:
+                case OpCode::LoadColumn:
+                    result.def = instruction.a;
+                    use(instruction.b);
+                    use(instruction.c);
+                    break;
+                case OpCode::JumpIfTrue:
+                case OpCode::JumpIfFalse:
+                case OpCode::Return:
+                    use(instruction.a);
+                    break;
+                case OpCode::JumpIfEqual:
+                case OpCode::JumpIfNotEqual:
+                case OpCode::JumpIfLess:
+                case OpCode::JumpIfNotLess:
+                case OpCode::JumpIfLessEqual:
+                case OpCode::JumpIfNotLessEqual:
+                case OpCode::CheckIndex:
+                case OpCode::CopyArray:
+                case OpCode::FillArray:
+                case OpCode::FillColumn:
+                    use(instruction.a);
+                    use(instruction.b);
+                    break;
+                case OpCode::StoreIndex:
+                case OpCode::StoreColumn:
+                case OpCode::VecAdd:
+                case OpCode::VecSubtract:
+                case OpCode::VecMultiply:
+                case OpCode::VecDivide:
+                    use(instruction.a);
+                    use(instruction.b);
+                    use(instruction.c);
+                    break;
+                case OpCode::Call:
+                    result.range = instruction.a;
+                    result.range_uses = instruction.c;
+                    result.range_defs = result_slots(program, program.functions[instruction.b]);
+                    break;
+                case OpCode::ReturnSlots:
+                    result.range = instruction.a;
+                    result.range_uses = instruction.b;
+                    break;
+                case OpCode::Jump:
+                case OpCode::ReturnVoid:
+                case OpCode::ExtraArg:
+                    break;
+            }
+            return result;
+        }
+
+        // Instructions that call a function, which may change the registers
+        // that are not preserved
+        bool calls(OpCode op)
+        {
+            switch (op) {
+                case OpCode::Call:
+                case OpCode::CopyArray:
+                case OpCode::VecAdd:
+                case OpCode::VecSubtract:
+                case OpCode::VecMultiply:
+                case OpCode::VecDivide:
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+        std::optional<std::size_t> jump_target(const Instruction& instruction)
+        {
+            switch (instruction.op) {
+                case OpCode::Jump:
+                    return instruction.a;
+                case OpCode::JumpIfTrue:
+                case OpCode::JumpIfFalse:
+                    return instruction.b;
+                case OpCode::JumpIfEqual:
+                case OpCode::JumpIfNotEqual:
+                case OpCode::JumpIfLess:
+                case OpCode::JumpIfNotLess:
+                case OpCode::JumpIfLessEqual:
+                case OpCode::JumpIfNotLessEqual:
+                    return instruction.c;
+                default:
+                    return std::nullopt;
+            }
+        }
+
+        bool ends_block(OpCode op)
+        {
+            return op == OpCode::Jump || op == OpCode::Return || op == OpCode::ReturnSlots || op == OpCode::ReturnVoid;
+        }
+
+        // A set of registers, one bit each
+        class RegisterSet
+        {
+        public:
+            explicit RegisterSet(std::size_t size) : words_((size + 63) / 64, 0) {}
+
+            void insert(std::size_t r) { words_[r / 64] |= std::uint64_t{1} << (r % 64); }
+            void erase(std::size_t r) { words_[r / 64] &= ~(std::uint64_t{1} << (r % 64)); }
+            [[nodiscard]] bool contains(std::size_t r) const { return (words_[r / 64] >> (r % 64) & 1U) != 0; }
+
+            // this = uses | (this & ~defs), true if that added any register
+            bool merge(const RegisterSet& live_out, const RegisterSet& uses, const RegisterSet& defs)
+            {
+                auto changed = false;
+                for (std::size_t i = 0; i < words_.size(); ++i) {
+                    const auto word = uses.words_[i] | (live_out.words_[i] & ~defs.words_[i]);
+                    changed = changed || (word & ~words_[i]) != 0;
+                    words_[i] |= word;
+                }
+                return changed;
+            }
+
+            void unite(const RegisterSet& other)
+            {
+                for (std::size_t i = 0; i < words_.size(); ++i) {
+                    words_[i] |= other.words_[i];
+                }
+            }
+
+            template<typename F>
+            void for_each(F&& function) const
+            {
+                for (std::size_t i = 0; i < words_.size(); ++i) {
+                    for (auto word = words_[i]; word != 0; word &= word - 1) {
+                        function(i * 64 + static_cast<std::size_t>(std::countr_zero(word)));
+                    }
+                }
+            }
+
+        private:
+            std::vector<std::uint64_t> words_;
+        };
+
+        struct Block {
+            std::size_t begin = 0;
+            // One past the last instruction
+            std::size_t end = 0;
+            std::array<std::optional<std::size_t>, 2> successors;
+        };
+
+        // Positions are 2 * i where instruction i reads its operands and
+        // 2 * i + 1 where it writes its result, so that a value may take over
+        // the machine register of one that is last read where it is written.
+        // A segment is where a register is live within a block
+        struct Segment {
+            Register r = 0;
+            std::size_t start = 0;
+            std::size_t end = 0;
+            // Uses and definitions, weighted by loop depth
+            double cost = 0;
+            bool crosses_call = false;
+        };
+
+        // The segments of a web, the values that flow into the same uses
+        struct Interval {
+            std::size_t start = 0;
+            std::size_t end = 0;
+            double cost = 0;
+            bool crosses_call = false;
+
+            [[nodiscard]] double weight() const { return cost / static_cast<double>(end - start + 1); }
+        };
+
+        std::vector<Block> find_blocks(const Function& function)
+        {
+            const auto& code = function.code;
+            auto leaders = std::vector<bool>(code.size() + 1, false);
+            leaders[0] = true;
+            for (std::size_t i = 0; i < code.size(); ++i) {
+                if (const auto target = jump_target(code[i])) {
+                    leaders[*target] = true;
+                    leaders[i + 1] = true;
+                }
+                else if (ends_block(code[i].op)) {
+                    leaders[i + 1] = true;
+                }
+            }
+            auto blocks = std::vector<Block>{};
+            auto block_of = std::vector<std::size_t>(code.size() + 1, 0);
+            for (std::size_t i = 0; i < code.size(); ++i) {
+                if (leaders[i]) {
+                    blocks.push_back(Block{.begin = i});
+                }
+                blocks.back().end = i + 1;
+                block_of[i] = blocks.size() - 1;
+            }
+            // Jumping past the last instruction leaves the function
+            for (auto& block : blocks) {
+                const auto& last = code[block.end - 1];
+                const auto target = jump_target(last);
+                if (target && *target < code.size()) {
+                    block.successors[0] = block_of[*target];
+                }
+                if (last.op != OpCode::Jump && !ends_block(last.op) && block.end < code.size()) {
+                    block.successors[1] = block_of[block.end];
+                }
+            }
+            return blocks;
+        }
+
+        // How deeply each instruction is nested in loops, found from the
+        // backward jumps of the code generator's loops
+        std::vector<std::size_t> loop_depths(const Function& function)
+        {
+            auto changes = std::vector<std::ptrdiff_t>(function.code.size() + 1, 0);
+            for (std::size_t i = 0; i < function.code.size(); ++i) {
+                if (const auto target = jump_target(function.code[i]); target && *target <= i) {
+                    ++changes[*target];
+                    --changes[i + 1];
+                }
+            }
+            auto depths = std::vector<std::size_t>(function.code.size(), 0);
+            auto depth = std::ptrdiff_t{0};
+            for (std::size_t i = 0; i < depths.size(); ++i) {
+                depth += changes[i];
+                depths[i] = static_cast<std::size_t>(depth);
+            }
+            return depths;
+        }
+    } // namespace
+
+    RegisterAllocation allocate_registers(const Program& program, const Function& function, RegisterFile file)
+    {
+        const auto& code = function.code;
+        const auto register_count = std::size_t{function.register_count};
+        auto allocation = RegisterAllocation{};
+        allocation.segments.resize(register_count);
+        allocation.used.assign(file.count, false);
+        if (code.empty()) {
+            return allocation;
+        }
+
+        // Liveness per block, iterated backwards to a fixed point
+        const auto blocks = find_blocks(function);
+        auto uses = std::vector<RegisterSet>(blocks.size(), RegisterSet{register_count});
+        auto defs = std::vector<RegisterSet>(blocks.size(), RegisterSet{register_count});
+        for (std::size_t b = 0; b < blocks.size(); ++b) {
+            for (auto i = blocks[b].begin; i < blocks[b].end; ++i) {
+                const auto operand = operands(program, code[i]);
+                const auto use = [&](std::size_t r) {
+                    if (!defs[b].contains(r)) {
+                        uses[b].insert(r);
+                    }
+                };
+                for (std::size_t u = 0; u < operand.use_count; ++u) {
+                    use(operand.uses[u]);
+                }
+                for (std::size_t u = 0; u < operand.range_uses; ++u) {
+                    use(operand.range + u);
+                }
+                if (operand.def) {
+                    defs[b].insert(*operand.def);
+                }
+                for (std::size_t d = 0; d < operand.range_defs; ++d) {
+                    defs[b].insert(operand.range + d);
+                }
+            }
+        }
+        auto live_in = std::vector<RegisterSet>(blocks.size(), RegisterSet{register_count});
+        auto live_out = std::vector<RegisterSet>(blocks.size(), RegisterSet{register_count});
+        for (auto changed = true; changed;) {
+            changed = false;
+            for (auto b = blocks.size(); b-- > 0;) {
+                for (const auto successor : blocks[b].successors) {
+                    if (successor) {
+                        live_out[b].unite(live_in[*successor]);
+                    }
+                }
+                changed = live_in[b].merge(live_out[b], uses[b], defs[b]) || changed;
+            }
+        }
+
+        // Live ranges within blocks, scanned backwards. A range that is live
+        // into a block joins those live out of its predecessors in one web
+        auto segments = std::vector<Segment>{};
+        auto parents = std::vector<std::size_t>{};
+        const auto add_segment = [&](std::size_t r, std::size_t position) {
+            segments.push_back(Segment{.r = static_cast<Register>(r), .start = position, .end = position});
+            parents.push_back(parents.size());
+            return segments.size() - 1;
+        };
+        const auto find = [&](std::size_t segment) {
+            while (parents[segment] != segment) {
+                segment = parents[segment] = parents[parents[segment]];
+            }
+            return segment;
+        };
+        const auto none = std::numeric_limits<std::size_t>::max();
+        auto open = std::vector<std::size_t>(register_count, none);
+        auto entries = std::vector<std::vector<std::size_t>>(blocks.size());
+        auto exits = std::vector<std::vector<std::size_t>>(blocks.size());
+        const auto depths = loop_depths(function);
+        for (std::size_t b = 0; b < blocks.size(); ++b) {
+            auto live = live_out[b];
+            live.for_each([&](std::size_t r) {
+                open[r] = add_segment(r, 2 * blocks[b].end - 1);
+                exits[b].push_back(open[r]);
+            });
+            for (auto i = blocks[b].end; i-- > blocks[b].begin;) {
+                const auto operand = operands(program, code[i]);
+                // Uses in loops cost 8 times more than those outside
+                const auto cost = static_cast<double>(std::uint64_t{1} << (3 * std::min<std::size_t>(depths[i], 6)));
+                const auto define = [&](std::size_t r) {
+                    const auto segment = open[r] != none ? open[r] : add_segment(r, 2 * i + 1);
+                    segments[segment].start = 2 * i + 1;
+                    segments[segment].cost += cost;
+                    open[r] = none;
+                    live.erase(r);
+                };
+                const auto use = [&](std::size_t r) {
+                    if (open[r] == none) {
+                        open[r] = add_segment(r, 2 * i);
+                    }
+                    segments[open[r]].start = 2 * i;
+                    segments[open[r]].cost += cost;
+                    live.insert(r);
+                };
+                if (operand.def) {
+                    define(*operand.def);
+                }
+                for (std::size_t d = 0; d < operand.range_defs; ++d) {
+                    define(operand.range + d);
+                }
+                if (calls(code[i].op)) {
+                    live.for_each([&](std::size_t r) { segments[open[r]].crosses_call = true; });
+                }
+                for (std::size_t u = 0; u < operand.use_count; ++u) {
+                    use(operand.uses[u]);
+                }
+                for (std::size_t u = 0; u < operand.range_uses; ++u) {
+                    use(operand.range + u);
+                }
+            }
+            live.for_each([&](std::size_t r) {
+                segments[open[r]].start = 2 * blocks[b].begin;
+                entries[b].push_back(open[r]);
+                open[r] = none;
+            });
+        }
+        for (std::size_t b = 0; b < blocks.size(); ++b) {
+            for (const auto segment : exits[b]) {
+                open[segments[segment].r] = segment;
+            }
+            for (const auto successor : blocks[b].successors) {
+                if (!successor) {
+                    continue;
+                }
+                for (const auto segment : entries[*successor]) {
+                    parents[find(segment)] = find(open[segments[segment].r]);
+                }
+            }
+            for (const auto segment : exits[b]) {
+                open[segments[segment].r] = none;
+            }
+        }
+
+        // One interval per web, from its first to its last position
+        auto webs = std::vector<std::size_t>(segments.size(), none);
+        auto intervals = std::vector<Interval>{};
+        for (std::size_t s = 0; s < segments.size(); ++s) {
+            const auto root = find(s);
+            if (webs[root] == none) {
+                webs[root] = intervals.size();
+                intervals.push_back(Interval{.start = segments[s].start, .end = segments[s].end});
+            }
+            webs[s] = webs[root];
+            auto& interval = intervals[webs[s]];
+            interval.start = std::min(interval.start, segments[s].start);
+            interval.end = std::max(interval.end, segments[s].end);
+            interval.cost += segments[s].cost;
+            interval.crosses_call = interval.crosses_call || segments[s].crosses_call;
+        }
+        allocation.candidates = intervals.size();
+
+        allocation.segments.resize(register_count);
+        auto segment_webs = std::vector<std::vector<std::size_t>>(register_count);
+        {
+            auto order = std::vector<std::size_t>(segments.size());
+            for (std::size_t s = 0; s < order.size(); ++s) {
+                order[s] = s;
+            }
+            std::sort(order.begin(), order.end(), [&](std::size_t lhs, std::size_t rhs) { return segments[lhs].start < segments[rhs].start; });
+            for (const auto s : order) {
+                allocation.segments[segments[s].r].push_back(RegisterAllocation::Segment{.start = segments[s].start, .end = segments[s].end});
+                segment_webs[segments[s].r].push_back(webs[s]);
+            }
+        }
+        // The web of register r at position, if it is live there
+        const auto web_at = [&](std::size_t r, std::size_t position) -> std::optional<std::size_t> {
+            const auto found = find_segment(allocation.segments[r], position);
+            return found ? std::optional{segment_webs[r][*found]} : std::nullopt;
+        };
+
+        auto locations = std::vector<std::uint8_t>(intervals.size(), RegisterAllocation::in_frame);
+        auto order = std::vector<std::size_t>(intervals.size());
+        for (std::size_t i = 0; i < order.size(); ++i) {
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(), [&](std::size_t lhs, std::size_t rhs) { return intervals[lhs].start < intervals[rhs].start; });
+        auto free = std::vector<bool>(file.count, true);
+        auto active = std::vector<std::size_t>{};
+        for (const auto current : order) {
+            const auto& interval = intervals[current];
+            std::erase_if(active, [&](std::size_t other) {
+                if (intervals[other].end < interval.start) {
+                    free[locations[other]] = true;
+                    return true;
+                }
+                return false;
+            });
+            const auto allowed = interval.crosses_call ? std::min(file.preserved, file.count) : file.count;
+
+            // The register of the Move source that ends where the web starts
+            auto choice = std::optional<std::size_t>{};
+            if (interval.start % 2 == 1 && code[interval.start / 2].op == OpCode::Move) {
+                if (const auto source = web_at(code[interval.start / 2].b, interval.start - 1)) {
+                    const auto location = locations[*source];
+                    if (location < allowed && free[location]) {
+                        choice = location;
+                    }
+                }
+            }
+            // Registers that are not preserved first, saving the others for
+            // webs live across calls
+            for (auto m = allowed; !choice && m-- > 0;) {
+                if (free[m]) {
+                    choice = m;
+                }
+            }
+            if (!choice) {
+                const auto victim = std::min_element(active.begin(), active.end(), [&](std::size_t lhs, std::size_t rhs) {
+                    const auto lhs_allowed = locations[lhs] < allowed;
+                    const auto rhs_allowed = locations[rhs] < allowed;
+                    return lhs_allowed != rhs_allowed ? lhs_allowed : intervals[lhs].weight() < intervals[rhs].weight();
+                });
+                ++allocation.spills;
+                if (victim == active.end() || locations[*victim] >= allowed || intervals[*victim].weight() <= interval.weight()) {
+                    continue;
+                }
+                choice = locations[*victim];
+                locations[*victim] = RegisterAllocation::in_frame;
+                active.erase(victim);
+            }
+            locations[current] = static_cast<std::uint8_t>(*choice);
+            free[*choice] = false;
+            active.push_back(current);
+        }
+
+        for (std::size_t r = 0; r < register_count; ++r) {
+            for (std::size_t s = 0; s < allocation.segments[r].size(); ++s) {
+                const auto location = locations[segment_webs[r][s]];
+                allocation.segments[r][s].location = location;
+                if (location != RegisterAllocation::in_frame) {
+                    allocation.used[location] = true;
+                }
+            }
+        }
+        live_in.front().for_each([&](std::size_t r) {
+            if (allocation.read(static_cast<Register>(r), 0) != RegisterAllocation::in_frame) {
+                allocation.live_in.push_back(static_cast<Register>(r));
+            }
+        });
+        for (std::size_t i = 0; i < code.size(); ++i) {
+            const auto& instruction = code[i];
+            if (instruction.op == OpCode::Move && allocation.written(instruction.a, i) == allocation.read(instruction.b, i) &&
+                (instruction.a == instruction.b || allocation.written(instruction.a, i) != RegisterAllocation::in_frame)) {
+                ++allocation.coalesced_moves;
+            }
+        }
+        return allocation;
+    }
+
+    std::uint8_t RegisterAllocation::at(Register r, std::size_t position) const
+    {
+        const auto found = find_segment(segments[r], position);
+        return found ? segments[r][*found].location : in_frame;
+    }
+} // namespace talos
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "vm/bytecode.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace talos
+{
+    // Machine registers that may hold bytecode registers. The first preserved
+    // of them keep their value across calls, the rest do not
+    struct RegisterFile {
+        std::size_t count = 0;
+        std::size_t preserved = 0;
+    };
+
+    // Where each bytecode register of a function lives while it runs. A
+    // register may hold unrelated values at different times, each of which
+    // can be in a different place
+    struct RegisterAllocation {
+        static constexpr std::uint8_t in_frame = 0xFF;
+
+        // Positions 2 * i and 2 * i + 1 are where instruction i reads its
+        // operands and writes its result. location is an index into the
+        // register file, or in_frame for the slot of the register in the frame
+        struct Segment {
+            std::size_t start = 0;
+            std::size_t end = 0;
+            std::uint8_t location = in_frame;
+        };
+
+        // Positions each register is live at, sorted by start
+        std::vector<std::vector<Segment>> segments;
+        // Registers in machine registers that are live when the function is
+        // entered, such as parameters, loaded from their slots
+        std::vector<Register> live_in;
+        // Whether any value is in each machine register
+        std::vector<bool> used;
+        // Webs that could be kept in a machine register, those spilled to
+        // their slots instead, and moves whose operands ended up in the same
+        // place
+        std::size_t candidates = 0;
+        std::size_t spills = 0;
+        std::size_t coalesced_moves = 0;
+
+        // Location of register r where instruction reads it, or writes it
+        [[nodiscard]] std::uint8_t read(Register r, std::size_t instruction) const { return at(r, 2 * instruction); }
+        [[nodiscard]] std::uint8_t written(Register r, std::size_t instruction) const { return at(r, 2 * instruction + 1); }
+
+    private:
+        [[nodiscard]] std::uint8_t at(Register r, std::size_t position) const;
+    };
+
+    // Linear scan register allocation over the instructions of function in
+    // order. Liveness analysis splits each bytecode register into webs, the
+    // values that flow together into some uses, and each web gets one
+    // interval from its first to its last live position and one location for
+    // all of it. Webs live across a call only get preserved registers. When
+    // none is free, the web with the lowest spill weight, its uses weighted by
+    // loop depth per position it spans, goes to the frame slot. A Move whose
+    // source ends where its target starts gives the target the same register,
+    // which removes the move
+    [[nodiscard]] RegisterAllocation allocate_registers(const Program& program, const Function& function, RegisterFile file);
+} // namespace talos
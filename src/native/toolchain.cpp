@@ -0,0 +1,272 @@
+#include "toolchain.h"
+
+#include "exceptions.h"
+#include "vm/type.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <string_view>
+#include <vector>
+
+#ifdef TALOS_ENABLE_NATIVE
+    #include <spawn.h>
+    #include <sys/wait.h>
+
+extern char** environ;
+#endif
+
+namespace talos
+{
+    namespace
+    {
+        // After the constants runtime_source defines
+        constexpr auto runtime_body = R"(
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static int64_t talos_stack[TALOS_STACK_SIZE];
+static _Alignas(32) unsigned char talos_memory[TALOS_MEMORY_SIZE];
+const int64_t* const talos_stack_limit = talos_stack + TALOS_STACK_SIZE;
+const unsigned char* const talos_memory_limit = talos_memory + TALOS_MEMORY_SIZE;
+
+int64_t talos_start(int64_t* stack, unsigned char* memory, int64_t max_call_depth);
+
+// message is a printf format of the index that failed a check, if any
+_Noreturn void talos_fail(int code, const char* message, int64_t index)
+{
+    fprintf(stderr, message, (long long)index);
+    fputc('\n', stderr);
+    exit(code);
+}
+
+// Integers wrap around, the only quotient that overflows is negated instead
+#define TALOS_INTEGER_KERNEL(T)                                                      \
+    static bool kernel_##T(int op, T* result, const T* lhs, const T* rhs, int64_t n) \
+    {                                                                                \
+        switch (op) {                                                                \
+            case 0:                                                                  \
+                for (int64_t i = 0; i < n; ++i) {                                    \
+                    result[i] = (T)((uint64_t)lhs[i] + (uint64_t)rhs[i]);            \
+                }                                                                    \
+                return true;                                                         \
+            case 1:                                                                  \
+                for (int64_t i = 0; i < n; ++i) {                                    \
+                    result[i] = (T)((uint64_t)lhs[i] - (uint64_t)rhs[i]);            \
+                }                                                                    \
+                return true;                                                         \
+            case 2:                                                                  \
+                for (int64_t i = 0; i < n; ++i) {                                    \
+                    result[i] = (T)((uint64_t)lhs[i] * (uint64_t)rhs[i]);            \
+                }                                                                    \
+                return true;                                                         \
+            default:                                                                 \
+                for (int64_t i = 0; i < n; ++i) {                                    \
+                    if (rhs[i] == 0) {                                               \
+                        return false;                                                \
+                    }                                                                \
+                    result[i] = rhs[i] == -1 ? (T)(0 - (uint64_t)lhs[i]) : (T)(lhs[i] / rhs[i]); \
+                }                                                                    \
+                return true;                                                         \
+        }                                                                            \
+    }
+
+#define TALOS_FLOAT_KERNEL(T)                                                        \
+    static bool kernel_##T(int op, T* result, const T* lhs, const T* rhs, int64_t n) \
+    {                                                                                \
+        switch (op) {                                                                \
+            case 0:                                                                  \
+                for (int64_t i = 0; i < n; ++i) {                                    \
+                    result[i] = lhs[i] + rhs[i];                                     \
+                }                                                                    \
+                break;                                                               \
+            case 1:                                                                  \
+                for (int64_t i = 0; i < n; ++i) {                                    \
+                    result[i] = lhs[i] - rhs[i];                                     \
+                }                                                                    \
+                break;                                                               \
+            case 2:                                                                  \
+                for (int64_t i = 0; i < n; ++i) {                                    \
+                    result[i] = lhs[i] * rhs[i];                                     \
+                }                                                                    \
+                break;                                                               \
+            default:                                                                 \
+                for (int64_t i = 0; i < n; ++i) {                                    \
+                    result[i] = lhs[i] / rhs[i];                                     \
+                }                                                                    \
+                break;                                                               \
+        }                                                                            \
+        return true;                                                                 \
+    }
+
+TALOS_INTEGER_KERNEL(int8_t)
+TALOS_INTEGER_KERNEL(int16_t)
+TALOS_INTEGER_KERNEL(int32_t)
+TALOS_INTEGER_KERNEL(int64_t)
+TALOS_FLOAT_KERNEL(float)
+TALOS_FLOAT_KERNEL(double)
+
+// Elementwise add, subtract, multiply or divide, false on division by zero
+bool talos_vector(int op, int element, void* result, const void* lhs, const void* rhs, int64_t length)
+{
+    switch (element) {
+        case TALOS_INT8:
+            return kernel_int8_t(op, result, lhs, rhs, length);
+        case TALOS_INT16:
+            return kernel_int16_t(op, result, lhs, rhs, length);
+        case TALOS_INT32:
+            return kernel_int32_t(op, result, lhs, rhs, length);
+        case TALOS_INT64:
+            return kernel_int64_t(op, result, lhs, rhs, length);
+        case TALOS_FLOAT32:
+            return kernel_float(op, result, lhs, rhs, length);
+        default:
+            return kernel_double(op, result, lhs, rhs, length);
+    }
+}
+
+int main(void)
+{
+    return (int)talos_start(talos_stack, talos_memory, TALOS_MAX_CALL_DEPTH);
+}
+)";
+
+        std::string quote_command(std::span<const std::string> arguments)
+        {
+            auto command = std::string{};
+            for (const auto& argument : arguments) {
+                command += command.empty() ? "'" : " '";
+                command += argument;
+                command += '\'';
+            }
+            return command;
+        }
+
+        void run_tool(std::span<const std::string> arguments)
+        {
+            const auto status = run_command(arguments);
+            if (!status) {
+                throw TalosException(ReturnCode::ToolchainError, SourceLocation{}, fmt::format("Could not run {}", quote_command(arguments)));
+            }
+            if (*status != 0) {
+                throw TalosException(ReturnCode::ToolchainError, SourceLocation{}, fmt::format("{} exited with {}", quote_command(arguments), *status));
+            }
+        }
+
+        // The compiler in $CC, or cc, split at whitespace as make does so that
+        // e.g. "ccache gcc" or "gcc -m64" work. Quotes are not interpreted
+        std::vector<std::string> compiler_command()
+        {
+            auto command = std::vector<std::string>{};
+            const char* compiler = std::getenv("CC");
+            const auto words = std::string_view{compiler != nullptr ? compiler : ""};
+            for (std::size_t end = 0; end < words.size();) {
+                const auto begin = words.find_first_not_of(" \t\n", end);
+                if (begin == std::string_view::npos) {
+                    break;
+                }
+                end = std::min(words.find_first_of(" \t\n", begin), words.size());
+                command.emplace_back(words.substr(begin, end - begin));
+            }
+            if (command.empty()) {
+                command.emplace_back("cc");
+            }
+            return command;
+        }
+
+        void write_file(const std::filesystem::path& path, std::string_view contents)
+        {
+            auto file = std::ofstream{path, std::ios::binary};
+            file.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+            if (!file) {
+                throw TalosException(ReturnCode::ToolchainError, SourceLocation{}, fmt::format("Could not write '{}'", path.string()));
+            }
+        }
+
+        // Removes the directory and what the tools wrote to it when done
+        class TemporaryDirectory
+        {
+        public:
+            TemporaryDirectory()
+            {
+                static auto counter = std::atomic<unsigned>{0};
+                auto error = std::error_code{};
+                path_ = std::filesystem::temp_directory_path(error) / fmt::format("talos-{:x}-{}", std::random_device{}(), counter++);
+                if (error || !std::filesystem::create_directories(path_, error)) {
+                    throw TalosException(ReturnCode::ToolchainError, SourceLocation{}, "Could not create a temporary directory");
+                }
+            }
+
+            ~TemporaryDirectory()
+            {
+                auto error = std::error_code{};
+                std::filesystem::remove_all(path_, error);
+            }
+
+            TemporaryDirectory(const TemporaryDirectory&) = delete;
+            TemporaryDirectory& operator=(const TemporaryDirectory&) = delete;
+
+            [[nodiscard]] const std::filesystem::path& path() const noexcept { return path_; }
+
+        private:
+            std::filesystem::path path_;
+        };
+    } // namespace
+
+    std::string runtime_source(std::size_t stack_size, std::size_t max_call_depth, std::size_t memory_size)
+    {
+        auto source = fmt::format("// Runtime of a native Talos program\n"
+                                  "#define TALOS_STACK_SIZE {}\n#define TALOS_MAX_CALL_DEPTH {}\n#define TALOS_MEMORY_SIZE {}\n",
+                                  stack_size, max_call_depth, memory_size);
+        source += fmt::format("#define TALOS_INT8 {}\n#define TALOS_INT16 {}\n#define TALOS_INT32 {}\n#define TALOS_INT64 {}\n#define TALOS_FLOAT32 {}\n",
+                              static_cast<int>(Type::Int8), static_cast<int>(Type::Int16), static_cast<int>(Type::Int32), static_cast<int>(Type::Int64),
+                              static_cast<int>(Type::Float32));
+        source += runtime_body;
+        return source;
+    }
+
+    std::optional<int> run_command(std::span<const std::string> arguments)
+    {
+#ifdef TALOS_ENABLE_NATIVE
+        auto argv = std::vector<char*>{};
+        for (const auto& argument : arguments) {
+            argv.push_back(const_cast<char*>(argument.c_str()));
+        }
+        argv.push_back(nullptr);
+        auto pid = pid_t{};
+        if (posix_spawnp(&pid, argv.front(), nullptr, nullptr, argv.data(), environ) != 0) {
+            return std::nullopt;
+        }
+        auto status = 0;
+        if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status)) {
+            return std::nullopt;
+        }
+        return WEXITSTATUS(status);
+#else
+        static_cast<void>(arguments);
+        return std::nullopt;
+#endif
+    }
+
+    void build_executable(std::string_view assembly, std::string_view runtime, const std::filesystem::path& output)
+    {
+        const auto directory = TemporaryDirectory{};
+        const auto program_source = directory.path() / "program.s";
+        const auto program_object = directory.path() / "program.o";
+        const auto runtime_file = directory.path() / "runtime.c";
+        write_file(program_source, assembly);
+        write_file(runtime_file, runtime);
+
+        const auto assemble = std::vector<std::string>{"as", "-o", program_object.string(), program_source.string()};
+        run_tool(assemble);
+        auto link = compiler_command();
+        link.insert(link.end(), {"-O2", "-o", output.string(), program_object.string(), runtime_file.string()});
+        run_tool(link);
+    }
+} // namespace talos
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace talos
+{
+    // C source of the runtime that native programs are linked with. Its main
+    // reserves frames of the given sizes, as the interpreter would, calls
+    // talos_start and exits with what main returned. It also reports runtime
+    // errors and computes elementwise arithmetic, with loops the C compiler
+    // vectorizes
+    [[nodiscard]] std::string runtime_source(std::size_t stack_size, std::size_t max_call_depth, std::size_t memory_size);
+
+    // Runs the program arguments[0], found on the PATH, and waits for it.
+    // Returns its exit code, or nullopt if it could not be run or was killed
+    [[nodiscard]] std::optional<int> run_command(std::span<const std::string> arguments);
+
+    // Assembles assembly with as and links it with the runtime using cc, or
+    // the compiler in $CC split at whitespace, into the executable at output.
+    // Throws TalosException with ToolchainError if either fails
+    void build_executable(std::string_view assembly, std::string_view runtime, const std::filesystem::path& output);
+} // namespace talos
@@ -10,7 +10,18 @@ namespace talos
         UnexpectedToken,
         UnexpectedEof,
         UnexpectedChar,
-        EmptyCharLiteral
+        EmptyCharLiteral,
+        ReadError,
+        NestingTooDeep,
+        TypeError,
+        UndefinedName,
+        Redefinition,
+        FunctionTooLarge,
+        StackOverflow,
+        DivisionByZero,
+        IndexOutOfBounds,
+        InvalidEscape,
+        ToolchainError,
     };
 
     [[nodiscard]] constexpr const char* return_code_str(ReturnCode code)
@@ -32,6 +43,28 @@ namespace talos
                 return "Unexpected character";
             case ReturnCode::EmptyCharLiteral:
                 return "Empty character literal";
+            case ReturnCode::ReadError:
+                return "Read error";
+            case ReturnCode::NestingTooDeep:
+                return "Nesting too deep";
+            case ReturnCode::TypeError:
+                return "Type error";
+            case ReturnCode::UndefinedName:
+                return "Undefined name";
+            case ReturnCode::Redefinition:
+                return "Redefinition";
+            case ReturnCode::FunctionTooLarge:
+                return "Function too large";
+            case ReturnCode::StackOverflow:
+                return "Stack overflow";
+            case ReturnCode::DivisionByZero:
+                return "Division by zero";
+            case ReturnCode::IndexOutOfBounds:
+                return "Index out of bounds";
+            case ReturnCode::InvalidEscape:
+                return "Invalid escape sequence";
+            case ReturnCode::ToolchainError:
+                return "Toolchain error";
         }
         return "Unknown";
     }
@@ -54,6 +87,28 @@ namespace talos
                 return "Unexpected character";
             case ReturnCode::EmptyCharLiteral:
                 return "Empty character literal";
+            case ReturnCode::ReadError:
+                return "Input could not be read";
+            case ReturnCode::NestingTooDeep:
+                return "Nesting exceeds the maximum depth";
+            case ReturnCode::TypeError:
+                return "Operand types do not match";
+            case ReturnCode::UndefinedName:
+                return "Name is not declared";
+            case ReturnCode::Redefinition:
+                return "Name is already declared in this scope";
+            case ReturnCode::FunctionTooLarge:
+                return "Function needs too many registers or constants";
+            case ReturnCode::StackOverflow:
+                return "Calls nest deeper than the VM stack allows";
+            case ReturnCode::DivisionByZero:
+                return "Integer division by zero";
+            case ReturnCode::IndexOutOfBounds:
+                return "Array index outside of the array";
+            case ReturnCode::InvalidEscape:
+                return "Unknown or malformed escape sequence in a string literal";
+            case ReturnCode::ToolchainError:
+                return "The assembler or linker could not build the executable";
         }
         return "Invalid return code";
     }
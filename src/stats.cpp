@@ -0,0 +1,90 @@
+#include "stats.h"
+
+#include "frontend/node_counter.h"
+
+#include <fmt/format.h>
+
+#include <iterator>
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+    #include <psapi.h>
+#else
+    #include <sys/resource.h>
+#endif
+
+namespace talos
+{
+    namespace
+    {
+        double milliseconds(std::chrono::nanoseconds duration)
+        {
+            return std::chrono::duration<double, std::milli>(duration).count();
+        }
+    } // namespace
+
+    std::string format_phase_times(const Stats& stats)
+    {
+        auto out = fmt::memory_buffer{};
+        auto total = std::chrono::nanoseconds{0};
+        fmt::format_to(std::back_inserter(out), "Phase times:\n");
+        for (std::size_t i = 0; i < phase_count; ++i) {
+            const auto phase = static_cast<Phase>(i);
+            fmt::format_to(std::back_inserter(out), "  {:<8}{:>12.3f} ms\n", format_as(phase), milliseconds(stats.time(phase)));
+            total += stats.time(phase);
+        }
+        fmt::format_to(std::back_inserter(out), "  {:<8}{:>12.3f} ms\n", "total", milliseconds(total));
+        return fmt::to_string(out);
+    }
+
+    std::string format_stats(const Stats& stats)
+    {
+        auto out = fmt::memory_buffer{};
+        fmt::format_to(std::back_inserter(out), "Statistics:\n");
+        fmt::format_to(std::back_inserter(out), "  {:<24}{:>12}\n", "bytes read", stats.bytes_read);
+        fmt::format_to(std::back_inserter(out), "  {:<24}{:>12}\n", "tokens", stats.tokens);
+        fmt::format_to(std::back_inserter(out), "  {:<24}{:>12}\n", "ast nodes", total_nodes(stats.nodes));
+        for (std::size_t i = 0; i < node_kind_count; ++i) {
+            if (stats.nodes[i] != 0) {
+                fmt::format_to(std::back_inserter(out), "    {:<22}{:>12}\n", format_as(static_cast<NodeKind>(i)), stats.nodes[i]);
+            }
+        }
+        fmt::format_to(std::back_inserter(out), "  {:<24}{:>12}\n", "peak ast nodes", stats.peak_ast_nodes);
+        fmt::format_to(std::back_inserter(out), "  {:<24}{:>9} KiB\n", "peak source", stats.peak_source_bytes / 1024);
+        if (stats.cache_hits + stats.cache_misses != 0) {
+            fmt::format_to(std::back_inserter(out), "  {:<24}{:>12}\n", "cache hits", stats.cache_hits);
+            fmt::format_to(std::back_inserter(out), "  {:<24}{:>12}\n", "cache misses", stats.cache_misses);
+        }
+        if (stats.functions_pruned + stats.globals_pruned + stats.structs_pruned != 0) {
+            fmt::format_to(std::back_inserter(out), "  {:<24}{:>12}\n", "functions pruned", stats.functions_pruned);
+            fmt::format_to(std::back_inserter(out), "  {:<24}{:>12}\n", "globals pruned", stats.globals_pruned);
+            fmt::format_to(std::back_inserter(out), "  {:<24}{:>12}\n", "structs pruned", stats.structs_pruned);
+        }
+        fmt::format_to(std::back_inserter(out), "  {:<24}{:>12}\n", "allocations", stats.allocations);
+        fmt::format_to(std::back_inserter(out), "  {:<24}{:>12}\n", "bytes allocated", stats.bytes_allocated);
+        fmt::format_to(std::back_inserter(out), "  {:<24}{:>9} KiB\n", "peak rss", stats.peak_rss / 1024);
+        return fmt::to_string(out);
+    }
+
+    std::uint64_t peak_rss() noexcept
+    {
+#ifdef _WIN32
+        auto counters = PROCESS_MEMORY_COUNTERS{};
+        if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) == 0) {
+            return 0;
+        }
+        return counters.PeakWorkingSetSize;
+#else
+        auto usage = rusage{};
+        if (getrusage(RUSAGE_SELF, &usage) != 0) {
+            return 0;
+        }
+    #ifdef __APPLE__
+        return static_cast<std::uint64_t>(usage.ru_maxrss);
+    #else
+        return static_cast<std::uint64_t>(usage.ru_maxrss) * 1024;
+    #endif
+#endif
+    }
+} // namespace talos
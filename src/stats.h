@@ -0,0 +1,199 @@
+#pragma once
+
+#include "frontend/node_kind.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+namespace talos
+{
+    enum class Phase {
+        Read,
+        Lex,
+        Parse,
+        Dump,
+        // Type checking and bytecode generation
+        Compile,
+        Run,
+    };
+
+    inline constexpr std::size_t phase_count = static_cast<std::size_t>(Phase::Run) + 1;
+
+    constexpr auto format_as(Phase phase)
+    {
+        switch (phase) {
+            case Phase::Read:
+                return "read";
+            case Phase::Lex:
+                return "lex";
+            case Phase::Parse:
+                return "parse";
+            case Phase::Dump:
+                return "dump";
+            case Phase::Compile:
+                return "compile";
+            case Phase::Run:
+                return "run";
+        }
+        return "unknown";
+    }
+
+#ifdef TALOS_ENABLE_STATS
+    inline constexpr bool stats_enabled = true;
+#else
+    inline constexpr bool stats_enabled = false;
+#endif
+
+    struct Stats {
+        // Exclusive time of each phase. Time spent in a nested phase
+        // (e.g. lexing driven by the parser) is only counted once
+        std::array<std::chrono::nanoseconds, phase_count> phase_times{};
+        std::uint64_t bytes_read = 0;
+        std::uint64_t tokens = 0;
+        NodeCounts nodes{};
+        // Most AST nodes and bytes of source held in memory at once
+        std::uint64_t peak_ast_nodes = 0;
+        std::uint64_t peak_source_bytes = 0;
+        // Top-level declarations found in and missing from the function cache
+        std::uint64_t cache_hits = 0;
+        std::uint64_t cache_misses = 0;
+        // Top-level declarations left out as unreachable, by kind
+        std::uint64_t functions_pruned = 0;
+        std::uint64_t globals_pruned = 0;
+        std::uint64_t structs_pruned = 0;
+        std::uint64_t allocations = 0;
+        std::uint64_t bytes_allocated = 0;
+        std::uint64_t peak_rss = 0;
+
+        [[nodiscard]] std::chrono::nanoseconds& time(Phase phase) { return phase_times.at(static_cast<std::size_t>(phase)); }
+        [[nodiscard]] std::chrono::nanoseconds time(Phase phase) const { return phase_times.at(static_cast<std::size_t>(phase)); }
+    };
+
+    [[nodiscard]] std::string format_phase_times(const Stats& stats);
+    [[nodiscard]] std::string format_stats(const Stats& stats);
+
+    // Peak resident set size of the process in bytes, 0 if unavailable
+    [[nodiscard]] std::uint64_t peak_rss() noexcept;
+
+    namespace detail
+    {
+        class PhaseTimer;
+
+        inline thread_local Stats* active_stats = nullptr;
+        inline thread_local PhaseTimer* active_timer = nullptr;
+    } // namespace detail
+
+    // Makes stats the collection target of the current thread for the lifetime
+    // of the scope. Passing null disables collection within the scope
+    class StatsScope
+    {
+    public:
+#ifdef TALOS_ENABLE_STATS
+        explicit StatsScope(Stats* stats) noexcept
+            : previous_(std::exchange(detail::active_stats, stats))
+        {
+        }
+        ~StatsScope() { detail::active_stats = previous_; }
+#else
+        explicit StatsScope(Stats*) noexcept {}
+        ~StatsScope() = default;
+#endif
+
+        StatsScope(const StatsScope&) = delete;
+        StatsScope(StatsScope&&) = delete;
+        StatsScope& operator=(const StatsScope&) = delete;
+        StatsScope& operator=(StatsScope&&) = delete;
+
+#ifdef TALOS_ENABLE_STATS
+    private:
+        Stats* previous_;
+#endif
+    };
+
+    // Hook for allocation functions, counts the allocation against the active stats
+    inline void record_allocation([[maybe_unused]] std::size_t size) noexcept
+    {
+#ifdef TALOS_ENABLE_STATS
+        if (auto* stats = detail::active_stats) {
+            ++stats->allocations;
+            stats->bytes_allocated += size;
+        }
+#endif
+    }
+
+#ifdef TALOS_ENABLE_STATS
+    namespace detail
+    {
+        class PhaseTimer
+        {
+        public:
+            using Clock = std::chrono::steady_clock;
+
+            explicit PhaseTimer(Phase phase) noexcept
+                : stats_(active_stats)
+                , phase_(phase)
+            {
+                if (stats_ != nullptr) {
+                    parent_ = std::exchange(active_timer, this);
+                    start_ = Clock::now();
+                }
+            }
+
+            ~PhaseTimer()
+            {
+                if (stats_ == nullptr) {
+                    return;
+                }
+                const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start_);
+                stats_->time(phase_) += elapsed - children_;
+                if (parent_ != nullptr) {
+                    parent_->children_ += elapsed;
+                }
+                active_timer = parent_;
+            }
+
+            PhaseTimer(const PhaseTimer&) = delete;
+            PhaseTimer(PhaseTimer&&) = delete;
+            PhaseTimer& operator=(const PhaseTimer&) = delete;
+            PhaseTimer& operator=(PhaseTimer&&) = delete;
+
+        private:
+            Stats* stats_;
+            Phase phase_;
+            PhaseTimer* parent_ = nullptr;
+            Clock::time_point start_;
+            std::chrono::nanoseconds children_{0};
+        };
+    } // namespace detail
+#endif
+} // namespace talos
+
+// Instrumentation macros expand to nothing unless TALOS_ENABLE_STATS is defined,
+// so instrumented hot paths carry no cost in builds without statistics
+#ifdef TALOS_ENABLE_STATS
+    #define TALOS_STATS_CONCAT_IMPL(lhs, rhs) lhs##rhs
+    #define TALOS_STATS_CONCAT(lhs, rhs) TALOS_STATS_CONCAT_IMPL(lhs, rhs)
+    #define TALOS_TIME_PHASE(phase) \
+        const ::talos::detail::PhaseTimer TALOS_STATS_CONCAT(talos_phase_timer_, __LINE__) { phase }
+    #define TALOS_STATS_ADD(member, value)                             \
+        do {                                                           \
+            if (auto* talos_stats = ::talos::detail::active_stats) {   \
+                talos_stats->member += (value);                        \
+            }                                                          \
+        } while (false)
+    #define TALOS_STATS_MAX(member, value)                                                   \
+        do {                                                                                 \
+            if (auto* talos_stats = ::talos::detail::active_stats) {                         \
+                talos_stats->member = std::max<std::uint64_t>(talos_stats->member, (value)); \
+            }                                                                                \
+        } while (false)
+#else
+    #define TALOS_TIME_PHASE(phase) static_cast<void>(0)
+    #define TALOS_STATS_ADD(member, value) static_cast<void>(0)
+    #define TALOS_STATS_MAX(member, value) static_cast<void>(0)
+#endif
@@ -1,45 +1,378 @@
 #include "talos.h"
 
+#include "cache/function_cache.h"
 #include "exceptions.h"
-#include "frontend/ast_printer.h"
+#include "frontend/declaration_splitter.h"
 #include "frontend/lexer.h"
+#include "frontend/node_counter.h"
 #include "frontend/parser.h"
+#include "frontend/pipelined_lexer.h"
+#include "frontend/reachability.h"
+#include "frontend/streaming_lexer.h"
+#include "native/assembly.h"
+#include "native/toolchain.h"
+#include "trace.h"
+#include "vm/codegen.h"
+#include "vm/interpreter.h"
 
+#include <algorithm>
 #include <fstream>
+#include <memory>
 #include <sstream>
 
 #include <fmt/format.h>
 
 namespace talos
 {
-    VMReturn TalosVM::execute_string(std::string_view string)
+    namespace
     {
-        try {
-            auto lexer = Lexer{string};
-            auto parser = Parser{&lexer};
-            auto result = parser.parse();
-            auto ast_printer = ASTPrinter{};
-            ast_printer.print(result);
-            return VMSuccess{.output = ""};
-        } catch (const TalosException& exception) {
-            return unexpected(VMError{
+        void add_signature(const Statement& statement, std::vector<FunctionSignature>& functions)
+        {
+            if (const auto* function = dynamic_cast<const FunDeclStatement*>(&statement)) {
+                const auto identifier = function->identifier();
+                functions.push_back(FunctionSignature{
+                    .name = std::string{identifier.string},
+                    .return_type = type_specifier_string(function->type_spec()),
+                    .location = identifier.location,
+                });
+            }
+        }
+        VMError to_vm_error(const TalosException& exception)
+        {
+            return VMError{
                 .code = exception.code(),
                 .description = fmt::format("{} ({}): {}",
                                            return_code_str(exception.code()),
                                            exception.location(),
                                            exception.what()),
-            });
+            };
+        }
+    } // namespace
+
+    static_assert(VMOptions::default_max_nesting_depth == Parser::default_max_depth);
+    static_assert(VMOptions::default_stack_size == Interpreter::default_stack_size);
+    static_assert(VMOptions::default_max_call_depth == Interpreter::default_max_call_depth);
+    static_assert(VMOptions::default_memory_size == Interpreter::default_memory_size);
+
+    TalosVM::TalosVM() = default;
+
+    TalosVM::TalosVM(VMOptions options)
+        : options_(std::move(options))
+    {
+        if (!options_.cache_directory.empty()) {
+            cache_ = std::make_unique<FunctionCache>(options_.cache_directory, options_.cache_max_size);
         }
     }
 
+    TalosVM::~TalosVM() = default;
+    TalosVM::TalosVM(TalosVM&&) noexcept = default;
+    TalosVM& TalosVM::operator=(TalosVM&&) noexcept = default;
+
+    VMReturn TalosVM::execute_string(std::string_view string)
+    {
+        TALOS_TRACE_SCOPE("execute_string");
+        auto stats = Stats{};
+        const auto stats_scope = StatsScope{options_.collect_stats ? &stats : nullptr};
+        return finish(execute_source(string), stats);
+    }
+
     VMReturn TalosVM::execute_file(std::string_view filename)
     {
-        auto source_file = std::fstream{filename};
-        if (source_file.fail()) {
-            return unexpected(VMError{.code = ReturnCode::FileNotFound});
+        TALOS_TRACE_SCOPE("execute_file");
+        auto stats = Stats{};
+        const auto stats_scope = StatsScope{options_.collect_stats ? &stats : nullptr};
+        if (options_.stream_chunk_size != 0) {
+            const auto file = std::unique_ptr<std::FILE, decltype(&std::fclose)>{
+                std::fopen(std::string{filename}.c_str(), "rb"),
+                &std::fclose,
+            };
+            if (file == nullptr) {
+                return unexpected(VMError{.code = ReturnCode::FileNotFound});
+            }
+            return finish(execute_chunked(file.get()), stats);
+        }
+
+        std::string source;
+        {
+            TALOS_TRACE_SCOPE("read");
+            TALOS_TIME_PHASE(Phase::Read);
+            auto source_file = std::fstream{filename};
+            if (source_file.fail()) {
+                return unexpected(VMError{.code = ReturnCode::FileNotFound});
+            }
+            std::stringstream sstream;
+            sstream << source_file.rdbuf();
+            source = std::move(sstream).str();
+            TALOS_STATS_ADD(bytes_read, source.size());
+        }
+        return finish(execute_source(source), stats);
+    }
+
+    VMReturn TalosVM::execute_stream(std::FILE* file)
+    {
+        TALOS_TRACE_SCOPE("execute_stream");
+        auto stats = Stats{};
+        const auto stats_scope = StatsScope{options_.collect_stats ? &stats : nullptr};
+        return finish(execute_chunked(file), stats);
+    }
+
+    VMReturn TalosVM::execute_source(std::string_view source)
+    {
+        TALOS_STATS_MAX(peak_source_bytes, source.size());
+        if (options_.pipeline_lexer) {
+            auto lexer = PipelinedLexer{source};
+            return execute(lexer);
+        }
+        auto lexer = Lexer{source};
+        return execute(lexer);
+    }
+
+    VMReturn TalosVM::execute_chunked(std::FILE* file)
+    {
+        const auto chunk_size = options_.stream_chunk_size != 0 ? options_.stream_chunk_size : VMOptions::default_stream_chunk_size;
+        auto lexer = StreamingLexer{file, chunk_size};
+        return execute(lexer);
+    }
+
+    VMReturn TalosVM::execute(TokenSource& tokens)
+    {
+        const auto whole_program = options_.run || options_.native != NativeOutput::None;
+        if (cache_ != nullptr && !whole_program) {
+            return execute_cached(tokens);
+        }
+        try {
+            auto parser = Parser{&tokens, options_.max_nesting_depth};
+            auto success = VMSuccess{};
+            if (options_.per_function && !whole_program) {
+                parser.parse([&](StatementPtr declaration) {
+                    add_signature(*declaration, success.functions);
+                    process(*declaration);
+                    declaration.reset();
+                    tokens.release_consumed();
+                });
+            }
+            else {
+                const auto program = whole_program && options_.prune != Pruning::None ? parse_reachable(tokens, parser) : parser.parse();
+                for (const auto& statement : program.statements()) {
+                    add_signature(*statement, success.functions);
+                }
+                process(program);
+                if (options_.native != NativeOutput::None) {
+                    compile_native(program);
+                }
+                else if (options_.run) {
+                    run(program, success);
+                }
+            }
+            return success;
+        } catch (const TalosException& exception) {
+            return unexpected(to_vm_error(exception));
+        }
+    }
+
+    VMReturn TalosVM::execute_cached(TokenSource& tokens)
+    {
+        TALOS_TRACE_SCOPE("execute_cached");
+        const auto cacheable = options_.dump_ast != DumpFormat::Binary;
+        try {
+            auto success = VMSuccess{};
+            auto splitter = DeclarationSplitter{tokens};
+            auto declaration = DeclarationTokens{};
+            while (splitter.next(declaration)) {
+                // Declarations cut short by a lexer error cannot be complete
+                const auto use_cache = cacheable && !declaration.error;
+                // Compiling depends on the dump format and, as it may fail, on the depth limit. Other
+                // versions of the compiler get keys of their own rather than replacing these entries
+                const auto key = declaration.hash ^ (static_cast<std::uint64_t>(options_.max_nesting_depth) << 8U) ^ static_cast<std::uint64_t>(options_.dump_ast) ^
+                                 (compiled_version << 48U);
+                auto compiled = use_cache ? cache_->load(key) : std::nullopt;
+                if (compiled) {
+                    TALOS_STATS_ADD(cache_hits, 1);
+                }
+                else {
+                    TALOS_STATS_ADD(cache_misses, 1);
+                    compiled = compile(declaration);
+                    if (use_cache) {
+                        cache_->store(key, *compiled);
+                    }
+                }
+                emit(*compiled, declaration, success);
+                tokens.release_consumed();
+            }
+            return success;
+        } catch (const TalosException& exception) {
+            return unexpected(to_vm_error(exception));
+        }
+    }
+
+    CompiledDeclaration TalosVM::compile(const DeclarationTokens& declaration)
+    {
+        auto source = DeclarationTokenSource{declaration};
+        auto parser = Parser{&source, options_.max_nesting_depth};
+        auto compiled = CompiledDeclaration{};
+        parser.parse([&](StatementPtr statement) {
+            if (const auto* function = dynamic_cast<const FunDeclStatement*>(statement.get())) {
+                compiled.function_name = function->identifier().string;
+                compiled.return_type = type_specifier_string(function->type_spec());
+            }
+            const auto counts = count_nodes(*statement);
+            for (std::size_t i = 0; i < node_kind_count; ++i) {
+                compiled.nodes[i] += counts[i];
+            }
+            TALOS_STATS_MAX(peak_ast_nodes, total_nodes(counts));
+            if (options_.dump_ast != DumpFormat::None) {
+                TALOS_TRACE_SCOPE("dump_ast");
+                TALOS_TIME_PHASE(Phase::Dump);
+                dump_buffer_.clear();
+                dump_ast(*statement, options_.dump_ast, dump_buffer_);
+                if (options_.dump_ast == DumpFormat::Json) {
+                    dump_buffer_.push_back('\n');
+                }
+                compiled.dump.append(dump_buffer_.data(), dump_buffer_.size());
+            }
+        });
+        return compiled;
+    }
+
+    void TalosVM::emit(const CompiledDeclaration& compiled, const DeclarationTokens& declaration, VMSuccess& success)
+    {
+        if (!compiled.function_name.empty()) {
+            success.functions.push_back(FunctionSignature{
+                .name = compiled.function_name,
+                .return_type = compiled.return_type,
+                // 'fun' is followed by the name
+                .location = declaration.tokens.at(1).location,
+            });
+        }
+#ifdef TALOS_ENABLE_STATS
+        if (auto* stats = detail::active_stats) {
+            for (std::size_t i = 0; i < node_kind_count; ++i) {
+                stats->nodes[i] += compiled.nodes[i];
+            }
+        }
+#endif
+        std::fwrite(compiled.dump.data(), 1, compiled.dump.size(), options_.dump_output);
+    }
+
+    ProgramNode TalosVM::parse_reachable(TokenSource& tokens, Parser& parser) const
+    {
+        TALOS_TRACE_SCOPE("parse_reachable");
+        auto uses = std::vector<DeclarationUses>{};
+        auto statements = std::vector<StatementPtr>{};
+        const auto count_pruned = [](const DeclarationUses& declaration) {
+            if (declaration.kind == DeclarationKind::Function) {
+                TALOS_STATS_ADD(functions_pruned, 1);
+            }
+            else if (declaration.kind == DeclarationKind::Global) {
+                TALOS_STATS_ADD(globals_pruned, 1);
+            }
+            else if (declaration.kind == DeclarationKind::Struct) {
+                TALOS_STATS_ADD(structs_pruned, 1);
+            }
+        };
+        if (options_.prune == Pruning::BeforeParsing) {
+            auto declarations = std::vector<DeclarationTokens>{};
+            auto splitter = DeclarationSplitter{tokens};
+            for (auto declaration = DeclarationTokens{}; splitter.next(declaration);) {
+                uses.push_back(declaration_uses(declaration));
+                declarations.push_back(std::move(declaration));
+            }
+            const auto reachable = reachable_declarations(uses, options_.entry_points);
+            for (std::size_t i = 0; i < declarations.size(); ++i) {
+                if (!reachable[i]) {
+                    count_pruned(uses[i]);
+                    continue;
+                }
+                auto source = DeclarationTokenSource{declarations[i]};
+                auto declaration_parser = Parser{&source, options_.max_nesting_depth};
+                declaration_parser.parse([&](StatementPtr statement) { statements.push_back(std::move(statement)); });
+            }
+            return ProgramNode{std::move(statements)};
+        }
+
+        parser.parse([&](StatementPtr statement) { statements.push_back(std::move(statement)); });
+        for (const auto& statement : statements) {
+            uses.push_back(declaration_uses(*statement));
+        }
+        const auto reachable = reachable_declarations(uses, options_.entry_points);
+        auto kept = std::vector<StatementPtr>{};
+        for (std::size_t i = 0; i < statements.size(); ++i) {
+            if (reachable[i]) {
+                kept.push_back(std::move(statements[i]));
+            }
+            else {
+                count_pruned(uses[i]);
+            }
+        }
+        return ProgramNode{std::move(kept)};
+    }
+
+    void TalosVM::process(const ASTNode& node)
+    {
+#ifdef TALOS_ENABLE_STATS
+        if (auto* stats = detail::active_stats) {
+            const auto counts = count_nodes(node);
+            for (std::size_t i = 0; i < node_kind_count; ++i) {
+                stats->nodes[i] += counts[i];
+            }
+            stats->peak_ast_nodes = std::max(stats->peak_ast_nodes, total_nodes(counts));
+        }
+#endif
+        if (options_.dump_ast != DumpFormat::None) {
+            TALOS_TRACE_SCOPE("dump_ast");
+            TALOS_TIME_PHASE(Phase::Dump);
+            dump_buffer_.clear();
+            dump_ast(node, options_.dump_ast, dump_buffer_);
+            if (options_.per_function && options_.dump_ast == DumpFormat::Json) {
+                dump_buffer_.push_back('\n');
+            }
+            std::fwrite(dump_buffer_.data(), 1, dump_buffer_.size(), options_.dump_output);
+        }
+    }
+
+    void TalosVM::run(const ProgramNode& program, VMSuccess& success) const
+    {
+        TALOS_TRACE_SCOPE("run");
+        auto bytecode = Program{};
+        {
+            TALOS_TIME_PHASE(Phase::Compile);
+            bytecode = compile_program(program);
+        }
+        TALOS_TIME_PHASE(Phase::Run);
+        auto interpreter = Interpreter{options_.stack_size, options_.max_call_depth, options_.memory_size};
+        const auto result = interpreter.run(bytecode);
+        if (is_integer(result.type)) {
+            success.main_result = result.integer;
+        }
+    }
+
+    void TalosVM::compile_native(const ProgramNode& program) const
+    {
+        TALOS_TRACE_SCOPE("compile_native");
+        TALOS_TIME_PHASE(Phase::Compile);
+        const auto assembly = emit_assembly(compile_program(program));
+        if (options_.native == NativeOutput::Executable) {
+            const auto runtime = runtime_source(options_.stack_size, options_.max_call_depth, options_.memory_size);
+            build_executable(assembly, runtime, options_.native_output.empty() ? "a.out" : options_.native_output);
+            return;
+        }
+        if (options_.native_output.empty()) {
+            std::fwrite(assembly.data(), 1, assembly.size(), options_.dump_output);
+            return;
+        }
+        auto file = std::ofstream{options_.native_output, std::ios::binary};
+        file << assembly;
+        if (!file) {
+            throw TalosException(ReturnCode::ToolchainError, SourceLocation{}, fmt::format("Could not write '{}'", options_.native_output));
+        }
+    }
+
+    VMReturn TalosVM::finish(VMReturn result, const Stats& stats) const
+    {
+        if (result && options_.collect_stats) {
+            result->stats = stats;
+            result->stats.peak_rss = peak_rss();
         }
-        std::stringstream sstream;
-        sstream << source_file.rdbuf();
-        return execute_string(sstream.str());
+        return result;
     }
 } // namespace talos
@@ -2,13 +2,125 @@
 
 #include "return_code.h"
 #include "expected.h"
+#include "frontend/ast_dump.h"
+#include "source_location.h"
+#include "stats.h"
 
+#include <fmt/format.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <optional>
 #include <string>
 #include <string_view>
+#include <vector>
 
 namespace talos {
+    class ASTNode;
+    class Parser;
+    class ProgramNode;
+    class FunctionCache;
+    class TokenSource;
+    struct CompiledDeclaration;
+    struct DeclarationTokens;
+
+    // What to compile a program to instead of running it
+    enum class NativeOutput {
+        None,
+        // x86-64 assembly text
+        Assembly,
+        // An executable linked with the runtime by the system toolchain
+        Executable,
+    };
+
+    // Which top-level declarations a whole program compiles
+    enum class Pruning {
+        // All of them
+        None,
+        // Only those reachable from main and the entry points, found after
+        // parsing the whole program. Syntax errors anywhere are still reported
+        Unreachable,
+        // The same, found from the tokens of each declaration so that only
+        // reachable ones are parsed
+        BeforeParsing,
+    };
+
+    struct VMOptions {
+        static constexpr std::size_t default_stream_chunk_size = 1024 * 1024;
+        static constexpr std::uint64_t default_cache_max_size = 64 * 1024 * 1024;
+        static constexpr std::size_t default_max_nesting_depth = 2048;
+        static constexpr std::size_t default_stack_size = std::size_t{1} << 20U;
+        static constexpr std::size_t default_max_call_depth = std::size_t{1} << 16U;
+        static constexpr std::size_t default_memory_size = std::size_t{64} << 20U;
+
+        // Collect phase timings and counters into VMSuccess::stats.
+        // Has no effect unless built with TALOS_ENABLE_STATS
+        bool collect_stats = false;
+        // Format in which the AST of each execution is dumped, if at all
+        DumpFormat dump_ast = DumpFormat::None;
+        std::FILE* dump_output = stdout;
+        // Lex on a separate thread, overlapping with parsing. The Lex phase time
+        // then only covers the time the parser spent waiting for tokens
+        bool pipeline_lexer = false;
+        // If non-zero, execute_file lexes the file in chunks of this many bytes
+        // instead of reading it whole first. Ignores pipeline_lexer
+        std::size_t stream_chunk_size = 0;
+        // Hand each top-level declaration to the later passes as soon as it is
+        // parsed and free it (and its source, when streaming) afterwards, so peak
+        // memory follows the largest declaration rather than the whole program.
+        // AST dumps then hold one tree per declaration, one per line for json
+        bool per_function = false;
+        // Programs whose AST nests deeper than this fail with NestingTooDeep
+        // instead of exhausting the stack of the parser or of later passes
+        std::size_t max_nesting_depth = default_max_nesting_depth;
+        // If non-empty, the results of compiling each top-level declaration are
+        // cached in this directory, keyed by a hash of its tokens, and only
+        // declarations changed since an earlier run are parsed and dumped again.
+        // Implies per_function. Binary dumps hold locations and are not cached.
+        // Running and native output check and compile the whole program, which
+        // is not cached, so the cache is not used with them. Concurrent
+        // processes may share the directory
+        std::string cache_directory;
+        // Size in bytes beyond which least recently used cache entries are evicted
+        std::uint64_t cache_max_size = default_cache_max_size;
+        // Type check the program, compile it to bytecode and run its main
+        // function. Needs the whole program, so ignores per_function and the cache
+        bool run = false;
+        // Values on the VM stack and nested calls before running fails with StackOverflow
+        std::size_t stack_size = default_stack_size;
+        std::size_t max_call_depth = default_max_call_depth;
+        // Bytes for the arrays of the running calls, which are reserved up front
+        std::size_t memory_size = default_memory_size;
+        // Compile the program to native code instead of running it, with the
+        // stack and memory sizes above. Needs the whole program like run
+        NativeOutput native = NativeOutput::None;
+        // File the assembly or executable is written to. If empty, assembly
+        // goes to dump_output and the executable to a.out
+        std::string native_output;
+        // Leave out declarations that can never run when running or compiling
+        // to native code, so that they are neither type checked nor compiled.
+        // Their errors are then not reported, and VMSuccess::functions only
+        // lists the functions that are kept
+        Pruning prune = Pruning::None;
+        // Functions an embedder calls besides main, kept when pruning
+        std::vector<std::string> entry_points;
+    };
+
+    struct FunctionSignature {
+        std::string name;
+        // Name of the return type, "Inferred" if it was not specified
+        std::string return_type;
+        SourceLocation location;
+    };
+
     struct VMSuccess {
         std::string output;
+        std::vector<FunctionSignature> functions;
+        // Result of main if the program was run and main returns an integer
+        std::optional<std::int64_t> main_result;
+        Stats stats;
     };
 
     struct VMError {
@@ -21,7 +133,34 @@ namespace talos {
     class TalosVM
     {
     public:
+        TalosVM();
+        explicit TalosVM(VMOptions options);
+        ~TalosVM();
+        TalosVM(TalosVM&&) noexcept;
+        TalosVM& operator=(TalosVM&&) noexcept;
+
         [[nodiscard]] VMReturn execute_string(std::string_view string);
         [[nodiscard]] VMReturn execute_file(std::string_view filename);
+        // Lexes file in chunks as it is read, e.g. to execute stdin
+        [[nodiscard]] VMReturn execute_stream(std::FILE* file);
+
+    private:
+        [[nodiscard]] VMReturn execute_source(std::string_view source);
+        [[nodiscard]] VMReturn execute_chunked(std::FILE* file);
+        [[nodiscard]] VMReturn execute(TokenSource& tokens);
+        [[nodiscard]] VMReturn execute_cached(TokenSource& tokens);
+        [[nodiscard]] CompiledDeclaration compile(const DeclarationTokens& declaration);
+        void emit(const CompiledDeclaration& compiled, const DeclarationTokens& declaration, VMSuccess& success);
+        [[nodiscard]] ProgramNode parse_reachable(TokenSource& tokens, Parser& parser) const;
+        void process(const ASTNode& node);
+        void run(const ProgramNode& program, VMSuccess& success) const;
+        void compile_native(const ProgramNode& program) const;
+        [[nodiscard]] VMReturn finish(VMReturn result, const Stats& stats) const;
+
+        VMOptions options_;
+        // Reused across executions so that dumping does not reallocate every time
+        fmt::memory_buffer dump_buffer_;
+        // Null unless VMOptions::cache_directory is set
+        std::unique_ptr<FunctionCache> cache_;
     };
 } // namespace talos
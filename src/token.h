@@ -22,10 +22,31 @@ namespace talos
         RightBrace,
         Equal,
         Colon,
+        Comma,
+        Percent,
+        EqualEqual,
+        Bang,
+        BangEqual,
+        Less,
+        LessEqual,
+        Greater,
+        GreaterEqual,
+        AmpAmp,
+        PipePipe,
+        Dot,
+        LeftBracket,
+        RightBracket,
 
         // Keywords
         Fun,
         Return,
+        If,
+        Else,
+        While,
+        For,
+        Struct,
+        Packed,
+        Soa,
         Identifier,
         Var,
         Let,
@@ -100,10 +121,52 @@ namespace talos
                 return "Equal";
             case TokenType::Colon:
                 return "Colon";
+            case TokenType::Comma:
+                return "Comma";
+            case TokenType::Percent:
+                return "Percent";
+            case TokenType::EqualEqual:
+                return "Equal Equal";
+            case TokenType::Bang:
+                return "Bang";
+            case TokenType::BangEqual:
+                return "Bang Equal";
+            case TokenType::Less:
+                return "Less";
+            case TokenType::LessEqual:
+                return "Less Equal";
+            case TokenType::Greater:
+                return "Greater";
+            case TokenType::GreaterEqual:
+                return "Greater Equal";
+            case TokenType::AmpAmp:
+                return "Amp Amp";
+            case TokenType::PipePipe:
+                return "Pipe Pipe";
+            case TokenType::Dot:
+                return "Dot";
+            case TokenType::LeftBracket:
+                return "Left Bracket";
+            case TokenType::RightBracket:
+                return "Right Bracket";
             case TokenType::Fun:
                 return "Fun";
             case TokenType::Return:
                 return "Return";
+            case TokenType::If:
+                return "If";
+            case TokenType::Else:
+                return "Else";
+            case TokenType::While:
+                return "While";
+            case TokenType::For:
+                return "For";
+            case TokenType::Struct:
+                return "Struct";
+            case TokenType::Packed:
+                return "Packed";
+            case TokenType::Soa:
+                return "Soa";
             case TokenType::Identifier:
                 return "Identifier";
             case TokenType::Var:
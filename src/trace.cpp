@@ -0,0 +1,276 @@
+#include "trace.h"
+
+#include <fmt/format.h>
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace talos::trace
+{
+    namespace
+    {
+        // Single producer (the owning thread), single consumer (the collector)
+        class RingBuffer
+        {
+        public:
+            static constexpr std::uint64_t capacity = 16 * 1024;
+
+            bool push(const Event& event) noexcept
+            {
+                const auto head = head_.load(std::memory_order_relaxed);
+                if (head - tail_.load(std::memory_order_acquire) >= capacity) {
+                    dropped_.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+                events_[head % capacity] = event;
+                head_.store(head + 1, std::memory_order_release);
+                return true;
+            }
+
+            template<typename F>
+            void drain(F&& sink)
+            {
+                auto tail = tail_.load(std::memory_order_relaxed);
+                const auto head = head_.load(std::memory_order_acquire);
+                for (; tail != head; ++tail) {
+                    sink(events_[tail % capacity]);
+                }
+                tail_.store(tail, std::memory_order_release);
+            }
+
+            [[nodiscard]] std::uint64_t dropped() const noexcept { return dropped_.load(std::memory_order_relaxed); }
+            std::uint64_t take_dropped() noexcept { return dropped_.exchange(0, std::memory_order_relaxed); }
+
+        private:
+            std::array<Event, capacity> events_{};
+            alignas(64) std::atomic<std::uint64_t> head_{0};
+            alignas(64) std::atomic<std::uint64_t> tail_{0};
+            std::atomic<std::uint64_t> dropped_{0};
+        };
+
+        struct ThreadBuffer {
+            std::uint32_t thread_id = 0;
+            std::string name;
+            RingBuffer ring;
+        };
+
+        struct Collector {
+            std::mutex mutex;
+            // Of the running threads
+            std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+            // Handed back by threads that exited, drained, for new threads to reuse
+            std::vector<std::shared_ptr<ThreadBuffer>> free_buffers;
+            // Ids and names of the threads that exited since the trace started,
+            // and the events they dropped
+            std::vector<std::pair<std::uint32_t, std::string>> exited_threads;
+            std::uint64_t exited_dropped = 0;
+            std::vector<Event> events;
+            std::jthread thread;
+            std::uint64_t start_time = 0;
+            std::uint32_t next_thread_id = 1;
+
+            // Must be called with mutex held
+            void drain_all()
+            {
+                for (const auto& buffer : buffers) {
+                    buffer->ring.drain([this](const Event& event) { events.push_back(event); });
+                }
+            }
+        };
+
+        Collector& collector()
+        {
+            static Collector instance;
+            return instance;
+        }
+
+        std::uint64_t now() noexcept
+        {
+            const auto time = std::chrono::steady_clock::now().time_since_epoch();
+            return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(time).count());
+        }
+
+        std::shared_ptr<ThreadBuffer> register_thread()
+        {
+            auto& instance = collector();
+            const auto lock = std::lock_guard{instance.mutex};
+            auto buffer = std::shared_ptr<ThreadBuffer>{};
+            if (instance.free_buffers.empty()) {
+                buffer = std::make_shared<ThreadBuffer>();
+            }
+            else {
+                buffer = std::move(instance.free_buffers.back());
+                instance.free_buffers.pop_back();
+            }
+            buffer->thread_id = instance.next_thread_id++;
+            instance.buffers.push_back(buffer);
+            return buffer;
+        }
+
+        // Keeps the events of an exiting thread and recycles its buffer, so
+        // that threads started for every execution, e.g. by PipelinedLexer,
+        // do not allocate a ring each
+        void release_thread(std::shared_ptr<ThreadBuffer> buffer)
+        {
+            auto& instance = collector();
+            const auto lock = std::lock_guard{instance.mutex};
+            buffer->ring.drain([&instance](const Event& event) { instance.events.push_back(event); });
+            instance.exited_dropped += buffer->ring.take_dropped();
+            instance.exited_threads.emplace_back(buffer->thread_id, std::move(buffer->name));
+            buffer->name.clear();
+            std::erase(instance.buffers, buffer);
+            instance.free_buffers.push_back(std::move(buffer));
+        }
+
+        // Registers the thread on construction and releases its buffer when the thread exits
+        class ThreadRegistration
+        {
+        public:
+            ThreadRegistration()
+                : buffer_(register_thread())
+            {
+            }
+            ~ThreadRegistration() { release_thread(std::move(buffer_)); }
+            ThreadRegistration(const ThreadRegistration&) = delete;
+            ThreadRegistration& operator=(const ThreadRegistration&) = delete;
+
+            [[nodiscard]] ThreadBuffer& buffer() const noexcept { return *buffer_; }
+
+        private:
+            std::shared_ptr<ThreadBuffer> buffer_;
+        };
+
+        ThreadBuffer& thread_buffer()
+        {
+            // Registration happens once per thread, every later event is lock-free
+            thread_local const auto registration = ThreadRegistration{};
+            return registration.buffer();
+        }
+
+        void record(const char* name, char phase) noexcept
+        {
+            auto& buffer = thread_buffer();
+            buffer.ring.push(Event{.name = name, .timestamp = now(), .thread_id = buffer.thread_id, .phase = phase});
+        }
+
+        void append_escaped(fmt::memory_buffer& out, std::string_view string)
+        {
+            for (const auto character : string) {
+                if (character == '"' || character == '\\') {
+                    out.push_back('\\');
+                }
+                out.push_back(character);
+            }
+        }
+    } // namespace
+
+    void start()
+    {
+        auto& instance = collector();
+        {
+            const auto lock = std::lock_guard{instance.mutex};
+            instance.drain_all();
+            instance.events.clear();
+            instance.exited_threads.clear();
+            instance.exited_dropped = 0;
+            instance.start_time = now();
+        }
+        detail::active.store(true, std::memory_order_relaxed);
+        instance.thread = std::jthread{[&instance](const std::stop_token& stop_token) {
+            while (!stop_token.stop_requested()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds{2});
+                const auto lock = std::lock_guard{instance.mutex};
+                instance.drain_all();
+            }
+        }};
+    }
+
+    bool stop(const std::string& filename)
+    {
+        detail::active.store(false, std::memory_order_relaxed);
+        auto& instance = collector();
+        instance.thread = std::jthread{};
+
+        auto out = fmt::memory_buffer{};
+        std::uint64_t dropped = 0;
+        {
+            const auto lock = std::lock_guard{instance.mutex};
+            instance.drain_all();
+            fmt::format_to(std::back_inserter(out), "{{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+            bool first = true;
+            auto separator = [&]() {
+                if (!first) {
+                    fmt::format_to(std::back_inserter(out), ",\n");
+                }
+                first = false;
+            };
+            const auto thread_name = [&](std::uint32_t thread_id, const std::string& name) {
+                separator();
+                fmt::format_to(std::back_inserter(out), R"({{"name":"thread_name","ph":"M","pid":1,"tid":{},"args":{{"name":")", thread_id);
+                append_escaped(out, name.empty() ? fmt::format("thread {}", thread_id) : name);
+                fmt::format_to(std::back_inserter(out), "\"}}}}");
+            };
+            for (const auto& buffer : instance.buffers) {
+                dropped += buffer->ring.dropped();
+                thread_name(buffer->thread_id, buffer->name);
+            }
+            for (const auto& [thread_id, name] : instance.exited_threads) {
+                thread_name(thread_id, name);
+            }
+            dropped += instance.exited_dropped;
+            for (const auto& event : instance.events) {
+                if (event.timestamp < instance.start_time) {
+                    continue;
+                }
+                separator();
+                const auto microseconds = static_cast<double>(event.timestamp - instance.start_time) / 1000.0;
+                fmt::format_to(std::back_inserter(out), R"({{"name":")");
+                append_escaped(out, event.name);
+                fmt::format_to(std::back_inserter(out), R"(","ph":"{}","ts":{:.3f},"pid":1,"tid":{}}})",
+                               event.phase, microseconds, event.thread_id);
+            }
+            fmt::format_to(std::back_inserter(out), "\n],\"otherData\":{{\"dropped_events\":{}}}}}\n", dropped);
+            instance.events.clear();
+            instance.exited_threads.clear();
+            instance.exited_dropped = 0;
+        }
+
+        auto* file = std::fopen(filename.c_str(), "wb");
+        if (file == nullptr) {
+            return false;
+        }
+        const auto written = std::fwrite(out.data(), 1, out.size(), file);
+        return std::fclose(file) == 0 && written == out.size();
+    }
+
+    void set_thread_name(std::string name)
+    {
+        auto& buffer = thread_buffer();
+        const auto lock = std::lock_guard{collector().mutex};
+        buffer.name = std::move(name);
+    }
+
+    std::size_t allocated_buffers()
+    {
+        auto& instance = collector();
+        const auto lock = std::lock_guard{instance.mutex};
+        return instance.buffers.size() + instance.free_buffers.size();
+    }
+
+    void begin(const char* name) noexcept
+    {
+        record(name, 'B');
+    }
+
+    void end(const char* name) noexcept
+    {
+        record(name, 'E');
+    }
+} // namespace talos::trace
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace talos::trace
+{
+    struct Event {
+        // Must point to a string with static storage duration
+        const char* name;
+        std::uint64_t timestamp;
+        std::uint32_t thread_id;
+        char phase;
+    };
+
+    namespace detail
+    {
+        inline std::atomic<bool> active{false};
+    } // namespace detail
+
+    [[nodiscard]] inline bool is_active() noexcept
+    {
+        return detail::active.load(std::memory_order_relaxed);
+    }
+
+    // Starts recording events from every thread. Events are kept in per-thread
+    // lock-free ring buffers which a collector thread drains in the background
+    void start();
+
+    // Stops recording and writes all collected events to filename in the Chrome
+    // trace-event JSON format (viewable in chrome://tracing or Perfetto).
+    // Returns false if the file could not be written
+    [[nodiscard]] bool stop(const std::string& filename);
+
+    // Names the calling thread in the trace
+    void set_thread_name(std::string name);
+
+    // Per-thread ring buffers allocated so far. Threads that exit hand theirs
+    // back for new threads to reuse
+    [[nodiscard]] std::size_t allocated_buffers();
+
+    void begin(const char* name) noexcept;
+    void end(const char* name) noexcept;
+
+    // Records a begin event on construction and the matching end event on destruction
+    class Scope
+    {
+    public:
+        explicit Scope(const char* name) noexcept
+            : name_(is_active() ? name : nullptr)
+        {
+            if (name_ != nullptr) {
+                begin(name_);
+            }
+        }
+
+        ~Scope()
+        {
+            if (name_ != nullptr) {
+                end(name_);
+            }
+        }
+
+        Scope(const Scope&) = delete;
+        Scope(Scope&&) = delete;
+        Scope& operator=(const Scope&) = delete;
+        Scope& operator=(Scope&&) = delete;
+
+    private:
+        const char* name_;
+    };
+} // namespace talos::trace
+
+// Expands to nothing unless TALOS_ENABLE_TRACING is defined
+#ifdef TALOS_ENABLE_TRACING
+    #define TALOS_TRACE_CONCAT_IMPL(lhs, rhs) lhs##rhs
+    #define TALOS_TRACE_CONCAT(lhs, rhs) TALOS_TRACE_CONCAT_IMPL(lhs, rhs)
+    #define TALOS_TRACE_SCOPE(name) \
+        const ::talos::trace::Scope TALOS_TRACE_CONCAT(talos_trace_scope_, __LINE__) { name }
+#else
+    #define TALOS_TRACE_SCOPE(name) static_cast<void>(0)
+#endif
@@ -0,0 +1,125 @@
+#include "bytecode.h"
+
+#include <fmt/format.h>
+
+#include <iterator>
+
+namespace talos
+{
+    namespace
+    {
+        void disassemble(const Program& program, const Function& function, fmt::memory_buffer& out)
+        {
+            const auto output = std::back_inserter(out);
+            fmt::format_to(output, "fun {} ({} parameters, {} registers", function.name, function.parameter_count, function.register_count);
+            if (function.memory_size != 0) {
+                fmt::format_to(output, ", {} bytes", function.memory_size);
+            }
+            fmt::format_to(output, ")\n");
+            for (std::size_t i = 0; i < function.code.size(); ++i) {
+                const auto& instruction = function.code[i];
+                fmt::format_to(output, "  {:>4}  {:<12}", i, format_as(instruction.op));
+                switch (instruction.op) {
+                    case OpCode::LoadConst:
+                        fmt::format_to(output, "r{}, {}", instruction.a, format_as(function.constants.at(instruction.b)));
+                        break;
+                    case OpCode::Move:
+                    case OpCode::Negate:
+                    case OpCode::Not:
+                    case OpCode::FillColumn:
+                        fmt::format_to(output, "r{}, r{}", instruction.a, instruction.b);
+                        break;
+                    case OpCode::CheckIndex:
+                    case OpCode::CopyArray:
+                    case OpCode::FillArray:
+                        fmt::format_to(output, "r{}, r{}, {}", instruction.a, instruction.b, program.arrays.at(instruction.c).name);
+                        break;
+                    case OpCode::ExtraArg: {
+                        const auto& layout = program.arrays.at(instruction.a);
+                        fmt::format_to(output, "{}", layout.name);
+                        if (is_struct(layout.element)) {
+                            fmt::format_to(output, ", {}", instruction.b);
+                        }
+                        break;
+                    }
+                    case OpCode::LoadGlobal:
+                        fmt::format_to(output, "r{}, g{}", instruction.a, instruction.b);
+                        break;
+                    case OpCode::StoreGlobal:
+                        fmt::format_to(output, "g{}, r{}", instruction.a, instruction.b);
+                        break;
+                    case OpCode::Add:
+                    case OpCode::Subtract:
+                    case OpCode::Multiply:
+                    case OpCode::Divide:
+                    case OpCode::Modulo:
+                    case OpCode::Equal:
+                    case OpCode::NotEqual:
+                    case OpCode::Less:
+                    case OpCode::LessEqual:
+                    case OpCode::LoadIndex:
+                    case OpCode::StoreIndex:
+                    case OpCode::LoadColumn:
+                    case OpCode::StoreColumn:
+                    case OpCode::VecAdd:
+                    case OpCode::VecSubtract:
+                    case OpCode::VecMultiply:
+                    case OpCode::VecDivide:
+                        fmt::format_to(output, "r{}, r{}, r{}", instruction.a, instruction.b, instruction.c);
+                        break;
+                    case OpCode::Jump:
+                        fmt::format_to(output, "{}", instruction.a);
+                        break;
+                    case OpCode::JumpIfTrue:
+                    case OpCode::JumpIfFalse:
+                        fmt::format_to(output, "r{}, {}", instruction.a, instruction.b);
+                        break;
+                    case OpCode::JumpIfEqual:
+                    case OpCode::JumpIfNotEqual:
+                    case OpCode::JumpIfLess:
+                    case OpCode::JumpIfNotLess:
+                    case OpCode::JumpIfLessEqual:
+                    case OpCode::JumpIfNotLessEqual:
+                        fmt::format_to(output, "r{}, r{}, {}", instruction.a, instruction.b, instruction.c);
+                        break;
+                    case OpCode::Call:
+                        fmt::format_to(output, "r{}, {}, {}", instruction.a, program.functions.at(instruction.b).name, instruction.c);
+                        break;
+                    case OpCode::Return:
+                        fmt::format_to(output, "r{}", instruction.a);
+                        break;
+                    case OpCode::ReturnSlots:
+                        fmt::format_to(output, "r{}, {}", instruction.a, instruction.b);
+                        break;
+                    case OpCode::ReturnVoid:
+                        break;
+                    case OpCode::FrameArray:
+                        fmt::format_to(output, "r{}, {}, {}", instruction.a, program.arrays.at(instruction.b).name, format_as(function.constants.at(instruction.c)));
+                        break;
+                }
+                // Without trailing blanks
+                while (out.size() > 0 && out.data()[out.size() - 1] == ' ') {
+                    out.resize(out.size() - 1);
+                }
+                out.push_back('\n');
+            }
+        }
+    } // namespace
+
+    std::size_t result_slots(const Program& program, const Function& function)
+    {
+        if (function.return_type == Type::Void) {
+            return 0;
+        }
+        return is_struct(function.return_type) ? program.structs[struct_index(function.return_type)].slots.size() : 1;
+    }
+
+    std::string disassemble(const Program& program)
+    {
+        auto out = fmt::memory_buffer{};
+        for (const auto& function : program.functions) {
+            disassemble(program, function, out);
+        }
+        return fmt::to_string(out);
+    }
+} // namespace talos
@@ -0,0 +1,256 @@
+#pragma once
+
+#include "layout.h"
+#include "source_location.h"
+#include "value.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace talos
+{
+    // Index of a register within the frame of the running function
+    using Register = std::uint16_t;
+
+    // R[x] is register x of the running function, K[x] its constant x and
+    // G[x] global variable x. A register holding an array points to its
+    // elements, E[x] is element x of the array in R[a], and A[x] is
+    // Program::arrays[x]. Registers are untyped words: instructions whose
+    // behaviour depends on the type of their operands carry it, see
+    // Instruction::type
+    enum class OpCode : std::uint8_t {
+        // R[a] = K[b]
+        LoadConst,
+        // R[a] = R[b]
+        Move,
+        // R[a] = G[b]
+        LoadGlobal,
+        // G[a] = R[b]
+        StoreGlobal,
+        // R[a] = R[b] op R[c], of the given type
+        Add,
+        Subtract,
+        Multiply,
+        Divide,
+        Modulo,
+        // R[a] = R[b] op R[c], a bool. The type is that of the operands
+        Equal,
+        NotEqual,
+        Less,
+        LessEqual,
+        // R[a] = -R[b], of the given type
+        Negate,
+        // R[a] = !R[b]
+        Not,
+        // Continues at instruction a
+        Jump,
+        // Continues at instruction b if R[a] is true, or false
+        JumpIfTrue,
+        JumpIfFalse,
+        // Continues at instruction c if R[a] op R[b], of the given type.
+        // Comparisons and the jumps they guard are fused, and each has a
+        // negation that is true for NaN
+        JumpIfEqual,
+        JumpIfNotEqual,
+        JumpIfLess,
+        JumpIfNotLess,
+        JumpIfLessEqual,
+        JumpIfNotLessEqual,
+        // Calls function b with the c arguments in R[a] onwards, which become
+        // the first registers of its frame. The result is returned in R[a]
+        Call,
+        // Returns R[a]
+        Return,
+        // Returns the b registers from R[a] onwards, the scalars of a struct
+        ReturnSlots,
+        ReturnVoid,
+        // R[a] = an array of type Program::arrays[b], stored K[c] bytes into
+        // the memory of the running function
+        FrameArray,
+        // R[a] = R[b][R[c]], the type is that of the elements
+        LoadIndex,
+        // E[R[b]] = R[c], the type is that of the elements
+        StoreIndex,
+        // Fails with IndexOutOfBounds unless R[b] indexes R[a], of type A[c]
+        CheckIndex,
+        // Every E[i] = R[b][i], both of type A[c]
+        CopyArray,
+        // Every E[i] = R[b], of type A[c]
+        FillArray,
+        // R[a] = one scalar of R[b][R[c]], an element of an array of structs,
+        // of the given type. The array has type A[a] of the ExtraArg that
+        // follows, and the scalar is in its column b, see ArrayLayout::columns
+        LoadColumn,
+        // The scalar of E[R[b]] in the column of the ExtraArg = R[c], of the
+        // given type, see LoadColumn
+        StoreColumn,
+        // The scalar of every E[i] in the column of the ExtraArg = R[b], see
+        // LoadColumn
+        FillColumn,
+        // Every E[i] = R[b][i] op R[c][i], on vectors of elements at once. The
+        // arrays have type A[a] of the ExtraArg that follows
+        VecAdd,
+        VecSubtract,
+        VecMultiply,
+        VecDivide,
+        // Operand of the instruction before it, never executed on its own
+        ExtraArg,
+    };
+
+    constexpr auto format_as(OpCode op)
+    {
+        switch (op) {
+            case OpCode::LoadConst:
+                return "LoadConst";
+            case OpCode::Move:
+                return "Move";
+            case OpCode::LoadGlobal:
+                return "LoadGlobal";
+            case OpCode::StoreGlobal:
+                return "StoreGlobal";
+            case OpCode::Add:
+                return "Add";
+            case OpCode::Subtract:
+                return "Subtract";
+            case OpCode::Multiply:
+                return "Multiply";
+            case OpCode::Divide:
+                return "Divide";
+            case OpCode::Modulo:
+                return "Modulo";
+            case OpCode::Equal:
+                return "Equal";
+            case OpCode::NotEqual:
+                return "NotEqual";
+            case OpCode::Less:
+                return "Less";
+            case OpCode::LessEqual:
+                return "LessEqual";
+            case OpCode::Negate:
+                return "Negate";
+            case OpCode::Not:
+                return "Not";
+            case OpCode::Jump:
+                return "Jump";
+            case OpCode::JumpIfTrue:
+                return "JumpIfTrue";
+            case OpCode::JumpIfFalse:
+                return "JumpIfFalse";
+            case OpCode::JumpIfEqual:
+                return "JumpIfEqual";
+            case OpCode::JumpIfNotEqual:
+                return "JumpIfNotEqual";
+            case OpCode::JumpIfLess:
+                return "JumpIfLess";
+            case OpCode::JumpIfNotLess:
+                return "JumpIfNotLess";
+            case OpCode::JumpIfLessEqual:
+                return "JumpIfLessEqual";
+            case OpCode::JumpIfNotLessEqual:
+                return "JumpIfNotLessEqual";
+            case OpCode::Call:
+                return "Call";
+            case OpCode::Return:
+                return "Return";
+            case OpCode::ReturnSlots:
+                return "ReturnSlots";
+            case OpCode::ReturnVoid:
+                return "ReturnVoid";
+            case OpCode::FrameArray:
+                return "FrameArray";
+            case OpCode::LoadIndex:
+                return "LoadIndex";
+            case OpCode::StoreIndex:
+                return "StoreIndex";
+            case OpCode::CheckIndex:
+                return "CheckIndex";
+            case OpCode::CopyArray:
+                return "CopyArray";
+            case OpCode::FillArray:
+                return "FillArray";
+            case OpCode::LoadColumn:
+                return "LoadColumn";
+            case OpCode::StoreColumn:
+                return "StoreColumn";
+            case OpCode::FillColumn:
+                return "FillColumn";
+            case OpCode::VecAdd:
+                return "VecAdd";
+            case OpCode::VecSubtract:
+                return "VecSubtract";
+            case OpCode::VecMultiply:
+                return "VecMultiply";
+            case OpCode::VecDivide:
+                return "VecDivide";
+            case OpCode::ExtraArg:
+                return "ExtraArg";
+        }
+        return "Unknown";
+    }
+
+    struct Instruction {
+        OpCode op;
+        // Type of the scalars the instruction operates on, where that decides
+        // what it does, e.g. whether Add adds integers or floats. Scalar types
+        // fit the byte that would otherwise be padding, see operand_type
+        std::uint8_t type = 0;
+        std::uint16_t a = 0;
+        std::uint16_t b = 0;
+        std::uint16_t c = 0;
+    };
+
+    static_assert(sizeof(Instruction) == 8);
+
+    [[nodiscard]] constexpr Type operand_type(Instruction instruction) noexcept
+    {
+        return static_cast<Type>(instruction.type);
+    }
+
+    struct Function {
+        std::string name;
+        // Registers the arguments take, structs take one per scalar
+        std::uint16_t parameter_count = 0;
+        // Size of the frame. The result is returned in the first registers, so
+        // there are always enough for it
+        std::uint16_t register_count = 1;
+        // Bytes of memory each call reserves for the arrays of its locals and
+        // temporaries
+        std::size_t memory_size = 0;
+        Type return_type = Type::Void;
+        std::vector<Instruction> code;
+        // Source location of each instruction, reported by runtime errors
+        std::vector<SourceLocation> locations;
+        std::vector<Value> constants;
+    };
+
+    struct Program {
+        std::vector<Function> functions;
+        // Types of the global slots, which are zero until initialized. Global
+        // structs take one slot per scalar
+        std::vector<Type> globals;
+        // Indexed by struct_index
+        std::vector<StructLayout> structs;
+        // Indexed by array_index
+        std::vector<ArrayLayout> arrays;
+        // Contents of the string constants, each distinct one stored once so
+        // that equal literals share it. Elements never move
+        std::unordered_set<std::string> strings;
+        // Elements of the array constants, which never move either
+        std::deque<std::vector<std::byte>> array_constants;
+        // Runs the top-level statements in source order
+        std::uint32_t initializer = 0;
+        std::optional<std::uint32_t> main;
+    };
+
+    // Registers the result of a call to function takes, from where the caller
+    // put the first argument
+    [[nodiscard]] std::size_t result_slots(const Program& program, const Function& function);
+
+    // One line per instruction, grouped by function
+    [[nodiscard]] std::string disassemble(const Program& program);
+} // namespace talos
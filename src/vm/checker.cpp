@@ -0,0 +1,1003 @@
+#include "checker.h"
+
+#include "exceptions.h"
+#include "value.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <charconv>
+#include <limits>
+#include <string_view>
+
+namespace talos
+{
+    namespace
+    {
+        // Type of a checked expression. Literals without a suffix, and arithmetic
+        // on nothing but such literals, are untyped until their context decides
+        struct ExprType {
+            Type type;
+            bool untyped = false;
+        };
+
+        enum class State : std::uint8_t {
+            Unchecked,
+            Checking,
+            Checked,
+        };
+
+        // Inferring the return type of a function checks it on the spot, which
+        // may in turn check the functions it calls
+        constexpr int max_inference_depth = 256;
+
+        bool is_true_literal(const Expr* expr) noexcept
+        {
+            return expr != nullptr && expr->kind() == NodeKind::BoolLiteralExpr &&
+                   static_cast<const BoolLiteralExpr*>(expr)->bool_literal().type == TokenType::TrueLiteral;
+        }
+
+        // The literal operand of a '-', which may be one further from zero than
+        // the literal alone, as in -128i8
+        const IntLiteralExpr* negated_literal(const UnaryExpr& unary) noexcept
+        {
+            const auto* operand = unary.expr();
+            if (unary.unary_op().type != TokenType::Minus || operand->kind() != NodeKind::IntLiteralExpr) {
+                return nullptr;
+            }
+            return static_cast<const IntLiteralExpr*>(operand);
+        }
+
+        // Arrays hold scalars or structs, which cannot contain arrays
+        constexpr bool is_element(Type type) noexcept
+        {
+            return is_scalar(type) || is_struct(type);
+        }
+
+        TalosException redefinition(const Token& identifier)
+        {
+            return {ReturnCode::Redefinition, identifier.location, fmt::format("'{}' is already declared", identifier.string)};
+        }
+
+        // Nested struct values are flattened into the registers of the outer one
+        constexpr std::size_t max_struct_slots = std::numeric_limits<std::uint16_t>::max();
+
+        // The length of an array is an i32
+        constexpr auto max_array_length = static_cast<std::uint32_t>(std::numeric_limits<std::int32_t>::max());
+
+        class Checker
+        {
+        public:
+            explicit Checker(const ProgramNode& program)
+                : program_(program)
+            {
+            }
+
+            CheckedProgram check()
+            {
+                declare_top_level();
+                for (const auto& statement : program_.statements()) {
+                    if (statement->kind() == NodeKind::VarDeclStatement) {
+                        check_global(checked_.variables.at(static_cast<const VarDeclStatement*>(statement.get())).index);
+                    }
+                    else if (statement->kind() != NodeKind::FunDeclStatement && statement->kind() != NodeKind::StructDeclStatement) {
+                        auto context = Context{.function = CheckedProgram::initializer};
+                        check_statement(context, *statement);
+                    }
+                }
+                for (std::uint32_t function = 0; function < checked_.functions.size(); ++function) {
+                    if (function_states_[function] == State::Unchecked) {
+                        check_function(function);
+                    }
+                }
+                check_main();
+                return std::move(checked_);
+            }
+
+        private:
+            // Function being checked and the locals in scope
+            struct Context {
+                struct Local {
+                    std::string_view name;
+                    std::uint32_t index;
+                };
+
+                std::uint32_t function;
+                std::vector<Local> locals;
+            };
+
+            void declare_top_level()
+            {
+                // Structs first, the other declarations may use them as types
+                for (const auto& statement : program_.statements()) {
+                    if (statement->kind() == NodeKind::StructDeclStatement) {
+                        const auto& declaration = static_cast<const StructDeclStatement&>(*statement);
+                        if (struct_declarations_.size() == max_struct_types) {
+                            throw type_error(declaration.identifier().location, fmt::format("Programs cannot have more than {} structs", max_struct_types));
+                        }
+                        add_top_level(declaration.identifier(), Binding{.kind = Binding::Kind::Struct, .index = static_cast<std::uint32_t>(struct_declarations_.size())});
+                        struct_declarations_.push_back(&declaration);
+                    }
+                }
+                checked_.structs.resize(struct_declarations_.size());
+                struct_states_.resize(struct_declarations_.size(), State::Unchecked);
+                for (std::uint32_t index = 0; index < struct_declarations_.size(); ++index) {
+                    layout(index);
+                }
+
+                add_function(FunctionInfo{.name = "<init>"}, std::nullopt, true);
+                function_states_.back() = State::Checked;
+                for (const auto& statement : program_.statements()) {
+                    switch (statement->kind()) {
+                        case NodeKind::FunDeclStatement: {
+                            const auto& function = static_cast<const FunDeclStatement&>(*statement);
+                            const auto index = declare_function(function, std::nullopt);
+                            add_top_level(function.identifier(), Binding{.kind = Binding::Kind::Function, .index = index});
+                            break;
+                        }
+                        case NodeKind::VarDeclStatement: {
+                            const auto& variable = static_cast<const VarDeclStatement&>(*statement);
+                            const auto binding = Binding{
+                                .kind = Binding::Kind::Global,
+                                .index = static_cast<std::uint32_t>(checked_.globals.size()),
+                            };
+                            checked_.globals.push_back(Variable{.type = Type::Void, .is_mutable = variable.decl_type().type == TokenType::Var});
+                            global_declarations_.push_back(&variable);
+                            global_states_.push_back(State::Unchecked);
+                            checked_.variables.emplace(&variable, binding);
+                            add_top_level(variable.identifier(), binding);
+                            break;
+                        }
+                        default:
+                            break;
+                    }
+                }
+            }
+
+            // Lays out struct index after the structs it contains
+            void layout(std::uint32_t index)
+            {
+                if (struct_states_[index] == State::Checked) {
+                    return;
+                }
+                const auto& declaration = *struct_declarations_[index];
+                const auto identifier = declaration.identifier();
+                if (struct_states_[index] == State::Checking) {
+                    throw type_error(identifier.location, fmt::format("'{}' contains itself", identifier.string));
+                }
+                struct_states_[index] = State::Checking;
+                auto fields = std::vector<std::pair<std::string, Type>>{};
+                for (const auto& field : declaration.fields()) {
+                    const auto name = field.identifier.string;
+                    if (std::ranges::any_of(fields, [&](const auto& other) { return other.first == name; })) {
+                        throw redefinition(field.identifier);
+                    }
+                    const auto type = resolve_type(field.type_spec);
+                    if (is_array(type)) {
+                        throw type_error(field.identifier.location, fmt::format("Field '{}' cannot be an array", name));
+                    }
+                    if (is_struct(type)) {
+                        layout(static_cast<std::uint32_t>(struct_index(type)));
+                    }
+                    fields.emplace_back(name, type);
+                }
+                auto result = layout_struct(std::string{identifier.string}, declaration.packed(), fields, checked_.structs);
+                result.soa = declaration.soa();
+                if (result.slots.size() > max_struct_slots) {
+                    throw type_error(identifier.location, fmt::format("'{}' has more than {} scalar fields", identifier.string, max_struct_slots));
+                }
+                checked_.structs[index] = std::move(result);
+                struct_states_[index] = State::Checked;
+            }
+
+            Type resolve_type(const Token& type_spec) const
+            {
+                if (const auto type = builtin_type(type_spec.type)) {
+                    return *type;
+                }
+                if (type_spec.type == TokenType::Identifier) {
+                    const auto binding = top_level_.find(type_spec.string);
+                    if (binding != top_level_.end() && binding->second.kind == Binding::Kind::Struct) {
+                        return struct_type(binding->second.index);
+                    }
+                }
+                throw type_error(type_spec.location, fmt::format("Unknown type '{}'", type_spec.string));
+            }
+
+            Type resolve_type(const TypeSpec& type_spec)
+            {
+                const auto type = resolve_type(type_spec.name);
+                if (!type_spec.length) {
+                    return type;
+                }
+                if (!is_element(type)) {
+                    throw type_error(type_spec.name.location, fmt::format("Array elements must be scalars or structs, not {}", checked_.name_of(type)));
+                }
+                return array_of(type, array_length(*type_spec.length), type_spec.length->location);
+            }
+
+            static std::uint32_t array_length(const Token& length)
+            {
+                auto value = std::uint32_t{};
+                const auto [end, error] = std::from_chars(length.string.data(), length.string.data() + length.string.size(), value);
+                if (error != std::errc{} || end != length.string.data() + length.string.size() || value == 0 || value > max_array_length) {
+                    throw type_error(length.location, fmt::format("Array length {} must be between 1 and {}", length.string, max_array_length));
+                }
+                return value;
+            }
+
+            // Each array type is numbered once, however often it is spelled
+            Type array_of(Type element, std::uint32_t length, SourceLocation location)
+            {
+                const auto existing = std::ranges::find_if(checked_.arrays, [&](const auto& array) { return array.element == element && array.length == length; });
+                if (existing != checked_.arrays.end()) {
+                    return array_type(static_cast<std::size_t>(existing - checked_.arrays.begin()));
+                }
+                if (checked_.arrays.size() == max_array_types) {
+                    throw type_error(location, fmt::format("Programs cannot have more than {} array types", max_array_types));
+                }
+                checked_.arrays.push_back(layout_array(fmt::format("[{}]{}", length, checked_.name_of(element)), element, length, checked_.structs));
+                return array_type(checked_.arrays.size() - 1);
+            }
+
+            // Declares function and the functions nested in it
+            std::uint32_t declare_function(const FunDeclStatement& function, std::optional<std::uint32_t> parent)
+            {
+                auto info = FunctionInfo{.declaration = &function, .name = std::string{function.identifier().string}};
+                for (const auto& parameter : function.parameters()) {
+                    info.parameters.push_back(resolve_type(parameter.type_spec));
+                }
+                const auto type_spec = function.type_spec();
+                if (type_spec) {
+                    info.return_type = resolve_type(*type_spec);
+                }
+                const auto index = add_function(std::move(info), parent, type_spec.has_value());
+
+                for (const auto& statement : function.statements()) {
+                    if (statement->kind() != NodeKind::FunDeclStatement) {
+                        continue;
+                    }
+                    const auto& nested = static_cast<const FunDeclStatement&>(*statement);
+                    const auto nested_index = declare_function(nested, index);
+                    for (const auto& [name, other] : nested_functions_[index]) {
+                        if (name == nested.identifier().string) {
+                            throw redefinition(nested.identifier());
+                        }
+                    }
+                    nested_functions_[index].emplace_back(nested.identifier().string, nested_index);
+                }
+                return index;
+            }
+
+            std::uint32_t add_function(FunctionInfo info, std::optional<std::uint32_t> parent, bool return_type_known)
+            {
+                const auto index = static_cast<std::uint32_t>(checked_.functions.size());
+                checked_.functions.push_back(std::move(info));
+                function_states_.push_back(State::Unchecked);
+                return_type_known_.push_back(return_type_known);
+                parents_.push_back(parent);
+                nested_functions_.emplace_back();
+                return index;
+            }
+
+            void add_top_level(const Token& identifier, Binding binding)
+            {
+                if (!top_level_.emplace(identifier.string, binding).second) {
+                    throw redefinition(identifier);
+                }
+            }
+
+            void check_function(std::uint32_t index)
+            {
+                function_states_[index] = State::Checking;
+                auto& info = checked_.functions[index];
+                const auto& declaration = *info.declaration;
+                auto context = Context{.function = index};
+                for (std::size_t i = 0; i < info.parameters.size(); ++i) {
+                    // Parameters cannot be assigned to
+                    add_local(context, declaration.parameters()[i].identifier, Variable{.type = info.parameters[i], .is_mutable = false});
+                }
+
+                auto completes = true;
+                for (const auto& statement : declaration.statements()) {
+                    check_statement(context, *statement);
+                    completes = completes && can_complete(*statement);
+                }
+                if (!return_type_known_[index]) {
+                    // No return statement
+                    info.return_type = Type::Void;
+                    return_type_known_[index] = true;
+                }
+                if (info.return_type != Type::Void && completes) {
+                    throw type_error(declaration.identifier().location, fmt::format("'{}' must return a value of type {}", info.name, checked_.name_of(info.return_type)));
+                }
+                function_states_[index] = State::Checked;
+            }
+
+            void check_global(std::uint32_t index)
+            {
+                if (global_states_[index] == State::Checked) {
+                    return;
+                }
+                const auto& declaration = *global_declarations_[index];
+                if (global_states_[index] == State::Checking) {
+                    throw type_error(declaration.identifier().location, fmt::format("The type of '{}' depends on itself", declaration.identifier().string));
+                }
+                global_states_[index] = State::Checking;
+                auto context = Context{.function = CheckedProgram::initializer};
+                checked_.globals[index].type = variable_type(context, declaration);
+                global_states_[index] = State::Checked;
+            }
+
+            void check_main()
+            {
+                const auto main = top_level_.find("main");
+                if (main == top_level_.end() || main->second.kind != Binding::Kind::Function) {
+                    return;
+                }
+                const auto& info = checked_.functions[main->second.index];
+                const auto location = info.declaration->identifier().location;
+                if (!info.parameters.empty()) {
+                    throw type_error(location, "main must not take parameters");
+                }
+                if (info.return_type != Type::Void && !is_integer(info.return_type)) {
+                    throw type_error(location, fmt::format("main must return an integer or nothing, not {}", checked_.name_of(info.return_type)));
+                }
+                checked_.main = main->second.index;
+            }
+
+            void check_statement(Context& context, const Statement& statement)
+            {
+                switch (statement.kind()) {
+                    case NodeKind::ExprStatement: {
+                        const auto& expr = *static_cast<const ExprStatement&>(statement).expr();
+                        finalize(expr, check_expr(context, expr));
+                        break;
+                    }
+                    case NodeKind::ReturnStatement:
+                        check_return(context, *static_cast<const ReturnStatement&>(statement).return_value());
+                        break;
+                    case NodeKind::VarDeclStatement: {
+                        const auto& declaration = static_cast<const VarDeclStatement&>(statement);
+                        // The initializer cannot refer to the variable it initializes
+                        const auto type = variable_type(context, declaration);
+                        const auto index = add_local(context, declaration.identifier(), Variable{
+                                                                                         .type = type,
+                                                                                         .is_mutable = declaration.decl_type().type == TokenType::Var,
+                                                                                     });
+                        checked_.variables.emplace(&declaration, Binding{.kind = Binding::Kind::Local, .index = index});
+                        break;
+                    }
+                    case NodeKind::BlockStatement: {
+                        const auto scope = context.locals.size();
+                        for (const auto& child : static_cast<const BlockStatement&>(statement).statements()) {
+                            check_statement(context, *child);
+                        }
+                        context.locals.resize(scope);
+                        break;
+                    }
+                    case NodeKind::IfStatement: {
+                        const auto& if_statement = static_cast<const IfStatement&>(statement);
+                        check_condition(context, *if_statement.condition());
+                        check_statement(context, *if_statement.then_branch());
+                        if (const auto* else_branch = if_statement.else_branch()) {
+                            check_statement(context, *else_branch);
+                        }
+                        break;
+                    }
+                    case NodeKind::WhileStatement: {
+                        const auto& while_statement = static_cast<const WhileStatement&>(statement);
+                        check_condition(context, *while_statement.condition());
+                        check_statement(context, *while_statement.body());
+                        break;
+                    }
+                    case NodeKind::ForStatement: {
+                        // Variables of the initializer are scoped to the loop
+                        const auto scope = context.locals.size();
+                        const auto& for_statement = static_cast<const ForStatement&>(statement);
+                        if (const auto* initializer = for_statement.initializer()) {
+                            check_statement(context, *initializer);
+                        }
+                        if (const auto* condition = for_statement.condition()) {
+                            check_condition(context, *condition);
+                        }
+                        if (const auto* increment = for_statement.increment()) {
+                            finalize(*increment, check_expr(context, *increment));
+                        }
+                        check_statement(context, *for_statement.body());
+                        context.locals.resize(scope);
+                        break;
+                    }
+                    default:
+                        // Nested functions are checked on their own
+                        break;
+                }
+            }
+
+            void check_condition(Context& context, const Expr& condition)
+            {
+                const auto type = check_expr(context, condition);
+                if (type.type != Type::Bool) {
+                    throw type_error(location_of(condition), fmt::format("Conditions must be bool, not {}", checked_.name_of(type.type)));
+                }
+            }
+
+            void check_return(Context& context, const Expr& value)
+            {
+                if (context.function == CheckedProgram::initializer) {
+                    throw type_error(location_of(value), "Return statements must be inside a function");
+                }
+                const auto type = check_expr(context, value);
+                auto& info = checked_.functions[context.function];
+                if (return_type_known_[context.function]) {
+                    convert(value, type, info.return_type);
+                    return;
+                }
+                info.return_type = finalize(value, type);
+                return_type_known_[context.function] = true;
+            }
+
+            Type variable_type(Context& context, const VarDeclStatement& declaration)
+            {
+                const auto& initializer = *declaration.initializer();
+                const auto type = check_expr(context, initializer);
+                if (const auto type_spec = declaration.type_specifier()) {
+                    const auto declared = resolve_type(*type_spec);
+                    convert(initializer, type, declared);
+                    return declared;
+                }
+                if (type.type == Type::Void) {
+                    throw type_error(location_of(initializer), fmt::format("Initializer of '{}' has no value", declaration.identifier().string));
+                }
+                return finalize(initializer, type);
+            }
+
+            std::uint32_t add_local(Context& context, const Token& identifier, Variable variable)
+            {
+                for (const auto& local : context.locals) {
+                    if (local.name == identifier.string) {
+                        throw redefinition(identifier);
+                    }
+                }
+                auto& locals = checked_.functions[context.function].locals;
+                const auto index = static_cast<std::uint32_t>(locals.size());
+                locals.push_back(variable);
+                context.locals.push_back(Context::Local{.name = identifier.string, .index = index});
+                return index;
+            }
+
+            Binding resolve(const Context& context, const Token& identifier) const
+            {
+                for (auto local = context.locals.rbegin(); local != context.locals.rend(); ++local) {
+                    if (local->name == identifier.string) {
+                        return Binding{.kind = Binding::Kind::Local, .index = local->index};
+                    }
+                }
+                // Functions nested in the enclosing functions, innermost first
+                for (auto function = std::optional{context.function}; function; function = parents_[*function]) {
+                    for (const auto& [name, index] : nested_functions_[*function]) {
+                        if (name == identifier.string) {
+                            return Binding{.kind = Binding::Kind::Function, .index = index};
+                        }
+                    }
+                }
+                if (const auto global = top_level_.find(identifier.string); global != top_level_.end()) {
+                    return global->second;
+                }
+                throw TalosException(ReturnCode::UndefinedName, identifier.location, fmt::format("'{}' is not declared", identifier.string));
+            }
+
+            Variable variable(const Context& context, Binding binding, const Token& identifier)
+            {
+                switch (binding.kind) {
+                    case Binding::Kind::Local:
+                        return checked_.functions[context.function].locals[binding.index];
+                    case Binding::Kind::Global:
+                        check_global(binding.index);
+                        return checked_.globals[binding.index];
+                    case Binding::Kind::Function:
+                        break;
+                    case Binding::Kind::Struct:
+                        throw type_error(identifier.location, fmt::format("'{}' is a struct and can only be constructed", identifier.string));
+                }
+                throw type_error(identifier.location, fmt::format("'{}' is a function and can only be called", identifier.string));
+            }
+
+            Type return_type(std::uint32_t function, SourceLocation location)
+            {
+                if (return_type_known_[function]) {
+                    return checked_.functions[function].return_type;
+                }
+                const auto& name = checked_.functions[function].name;
+                if (function_states_[function] == State::Checking) {
+                    throw type_error(location, fmt::format("The return type of '{}' cannot be inferred before its first return, add a type specifier", name));
+                }
+                if (inference_depth_ == max_inference_depth) {
+                    throw type_error(location, fmt::format("Return types are inferred through too many calls, add a type specifier to '{}'", name));
+                }
+                ++inference_depth_;
+                check_function(function);
+                --inference_depth_;
+                return checked_.functions[function].return_type;
+            }
+
+            ExprType check_expr(Context& context, const Expr& expr)
+            {
+                const auto type = check_node(context, expr);
+                checked_.types[&expr] = type.type;
+                return type;
+            }
+
+            ExprType check_node(Context& context, const Expr& expr)
+            {
+                switch (expr.kind()) {
+                    case NodeKind::IntLiteralExpr:
+                        return check_literal(static_cast<const IntLiteralExpr&>(expr));
+                    case NodeKind::FloatingLiteralExpr: {
+                        const auto& literal = static_cast<const FloatingLiteralExpr&>(expr);
+                        if (const auto suffix = literal.suffix()) {
+                            const auto type = resolve_type(*suffix);
+                            if (!is_floating(type)) {
+                                throw type_error(suffix->location, fmt::format("Floating point literals cannot have type {}", type));
+                            }
+                            return ExprType{type};
+                        }
+                        return ExprType{Type::Float64, true};
+                    }
+                    case NodeKind::StringLiteralExpr:
+                        return ExprType{Type::String};
+                    case NodeKind::CharLiteralExpr:
+                        return ExprType{Type::Char};
+                    case NodeKind::BoolLiteralExpr:
+                        return ExprType{Type::Bool};
+                    case NodeKind::IdentifierExpr: {
+                        const auto& identifier = static_cast<const IdentifierExpr&>(expr);
+                        const auto binding = resolve(context, identifier.identifier());
+                        checked_.bindings.emplace(&identifier, binding);
+                        return ExprType{variable(context, binding, identifier.identifier()).type};
+                    }
+                    case NodeKind::ParenExpr:
+                        return check_expr(context, *static_cast<const ParenExpr&>(expr).expr());
+                    case NodeKind::UnaryExpr: {
+                        const auto& unary = static_cast<const UnaryExpr&>(expr);
+                        auto type = ExprType{};
+                        if (const auto* literal = negated_literal(unary)) {
+                            type = check_literal(*literal, true);
+                            checked_.types[literal] = type.type;
+                        } else {
+                            type = check_expr(context, *unary.expr());
+                        }
+                        const auto op = unary.unary_op();
+                        if (op.type == TokenType::Bang) {
+                            if (type.type != Type::Bool) {
+                                throw type_error(op.location, fmt::format("Operand of '!' must be bool, not {}", checked_.name_of(type.type)));
+                            }
+                            return type;
+                        }
+                        if (!is_numeric(type.type)) {
+                            throw type_error(op.location, fmt::format("Operand of '{}' must be a number, not {}", op.string, checked_.name_of(type.type)));
+                        }
+                        return type;
+                    }
+                    case NodeKind::BinaryExpr:
+                        return check_binary(context, static_cast<const BinaryExpr&>(expr));
+                    case NodeKind::AssignmentExpr:
+                        return check_assignment(context, static_cast<const AssignmentExpr&>(expr));
+                    case NodeKind::CallExpr:
+                        return check_call(context, static_cast<const CallExpr&>(expr));
+                    case NodeKind::FieldExpr:
+                        return check_field(context, static_cast<const FieldExpr&>(expr));
+                    case NodeKind::IndexExpr:
+                        return check_index(context, static_cast<const IndexExpr&>(expr));
+                    case NodeKind::ArrayLiteralExpr:
+                        return check_array_literal(context, static_cast<const ArrayLiteralExpr&>(expr));
+                    default:
+                        break;
+                }
+                throw type_error(location_of(expr), fmt::format("Unexpected {}", expr.kind()));
+            }
+
+            ExprType check_literal(const IntLiteralExpr& literal, bool negated = false)
+            {
+                const auto token = literal.int_literal();
+                auto value = std::int64_t{};
+                const auto [end, error] = std::from_chars(token.string.data(), token.string.data() + token.string.size(), value);
+                if (error != std::errc{} || end != token.string.data() + token.string.size()) {
+                    throw type_error(token.location, fmt::format("Integer literal {} is too large", token.string));
+                }
+                if (const auto suffix = literal.suffix()) {
+                    const auto type = resolve_type(*suffix);
+                    if (!is_numeric(type)) {
+                        throw type_error(suffix->location, fmt::format("Integer literals cannot have type {}", type));
+                    }
+                    check_range(literal, type, negated);
+                    return ExprType{type};
+                }
+                return ExprType{Type::Int32, true};
+            }
+
+            // Checks that literal, negated or not, is a value of type. Untyped
+            // literals are checked once their context gives them a type
+            void check_range(const IntLiteralExpr& literal, Type type, bool negated)
+            {
+                if (!is_integer(type)) {
+                    return;
+                }
+                const auto token = literal.int_literal();
+                auto value = std::int64_t{};
+                std::from_chars(token.string.data(), token.string.data() + token.string.size(), value);
+                if (negated) {
+                    value = -value;
+                }
+                if (wrap_integer(type, value) != value) {
+                    throw type_error(token.location, fmt::format("Integer literal {} is too large for {}", token.string, type));
+                }
+            }
+
+            ExprType check_binary(Context& context, const BinaryExpr& binary)
+            {
+                const auto lhs = check_expr(context, *binary.lhs());
+                const auto rhs = check_expr(context, *binary.rhs());
+                const auto op = binary.op();
+                switch (op.type) {
+                    case TokenType::AmpAmp:
+                    case TokenType::PipePipe:
+                        if (lhs.type != Type::Bool || rhs.type != Type::Bool) {
+                            throw type_error(op.location, fmt::format("Operands of '{}' must be bool, not {} and {}", op.string, checked_.name_of(lhs.type), checked_.name_of(rhs.type)));
+                        }
+                        return ExprType{Type::Bool};
+                    case TokenType::EqualEqual:
+                    case TokenType::BangEqual:
+                    case TokenType::Less:
+                    case TokenType::LessEqual:
+                    case TokenType::Greater:
+                    case TokenType::GreaterEqual: {
+                        // Characters are ordered, booleans can only be told apart
+                        const auto equality = op.type == TokenType::EqualEqual || op.type == TokenType::BangEqual;
+                        if (lhs.type == rhs.type && (lhs.type == Type::Char || (equality && lhs.type == Type::Bool))) {
+                            return ExprType{Type::Bool};
+                        }
+                        const auto operands = unify(binary, lhs, rhs);
+                        // The comparison has a type of its own, so untyped operands take their default
+                        finalize(*binary.lhs(), operands);
+                        finalize(*binary.rhs(), operands);
+                        return ExprType{Type::Bool};
+                    }
+                    case TokenType::Percent: {
+                        const auto operands = unify(binary, lhs, rhs);
+                        if (!is_integer(operands.type)) {
+                            throw type_error(op.location, fmt::format("Operands of '%' must be integers, not {}", checked_.name_of(operands.type)));
+                        }
+                        return operands;
+                    }
+                    default:
+                        if (is_array(lhs.type) || is_array(rhs.type)) {
+                            return check_elementwise(binary, lhs, rhs);
+                        }
+                        return unify(binary, lhs, rhs);
+                }
+            }
+
+            // Arithmetic on two arrays of the same numbers applies to each pair of elements
+            ExprType check_elementwise(const BinaryExpr& binary, ExprType lhs, ExprType rhs)
+            {
+                const auto op = binary.op();
+                const auto numbers = [&](Type type) { return is_array(type) && is_numeric(checked_.array_of(type).element); };
+                if (!numbers(lhs.type) || !numbers(rhs.type)) {
+                    throw type_error(op.location, fmt::format("Operands of '{}' must be arrays of numbers, not {} and {}", op.string, checked_.name_of(lhs.type), checked_.name_of(rhs.type)));
+                }
+                if (lhs.untyped && rhs.untyped && lhs.type != rhs.type) {
+                    // Both default, integer elements can become floating point ones
+                    const auto type = is_floating(checked_.array_of(lhs.type).element) ? lhs.type : rhs.type;
+                    convert(*binary.lhs(), lhs, type);
+                    convert(*binary.rhs(), rhs, type);
+                    return ExprType{type, true};
+                }
+                if (lhs.untyped && !rhs.untyped) {
+                    convert(*binary.lhs(), lhs, rhs.type);
+                    return rhs;
+                }
+                if (rhs.untyped && !lhs.untyped) {
+                    convert(*binary.rhs(), rhs, lhs.type);
+                    return lhs;
+                }
+                if (lhs.type != rhs.type) {
+                    throw type_error(op.location, fmt::format("Operands of '{}' have different types {} and {}", op.string, checked_.name_of(lhs.type), checked_.name_of(rhs.type)));
+                }
+                return lhs;
+            }
+
+            // Type of the numeric operands of binary, after giving an untyped operand the type of the other
+            ExprType unify(const BinaryExpr& binary, ExprType lhs, ExprType rhs)
+            {
+                const auto op = binary.op();
+                if (!is_numeric(lhs.type) || !is_numeric(rhs.type)) {
+                    throw type_error(op.location, fmt::format("Operands of '{}' must be numbers, not {} and {}", op.string, checked_.name_of(lhs.type), checked_.name_of(rhs.type)));
+                }
+                if (lhs.untyped && rhs.untyped) {
+                    return ExprType{is_floating(lhs.type) || is_floating(rhs.type) ? Type::Float64 : Type::Int32, true};
+                }
+                if (lhs.untyped) {
+                    convert(*binary.lhs(), lhs, rhs.type);
+                    return rhs;
+                }
+                if (rhs.untyped) {
+                    convert(*binary.rhs(), rhs, lhs.type);
+                    return lhs;
+                }
+                if (lhs.type != rhs.type) {
+                    throw type_error(op.location, fmt::format("Operands of '{}' have different types {} and {}", op.string, lhs.type, rhs.type));
+                }
+                return lhs;
+            }
+
+            // Assigns to a variable, or to a field or element of one, which must be mutable
+            ExprType check_assignment(Context& context, const AssignmentExpr& assignment)
+            {
+                const auto& target = *assignment.lhs();
+                const auto* root = &target;
+                while (root->kind() == NodeKind::FieldExpr || root->kind() == NodeKind::IndexExpr) {
+                    root = root->kind() == NodeKind::FieldExpr ? static_cast<const FieldExpr*>(root)->object() : static_cast<const IndexExpr*>(root)->array();
+                }
+                if (root->kind() != NodeKind::IdentifierExpr) {
+                    throw type_error(location_of(target), "Only variables, their fields and their elements can be assigned to");
+                }
+                const auto& identifier = static_cast<const IdentifierExpr&>(*root);
+                const auto binding = resolve(context, identifier.identifier());
+                const auto assigned = variable(context, binding, identifier.identifier());
+                if (!assigned.is_mutable) {
+                    throw type_error(identifier.identifier().location, fmt::format("Cannot assign to constant '{}'", identifier.identifier().string));
+                }
+                checked_.bindings.emplace(&identifier, binding);
+                checked_.types[root] = assigned.type;
+                const auto type = root == &target ? assigned.type : check_expr(context, target).type;
+                if (target.kind() == NodeKind::FieldExpr) {
+                    const auto& field = static_cast<const FieldExpr&>(target);
+                    if (is_array(checked_.types.at(field.object()))) {
+                        throw type_error(field.field().location, "The length of an array cannot be assigned to");
+                    }
+                }
+
+                const auto& value = *assignment.rhs();
+                convert(value, check_expr(context, value), type);
+                return ExprType{type};
+            }
+
+            ExprType check_call(Context& context, const CallExpr& call)
+            {
+                const auto& callee = *call.callee();
+                if (callee.kind() != NodeKind::IdentifierExpr) {
+                    throw type_error(location_of(callee), "Only functions can be called");
+                }
+                const auto& identifier = static_cast<const IdentifierExpr&>(callee);
+                const auto name = identifier.identifier();
+                const auto binding = resolve(context, name);
+                if (binding.kind == Binding::Kind::Struct) {
+                    checked_.bindings.emplace(&identifier, binding);
+                    return check_construction(context, call, name, binding.index);
+                }
+                if (binding.kind != Binding::Kind::Function) {
+                    throw type_error(name.location, fmt::format("'{}' is not a function", name.string));
+                }
+                checked_.bindings.emplace(&identifier, binding);
+
+                const auto arguments = call.arguments();
+                const auto& parameters = checked_.functions[binding.index].parameters;
+                if (arguments.size() != parameters.size()) {
+                    throw type_error(name.location, fmt::format("'{}' takes {} arguments, not {}", name.string, parameters.size(), arguments.size()));
+                }
+                for (std::size_t i = 0; i < arguments.size(); ++i) {
+                    convert(*arguments[i], check_expr(context, *arguments[i]), parameters[i]);
+                }
+                return ExprType{return_type(binding.index, name.location)};
+            }
+
+            // The arguments initialize the fields in declaration order
+            ExprType check_construction(Context& context, const CallExpr& call, const Token& name, std::uint32_t index)
+            {
+                const auto arguments = call.arguments();
+                const auto& fields = checked_.structs[index].fields;
+                if (arguments.size() != fields.size()) {
+                    throw type_error(name.location, fmt::format("'{}' has {} fields, not {}", name.string, fields.size(), arguments.size()));
+                }
+                for (std::size_t i = 0; i < arguments.size(); ++i) {
+                    convert(*arguments[i], check_expr(context, *arguments[i]), fields[i].type);
+                }
+                return ExprType{struct_type(index)};
+            }
+
+            ExprType check_field(Context& context, const FieldExpr& expr)
+            {
+                const auto object = finalize(*expr.object(), check_expr(context, *expr.object()));
+                const auto field = expr.field();
+                if (is_array(object)) {
+                    if (field.string != "length") {
+                        throw type_error(field.location, fmt::format("{} has no field '{}', only length", checked_.name_of(object), field.string));
+                    }
+                    // A constant, which takes the type its context needs like a literal
+                    return ExprType{Type::Int32, true};
+                }
+                if (!is_struct(object)) {
+                    throw type_error(field.location, fmt::format("Only structs have fields, not {}", checked_.name_of(object)));
+                }
+                const auto& layout = checked_.structs[struct_index(object)];
+                const auto index = layout.find(field.string);
+                if (!index) {
+                    throw type_error(field.location, fmt::format("'{}' has no field '{}'", layout.name, field.string));
+                }
+                checked_.fields.emplace(&expr, *index);
+                return ExprType{layout.fields[*index].type};
+            }
+
+            ExprType check_index(Context& context, const IndexExpr& expr)
+            {
+                const auto array = check_expr(context, *expr.array());
+                if (!is_array(array.type)) {
+                    throw type_error(expr.bracket().location, fmt::format("Only arrays can be indexed, not {}", checked_.name_of(array.type)));
+                }
+                const auto& index = *expr.index();
+                const auto index_type = check_expr(context, index);
+                if (!is_integer(index_type.type)) {
+                    throw type_error(location_of(index), fmt::format("Array indexes must be integers, not {}", checked_.name_of(index_type.type)));
+                }
+                finalize(index, index_type);
+                return ExprType{checked_.array_of(finalize(*expr.array(), array)).element};
+            }
+
+            // The elements take one type, the first typed one's or else their
+            // default. [x; n] repeats x n times
+            ExprType check_array_literal(Context& context, const ArrayLiteralExpr& literal)
+            {
+                const auto elements = literal.elements();
+                auto types = std::vector<ExprType>{};
+                for (const auto& element : elements) {
+                    types.push_back(check_expr(context, *element));
+                }
+                const auto typed = std::ranges::find_if(types, [](const auto& type) { return !type.untyped; });
+                auto element = ExprType{};
+                if (typed != types.end()) {
+                    element = *typed;
+                }
+                else {
+                    const auto floating = std::ranges::any_of(types, [](const auto& type) { return is_floating(type.type); });
+                    element = ExprType{floating ? Type::Float64 : types.front().type, true};
+                }
+                if (!is_element(element.type)) {
+                    throw type_error(location_of(*elements.front()), fmt::format("Array elements must be scalars or structs, not {}", checked_.name_of(element.type)));
+                }
+                for (std::size_t i = 0; i < elements.size(); ++i) {
+                    convert(*elements[i], types[i], element.type);
+                }
+                if (elements.size() > max_array_length) {
+                    throw type_error(literal.bracket().location, fmt::format("Arrays cannot have more than {} elements", max_array_length));
+                }
+                const auto length = literal.count() ? array_length(*literal.count()) : static_cast<std::uint32_t>(elements.size());
+                return ExprType{array_of(element.type, length, literal.bracket().location), element.untyped};
+            }
+
+            // Checks that expr, of the given type, can be used as a value of type target
+            void convert(const Expr& expr, ExprType type, Type target)
+            {
+                if (type.type == target) {
+                    return;
+                }
+                if (!type.untyped || !converts(type.type, target)) {
+                    throw type_error(location_of(expr), fmt::format("Expected a value of type {}, not {}", checked_.name_of(target), checked_.name_of(type.type)));
+                }
+                retype(expr, target);
+            }
+
+            // Whether an untyped value of type can take type target. Integer
+            // literals can also be floating point values, but not the reverse
+            [[nodiscard]] bool converts(Type type, Type target) const
+            {
+                if (is_array(type)) {
+                    if (!is_array(target)) {
+                        return false;
+                    }
+                    const auto& from = checked_.array_of(type);
+                    const auto& to = checked_.array_of(target);
+                    return from.length == to.length && (from.element == to.element || converts(from.element, to.element));
+                }
+                return is_integer(type) ? is_numeric(target) : is_floating(target);
+            }
+
+            // Gives untyped expressions their default type
+            Type finalize(const Expr& expr, ExprType type)
+            {
+                if (type.untyped) {
+                    retype(expr, type.type);
+                }
+                return type.type;
+            }
+
+            void retype(const Expr& expr, Type type)
+            {
+                checked_.types[&expr] = type;
+                switch (expr.kind()) {
+                    case NodeKind::ParenExpr:
+                        retype(*static_cast<const ParenExpr&>(expr).expr(), type);
+                        break;
+                    case NodeKind::UnaryExpr: {
+                        const auto& unary = static_cast<const UnaryExpr&>(expr);
+                        if (const auto* literal = negated_literal(unary)) {
+                            checked_.types[literal] = type;
+                            check_range(*literal, type, true);
+                        } else {
+                            retype(*unary.expr(), type);
+                        }
+                        break;
+                    }
+                    case NodeKind::IntLiteralExpr:
+                        check_range(static_cast<const IntLiteralExpr&>(expr), type, false);
+                        break;
+                    case NodeKind::BinaryExpr: {
+                        const auto& binary = static_cast<const BinaryExpr&>(expr);
+                        retype(*binary.lhs(), type);
+                        retype(*binary.rhs(), type);
+                        break;
+                    }
+                    case NodeKind::ArrayLiteralExpr:
+                        for (const auto& element : static_cast<const ArrayLiteralExpr&>(expr).elements()) {
+                            retype(*element, checked_.array_of(type).element);
+                        }
+                        break;
+                    default:
+                        // Literals, and the lengths of arrays
+                        break;
+                }
+            }
+
+            const ProgramNode& program_;
+            CheckedProgram checked_;
+
+            // Indexed like CheckedProgram::functions
+            std::vector<State> function_states_;
+            std::vector<bool> return_type_known_;
+            std::vector<std::optional<std::uint32_t>> parents_;
+            std::vector<std::vector<std::pair<std::string_view, std::uint32_t>>> nested_functions_;
+            int inference_depth_ = 0;
+
+            // Indexed like CheckedProgram::globals
+            std::vector<State> global_states_;
+            std::vector<const VarDeclStatement*> global_declarations_;
+
+            // Indexed like CheckedProgram::structs
+            std::vector<State> struct_states_;
+            std::vector<const StructDeclStatement*> struct_declarations_;
+
+            // Top-level structs, functions and globals
+            std::unordered_map<std::string_view, Binding> top_level_;
+        };
+    } // namespace
+
+    CheckedProgram check_program(const ProgramNode& program)
+    {
+        return Checker{program}.check();
+    }
+
+    bool can_complete(const Statement& statement) noexcept
+    {
+        switch (statement.kind()) {
+            case NodeKind::ReturnStatement:
+                return false;
+            case NodeKind::BlockStatement: {
+                const auto statements = static_cast<const BlockStatement&>(statement).statements();
+                return std::ranges::all_of(statements, [](const auto& child) { return can_complete(*child); });
+            }
+            case NodeKind::IfStatement: {
+                const auto& if_statement = static_cast<const IfStatement&>(statement);
+                return if_statement.else_branch() == nullptr || can_complete(*if_statement.then_branch()) ||
+                       can_complete(*if_statement.else_branch());
+            }
+            case NodeKind::WhileStatement:
+                return !is_true_literal(static_cast<const WhileStatement&>(statement).condition());
+            case NodeKind::ForStatement: {
+                const auto* condition = static_cast<const ForStatement&>(statement).condition();
+                return condition != nullptr && !is_true_literal(condition);
+            }
+            default:
+                return true;
+        }
+    }
+} // namespace talos
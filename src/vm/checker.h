@@ -0,0 +1,104 @@
+#pragma once
+
+#include "frontend/ast.h"
+#include "layout.h"
+#include "type.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace talos
+{
+    // What an identifier refers to
+    struct Binding {
+        enum class Kind : std::uint8_t {
+            Local,
+            Global,
+            Function,
+            Struct,
+        };
+
+        Kind kind;
+        // Into FunctionInfo::locals, CheckedProgram::globals, CheckedProgram::functions
+        // or CheckedProgram::structs
+        std::uint32_t index;
+    };
+
+    struct Variable {
+        Type type;
+        bool is_mutable;
+    };
+
+    struct FunctionInfo {
+        // Null for the initializer, which runs the top-level statements
+        const FunDeclStatement* declaration = nullptr;
+        std::string name;
+        std::vector<Type> parameters;
+        Type return_type = Type::Void;
+        // Parameters first, then one per variable declaration in source order
+        std::vector<Variable> locals;
+    };
+
+    // Names and types of a program resolved by check_program
+    struct CheckedProgram {
+        static constexpr std::uint32_t initializer = 0;
+
+        std::vector<FunctionInfo> functions;
+        std::vector<Variable> globals;
+        std::optional<std::uint32_t> main;
+        // Indexed by struct_index
+        std::vector<StructLayout> structs;
+        // Indexed by array_index
+        std::vector<ArrayLayout> arrays;
+        // Type of every expression. Literals without a suffix take the type
+        // their context expects, e.g. 1 in `let x : i64 = 1;` is an i64
+        std::unordered_map<const Expr*, Type> types;
+        // Identifiers used as values, assignment targets, callees and constructors
+        std::unordered_map<const IdentifierExpr*, Binding> bindings;
+        // Index of each struct field accessed into the FieldLayouts of its
+        // struct. Arrays have a length field, which is not listed
+        std::unordered_map<const FieldExpr*, std::uint32_t> fields;
+        // Local or global variable of each declaration
+        std::unordered_map<const VarDeclStatement*, Binding> variables;
+
+        [[nodiscard]] Type type_of(const Expr& expr) const { return types.at(&expr); }
+        [[nodiscard]] Binding binding_of(const IdentifierExpr& expr) const { return bindings.at(&expr); }
+        [[nodiscard]] const FieldLayout& field_of(const FieldExpr& expr) const
+        {
+            return structs[struct_index(type_of(*expr.object()))].fields[fields.at(&expr)];
+        }
+        [[nodiscard]] const ArrayLayout& array_of(Type type) const { return arrays[array_index(type)]; }
+        // Registers a value of type takes, one per scalar of a struct. Arrays
+        // take one, which points to their elements
+        [[nodiscard]] std::uint32_t slot_count(Type type) const
+        {
+            return is_struct(type) ? static_cast<std::uint32_t>(structs[struct_index(type)].slots.size()) : 1;
+        }
+        // Spelling of type in messages
+        [[nodiscard]] std::string_view name_of(Type type) const
+        {
+            if (is_struct(type)) {
+                return structs[struct_index(type)].name;
+            }
+            return is_array(type) ? std::string_view{array_of(type).name} : std::string_view{format_as(type)};
+        }
+    };
+
+    // Resolves every name in program and checks its types. Top-level structs,
+    // functions and globals may be used before their declaration, locals only
+    // after it. Structs are constructed by calling them with their fields.
+    // Arrays hold scalars or structs and have the values of an array type.
+    // Arrays of numbers are added, subtracted, multiplied and divided element
+    // by element. Return types of
+    // functions without a type specifier are inferred from their first return
+    // statement. Throws TalosException
+    [[nodiscard]] CheckedProgram check_program(const ProgramNode& program);
+
+    // Whether execution can continue after statement, rather than always
+    // returning or looping forever
+    [[nodiscard]] bool can_complete(const Statement& statement) noexcept;
+} // namespace talos
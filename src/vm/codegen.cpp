@@ -0,0 +1,1575 @@
+#include "codegen.h"
+
+#include "exceptions.h"
+#include "frontend/ast_walker.h"
+#include "frontend/expression_table.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <charconv>
+#include <limits>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace talos
+{
+    namespace
+    {
+        constexpr std::size_t max_operand = std::numeric_limits<std::uint16_t>::max();
+        // Registers a loop may hold invariant values in
+        constexpr std::size_t max_hoisted = 64;
+
+        // Whether evaluating expr may assign to a variable. Calls may assign to
+        // globals, which only counts if through_calls
+        bool assigns(const Expr& expr, bool through_calls = false)
+        {
+            const auto any_assigns = [&](auto elements) {
+                return std::any_of(elements.begin(), elements.end(), [&](const auto& element) { return assigns(*element, through_calls); });
+            };
+            switch (expr.kind()) {
+                case NodeKind::AssignmentExpr:
+                    return true;
+                case NodeKind::ParenExpr:
+                    return assigns(*static_cast<const ParenExpr&>(expr).expr(), through_calls);
+                case NodeKind::UnaryExpr:
+                    return assigns(*static_cast<const UnaryExpr&>(expr).expr(), through_calls);
+                case NodeKind::BinaryExpr: {
+                    const auto& binary = static_cast<const BinaryExpr&>(expr);
+                    return assigns(*binary.lhs(), through_calls) || assigns(*binary.rhs(), through_calls);
+                }
+                case NodeKind::CallExpr:
+                    return through_calls || any_assigns(static_cast<const CallExpr&>(expr).arguments());
+                case NodeKind::FieldExpr:
+                    return assigns(*static_cast<const FieldExpr&>(expr).object(), through_calls);
+                case NodeKind::IndexExpr: {
+                    const auto& index = static_cast<const IndexExpr&>(expr);
+                    return assigns(*index.array(), through_calls) || assigns(*index.index(), through_calls);
+                }
+                case NodeKind::ArrayLiteralExpr:
+                    return any_assigns(static_cast<const ArrayLiteralExpr&>(expr).elements());
+                default:
+                    return false;
+            }
+        }
+
+        // Variable assigned to by an assignment to target, directly or through
+        // its fields and elements
+        const IdentifierExpr& assigned_variable(const Expr& target) noexcept
+        {
+            if (target.kind() == NodeKind::FieldExpr) {
+                return assigned_variable(*static_cast<const FieldExpr&>(target).object());
+            }
+            if (target.kind() == NodeKind::IndexExpr) {
+                return assigned_variable(*static_cast<const IndexExpr&>(target).array());
+            }
+            return static_cast<const IdentifierExpr&>(target);
+        }
+
+        // An array operand that is the storage of a variable rather than a
+        // temporary, which later operands may change
+        bool is_variable_storage(const Expr& expr) noexcept
+        {
+            const auto kind = expr.kind();
+            return kind == NodeKind::IdentifierExpr || kind == NodeKind::AssignmentExpr;
+        }
+
+        bool is_literal(const Expr& expr) noexcept
+        {
+            switch (expr.kind()) {
+                case NodeKind::IntLiteralExpr:
+                case NodeKind::FloatingLiteralExpr:
+                case NodeKind::StringLiteralExpr:
+                case NodeKind::CharLiteralExpr:
+                case NodeKind::BoolLiteralExpr:
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+        const Expr& without_parens(const Expr& expr) noexcept
+        {
+            if (expr.kind() == NodeKind::ParenExpr) {
+                return without_parens(*static_cast<const ParenExpr&>(expr).expr());
+            }
+            return expr;
+        }
+
+        // Greater and GreaterEqual are compiled as Less and LessEqual with
+        // swapped operands
+        bool swaps_operands(TokenType type) noexcept
+        {
+            return type == TokenType::Greater || type == TokenType::GreaterEqual;
+        }
+
+        OpCode binary_op(TokenType type)
+        {
+            switch (type) {
+                case TokenType::Plus:
+                    return OpCode::Add;
+                case TokenType::Minus:
+                    return OpCode::Subtract;
+                case TokenType::Star:
+                    return OpCode::Multiply;
+                case TokenType::Percent:
+                    return OpCode::Modulo;
+                case TokenType::EqualEqual:
+                    return OpCode::Equal;
+                case TokenType::BangEqual:
+                    return OpCode::NotEqual;
+                case TokenType::Less:
+                case TokenType::Greater:
+                    return OpCode::Less;
+                case TokenType::LessEqual:
+                case TokenType::GreaterEqual:
+                    return OpCode::LessEqual;
+                default:
+                    return OpCode::Divide;
+            }
+        }
+
+        // Elementwise arithmetic on arrays
+        OpCode vector_op(TokenType type)
+        {
+            switch (type) {
+                case TokenType::Plus:
+                    return OpCode::VecAdd;
+                case TokenType::Minus:
+                    return OpCode::VecSubtract;
+                case TokenType::Star:
+                    return OpCode::VecMultiply;
+                default:
+                    return OpCode::VecDivide;
+            }
+        }
+
+        [[nodiscard]] std::uint64_t integer_max(Type type) noexcept
+        {
+            return (std::uint64_t{1} << ((scalar_size(type) * 8U) - 1U)) - 1U;
+        }
+
+        // The fused jump taken if the comparison type evaluates to jump_if
+        std::optional<OpCode> compare_jump(TokenType type, bool jump_if)
+        {
+            switch (type) {
+                case TokenType::EqualEqual:
+                    return jump_if ? OpCode::JumpIfEqual : OpCode::JumpIfNotEqual;
+                case TokenType::BangEqual:
+                    return jump_if ? OpCode::JumpIfNotEqual : OpCode::JumpIfEqual;
+                case TokenType::Less:
+                case TokenType::Greater:
+                    return jump_if ? OpCode::JumpIfLess : OpCode::JumpIfNotLess;
+                case TokenType::LessEqual:
+                case TokenType::GreaterEqual:
+                    return jump_if ? OpCode::JumpIfLessEqual : OpCode::JumpIfNotLessEqual;
+                default:
+                    return std::nullopt;
+            }
+        }
+
+        // Counts the assignments to each local in a loop. Locals declared in
+        // the loop count as assigned, they hold a new value every iteration
+        class LoopAssignments : public ASTWalker<LoopAssignments>
+        {
+        public:
+            explicit LoopAssignments(const CheckedProgram& checked) : checked_(checked) {}
+
+            [[nodiscard]] std::size_t count(std::uint32_t local) const
+            {
+                const auto iter = counts_.find(local);
+                return iter == counts_.end() ? 0 : iter->second;
+            }
+
+        private:
+            friend class ASTWalker<LoopAssignments>;
+
+            void pre(const AssignmentExpr& expr) { add(checked_.binding_of(assigned_variable(*expr.lhs()))); }
+            void pre(const VarDeclStatement& statement) { add(checked_.variables.at(&statement)); }
+
+            void add(Binding binding)
+            {
+                if (binding.kind == Binding::Kind::Local) {
+                    ++counts_[binding.index];
+                }
+            }
+
+            const CheckedProgram& checked_;
+            std::unordered_map<std::uint32_t, std::size_t> counts_;
+        };
+
+        // Local of a for loop that its increment steps by a constant, and
+        // nothing else in the loop assigns to
+        struct Induction {
+            std::uint32_t local;
+            std::int64_t step;
+        };
+
+        // What a loop computes before its first iteration
+        struct LoopScan {
+            const LoopAssignments& assignments;
+            std::optional<Induction> induction;
+            // Largest subexpressions with the same value in every iteration
+            std::vector<const Expr*> invariants;
+            // Products of the induction variable and a constant, which are
+            // stepped along with it instead of multiplied every iteration
+            std::vector<const BinaryExpr*> products;
+        };
+
+        // Add that keeps a reduced product up to date as the loop steps
+        struct ProductStep {
+            Register product;
+            Register step;
+            Type type;
+        };
+
+        // Compiles the body of one function
+        class FunctionGenerator
+        {
+        public:
+            FunctionGenerator(Program& program, const CheckedProgram& checked, std::span<const std::uint32_t> global_slots, std::uint32_t index)
+                : program_(program),
+                  checked_(checked),
+                  global_slots_(global_slots),
+                  info_(checked.functions[index]),
+                  function_(program.functions[index])
+            {
+                // Structs take one register per scalar
+                auto registers = std::size_t{0};
+                for (std::size_t i = 0; i < info_.locals.size(); ++i) {
+                    if (i == info_.parameters.size()) {
+                        function_.parameter_count = static_cast<std::uint16_t>(registers);
+                    }
+                    local_registers_.push_back(static_cast<Register>(registers));
+                    registers += checked_.slot_count(info_.locals[i].type);
+                    if (registers > max_operand) {
+                        throw too_large(info_.declaration->identifier().location, "registers");
+                    }
+                }
+                if (info_.locals.size() == info_.parameters.size()) {
+                    function_.parameter_count = static_cast<std::uint16_t>(registers);
+                }
+                locals_end_ = static_cast<Register>(registers);
+                next_ = locals_end_;
+                // Arrays of locals are stored in the memory of the call, those of
+                // parameters belong to the caller
+                local_memory_.resize(info_.locals.size());
+                for (std::size_t i = info_.parameters.size(); i < info_.locals.size(); ++i) {
+                    if (is_array(info_.locals[i].type)) {
+                        local_memory_[i] = locals_memory_end_;
+                        locals_memory_end_ += checked_.array_of(info_.locals[i].type).aligned_size();
+                    }
+                }
+                function_.memory_size = locals_memory_end_;
+                function_.name = info_.name;
+                function_.return_type = info_.return_type;
+                function_.register_count = static_cast<Register>(std::max<std::size_t>({registers, checked_.slot_count(info_.return_type), 1}));
+            }
+
+            void generate_function()
+            {
+                for (const auto& statement : info_.declaration->statements()) {
+                    generate_statement(*statement);
+                }
+                if (info_.return_type == Type::Void) {
+                    emit(OpCode::ReturnVoid, info_.declaration->identifier().location);
+                }
+            }
+
+            void generate_initializer(const ProgramNode& program)
+            {
+                for (const auto& statement : program.statements()) {
+                    generate_statement(*statement);
+                }
+                emit(OpCode::ReturnVoid, SourceLocation{});
+            }
+
+        private:
+            void generate_statement(const Statement& statement)
+            {
+                // Temporary arrays only live for the statement that computes them
+                next_memory_ = locals_memory_end_;
+                switch (statement.kind()) {
+                    case NodeKind::ExprStatement: {
+                        const auto top = next_;
+                        static_cast<void>(generate_expr(*static_cast<const ExprStatement&>(statement).expr()));
+                        next_ = top;
+                        break;
+                    }
+                    case NodeKind::ReturnStatement: {
+                        const auto& value = *static_cast<const ReturnStatement&>(statement).return_value();
+                        const auto top = next_;
+                        const auto result = generate_expr(value);
+                        next_ = top;
+                        if (info_.return_type == Type::Void) {
+                            // Returns the result of calling another void function
+                            emit(OpCode::ReturnVoid, location_of(value));
+                        }
+                        else if (is_struct(info_.return_type)) {
+                            emit(OpCode::ReturnSlots, location_of(value), result, static_cast<std::uint16_t>(checked_.slot_count(info_.return_type)));
+                        }
+                        else {
+                            emit(OpCode::Return, location_of(value), result);
+                        }
+                        break;
+                    }
+                    case NodeKind::VarDeclStatement: {
+                        const auto& declaration = static_cast<const VarDeclStatement&>(statement);
+                        const auto variable = checked_.variables.at(&declaration);
+                        const auto& initializer = *declaration.initializer();
+                        if (variable.kind == Binding::Kind::Local) {
+                            // The initializer cannot read the variable, so structs and arrays are built in place
+                            const auto local = local_registers_[variable.index];
+                            const auto type = checked_.type_of(initializer);
+                            if (is_array(type)) {
+                                emit_frame_array(local, type, local_memory_[variable.index], declaration.identifier().location);
+                            }
+                            static_cast<void>(generate_expr(initializer, local));
+                            break;
+                        }
+                        const auto top = next_;
+                        const auto value = generate_expr(initializer);
+                        next_ = top;
+                        store_global(global_slots_[variable.index], value, checked_.type_of(initializer), declaration.identifier().location);
+                        break;
+                    }
+                    case NodeKind::BlockStatement:
+                        for (const auto& child : static_cast<const BlockStatement&>(statement).statements()) {
+                            generate_statement(*child);
+                        }
+                        break;
+                    case NodeKind::IfStatement:
+                        generate_if(static_cast<const IfStatement&>(statement));
+                        break;
+                    case NodeKind::WhileStatement: {
+                        const auto& loop = static_cast<const WhileStatement&>(statement);
+                        generate_loop(nullptr, loop.condition(), nullptr, *loop.body());
+                        break;
+                    }
+                    case NodeKind::ForStatement: {
+                        const auto& loop = static_cast<const ForStatement&>(statement);
+                        if (const auto* initializer = loop.initializer()) {
+                            generate_statement(*initializer);
+                        }
+                        generate_loop(loop.initializer(), loop.condition(), loop.increment(), *loop.body());
+                        break;
+                    }
+                    default:
+                        // Functions are compiled on their own
+                        break;
+                }
+            }
+
+            // The then branch falls through to the else branch, which is jumped
+            // over unless the then branch never completes
+            void generate_if(const IfStatement& statement)
+            {
+                const auto location = location_of(*statement.condition());
+                auto to_else = std::vector<std::size_t>{};
+                generate_branch(*statement.condition(), false, to_else);
+                generate_statement(*statement.then_branch());
+                const auto* else_branch = statement.else_branch();
+                if (else_branch == nullptr) {
+                    patch(to_else, here(location));
+                    return;
+                }
+                auto to_end = std::vector<std::size_t>{};
+                if (can_complete(*statement.then_branch())) {
+                    to_end.push_back(emit_jump(OpCode::Jump, location));
+                }
+                patch(to_else, here(location));
+                generate_statement(*else_branch);
+                patch(to_end, here(location));
+            }
+
+            // Loops are rotated to test their condition at the bottom, so that the
+            // body runs straight through and each iteration takes one backward
+            // branch. The condition is jumped to once, on entry. Invariant values
+            // are computed before the loop and kept in registers. Indexing arrays
+            // by an induction variable known to stay within them is not checked
+            void generate_loop(const Statement* initializer, const Expr* condition, const Expr* increment, const Statement& body)
+            {
+                const auto location = condition != nullptr ? location_of(*condition) : SourceLocation{};
+                const auto top = next_;
+                auto assignments = LoopAssignments{checked_};
+                for (const ASTNode* part : {static_cast<const ASTNode*>(condition), static_cast<const ASTNode*>(increment), static_cast<const ASTNode*>(&body)}) {
+                    if (part != nullptr) {
+                        static_cast<void>(assignments.walk(*part));
+                    }
+                }
+                auto scan = LoopScan{.assignments = assignments, .induction = induction_of(increment, assignments)};
+                if (condition != nullptr) {
+                    find_root_invariant(*condition, scan);
+                }
+                if (increment != nullptr) {
+                    find_root_invariant(*increment, scan);
+                }
+                find_invariants(body, scan);
+
+                // Equal invariants share a register. Their names are those of
+                // locals declared outside of the loop, so in the same scope
+                auto hoisted = std::vector<const Expr*>{};
+                auto by_value = std::unordered_map<std::uint64_t, Register>{};
+                for (const auto* expr : scan.invariants) {
+                    const auto value = (std::uint64_t{expressions_.add(*expr)} << 16U) | static_cast<std::uint16_t>(checked_.type_of(*expr));
+                    auto [iter, inserted] = by_value.emplace(value, Register{});
+                    if (inserted) {
+                        iter->second = allocate(location);
+                        static_cast<void>(generate_expr(*expr, iter->second));
+                    }
+                    hoisted_.emplace(expr, iter->second);
+                    hoisted.push_back(expr);
+                }
+                const auto steps = reduce_products(scan, hoisted, location);
+
+                auto to_condition = std::vector<std::size_t>{};
+                if (condition != nullptr) {
+                    to_condition.push_back(emit_jump(OpCode::Jump, location));
+                }
+                const auto start = here(location);
+                const auto bound = index_bound(initializer, condition, scan.induction);
+                if (bound) {
+                    proven_.emplace_back(scan.induction->local, *bound);
+                }
+                generate_statement(body);
+                if (bound) {
+                    proven_.pop_back();
+                }
+                if (increment != nullptr) {
+                    const auto scope = next_;
+                    static_cast<void>(generate_expr(*increment));
+                    next_ = scope;
+                    for (const auto& [product, step, type] : steps) {
+                        emit(OpCode::Add, type, location, product, product, step);
+                    }
+                }
+                patch(to_condition, here(location));
+                auto to_start = std::vector<std::size_t>{};
+                if (condition != nullptr) {
+                    generate_branch(*condition, true, to_start);
+                }
+                else {
+                    to_start.push_back(emit_jump(OpCode::Jump, location));
+                }
+                patch(to_start, start);
+
+                for (const auto* expr : hoisted) {
+                    hoisted_.erase(expr);
+                }
+                next_ = top;
+            }
+
+            std::optional<Induction> induction_of(const Expr* increment, const LoopAssignments& assignments)
+            {
+                if (increment == nullptr || increment->kind() != NodeKind::AssignmentExpr) {
+                    return std::nullopt;
+                }
+                const auto& assignment = static_cast<const AssignmentExpr&>(*increment);
+                if (assignment.lhs()->kind() != NodeKind::IdentifierExpr) {
+                    return std::nullopt;
+                }
+                const auto binding = checked_.binding_of(static_cast<const IdentifierExpr&>(*assignment.lhs()));
+                const auto& rhs = without_parens(*assignment.rhs());
+                if (binding.kind != Binding::Kind::Local || assignments.count(binding.index) != 1 || !is_integer(checked_.type_of(rhs)) ||
+                    rhs.kind() != NodeKind::BinaryExpr) {
+                    return std::nullopt;
+                }
+                const auto& sum = static_cast<const BinaryExpr&>(rhs);
+                const auto op = sum.op().type;
+                const auto is_local = [&](const Expr& expr) { return is_local_variable(expr, binding.index); };
+                const auto is_literal = [](const Expr& expr) { return without_parens(expr).kind() == NodeKind::IntLiteralExpr; };
+                const Expr* step = nullptr;
+                if ((op == TokenType::Plus || op == TokenType::Minus) && is_local(*sum.lhs()) && is_literal(*sum.rhs())) {
+                    step = sum.rhs();
+                }
+                else if (op == TokenType::Plus && is_literal(*sum.lhs()) && is_local(*sum.rhs())) {
+                    step = sum.lhs();
+                }
+                if (step == nullptr) {
+                    return std::nullopt;
+                }
+                const auto value = literal_value(without_parens(*step)).integer;
+                return Induction{.local = binding.index, .step = op == TokenType::Minus ? static_cast<std::int64_t>(0 - static_cast<std::uint64_t>(value)) : value};
+            }
+
+            // Bound that the induction variable of a loop stays below in its
+            // body, without going below zero: it starts at a literal of at least
+            // zero, only grows, and the condition compares it to a constant.
+            // nullopt unless all of that holds and stepping past the bound cannot
+            // wrap around
+            std::optional<std::uint64_t> index_bound(const Statement* initializer, const Expr* condition, const std::optional<Induction>& induction)
+            {
+                if (!induction || induction->step <= 0 || initializer == nullptr || condition == nullptr ||
+                    initializer->kind() != NodeKind::VarDeclStatement) {
+                    return std::nullopt;
+                }
+                const auto& declaration = static_cast<const VarDeclStatement&>(*initializer);
+                const auto variable = checked_.variables.at(&declaration);
+                const auto& start = without_parens(*declaration.initializer());
+                if (variable.kind != Binding::Kind::Local || variable.index != induction->local || start.kind() != NodeKind::IntLiteralExpr ||
+                    literal_value(start).integer < 0) {
+                    return std::nullopt;
+                }
+                const auto& comparison = without_parens(*condition);
+                if (comparison.kind() != NodeKind::BinaryExpr) {
+                    return std::nullopt;
+                }
+                const auto& binary = static_cast<const BinaryExpr&>(comparison);
+                const auto op = binary.op().type;
+                if ((op != TokenType::Less && op != TokenType::LessEqual) || !is_local_variable(*binary.lhs(), induction->local)) {
+                    return std::nullopt;
+                }
+                const auto limit = constant_integer(without_parens(*binary.rhs()));
+                if (!limit || *limit < 0) {
+                    return std::nullopt;
+                }
+                const auto bound = static_cast<std::uint64_t>(*limit) + (op == TokenType::LessEqual ? 1U : 0U);
+                const auto max = integer_max(checked_.type_of(*binary.lhs()));
+                if (bound == 0 || bound - 1 > max || static_cast<std::uint64_t>(induction->step) > max - (bound - 1)) {
+                    return std::nullopt;
+                }
+                return bound;
+            }
+
+            // Value of an integer literal or of the length of an array
+            std::optional<std::int64_t> constant_integer(const Expr& expr)
+            {
+                if (expr.kind() == NodeKind::IntLiteralExpr) {
+                    return literal_value(expr).integer;
+                }
+                if (expr.kind() == NodeKind::FieldExpr) {
+                    const auto& object = *static_cast<const FieldExpr&>(expr).object();
+                    const auto type = checked_.type_of(object);
+                    if (is_array(type) && !assigns(object, true)) {
+                        return checked_.array_of(type).length;
+                    }
+                }
+                return std::nullopt;
+            }
+
+            // Whether the index of expr is a literal within the array, or an
+            // induction variable bound to it
+            bool is_proven(const IndexExpr& expr)
+            {
+                const auto length = checked_.array_of(checked_.type_of(*expr.array())).length;
+                const auto& index = without_parens(*expr.index());
+                if (index.kind() == NodeKind::IntLiteralExpr) {
+                    const auto value = literal_value(index).integer;
+                    return value >= 0 && value < std::int64_t{length};
+                }
+                return std::ranges::any_of(proven_, [&](const auto& proof) { return proof.second <= length && is_local_variable(index, proof.first); });
+            }
+
+            bool is_local_variable(const Expr& expr, std::uint32_t local) const
+            {
+                const auto& variable = without_parens(expr);
+                if (variable.kind() != NodeKind::IdentifierExpr) {
+                    return false;
+                }
+                const auto binding = checked_.binding_of(static_cast<const IdentifierExpr&>(variable));
+                return binding.kind == Binding::Kind::Local && binding.index == local;
+            }
+
+            // Computes the products of scan before the loop, into registers that
+            // the returned steps keep up to date
+            std::vector<ProductStep> reduce_products(const LoopScan& scan, std::vector<const Expr*>& hoisted, SourceLocation location)
+            {
+                auto steps = std::vector<ProductStep>{};
+                // Products by the same constant share a register
+                auto by_factor = std::unordered_map<std::int64_t, Register>{};
+                for (const auto* product : scan.products) {
+                    const auto& factor = is_local_variable(*product->lhs(), scan.induction->local) ? *product->rhs() : *product->lhs();
+                    const auto value = literal_value(without_parens(factor)).integer;
+                    auto [iter, inserted] = by_factor.emplace(value, Register{});
+                    if (inserted) {
+                        const auto type = checked_.type_of(*product);
+                        iter->second = allocate(location);
+                        static_cast<void>(generate_expr(*product, iter->second));
+                        const auto step = allocate(location);
+                        const auto increment = wrap_integer(type, static_cast<std::int64_t>(static_cast<std::uint64_t>(scan.induction->step) * static_cast<std::uint64_t>(value)));
+                        emit(OpCode::LoadConst, location, step, constant(Value::of_integer(type, increment), location));
+                        steps.push_back(ProductStep{.product = iter->second, .step = step, .type = type});
+                    }
+                    hoisted_.emplace(product, iter->second);
+                    hoisted.push_back(product);
+                }
+                return steps;
+            }
+
+            void find_invariants(const Statement& statement, LoopScan& scan)
+            {
+                switch (statement.kind()) {
+                    case NodeKind::ExprStatement:
+                        find_root_invariant(*static_cast<const ExprStatement&>(statement).expr(), scan);
+                        break;
+                    case NodeKind::ReturnStatement:
+                        find_root_invariant(*static_cast<const ReturnStatement&>(statement).return_value(), scan);
+                        break;
+                    case NodeKind::VarDeclStatement:
+                        find_root_invariant(*static_cast<const VarDeclStatement&>(statement).initializer(), scan);
+                        break;
+                    case NodeKind::BlockStatement:
+                        for (const auto& child : static_cast<const BlockStatement&>(statement).statements()) {
+                            find_invariants(*child, scan);
+                        }
+                        break;
+                    case NodeKind::IfStatement: {
+                        const auto& if_statement = static_cast<const IfStatement&>(statement);
+                        find_root_invariant(*if_statement.condition(), scan);
+                        find_invariants(*if_statement.then_branch(), scan);
+                        if (const auto* else_branch = if_statement.else_branch()) {
+                            find_invariants(*else_branch, scan);
+                        }
+                        break;
+                    }
+                    case NodeKind::WhileStatement: {
+                        const auto& loop = static_cast<const WhileStatement&>(statement);
+                        find_root_invariant(*loop.condition(), scan);
+                        find_invariants(*loop.body(), scan);
+                        break;
+                    }
+                    case NodeKind::ForStatement: {
+                        const auto& loop = static_cast<const ForStatement&>(statement);
+                        if (const auto* initializer = loop.initializer()) {
+                            find_invariants(*initializer, scan);
+                        }
+                        for (const auto* expr : {loop.condition(), loop.increment()}) {
+                            if (expr != nullptr) {
+                                find_root_invariant(*expr, scan);
+                            }
+                        }
+                        find_invariants(*loop.body(), scan);
+                        break;
+                    }
+                    default:
+                        break;
+                }
+            }
+
+            void find_root_invariant(const Expr& expr, LoopScan& scan)
+            {
+                // Literals are as cheap to load where they are used
+                if (find_invariants(expr, scan) && !is_literal(without_parens(expr))) {
+                    keep_invariant(expr, scan);
+                }
+            }
+
+            // Whether expr has the same value in every iteration of the loop of scan
+            bool find_invariants(const Expr& expr, LoopScan& scan)
+            {
+                if (hoisted_.contains(&expr)) {
+                    return true;
+                }
+                switch (expr.kind()) {
+                    case NodeKind::IntLiteralExpr:
+                    case NodeKind::FloatingLiteralExpr:
+                    case NodeKind::StringLiteralExpr:
+                    case NodeKind::CharLiteralExpr:
+                    case NodeKind::BoolLiteralExpr:
+                        return true;
+                    case NodeKind::IdentifierExpr: {
+                        // Globals may be assigned by any call
+                        const auto binding = checked_.binding_of(static_cast<const IdentifierExpr&>(expr));
+                        return binding.kind == Binding::Kind::Local && scan.assignments.count(binding.index) == 0;
+                    }
+                    case NodeKind::ParenExpr:
+                        return find_invariants(*static_cast<const ParenExpr&>(expr).expr(), scan);
+                    case NodeKind::UnaryExpr:
+                        return find_invariants(*static_cast<const UnaryExpr&>(expr).expr(), scan);
+                    case NodeKind::BinaryExpr: {
+                        const auto& binary = static_cast<const BinaryExpr&>(expr);
+                        const auto lhs = find_invariants(*binary.lhs(), scan);
+                        const auto rhs = find_invariants(*binary.rhs(), scan);
+                        if (lhs && rhs && !may_trap(binary)) {
+                            return true;
+                        }
+                        if (is_induction_product(binary, scan)) {
+                            scan.products.push_back(&binary);
+                            return false;
+                        }
+                        if (lhs) {
+                            keep_invariant(*binary.lhs(), scan);
+                        }
+                        if (rhs) {
+                            keep_invariant(*binary.rhs(), scan);
+                        }
+                        return false;
+                    }
+                    case NodeKind::AssignmentExpr:
+                        find_root_invariant(*static_cast<const AssignmentExpr&>(expr).rhs(), scan);
+                        return false;
+                    case NodeKind::CallExpr:
+                        for (const auto& argument : static_cast<const CallExpr&>(expr).arguments()) {
+                            find_root_invariant(*argument, scan);
+                        }
+                        return false;
+                    case NodeKind::FieldExpr:
+                        return find_invariants(*static_cast<const FieldExpr&>(expr).object(), scan);
+                    case NodeKind::IndexExpr: {
+                        // Elements may be stored to, and only scalars are kept
+                        const auto& index = static_cast<const IndexExpr&>(expr);
+                        find_root_invariant(*index.array(), scan);
+                        find_root_invariant(*index.index(), scan);
+                        return false;
+                    }
+                    case NodeKind::ArrayLiteralExpr:
+                        for (const auto& element : static_cast<const ArrayLiteralExpr&>(expr).elements()) {
+                            find_root_invariant(*element, scan);
+                        }
+                        return false;
+                    default:
+                        return false;
+                }
+            }
+
+            void keep_invariant(const Expr& expr, LoopScan& scan)
+            {
+                // Locals and their fields already are in registers. Registers of
+                // structs and arrays are not kept, the latter point to memory that
+                // is reused
+                const auto kind = without_parens(expr).kind();
+                if (kind != NodeKind::IdentifierExpr && kind != NodeKind::FieldExpr && is_scalar(checked_.type_of(expr)) && !hoisted_.contains(&expr) &&
+                    scan.invariants.size() < max_hoisted) {
+                    scan.invariants.push_back(&expr);
+                }
+            }
+
+            // Invariant operations are computed before the loop even if it runs
+            // no iterations, so they must not be able to fail
+            bool may_trap(const BinaryExpr& binary)
+            {
+                const auto op = binary.op().type;
+                if ((op != TokenType::Slash && op != TokenType::Percent) || is_floating(checked_.type_of(binary))) {
+                    return false;
+                }
+                const auto& divisor = without_parens(*binary.rhs());
+                return divisor.kind() != NodeKind::IntLiteralExpr || literal_value(divisor).integer == 0;
+            }
+
+            bool is_induction_product(const BinaryExpr& binary, const LoopScan& scan) const
+            {
+                if (!scan.induction || binary.op().type != TokenType::Star || !is_integer(checked_.type_of(binary))) {
+                    return false;
+                }
+                const auto is_factor = [](const Expr& expr) { return without_parens(expr).kind() == NodeKind::IntLiteralExpr; };
+                const auto local = scan.induction->local;
+                return (is_local_variable(*binary.lhs(), local) && is_factor(*binary.rhs())) ||
+                       (is_factor(*binary.lhs()) && is_local_variable(*binary.rhs(), local));
+            }
+
+            // Compiles expr into target, or into the register it returns if there
+            // is no target. Locals and their fields are returned in place, without
+            // a copy. Structs take consecutive registers, starting at the one
+            // returned. Arrays are compiled into the elements target points to,
+            // or else returned as a register pointing to them, which may be the
+            // storage of a variable or of a constant and must not be stored to
+            Register generate_expr(const Expr& expr, std::optional<Register> target = std::nullopt)
+            {
+                if (const auto hoisted = hoisted_.find(&expr); hoisted != hoisted_.end()) {
+                    if (target && *target != hoisted->second) {
+                        emit(OpCode::Move, location_of(expr), *target, hoisted->second);
+                        return *target;
+                    }
+                    return hoisted->second;
+                }
+                switch (expr.kind()) {
+                    case NodeKind::IntLiteralExpr:
+                    case NodeKind::FloatingLiteralExpr:
+                    case NodeKind::StringLiteralExpr:
+                    case NodeKind::CharLiteralExpr:
+                    case NodeKind::BoolLiteralExpr: {
+                        const auto location = location_of(expr);
+                        const auto result = target ? *target : allocate(location);
+                        emit(OpCode::LoadConst, location, result, constant(literal_value(expr), location));
+                        return result;
+                    }
+                    case NodeKind::IdentifierExpr: {
+                        const auto& identifier = static_cast<const IdentifierExpr&>(expr);
+                        const auto binding = checked_.binding_of(identifier);
+                        const auto location = identifier.identifier().location;
+                        const auto type = checked_.type_of(expr);
+                        if (binding.kind == Binding::Kind::Local) {
+                            const auto local = local_registers_[binding.index];
+                            if (target && *target != local) {
+                                move(*target, local, type, location);
+                                return *target;
+                            }
+                            return local;
+                        }
+                        return load_global(global_slots_[binding.index], type, target, location);
+                    }
+                    case NodeKind::ParenExpr:
+                        return generate_expr(*static_cast<const ParenExpr&>(expr).expr(), target);
+                    case NodeKind::UnaryExpr: {
+                        const auto& unary = static_cast<const UnaryExpr&>(expr);
+                        const auto top = next_;
+                        const auto operand = generate_expr(*unary.expr());
+                        next_ = top;
+                        const auto result = target ? *target : allocate(unary.unary_op().location);
+                        const auto op = unary.unary_op().type == TokenType::Bang ? OpCode::Not : OpCode::Negate;
+                        emit(op, checked_.type_of(*unary.expr()), unary.unary_op().location, result, operand);
+                        return result;
+                    }
+                    case NodeKind::BinaryExpr:
+                        return generate_binary(static_cast<const BinaryExpr&>(expr), target);
+                    case NodeKind::AssignmentExpr:
+                        return generate_assignment(static_cast<const AssignmentExpr&>(expr), target);
+                    case NodeKind::CallExpr:
+                        return generate_call(static_cast<const CallExpr&>(expr), target);
+                    case NodeKind::FieldExpr:
+                        return generate_field(static_cast<const FieldExpr&>(expr), target);
+                    case NodeKind::IndexExpr:
+                        return generate_index(static_cast<const IndexExpr&>(expr), target);
+                    case NodeKind::ArrayLiteralExpr:
+                        return generate_array_literal(static_cast<const ArrayLiteralExpr&>(expr), target);
+                    default:
+                        break;
+                }
+                throw type_error(location_of(expr), fmt::format("Cannot compile {}", expr.kind()));
+            }
+
+            Register generate_field(const FieldExpr& expr, std::optional<Register> target)
+            {
+                const auto location = expr.field().location;
+                const auto type = checked_.type_of(expr);
+                const auto object_type = checked_.type_of(*expr.object());
+                if (is_array(object_type)) {
+                    return generate_length(expr, target);
+                }
+                if (const auto global = global_slot(expr)) {
+                    // Only the field is loaded
+                    return load_global(*global, type, target, location);
+                }
+                if (const auto element = element_slot(expr)) {
+                    // So is the field of an element
+                    return generate_element(*element->first, element->second, type, target);
+                }
+                const auto top = next_;
+                const auto object = generate_expr(*expr.object());
+                const auto field = static_cast<Register>(object + checked_.field_of(expr).slot);
+                if (object < top) {
+                    // The field of a local
+                    if (target && *target != field) {
+                        move(*target, field, type, location);
+                        return *target;
+                    }
+                    return field;
+                }
+                // Moves the field down over the temporary object
+                next_ = top;
+                const auto result = target ? *target : allocate(location, checked_.slot_count(type));
+                if (result != field) {
+                    move(result, field, type, location);
+                }
+                return result;
+            }
+
+            // First global slot of a global variable or of a field of one,
+            // nullopt for other expressions
+            std::optional<std::uint32_t> global_slot(const Expr& expr) const
+            {
+                if (expr.kind() == NodeKind::IdentifierExpr) {
+                    const auto binding = checked_.binding_of(static_cast<const IdentifierExpr&>(expr));
+                    return binding.kind == Binding::Kind::Global ? std::optional{global_slots_[binding.index]} : std::nullopt;
+                }
+                if (expr.kind() == NodeKind::FieldExpr) {
+                    const auto& field = static_cast<const FieldExpr&>(expr);
+                    if (!is_struct(checked_.type_of(*field.object()))) {
+                        return std::nullopt;
+                    }
+                    if (const auto object = global_slot(*field.object())) {
+                        return *object + checked_.field_of(field).slot;
+                    }
+                }
+                return std::nullopt;
+            }
+
+            // Element of an array of structs that expr is, or is a field of, and
+            // the first slot of expr in it. nullopt for other expressions
+            std::optional<std::pair<const IndexExpr*, std::uint32_t>> element_slot(const Expr& expr) const
+            {
+                if (expr.kind() == NodeKind::IndexExpr) {
+                    const auto& element = static_cast<const IndexExpr&>(expr);
+                    return is_struct(checked_.type_of(element)) ? std::optional{std::pair{&element, std::uint32_t{0}}} : std::nullopt;
+                }
+                if (expr.kind() == NodeKind::FieldExpr) {
+                    const auto& field = static_cast<const FieldExpr&>(expr);
+                    if (!is_struct(checked_.type_of(*field.object()))) {
+                        return std::nullopt;
+                    }
+                    if (auto element = element_slot(*field.object())) {
+                        element->second += checked_.field_of(field).slot;
+                        return element;
+                    }
+                }
+                return std::nullopt;
+            }
+
+            // The slot of a global array points to its elements
+            Register load_global(std::uint32_t slot, Type type, std::optional<Register> target, SourceLocation location)
+            {
+                if (is_array(type)) {
+                    const auto top = next_;
+                    const auto pointer = allocate(location);
+                    emit(OpCode::LoadGlobal, location, pointer, static_cast<std::uint16_t>(slot));
+                    if (!target) {
+                        return pointer;
+                    }
+                    emit(OpCode::CopyArray, location, *target, pointer, array_operand(type));
+                    next_ = top;
+                    return *target;
+                }
+                const auto count = checked_.slot_count(type);
+                const auto result = target ? *target : allocate(location, count);
+                for (std::uint32_t i = 0; i < count; ++i) {
+                    emit(OpCode::LoadGlobal, location, static_cast<std::uint16_t>(result + i), static_cast<std::uint16_t>(slot + i));
+                }
+                return result;
+            }
+
+            void store_global(std::uint32_t slot, Register value, Type type, SourceLocation location)
+            {
+                if (is_array(type)) {
+                    // value may already be freed
+                    const auto top = next_;
+                    next_ = std::max(next_, static_cast<Register>(value + 1));
+                    const auto pointer = allocate(location);
+                    emit(OpCode::LoadGlobal, location, pointer, static_cast<std::uint16_t>(slot));
+                    emit(OpCode::CopyArray, location, pointer, value, array_operand(type));
+                    next_ = top;
+                    return;
+                }
+                for (std::uint32_t i = 0; i < checked_.slot_count(type); ++i) {
+                    emit(OpCode::StoreGlobal, location, static_cast<std::uint16_t>(slot + i), static_cast<std::uint16_t>(value + i));
+                }
+            }
+
+            // Copies a value of type from the registers at source to those at
+            // target, which is below source if they overlap. Arrays are copied
+            // from the elements source points to into those target points to
+            void move(Register target, Register source, Type type, SourceLocation location)
+            {
+                if (is_array(type)) {
+                    emit(OpCode::CopyArray, location, target, source, array_operand(type));
+                    return;
+                }
+                for (std::uint32_t i = 0; i < checked_.slot_count(type); ++i) {
+                    emit(OpCode::Move, location, static_cast<std::uint16_t>(target + i), static_cast<std::uint16_t>(source + i));
+                }
+            }
+
+            Register generate_binary(const BinaryExpr& binary, std::optional<Register> target)
+            {
+                const auto location = binary.op().location;
+                const auto type = binary.op().type;
+                if (type == TokenType::AmpAmp || type == TokenType::PipePipe) {
+                    return generate_logical(binary, target);
+                }
+                if (is_array(checked_.type_of(binary))) {
+                    // The operands may be temporaries too, so the result is allocated first
+                    const auto result = target ? *target : allocate_array(checked_.type_of(binary), location);
+                    const auto [lhs, rhs] = generate_operands(binary);
+                    emit(vector_op(type), location, result, lhs, rhs);
+                    emit(OpCode::ExtraArg, location, array_operand(checked_.type_of(binary)));
+                    return result;
+                }
+                auto [lhs, rhs] = generate_operands(binary);
+                if (swaps_operands(type)) {
+                    std::swap(lhs, rhs);
+                }
+                const auto result = target ? *target : allocate(location);
+                // Comparisons are of their operands, not of their bool result
+                emit(binary_op(type), checked_.type_of(*binary.lhs()), location, result, lhs, rhs);
+                return result;
+            }
+
+            // The registers holding both operands, which are free for the result
+            std::pair<Register, Register> generate_operands(const BinaryExpr& binary)
+            {
+                const auto location = binary.op().location;
+                const auto top = next_;
+                auto lhs = generate_expr(*binary.lhs());
+                const auto lhs_type = checked_.type_of(*binary.lhs());
+                if (is_array(lhs_type)) {
+                    if (is_variable_storage(without_parens(*binary.lhs())) && assigns(*binary.rhs(), true)) {
+                        // The right operand may store to the array, or call a function that does
+                        const auto copy = allocate_array(lhs_type, location);
+                        emit(OpCode::CopyArray, location, copy, lhs, array_operand(lhs_type));
+                        lhs = copy;
+                    }
+                }
+                else if (lhs < locals_end_ && assigns(*binary.rhs())) {
+                    // The right operand may change the local before it is read
+                    const auto copy = allocate(location);
+                    emit(OpCode::Move, location, copy, lhs);
+                    lhs = copy;
+                }
+                const auto rhs = generate_expr(*binary.rhs());
+                next_ = top;
+                return {lhs, rhs};
+            }
+
+            // Logical operators are compiled as branches, which load the result
+            Register generate_logical(const BinaryExpr& binary, std::optional<Register> target)
+            {
+                const auto location = binary.op().location;
+                auto to_false = std::vector<std::size_t>{};
+                generate_branch(binary, false, to_false);
+                const auto result = target ? *target : allocate(location);
+                emit(OpCode::LoadConst, location, result, constant(Value::of_bool(true), location));
+                const auto to_end = std::vector{emit_jump(OpCode::Jump, location)};
+                patch(to_false, here(location));
+                emit(OpCode::LoadConst, location, result, constant(Value::of_bool(false), location));
+                patch(to_end, here(location));
+                return result;
+            }
+
+            // Emits the jumps, added to jumps to be patched, that are taken if
+            // condition evaluates to jump_if, and falls through otherwise. Logical
+            // operators short-circuit and comparisons are fused with their jump
+            void generate_branch(const Expr& condition, bool jump_if, std::vector<std::size_t>& jumps)
+            {
+                const auto location = location_of(condition);
+                if (!hoisted_.contains(&condition)) {
+                    switch (condition.kind()) {
+                        case NodeKind::BoolLiteralExpr:
+                            if ((literal_value(condition).integer != 0) == jump_if) {
+                                jumps.push_back(emit_jump(OpCode::Jump, location));
+                            }
+                            return;
+                        case NodeKind::ParenExpr:
+                            generate_branch(*static_cast<const ParenExpr&>(condition).expr(), jump_if, jumps);
+                            return;
+                        case NodeKind::UnaryExpr:
+                            // Negation, the only unary operator on bool
+                            generate_branch(*static_cast<const UnaryExpr&>(condition).expr(), !jump_if, jumps);
+                            return;
+                        case NodeKind::BinaryExpr:
+                            if (generate_binary_branch(static_cast<const BinaryExpr&>(condition), jump_if, jumps)) {
+                                return;
+                            }
+                            break;
+                        default:
+                            break;
+                    }
+                }
+                const auto top = next_;
+                const auto value = generate_expr(condition);
+                next_ = top;
+                jumps.push_back(emit_jump(jump_if ? OpCode::JumpIfTrue : OpCode::JumpIfFalse, location, value));
+            }
+
+            // Returns false if binary is neither logical nor a comparison
+            bool generate_binary_branch(const BinaryExpr& binary, bool jump_if, std::vector<std::size_t>& jumps)
+            {
+                const auto type = binary.op().type;
+                if (type == TokenType::AmpAmp || type == TokenType::PipePipe) {
+                    // The value of the left operand that decides the result on its own
+                    const auto decisive = type == TokenType::PipePipe;
+                    if (jump_if == decisive) {
+                        generate_branch(*binary.lhs(), decisive, jumps);
+                        generate_branch(*binary.rhs(), jump_if, jumps);
+                        return true;
+                    }
+                    auto decided = std::vector<std::size_t>{};
+                    generate_branch(*binary.lhs(), decisive, decided);
+                    generate_branch(*binary.rhs(), jump_if, jumps);
+                    patch(decided, here(binary.op().location));
+                    return true;
+                }
+                const auto op = compare_jump(type, jump_if);
+                if (!op) {
+                    return false;
+                }
+                auto [lhs, rhs] = generate_operands(binary);
+                if (swaps_operands(type)) {
+                    std::swap(lhs, rhs);
+                }
+                jumps.push_back(emit_jump(*op, checked_.type_of(*binary.lhs()), binary.op().location, lhs, rhs));
+                return true;
+            }
+
+            Register generate_assignment(const AssignmentExpr& assignment, std::optional<Register> target)
+            {
+                const auto& lhs = *assignment.lhs();
+                if (const auto element = element_slot(lhs)) {
+                    return generate_element_assignment(assignment, *element->first, element->second, target);
+                }
+                if (lhs.kind() == NodeKind::IndexExpr) {
+                    return generate_element_assignment(assignment, static_cast<const IndexExpr&>(lhs), 0, target);
+                }
+                const auto type = checked_.type_of(lhs);
+                const auto location = location_of(lhs);
+                if (const auto global = global_slot(lhs)) {
+                    const auto value = generate_expr(*assignment.rhs(), target);
+                    store_global(*global, value, type, location);
+                    return value;
+                }
+                // A local or a field of one, which is compiled to its registers.
+                // Array literals are built aside too, their elements may read the array
+                const auto variable = generate_expr(lhs);
+                if (checked_.slot_count(type) == 1 && without_parens(*assignment.rhs()).kind() != NodeKind::ArrayLiteralExpr) {
+                    static_cast<void>(generate_expr(*assignment.rhs(), variable));
+                }
+                else {
+                    // The value is built aside, it may read the fields it overwrites
+                    const auto top = next_;
+                    const auto value = generate_expr(*assignment.rhs());
+                    next_ = top;
+                    if (value != variable) {
+                        move(variable, value, type, location);
+                    }
+                }
+                if (target && *target != variable) {
+                    move(*target, variable, type, location);
+                    return *target;
+                }
+                return variable;
+            }
+
+            // Arguments are evaluated straight into the registers that start the
+            // frame of the callee, which returns its result in the first of them
+            Register generate_call(const CallExpr& call, std::optional<Register> target)
+            {
+                const auto& callee = static_cast<const IdentifierExpr&>(*call.callee());
+                const auto binding = checked_.binding_of(callee);
+                if (binding.kind == Binding::Kind::Struct) {
+                    return generate_construction(call, target);
+                }
+                const auto location = callee.identifier().location;
+                const auto arguments = call.arguments();
+                const auto type = checked_.type_of(call);
+                auto argument_registers = std::vector<Register>{};
+                auto registers = std::size_t{0};
+                for (const auto& argument : arguments) {
+                    argument_registers.push_back(static_cast<Register>(registers));
+                    registers += checked_.slot_count(checked_.type_of(*argument));
+                }
+                const auto base = allocate(location, std::max<std::size_t>({registers, checked_.slot_count(type), 1}));
+                for (std::size_t i = 0; i < arguments.size(); ++i) {
+                    const auto argument = static_cast<Register>(base + argument_registers[i]);
+                    if (is_array(checked_.type_of(*arguments[i]))) {
+                        generate_array_argument(arguments, i, argument);
+                    }
+                    else {
+                        static_cast<void>(generate_expr(*arguments[i], argument));
+                    }
+                }
+                emit(OpCode::Call, location, base, static_cast<std::uint16_t>(binding.index), static_cast<std::uint16_t>(registers));
+                if (target) {
+                    next_ = base;
+                    move(*target, base, type, location);
+                    return *target;
+                }
+                next_ = static_cast<Register>(base + checked_.slot_count(type));
+                if (is_array(type)) {
+                    // The result may be stored in the memory of the callee, which the next call reuses
+                    const auto result = allocate_array(type, location);
+                    emit(OpCode::CopyArray, location, result, base, array_operand(type));
+                    return result;
+                }
+                return base;
+            }
+
+            // Arrays are passed as a pointer to their elements, which the callee
+            // cannot store to. Globals are copied, since the callee may assign
+            // them, and so are variables that later arguments may assign
+            void generate_array_argument(std::span<const ExprPtr> arguments, std::size_t i, Register argument)
+            {
+                const auto& expr = *arguments[i];
+                const auto location = location_of(expr);
+                const auto type = checked_.type_of(expr);
+                const auto top = next_;
+                auto pointer = generate_expr(expr);
+                const auto is_global = [&] {
+                    const auto& variable = without_parens(expr);
+                    return variable.kind() == NodeKind::IdentifierExpr && checked_.binding_of(static_cast<const IdentifierExpr&>(variable)).kind == Binding::Kind::Global;
+                };
+                const auto later_assigns = std::any_of(arguments.begin() + static_cast<std::ptrdiff_t>(i) + 1, arguments.end(), [](const auto& later) { return assigns(*later, true); });
+                if (is_global() || (is_variable_storage(without_parens(expr)) && later_assigns)) {
+                    const auto copy = allocate_array(type, location);
+                    emit(OpCode::CopyArray, location, copy, pointer, array_operand(type));
+                    pointer = copy;
+                }
+                emit(OpCode::Move, location, argument, pointer);
+                next_ = top;
+            }
+
+            // A constant, the object is only evaluated for its side effects
+            Register generate_length(const FieldExpr& expr, std::optional<Register> target)
+            {
+                const auto location = expr.field().location;
+                const auto& object = *expr.object();
+                if (assigns(object, true)) {
+                    const auto top = next_;
+                    static_cast<void>(generate_expr(object));
+                    next_ = top;
+                }
+                const auto type = checked_.type_of(expr);
+                const auto length = checked_.array_of(checked_.type_of(object)).length;
+                const auto value = is_floating(type) ? Value::of_floating(type, round_floating(type, length)) : Value::of_integer(type, wrap_integer(type, length));
+                const auto result = target ? *target : allocate(location);
+                emit(OpCode::LoadConst, location, result, constant(value, location));
+                return result;
+            }
+
+            // Indexes are checked unless a loop proves them in bounds
+            Register generate_index(const IndexExpr& expr, std::optional<Register> target)
+            {
+                if (const auto type = checked_.type_of(expr); is_struct(type)) {
+                    return generate_element(expr, 0, type, target);
+                }
+                const auto location = expr.bracket().location;
+                const auto top = next_;
+                const auto array = generate_expr(*expr.array());
+                const auto index = generate_expr(*expr.index());
+                const auto array_type = checked_.type_of(*expr.array());
+                if (!is_proven(expr)) {
+                    emit(OpCode::CheckIndex, location, array, index, array_operand(array_type));
+                }
+                next_ = top;
+                const auto result = target ? *target : allocate(location);
+                emit(OpCode::LoadIndex, checked_.array_of(array_type).element, location, result, array, index);
+                return result;
+            }
+
+            // Loads the scalars of an element of an array of structs that make a
+            // value of type from slot on, the whole element or one of its fields,
+            // each from its column
+            Register generate_element(const IndexExpr& element, std::uint32_t slot, Type type, std::optional<Register> target)
+            {
+                const auto location = element.bracket().location;
+                const auto count = checked_.slot_count(type);
+                // Below the array and the index, which are read by every load
+                const auto result = target ? *target : allocate(location, count);
+                const auto top = next_;
+                const auto array = generate_expr(*element.array());
+                const auto index = generate_expr(*element.index());
+                const auto array_type = checked_.type_of(*element.array());
+                if (!is_proven(element)) {
+                    emit(OpCode::CheckIndex, location, array, index, array_operand(array_type));
+                }
+                const auto& layout = checked_.array_of(array_type);
+                for (std::uint32_t i = 0; i < count; ++i) {
+                    emit(OpCode::LoadColumn, layout.columns[slot + i].type, location, static_cast<Register>(result + i), array, index);
+                    emit(OpCode::ExtraArg, location, array_operand(array_type), static_cast<std::uint16_t>(slot + i));
+                }
+                next_ = top;
+                return result;
+            }
+
+            // Stores the value of type in the registers from value on to the
+            // element of array at index, or to its slots from slot on if the
+            // elements are structs
+            void store_element(Register array, Register index, Register value, Type array_type, std::uint32_t slot, Type type, SourceLocation location)
+            {
+                const auto& layout = checked_.array_of(array_type);
+                if (!is_struct(layout.element)) {
+                    emit(OpCode::StoreIndex, layout.element, location, array, index, value);
+                    return;
+                }
+                for (std::uint32_t i = 0; i < checked_.slot_count(type); ++i) {
+                    emit(OpCode::StoreColumn, layout.columns[slot + i].type, location, array, index, static_cast<Register>(value + i));
+                    emit(OpCode::ExtraArg, location, array_operand(array_type), static_cast<std::uint16_t>(slot + i));
+                }
+            }
+
+            // Evaluates the array variable, the index and the value in that
+            // order, then stores the value to the element, or to the slots of
+            // it from slot on
+            Register generate_element_assignment(const AssignmentExpr& assignment, const IndexExpr& element, std::uint32_t slot, std::optional<Register> target)
+            {
+                const auto location = element.bracket().location;
+                const auto array = generate_expr(*element.array());
+                auto index = generate_expr(*element.index());
+                if (index < locals_end_ && assigns(*assignment.rhs())) {
+                    // The value may change the local before it is used
+                    const auto copy = allocate(location);
+                    emit(OpCode::Move, location, copy, index);
+                    index = copy;
+                }
+                const auto value = generate_expr(*assignment.rhs());
+                const auto array_type = checked_.type_of(*element.array());
+                if (!is_proven(element)) {
+                    emit(OpCode::CheckIndex, location, array, index, array_operand(array_type));
+                }
+                const auto type = checked_.type_of(*assignment.lhs());
+                store_element(array, index, value, array_type, slot, type, location);
+                if (target && *target != value) {
+                    move(*target, value, type, location);
+                    return *target;
+                }
+                return value;
+            }
+
+            // Literals of constants only are stored once, in the program, and
+            // copied where they are used. Other literals store each element
+            Register generate_array_literal(const ArrayLiteralExpr& literal, std::optional<Register> target)
+            {
+                const auto location = literal.bracket().location;
+                const auto type = checked_.type_of(literal);
+                const auto& layout = checked_.array_of(type);
+                const auto elements = literal.elements();
+                const auto constant_elements = std::all_of(elements.begin(), elements.end(), [](const auto& element) { return is_literal(without_parens(*element)); });
+                if (constant_elements && !literal.count()) {
+                    auto& bytes = program_.array_constants.emplace_back(layout.size);
+                    for (std::size_t i = 0; i < elements.size(); ++i) {
+                        store_scalar(bytes.data() + (i * scalar_size(layout.element)), literal_value(without_parens(*elements[i])));
+                    }
+                    const auto top = next_;
+                    const auto pointer = allocate(location);
+                    emit(OpCode::LoadConst, location, pointer, constant(Value::of_array(type, layout.element, layout.length, bytes.data()), location));
+                    if (!target) {
+                        return pointer;
+                    }
+                    emit(OpCode::CopyArray, location, *target, pointer, array_operand(type));
+                    next_ = top;
+                    return *target;
+                }
+                const auto result = target ? *target : allocate_array(type, location);
+                for (std::size_t i = 0; i < elements.size(); ++i) {
+                    const auto top = next_;
+                    const auto value = generate_expr(*elements[i]);
+                    if (literal.count()) {
+                        fill_array(result, value, type, location);
+                    }
+                    else {
+                        const auto index = allocate(location);
+                        emit(OpCode::LoadConst, location, index, constant(Value::of_integer(Type::Int64, static_cast<std::int64_t>(i)), location));
+                        store_element(result, index, value, type, 0, layout.element, location);
+                    }
+                    next_ = top;
+                }
+                return result;
+            }
+
+            // Stores the value in the registers from value on to every element,
+            // a column at a time if the elements are structs
+            void fill_array(Register array, Register value, Type type, SourceLocation location)
+            {
+                const auto& layout = checked_.array_of(type);
+                if (!is_struct(layout.element)) {
+                    emit(OpCode::FillArray, location, array, value, array_operand(type));
+                    return;
+                }
+                for (std::size_t i = 0; i < layout.columns.size(); ++i) {
+                    emit(OpCode::FillColumn, location, array, static_cast<Register>(value + i));
+                    emit(OpCode::ExtraArg, location, array_operand(type), static_cast<std::uint16_t>(i));
+                }
+            }
+
+            // The arguments are compiled into the registers of their fields
+            Register generate_construction(const CallExpr& call, std::optional<Register> target)
+            {
+                const auto location = location_of(*call.callee());
+                const auto& layout = checked_.structs[struct_index(checked_.type_of(call))];
+                const auto result = target ? *target : allocate(location, layout.slots.size());
+                const auto arguments = call.arguments();
+                for (std::size_t i = 0; i < arguments.size(); ++i) {
+                    const auto top = next_;
+                    static_cast<void>(generate_expr(*arguments[i], static_cast<Register>(result + layout.fields[i].slot)));
+                    next_ = top;
+                }
+                return result;
+            }
+
+            Value literal_value(const Expr& expr)
+            {
+                const auto type = checked_.type_of(expr);
+                switch (expr.kind()) {
+                    case NodeKind::IntLiteralExpr: {
+                        const auto token = static_cast<const IntLiteralExpr&>(expr).int_literal().string;
+                        auto value = std::int64_t{};
+                        std::from_chars(token.data(), token.data() + token.size(), value);
+                        if (is_floating(type)) {
+                            return Value::of_floating(type, round_floating(type, static_cast<double>(value)));
+                        }
+                        return Value::of_integer(type, wrap_integer(type, value));
+                    }
+                    case NodeKind::FloatingLiteralExpr: {
+                        const auto token = static_cast<const FloatingLiteralExpr&>(expr).float_literal().string;
+                        auto value = 0.0;
+                        std::from_chars(token.data(), token.data() + token.size(), value);
+                        return Value::of_floating(type, round_floating(type, value));
+                    }
+                    case NodeKind::StringLiteralExpr:
+                        return Value::of_string(&*program_.strings.insert(static_cast<const StringLiteralExpr&>(expr).value()).first);
+                    case NodeKind::CharLiteralExpr:
+                        return Value::of_char(static_cast<const CharLiteralExpr&>(expr).char_literal().string[1]);
+                    default:
+                        return Value::of_bool(static_cast<const BoolLiteralExpr&>(expr).bool_literal().type == TokenType::TrueLiteral);
+                }
+            }
+
+            std::uint16_t constant(Value value, SourceLocation location)
+            {
+                if (function_.constants.size() > max_operand) {
+                    throw too_large(location, "constants");
+                }
+                function_.constants.push_back(value);
+                return static_cast<std::uint16_t>(function_.constants.size() - 1);
+            }
+
+            // Returns a register pointing to the elements of a temporary array
+            Register allocate_array(Type type, SourceLocation location)
+            {
+                const auto result = allocate(location);
+                emit_frame_array(result, type, next_memory_, location);
+                next_memory_ += checked_.array_of(type).aligned_size();
+                function_.memory_size = std::max(function_.memory_size, next_memory_);
+                return result;
+            }
+
+            void emit_frame_array(Register target, Type type, std::size_t offset, SourceLocation location)
+            {
+                const auto offset_constant = constant(Value::of_integer(Type::Int64, static_cast<std::int64_t>(offset)), location);
+                emit(OpCode::FrameArray, location, target, array_operand(type), offset_constant);
+            }
+
+            // The index of the layout of an array type, as an operand
+            static std::uint16_t array_operand(Type type) noexcept
+            {
+                return static_cast<std::uint16_t>(array_index(type));
+            }
+
+            // Returns the first of count consecutive registers
+            Register allocate(SourceLocation location, std::size_t count = 1)
+            {
+                if (max_operand - next_ < count) {
+                    throw too_large(location, "registers");
+                }
+                const auto result = next_;
+                next_ = static_cast<Register>(next_ + count);
+                function_.register_count = std::max(function_.register_count, next_);
+                return result;
+            }
+
+            void emit(OpCode op, SourceLocation location, std::uint16_t a = 0, std::uint16_t b = 0, std::uint16_t c = 0)
+            {
+                emit(op, Type::Void, location, a, b, c);
+            }
+
+            // An instruction on operands of type, which the interpreter then
+            // never has to look up
+            void emit(OpCode op, Type type, SourceLocation location, std::uint16_t a = 0, std::uint16_t b = 0, std::uint16_t c = 0)
+            {
+                function_.code.push_back(Instruction{.op = op, .type = static_cast<std::uint8_t>(type), .a = a, .b = b, .c = c});
+                function_.locations.push_back(location);
+            }
+
+            // Emits a jump with operands a and b before its target, which is
+            // patched once known. Returns its index
+            std::size_t emit_jump(OpCode op, SourceLocation location, std::uint16_t a = 0, std::uint16_t b = 0)
+            {
+                return emit_jump(op, Type::Void, location, a, b);
+            }
+
+            std::size_t emit_jump(OpCode op, Type type, SourceLocation location, std::uint16_t a = 0, std::uint16_t b = 0)
+            {
+                emit(op, type, location, a, b);
+                return function_.code.size() - 1;
+            }
+
+            void patch(const std::vector<std::size_t>& jumps, std::uint16_t target)
+            {
+                for (const auto index : jumps) {
+                    auto& jump = function_.code[index];
+                    switch (jump.op) {
+                        case OpCode::Jump:
+                            jump.a = target;
+                            break;
+                        case OpCode::JumpIfTrue:
+                        case OpCode::JumpIfFalse:
+                            jump.b = target;
+                            break;
+                        default:
+                            jump.c = target;
+                            break;
+                    }
+                }
+            }
+
+            // Index of the next instruction, as a jump target
+            std::uint16_t here(SourceLocation location) const
+            {
+                if (function_.code.size() > max_operand) {
+                    throw too_large(location, "instructions");
+                }
+                return static_cast<std::uint16_t>(function_.code.size());
+            }
+
+            TalosException too_large(SourceLocation location, std::string_view what) const
+            {
+                return {ReturnCode::FunctionTooLarge, location, fmt::format("'{}' needs more than {} {}", info_.name, max_operand, what)};
+            }
+
+            Program& program_;
+            const CheckedProgram& checked_;
+            // First slot of each global variable
+            std::span<const std::uint32_t> global_slots_;
+            const FunctionInfo& info_;
+            Function& function_;
+            // First register of each local, which are followed by the temporaries
+            std::vector<Register> local_registers_;
+            Register locals_end_ = 0;
+            // First free register, temporaries are allocated and freed like a stack
+            Register next_ = 0;
+            // Registers computed before the loops around the expression being compiled
+            std::unordered_map<const Expr*, Register> hoisted_;
+            // Ids of the hoisted expressions, so that equal ones are computed once
+            ExpressionTable expressions_;
+            // Offset of the elements of each local array in the memory of the
+            // call, followed by those of the temporary arrays
+            std::vector<std::size_t> local_memory_;
+            std::size_t locals_memory_end_ = 0;
+            std::size_t next_memory_ = 0;
+            // Induction variables of the loops around the statement being
+            // compiled, and the bound they stay below
+            std::vector<std::pair<std::uint32_t, std::uint64_t>> proven_;
+        };
+    } // namespace
+
+    Program generate_code(const ProgramNode& program, const CheckedProgram& checked)
+    {
+        auto result = Program{
+            .functions = std::vector<Function>(checked.functions.size()),
+            .structs = checked.structs,
+            .arrays = checked.arrays,
+            .initializer = CheckedProgram::initializer,
+            .main = checked.main,
+        };
+        // Global structs are stored one slot per scalar, like in registers, and
+        // global arrays in one pointing to their elements
+        auto global_slots = std::vector<std::uint32_t>{};
+        for (const auto& global : checked.globals) {
+            global_slots.push_back(static_cast<std::uint32_t>(result.globals.size()));
+            if (is_struct(global.type)) {
+                for (const auto& slot : checked.structs[struct_index(global.type)].slots) {
+                    result.globals.push_back(slot.type);
+                }
+            }
+            else {
+                result.globals.push_back(global.type);
+            }
+        }
+        // Instructions address them with 16 bit operands too
+        if (checked.functions.size() > max_operand + 1 || result.globals.size() > max_operand + 1) {
+            throw TalosException(ReturnCode::FunctionTooLarge, SourceLocation{}, fmt::format("Programs cannot have more than {} functions or global slots", max_operand + 1));
+        }
+        FunctionGenerator{result, checked, global_slots, CheckedProgram::initializer}.generate_initializer(program);
+        for (std::uint32_t i = 0; i < checked.functions.size(); ++i) {
+            if (i != CheckedProgram::initializer) {
+                FunctionGenerator{result, checked, global_slots, i}.generate_function();
+            }
+        }
+        return result;
+    }
+
+    Program compile_program(const ProgramNode& program)
+    {
+        return generate_code(program, check_program(program));
+    }
+} // namespace talos
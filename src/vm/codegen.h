@@ -0,0 +1,21 @@
+#pragma once
+
+#include "bytecode.h"
+#include "checker.h"
+#include "frontend/ast.h"
+
+namespace talos
+{
+    // Compiles a checked program to bytecode. Locals live in the first
+    // registers of their function's frame and temporaries above them. Structs
+    // are flattened into one register per scalar, so fields are read and
+    // written like locals, and copied by moving each register. Loops
+    // compute their invariant subexpressions once, before the first iteration,
+    // and step products of their induction variable instead of multiplying.
+    // Throws TalosException if a function needs more registers, constants or
+    // instructions than an instruction can address
+    [[nodiscard]] Program generate_code(const ProgramNode& program, const CheckedProgram& checked);
+
+    // Checks program and compiles it to bytecode
+    [[nodiscard]] Program compile_program(const ProgramNode& program);
+} // namespace talos
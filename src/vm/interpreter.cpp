@@ -0,0 +1,437 @@
+#include "interpreter.h"
+
+#include "exceptions.h"
+#include "vector_kernels.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <memory>
+
+namespace talos
+{
+    namespace
+    {
+        TalosException runtime_error(ReturnCode code, const Function& function, const Instruction* pc, std::string message)
+        {
+            const auto index = static_cast<std::size_t>(pc - function.code.data()) - 1;
+            return {code, function.locations[index], std::move(message)};
+        }
+
+        TalosException stack_overflow(const Function& function, const Instruction* pc)
+        {
+            return runtime_error(ReturnCode::StackOverflow, function, pc, fmt::format("Calling from '{}' exceeds the VM stack", function.name));
+        }
+
+        OpCode scalar_op(OpCode op) noexcept
+        {
+            switch (op) {
+                case OpCode::VecAdd:
+                    return OpCode::Add;
+                case OpCode::VecSubtract:
+                    return OpCode::Subtract;
+                case OpCode::VecMultiply:
+                    return OpCode::Multiply;
+                default:
+                    return OpCode::Divide;
+            }
+        }
+
+        // Integers wrap around at the width of their type
+        template<OpCode Op>
+        std::int64_t integer_arithmetic(std::int64_t lhs, std::int64_t rhs) noexcept
+        {
+            const auto a = static_cast<std::uint64_t>(lhs);
+            const auto b = static_cast<std::uint64_t>(rhs);
+            if constexpr (Op == OpCode::Add) {
+                return static_cast<std::int64_t>(a + b);
+            }
+            else if constexpr (Op == OpCode::Subtract) {
+                return static_cast<std::int64_t>(a - b);
+            }
+            else if constexpr (Op == OpCode::Multiply) {
+                return static_cast<std::int64_t>(a * b);
+            }
+            else if constexpr (Op == OpCode::Modulo) {
+                // Avoids the overflow of the quotient
+                return rhs == -1 ? 0 : lhs % rhs;
+            }
+            else {
+                // The only quotient that overflows
+                if (lhs == std::numeric_limits<std::int64_t>::min() && rhs == -1) {
+                    return lhs;
+                }
+                return lhs / rhs;
+            }
+        }
+
+        template<OpCode Op>
+        double floating_arithmetic(double lhs, double rhs) noexcept
+        {
+            if constexpr (Op == OpCode::Add) {
+                return lhs + rhs;
+            }
+            else if constexpr (Op == OpCode::Subtract) {
+                return lhs - rhs;
+            }
+            else if constexpr (Op == OpCode::Multiply) {
+                return lhs * rhs;
+            }
+            else {
+                return lhs / rhs;
+            }
+        }
+
+        // The type comes from the instruction, so 64 bit operands take a path
+        // of their own and no operand is inspected to pick one
+        template<OpCode Op>
+        Word arithmetic(Type type, Word lhs, Word rhs) noexcept
+        {
+            switch (type) {
+                case Type::Int64:
+                    return Word{.integer = integer_arithmetic<Op>(lhs.integer, rhs.integer)};
+                case Type::Float64:
+                    return Word{.floating = floating_arithmetic<Op>(lhs.floating, rhs.floating)};
+                case Type::Float32:
+                    return Word{.floating = round_floating(type, floating_arithmetic<Op>(lhs.floating, rhs.floating))};
+                default:
+                    return Word{.integer = wrap_integer(type, integer_arithmetic<Op>(lhs.integer, rhs.integer))};
+            }
+        }
+
+        // Bools and chars compare as the integers they are stored as
+        bool equal(Type type, Word lhs, Word rhs) noexcept
+        {
+            return is_floating(type) ? lhs.floating == rhs.floating : lhs.integer == rhs.integer;
+        }
+
+        bool less(Type type, Word lhs, Word rhs) noexcept
+        {
+            return is_floating(type) ? lhs.floating < rhs.floating : lhs.integer < rhs.integer;
+        }
+
+        bool less_equal(Type type, Word lhs, Word rhs) noexcept
+        {
+            return is_floating(type) ? lhs.floating <= rhs.floating : lhs.integer <= rhs.integer;
+        }
+
+        Word of_bool(bool value) noexcept
+        {
+            return Word{.integer = value ? 1 : 0};
+        }
+
+        // The value of type that word holds, of a struct only its first scalar.
+        // Values cannot hold arrays of structs, which are returned as void
+        Value typed_value(const Program& program, Type type, Word word) noexcept
+        {
+            if (is_array(type)) {
+                const auto& layout = program.arrays[array_index(type)];
+                return is_struct(layout.element) ? Value{} : Value::of_array(type, layout.element, layout.length, word.elements);
+            }
+            if (is_struct(type)) {
+                const auto& slots = program.structs[struct_index(type)].slots;
+                if (slots.empty()) {
+                    return Value{};
+                }
+                type = slots.front().type;
+            }
+            return type == Type::Void ? Value{} : Value::of_word(type, word);
+        }
+    } // namespace
+
+    Interpreter::Interpreter(std::size_t stack_size, std::size_t max_call_depth, std::size_t memory_size)
+        : stack_(std::make_unique_for_overwrite<Word[]>(stack_size)),
+          stack_size_(stack_size),
+          frames_(std::make_unique_for_overwrite<Frame[]>(max_call_depth)),
+          max_call_depth_(max_call_depth),
+          memory_buffer_(std::make_unique_for_overwrite<std::byte[]>(memory_size + ArrayLayout::alignment)),
+          memory_size_(memory_size)
+    {
+        void* memory = memory_buffer_.get();
+        auto space = memory_size + ArrayLayout::alignment;
+        memory_ = static_cast<std::byte*>(std::align(ArrayLayout::alignment, memory_size, memory, space));
+    }
+
+    Value Interpreter::run(const Program& program)
+    {
+        initialize(program);
+        if (!program.main) {
+            return Value{};
+        }
+        return typed_value(program, program.functions[*program.main].return_type, execute(program, *program.main, {}));
+    }
+
+    Value Interpreter::call(const Program& program, std::uint32_t function, std::span<const Value> arguments)
+    {
+        initialize(program);
+        return typed_value(program, program.functions.at(function).return_type, execute(program, function, arguments));
+    }
+
+    void Interpreter::initialize(const Program& program)
+    {
+        globals_.clear();
+        auto global_memory_size = std::size_t{0};
+        for (const auto type : program.globals) {
+            if (is_array(type)) {
+                global_memory_size += program.arrays[array_index(type)].aligned_size();
+            }
+        }
+        global_memory_.assign(global_memory_size, std::byte{0});
+        auto* elements = global_memory_.data();
+        for (const auto type : program.globals) {
+            if (is_array(type)) {
+                globals_.push_back(Word{.elements = elements});
+                elements += program.arrays[array_index(type)].aligned_size();
+            }
+            else {
+                globals_.push_back(zero_value(type).word());
+            }
+        }
+        static_cast<void>(execute(program, program.initializer, {}));
+    }
+
+    Word Interpreter::execute(const Program& program, std::uint32_t function_index, std::span<const Value> arguments)
+    {
+        const auto* function = &program.functions.at(function_index);
+        if (function->register_count > stack_size_ || function->memory_size > memory_size_ || max_call_depth_ == 0) {
+            throw TalosException(ReturnCode::StackOverflow, SourceLocation{}, fmt::format("'{}' does not fit on the VM stack", function->name));
+        }
+        std::transform(arguments.begin(), arguments.end(), stack_.get(), [](const Value& argument) { return argument.word(); });
+
+        // The running function, kept in locals rather than in its frame
+        const auto* code = function->code.data();
+        const auto* pc = code;
+        const auto* constants = function->constants.data();
+        auto* base = stack_.get();
+        auto* const stack_end = stack_.get() + stack_size_;
+        auto* memory = memory_;
+        auto* const memory_end = memory_ + memory_size_;
+        // Frames of the callers
+        auto* frame = frames_.get();
+        auto* const frames_end = frames_.get() + max_call_depth_ - 1;
+        auto* const globals = globals_.data();
+
+        for (;;) {
+            const auto& instruction = *pc++;
+            const auto type = operand_type(instruction);
+            switch (instruction.op) {
+                case OpCode::LoadConst:
+                    base[instruction.a] = constants[instruction.b].word();
+                    break;
+                case OpCode::Move:
+                    base[instruction.a] = base[instruction.b];
+                    break;
+                case OpCode::LoadGlobal:
+                    base[instruction.a] = globals[instruction.b];
+                    break;
+                case OpCode::StoreGlobal:
+                    globals[instruction.a] = base[instruction.b];
+                    break;
+                case OpCode::Add:
+                    base[instruction.a] = arithmetic<OpCode::Add>(type, base[instruction.b], base[instruction.c]);
+                    break;
+                case OpCode::Subtract:
+                    base[instruction.a] = arithmetic<OpCode::Subtract>(type, base[instruction.b], base[instruction.c]);
+                    break;
+                case OpCode::Multiply:
+                    base[instruction.a] = arithmetic<OpCode::Multiply>(type, base[instruction.b], base[instruction.c]);
+                    break;
+                case OpCode::Divide:
+                case OpCode::Modulo: {
+                    const auto lhs = base[instruction.b];
+                    const auto rhs = base[instruction.c];
+                    if (is_integer(type) && rhs.integer == 0) {
+                        throw runtime_error(ReturnCode::DivisionByZero, *function, pc, fmt::format("Division by zero in '{}'", function->name));
+                    }
+                    base[instruction.a] = instruction.op == OpCode::Divide ? arithmetic<OpCode::Divide>(type, lhs, rhs) : arithmetic<OpCode::Modulo>(type, lhs, rhs);
+                    break;
+                }
+                case OpCode::Negate: {
+                    const auto operand = base[instruction.b];
+                    if (is_floating(type)) {
+                        base[instruction.a] = Word{.floating = -operand.floating};
+                    }
+                    else {
+                        base[instruction.a] = Word{.integer = wrap_integer(type, integer_arithmetic<OpCode::Subtract>(0, operand.integer))};
+                    }
+                    break;
+                }
+                case OpCode::Equal:
+                    base[instruction.a] = of_bool(equal(type, base[instruction.b], base[instruction.c]));
+                    break;
+                case OpCode::NotEqual:
+                    base[instruction.a] = of_bool(!equal(type, base[instruction.b], base[instruction.c]));
+                    break;
+                case OpCode::Less:
+                    base[instruction.a] = of_bool(less(type, base[instruction.b], base[instruction.c]));
+                    break;
+                case OpCode::LessEqual:
+                    base[instruction.a] = of_bool(less_equal(type, base[instruction.b], base[instruction.c]));
+                    break;
+                case OpCode::Not:
+                    base[instruction.a] = of_bool(base[instruction.b].integer == 0);
+                    break;
+                case OpCode::Jump:
+                    pc = code + instruction.a;
+                    break;
+                case OpCode::JumpIfTrue:
+                    if (base[instruction.a].integer != 0) {
+                        pc = code + instruction.b;
+                    }
+                    break;
+                case OpCode::JumpIfFalse:
+                    if (base[instruction.a].integer == 0) {
+                        pc = code + instruction.b;
+                    }
+                    break;
+                case OpCode::JumpIfEqual:
+                    if (equal(type, base[instruction.a], base[instruction.b])) {
+                        pc = code + instruction.c;
+                    }
+                    break;
+                case OpCode::JumpIfNotEqual:
+                    if (!equal(type, base[instruction.a], base[instruction.b])) {
+                        pc = code + instruction.c;
+                    }
+                    break;
+                case OpCode::JumpIfLess:
+                    if (less(type, base[instruction.a], base[instruction.b])) {
+                        pc = code + instruction.c;
+                    }
+                    break;
+                case OpCode::JumpIfNotLess:
+                    if (!less(type, base[instruction.a], base[instruction.b])) {
+                        pc = code + instruction.c;
+                    }
+                    break;
+                case OpCode::JumpIfLessEqual:
+                    if (less_equal(type, base[instruction.a], base[instruction.b])) {
+                        pc = code + instruction.c;
+                    }
+                    break;
+                case OpCode::JumpIfNotLessEqual:
+                    if (!less_equal(type, base[instruction.a], base[instruction.b])) {
+                        pc = code + instruction.c;
+                    }
+                    break;
+                case OpCode::Call: {
+                    const auto& callee = program.functions[instruction.b];
+                    auto* const callee_base = base + instruction.a;
+                    auto* const callee_memory = memory + function->memory_size;
+                    if (frame == frames_end || static_cast<std::size_t>(stack_end - callee_base) < callee.register_count ||
+                        static_cast<std::size_t>(memory_end - callee_memory) < callee.memory_size) {
+                        throw stack_overflow(*function, pc);
+                    }
+                    *frame++ = Frame{.function = function, .pc = pc, .base = base, .memory = memory};
+                    function = &callee;
+                    code = callee.code.data();
+                    pc = code;
+                    constants = callee.constants.data();
+                    base = callee_base;
+                    memory = callee_memory;
+                    break;
+                }
+                case OpCode::Return:
+                case OpCode::ReturnSlots:
+                case OpCode::ReturnVoid: {
+                    // The caller finds the result where it put the first argument
+                    const auto result = instruction.op != OpCode::ReturnVoid ? base[instruction.a] : Word{};
+                    if (frame == frames_.get()) {
+                        return result;
+                    }
+                    if (instruction.op == OpCode::ReturnSlots) {
+                        if (instruction.a != 0) {
+                            std::copy_n(base + instruction.a, instruction.b, base);
+                        }
+                    }
+                    else {
+                        base[0] = result;
+                    }
+                    --frame;
+                    function = frame->function;
+                    pc = frame->pc;
+                    code = function->code.data();
+                    constants = function->constants.data();
+                    base = frame->base;
+                    memory = frame->memory;
+                    break;
+                }
+                case OpCode::FrameArray:
+                    base[instruction.a] = Word{.elements = memory + constants[instruction.c].integer};
+                    break;
+                case OpCode::LoadIndex: {
+                    const auto offset = static_cast<std::size_t>(base[instruction.c].integer) * scalar_size(type);
+                    base[instruction.a] = load_word(type, base[instruction.b].elements + offset);
+                    break;
+                }
+                case OpCode::StoreIndex: {
+                    const auto offset = static_cast<std::size_t>(base[instruction.b].integer) * scalar_size(type);
+                    store_word(base[instruction.a].elements + offset, type, base[instruction.c]);
+                    break;
+                }
+                case OpCode::CheckIndex: {
+                    const auto index = base[instruction.b].integer;
+                    const auto length = program.arrays[instruction.c].length;
+                    if (index < 0 || index >= std::int64_t{length}) {
+                        throw runtime_error(ReturnCode::IndexOutOfBounds, *function, pc, fmt::format("Index {} is outside of an array of length {} in '{}'", index, length, function->name));
+                    }
+                    break;
+                }
+                case OpCode::CopyArray:
+                    // A variable may be assigned to itself
+                    std::memmove(base[instruction.a].elements, base[instruction.b].elements, program.arrays[instruction.c].size);
+                    break;
+                case OpCode::FillArray: {
+                    const auto& layout = program.arrays[instruction.c];
+                    const auto size = scalar_size(layout.element);
+                    auto* const elements = base[instruction.a].elements;
+                    for (std::size_t i = 0; i < layout.length; ++i) {
+                        store_word(elements + (i * size), layout.element, base[instruction.b]);
+                    }
+                    break;
+                }
+                case OpCode::LoadColumn: {
+                    const auto& column = program.arrays[pc->a].columns[pc->b];
+                    const auto offset = column.offset + (static_cast<std::size_t>(base[instruction.c].integer) * column.stride);
+                    base[instruction.a] = load_word(type, base[instruction.b].elements + offset);
+                    ++pc;
+                    break;
+                }
+                case OpCode::StoreColumn: {
+                    const auto& column = program.arrays[pc->a].columns[pc->b];
+                    const auto offset = column.offset + (static_cast<std::size_t>(base[instruction.b].integer) * column.stride);
+                    store_word(base[instruction.a].elements + offset, type, base[instruction.c]);
+                    ++pc;
+                    break;
+                }
+                case OpCode::FillColumn: {
+                    const auto& layout = program.arrays[pc->a];
+                    const auto& column = layout.columns[pc->b];
+                    auto* const elements = base[instruction.a].elements + column.offset;
+                    for (std::size_t i = 0; i < layout.length; ++i) {
+                        store_word(elements + (i * column.stride), column.type, base[instruction.b]);
+                    }
+                    ++pc;
+                    break;
+                }
+                case OpCode::VecAdd:
+                case OpCode::VecSubtract:
+                case OpCode::VecMultiply:
+                case OpCode::VecDivide: {
+                    const auto& layout = program.arrays[pc->a];
+                    if (!vector_arithmetic(scalar_op(instruction.op), layout.element, base[instruction.a].elements, base[instruction.b].elements, base[instruction.c].elements,
+                                           layout.length)) {
+                        throw runtime_error(ReturnCode::DivisionByZero, *function, pc, fmt::format("Division by zero in '{}'", function->name));
+                    }
+                    // Past the ExtraArg
+                    ++pc;
+                    break;
+                }
+                case OpCode::ExtraArg:
+                    break;
+            }
+        }
+    }
+} // namespace talos
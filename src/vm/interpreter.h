@@ -0,0 +1,65 @@
+#pragma once
+
+#include "bytecode.h"
+#include "value.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace talos
+{
+    // Runs bytecode on a stack of words, a call stack and a memory stack for
+    // arrays that are all allocated once, so that calls never allocate. The
+    // frame of a call starts at its arguments, which the caller evaluates into
+    // its topmost registers, and its arrays follow those of the caller.
+    // Values only get their type back when they leave the VM
+    class Interpreter
+    {
+    public:
+        static constexpr std::size_t default_stack_size = std::size_t{1} << 20U;
+        static constexpr std::size_t default_max_call_depth = std::size_t{1} << 16U;
+        static constexpr std::size_t default_memory_size = std::size_t{64} << 20U;
+
+        // stack_size counts words, max_call_depth nested calls and memory_size
+        // bytes of arrays. Exceeding any of them fails with StackOverflow
+        explicit Interpreter(std::size_t stack_size = default_stack_size, std::size_t max_call_depth = default_max_call_depth,
+                             std::size_t memory_size = default_memory_size);
+
+        // Initializes the globals of program and runs its main function, if any.
+        // Returns the result of main, a void value if it has none.
+        // Throws TalosException on runtime errors
+        [[nodiscard]] Value run(const Program& program);
+        // Initializes the globals of program and calls one of its functions.
+        // Struct arguments are passed one value per scalar, and of a struct
+        // result only the first scalar is returned. Arrays of structs are
+        // returned as void
+        [[nodiscard]] Value call(const Program& program, std::uint32_t function, std::span<const Value> arguments);
+
+    private:
+        struct Frame {
+            const Function* function;
+            // Of the caller, to resume at
+            const Instruction* pc;
+            Word* base;
+            std::byte* memory;
+        };
+
+        void initialize(const Program& program);
+        [[nodiscard]] Word execute(const Program& program, std::uint32_t function, std::span<const Value> arguments);
+
+        std::unique_ptr<Word[]> stack_;
+        std::size_t stack_size_;
+        std::unique_ptr<Frame[]> frames_;
+        std::size_t max_call_depth_;
+        std::unique_ptr<std::byte[]> memory_buffer_;
+        // Within memory_buffer_, aligned for arrays
+        std::byte* memory_;
+        std::size_t memory_size_;
+        std::vector<Word> globals_;
+        // Elements of the global arrays
+        std::vector<std::byte> global_memory_;
+    };
+} // namespace talos
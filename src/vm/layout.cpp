@@ -0,0 +1,72 @@
+#include "layout.h"
+
+#include <algorithm>
+
+namespace talos
+{
+    std::optional<std::uint32_t> StructLayout::find(std::string_view field) const noexcept
+    {
+        const auto iter = std::ranges::find(fields, field, &FieldLayout::name);
+        if (iter == fields.end()) {
+            return std::nullopt;
+        }
+        return static_cast<std::uint32_t>(iter - fields.begin());
+    }
+
+    StructLayout layout_struct(std::string name, bool packed, std::span<const std::pair<std::string, Type>> fields,
+                               std::span<const StructLayout> structs)
+    {
+        auto layout = StructLayout{.name = std::move(name), .packed = packed};
+        for (const auto& [field_name, type] : fields) {
+            const auto* nested = is_struct(type) ? &structs[struct_index(type)] : nullptr;
+            const auto size = nested != nullptr ? nested->size : scalar_size(type);
+            const auto alignment = packed ? 1U : (nested != nullptr ? nested->alignment : size);
+            const auto offset = (layout.size + alignment - 1) / alignment * alignment;
+            layout.fields.push_back(FieldLayout{
+                .name = field_name,
+                .type = type,
+                .offset = offset,
+                .slot = static_cast<std::uint32_t>(layout.slots.size()),
+            });
+            if (nested != nullptr) {
+                for (const auto slot : nested->slots) {
+                    layout.slots.push_back(SlotLayout{.type = slot.type, .offset = offset + slot.offset});
+                }
+            }
+            else {
+                layout.slots.push_back(SlotLayout{.type = type, .offset = offset});
+            }
+            layout.size = offset + size;
+            layout.alignment = std::max(layout.alignment, alignment);
+        }
+        // Arrays of the struct keep every element aligned
+        layout.size = (layout.size + layout.alignment - 1) / layout.alignment * layout.alignment;
+        return layout;
+    }
+
+    ArrayLayout layout_array(std::string name, Type element, std::uint32_t length, std::span<const StructLayout> structs)
+    {
+        auto layout = ArrayLayout{.element = element, .length = length, .name = std::move(name)};
+        if (!is_struct(element)) {
+            const auto size = scalar_size(element);
+            layout.columns.push_back(ColumnLayout{.type = element, .offset = 0, .stride = size});
+            layout.size = std::size_t{length} * size;
+            return layout;
+        }
+        const auto& structure = structs[struct_index(element)];
+        for (const auto slot : structure.slots) {
+            if (!structure.soa) {
+                layout.columns.push_back(ColumnLayout{.type = slot.type, .offset = slot.offset, .stride = structure.size});
+                continue;
+            }
+            const auto offset = (layout.size + ArrayLayout::alignment - 1) / ArrayLayout::alignment * ArrayLayout::alignment;
+            const auto size = scalar_size(slot.type);
+            layout.columns.push_back(ColumnLayout{.type = slot.type, .offset = offset, .stride = size});
+            layout.size = offset + (std::size_t{length} * size);
+        }
+        if (!structure.soa) {
+            layout.size = std::size_t{length} * structure.size;
+        }
+        return layout;
+    }
+} // namespace talos
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "type.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace talos
+{
+    struct FieldLayout {
+        std::string name;
+        Type type;
+        // Bytes from the start of the struct
+        std::uint32_t offset;
+        // Index of the field's first scalar in StructLayout::slots
+        std::uint32_t slot;
+    };
+
+    // A scalar in a struct whose nested structs are flattened
+    struct SlotLayout {
+        Type type;
+        std::uint32_t offset;
+    };
+
+    // How the values of a struct type are laid out in memory. Fields are
+    // aligned to their natural alignment unless the struct is packed, in which
+    // case they follow each other without padding. The VM holds a struct in
+    // one register per slot, and arrays store structs as they are laid out
+    // unless the struct is soa, see layout_array
+    struct StructLayout {
+        std::string name;
+        bool packed = false;
+        bool soa = false;
+        std::vector<FieldLayout> fields;
+        std::vector<SlotLayout> slots;
+        // Bytes, a multiple of alignment
+        std::uint32_t size = 0;
+        std::uint32_t alignment = 1;
+
+        // Index of the field, nullopt if there is none of that name
+        [[nodiscard]] std::optional<std::uint32_t> find(std::string_view field) const noexcept;
+    };
+
+    // Size and alignment in bytes of a scalar type. Strings are stored as a pointer
+    [[nodiscard]] constexpr std::uint32_t scalar_size(Type type) noexcept
+    {
+        switch (type) {
+            case Type::Int8:
+            case Type::Bool:
+            case Type::Char:
+                return 1;
+            case Type::Int16:
+                return 2;
+            case Type::Int32:
+            case Type::Float32:
+                return 4;
+            case Type::Int64:
+            case Type::Float64:
+            case Type::String:
+                return 8;
+            default:
+                return 0;
+        }
+    }
+
+    // Where one scalar of every element of an array is stored, that of
+    // element i at offset + i * stride bytes
+    struct ColumnLayout {
+        Type type;
+        std::size_t offset;
+        std::uint32_t stride;
+    };
+
+    // A fixed-size array type. Scalar elements are stored contiguously, and
+    // so are struct elements unless their struct is soa
+    struct ArrayLayout {
+        Type element;
+        std::uint32_t length;
+        // Spelling in messages, e.g. [4]f32
+        std::string name;
+        // One per slot of the element type, see StructLayout::slots
+        std::vector<ColumnLayout> columns;
+        // Bytes of all elements
+        std::size_t size = 0;
+
+        // Arrays, and each column of an array of a soa struct, are stored at
+        // multiples of the width of the widest vectors the elementwise
+        // kernels use
+        static constexpr std::size_t alignment = 32;
+
+        [[nodiscard]] std::size_t aligned_size() const noexcept { return (size + alignment - 1) / alignment * alignment; }
+    };
+
+    // Lays out fields in declaration order. The layouts of the structs they
+    // contain must already be in structs, indexed by struct_index
+    [[nodiscard]] StructLayout layout_struct(std::string name, bool packed, std::span<const std::pair<std::string, Type>> fields,
+                                             std::span<const StructLayout> structs);
+
+    // Lays out length elements of type element, which is a scalar or one of
+    // structs. Elements of a soa struct are stored a column per slot, each
+    // aligned like an array, others element by element, a struct as
+    // layout_struct laid it out
+    [[nodiscard]] ArrayLayout layout_array(std::string name, Type element, std::uint32_t length, std::span<const StructLayout> structs);
+} // namespace talos
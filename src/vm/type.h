@@ -0,0 +1,146 @@
+#pragma once
+
+#include "token.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+
+namespace talos
+{
+    // Static type of a Talos value. Struct types follow the builtin ones,
+    // numbered in declaration order, see struct_type. Array types take the
+    // upper half of the range, numbered as the program first uses them
+    enum class Type : std::uint16_t {
+        // Result of calling a function that returns nothing
+        Void,
+        Int8,
+        Int16,
+        Int32,
+        Int64,
+        Float32,
+        Float64,
+        Bool,
+        Char,
+        String,
+    };
+
+    constexpr auto first_struct_type = static_cast<std::uint16_t>(Type::String) + 1U;
+    constexpr auto first_array_type = std::uint16_t{0x8000};
+    constexpr auto max_struct_types = std::size_t{first_array_type} - first_struct_type;
+    constexpr auto max_array_types = std::size_t{std::numeric_limits<std::uint16_t>::max()} + 1U - first_array_type;
+
+    [[nodiscard]] constexpr bool is_integer(Type type) noexcept
+    {
+        return type >= Type::Int8 && type <= Type::Int64;
+    }
+
+    [[nodiscard]] constexpr bool is_floating(Type type) noexcept
+    {
+        return type == Type::Float32 || type == Type::Float64;
+    }
+
+    [[nodiscard]] constexpr bool is_numeric(Type type) noexcept
+    {
+        return is_integer(type) || is_floating(type);
+    }
+
+    [[nodiscard]] constexpr bool is_struct(Type type) noexcept
+    {
+        return static_cast<std::uint16_t>(type) >= first_struct_type && static_cast<std::uint16_t>(type) < first_array_type;
+    }
+
+    [[nodiscard]] constexpr bool is_array(Type type) noexcept
+    {
+        return static_cast<std::uint16_t>(type) >= first_array_type;
+    }
+
+    // A value of one register that is copied by moving it, unlike structs,
+    // which take several, and arrays, whose register points to their elements
+    [[nodiscard]] constexpr bool is_scalar(Type type) noexcept
+    {
+        return type != Type::Void && !is_struct(type) && !is_array(type);
+    }
+
+    // Type of the struct declared index-th
+    [[nodiscard]] constexpr Type struct_type(std::size_t index) noexcept
+    {
+        return static_cast<Type>(first_struct_type + index);
+    }
+
+    [[nodiscard]] constexpr std::size_t struct_index(Type type) noexcept
+    {
+        return static_cast<std::size_t>(type) - first_struct_type;
+    }
+
+    // Type of the array type the program used index-th
+    [[nodiscard]] constexpr Type array_type(std::size_t index) noexcept
+    {
+        return static_cast<Type>(first_array_type + index);
+    }
+
+    [[nodiscard]] constexpr std::size_t array_index(Type type) noexcept
+    {
+        return static_cast<std::size_t>(type) - first_array_type;
+    }
+
+    // Spelling of the type in Talos source. Struct and array types are spelled
+    // by their name and by their element type and length, which only the
+    // program using them knows
+    constexpr auto format_as(Type type)
+    {
+        if (is_struct(type)) {
+            return "struct";
+        }
+        if (is_array(type)) {
+            return "array";
+        }
+        switch (type) {
+            case Type::Void:
+                return "void";
+            case Type::Int8:
+                return "i8";
+            case Type::Int16:
+                return "i16";
+            case Type::Int32:
+                return "i32";
+            case Type::Int64:
+                return "i64";
+            case Type::Float32:
+                return "f32";
+            case Type::Float64:
+                return "f64";
+            case Type::Bool:
+                return "bool";
+            case Type::Char:
+                return "char";
+            case Type::String:
+                return "string";
+        }
+        return "unknown";
+    }
+
+    // Type named by a builtin type keyword, nullopt for other tokens
+    [[nodiscard]] constexpr std::optional<Type> builtin_type(TokenType token_type) noexcept
+    {
+        switch (token_type) {
+            case TokenType::Int8:
+                return Type::Int8;
+            case TokenType::Int16:
+                return Type::Int16;
+            case TokenType::Int32:
+                return Type::Int32;
+            case TokenType::Int64:
+                return Type::Int64;
+            case TokenType::Float32:
+                return Type::Float32;
+            case TokenType::Float64:
+                return Type::Float64;
+            case TokenType::Bool:
+                return Type::Bool;
+            default:
+                return std::nullopt;
+        }
+    }
+} // namespace talos
@@ -0,0 +1,98 @@
+#include "value.h"
+
+#include "layout.h"
+
+#include <fmt/format.h>
+
+namespace talos
+{
+    namespace
+    {
+        // Shared by zeroed strings, so that they never point nowhere
+        const std::string empty_string;
+    } // namespace
+
+    bool operator==(const Value& lhs, const Value& rhs) noexcept
+    {
+        if (lhs.type != rhs.type) {
+            return false;
+        }
+        if (is_array(lhs.type)) {
+            const auto size = scalar_size(lhs.element);
+            for (std::size_t i = 0; i < lhs.length; ++i) {
+                if (load_scalar(lhs.element, lhs.elements + (i * size)) != load_scalar(rhs.element, rhs.elements + (i * size))) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        switch (lhs.type) {
+            case Type::Void:
+                return true;
+            case Type::Int8:
+            case Type::Int16:
+            case Type::Int32:
+            case Type::Int64:
+            case Type::Bool:
+            case Type::Char:
+                return lhs.integer == rhs.integer;
+            case Type::Float32:
+            case Type::Float64:
+                return lhs.floating == rhs.floating;
+            case Type::String:
+                // Equal literals share their contents
+                return lhs.string == rhs.string || *lhs.string == *rhs.string;
+        }
+        return false;
+    }
+
+    Value zero_value(Type type) noexcept
+    {
+        switch (type) {
+            case Type::Float32:
+            case Type::Float64:
+                return Value::of_floating(type, 0.0);
+            case Type::Bool:
+                return Value::of_bool(false);
+            case Type::Char:
+                return Value::of_char('\0');
+            case Type::String:
+                return Value::of_string(&empty_string);
+            default:
+                return Value::of_integer(type, 0);
+        }
+    }
+
+    std::string format_as(const Value& value)
+    {
+        if (is_array(value.type)) {
+            auto result = std::string{"["};
+            const auto size = scalar_size(value.element);
+            for (std::size_t i = 0; i < value.length; ++i) {
+                result += i == 0 ? "" : ", ";
+                result += format_as(load_scalar(value.element, value.elements + (i * size)));
+            }
+            return result + "]";
+        }
+        switch (value.type) {
+            case Type::Void:
+                return "void";
+            case Type::Int8:
+            case Type::Int16:
+            case Type::Int32:
+            case Type::Int64:
+                return fmt::format("{}", value.integer);
+            case Type::Float32:
+                return fmt::format("{}", static_cast<float>(value.floating));
+            case Type::Float64:
+                return fmt::format("{}", value.floating);
+            case Type::Bool:
+                return value.integer != 0 ? "true" : "false";
+            case Type::Char:
+                return fmt::format("'{}'", static_cast<char>(value.integer));
+            case Type::String:
+                return fmt::format("\"{}\"", *value.string);
+        }
+        return "unknown";
+    }
+} // namespace talos
@@ -0,0 +1,226 @@
+#pragma once
+
+#include "type.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace talos
+{
+    // A value as the VM holds it in a register, global or stack slot: one
+    // word, whose type only the instructions using it know since the checker
+    // proved it. Integers of every width are sign extended to 64 bits, bools
+    // are 0 or 1 and chars their code, all in integer. f32 values are the
+    // double they round to. An array word points to its elements, stored
+    // contiguously with the size of their scalar type, see scalar_size
+    union Word {
+        std::int64_t integer;
+        double floating;
+        // Owned by the Program the value was loaded from
+        const std::string* string;
+        // Owned by the frame, global or Program holding the array
+        std::byte* elements;
+    };
+
+    static_assert(sizeof(Word) == 8);
+
+    // A word together with its type, as values are passed into and out of the
+    // VM and stored as constants. Values are trivially copyable so that they
+    // can be copied around freely, and a default one is a void zero
+    struct Value {
+        Type type = Type::Void;
+        // Of arrays
+        Type element = Type::Void;
+        std::uint32_t length = 0;
+        // The members of Word
+        union {
+            std::int64_t integer = 0;
+            double floating;
+            const std::string* string;
+            std::byte* elements;
+        };
+
+        [[nodiscard]] static constexpr Value of_integer(Type type, std::int64_t value) noexcept
+        {
+            auto result = Value{};
+            result.type = type;
+            result.integer = value;
+            return result;
+        }
+
+        [[nodiscard]] static constexpr Value of_floating(Type type, double value) noexcept
+        {
+            auto result = Value{};
+            result.type = type;
+            result.floating = value;
+            return result;
+        }
+
+        [[nodiscard]] static constexpr Value of_bool(bool value) noexcept
+        {
+            return of_integer(Type::Bool, value ? 1 : 0);
+        }
+
+        [[nodiscard]] static constexpr Value of_char(char value) noexcept
+        {
+            return of_integer(Type::Char, value);
+        }
+
+        [[nodiscard]] static constexpr Value of_string(const std::string* value) noexcept
+        {
+            auto result = Value{};
+            result.type = Type::String;
+            result.string = value;
+            return result;
+        }
+
+        [[nodiscard]] static constexpr Value of_array(Type type, Type element, std::uint32_t length, std::byte* elements) noexcept
+        {
+            auto result = Value{};
+            result.type = type;
+            result.element = element;
+            result.length = length;
+            result.elements = elements;
+            return result;
+        }
+
+        // A scalar of type
+        [[nodiscard]] static Value of_word(Type type, Word word) noexcept
+        {
+            auto result = Value{};
+            result.type = type;
+            std::memcpy(&result.integer, &word, sizeof(Word));
+            return result;
+        }
+
+        [[nodiscard]] Word word() const noexcept
+        {
+            auto result = Word{};
+            std::memcpy(&result, &integer, sizeof(Word));
+            return result;
+        }
+
+        // Equal if both type and contents are, strings and arrays are compared
+        // by contents
+        friend bool operator==(const Value& lhs, const Value& rhs) noexcept;
+    };
+
+    // Value truncated to the width of integer type and sign extended again
+    [[nodiscard]] constexpr std::int64_t wrap_integer(Type type, std::int64_t value) noexcept
+    {
+        switch (type) {
+            case Type::Int8:
+                return static_cast<std::int8_t>(value);
+            case Type::Int16:
+                return static_cast<std::int16_t>(value);
+            case Type::Int32:
+                return static_cast<std::int32_t>(value);
+            default:
+                return value;
+        }
+    }
+
+    // Value rounded to the precision of floating point type
+    [[nodiscard]] constexpr double round_floating(Type type, double value) noexcept
+    {
+        return type == Type::Float32 ? static_cast<double>(static_cast<float>(value)) : value;
+    }
+
+    // Zero of the given type, which variables hold before they are initialized
+    [[nodiscard]] Value zero_value(Type type) noexcept;
+
+    // Value as it would be written in Talos source, e.g. 1.5 or 'c'
+    [[nodiscard]] std::string format_as(const Value& value);
+
+    template<typename T>
+    [[nodiscard]] T load_bytes(const std::byte* source) noexcept
+    {
+        auto result = T{};
+        std::memcpy(&result, source, sizeof(T));
+        return result;
+    }
+
+    template<typename T>
+    void store_bytes(std::byte* destination, T value) noexcept
+    {
+        std::memcpy(destination, &value, sizeof(T));
+    }
+
+    // Reads a scalar of type from the bytes it is stored in
+    [[nodiscard]] inline Word load_word(Type type, const std::byte* source) noexcept
+    {
+        switch (type) {
+            case Type::Int8:
+                return Word{.integer = load_bytes<std::int8_t>(source)};
+            case Type::Int16:
+                return Word{.integer = load_bytes<std::int16_t>(source)};
+            case Type::Int32:
+                return Word{.integer = load_bytes<std::int32_t>(source)};
+            case Type::Int64:
+                return Word{.integer = load_bytes<std::int64_t>(source)};
+            case Type::Float32:
+                return Word{.floating = load_bytes<float>(source)};
+            case Type::Float64:
+                return Word{.floating = load_bytes<double>(source)};
+            case Type::Bool:
+                return Word{.integer = load_bytes<bool>(source) ? 1 : 0};
+            case Type::Char:
+                return Word{.integer = load_bytes<char>(source)};
+            case Type::String: {
+                // An empty string rather than a null one
+                const auto* string = load_bytes<const std::string*>(source);
+                return string != nullptr ? Word{.string = string} : zero_value(type).word();
+            }
+            default:
+                return Word{.integer = 0};
+        }
+    }
+
+    // Writes a scalar of type to the bytes it is stored in
+    inline void store_word(std::byte* destination, Type type, Word word) noexcept
+    {
+        switch (type) {
+            case Type::Int8:
+                store_bytes(destination, static_cast<std::int8_t>(word.integer));
+                break;
+            case Type::Int16:
+                store_bytes(destination, static_cast<std::int16_t>(word.integer));
+                break;
+            case Type::Int32:
+                store_bytes(destination, static_cast<std::int32_t>(word.integer));
+                break;
+            case Type::Int64:
+                store_bytes(destination, word.integer);
+                break;
+            case Type::Float32:
+                store_bytes(destination, static_cast<float>(word.floating));
+                break;
+            case Type::Float64:
+                store_bytes(destination, word.floating);
+                break;
+            case Type::Bool:
+                store_bytes(destination, word.integer != 0);
+                break;
+            case Type::Char:
+                store_bytes(destination, static_cast<char>(word.integer));
+                break;
+            case Type::String:
+                store_bytes(destination, word.string);
+                break;
+            default:
+                break;
+        }
+    }
+
+    [[nodiscard]] inline Value load_scalar(Type type, const std::byte* source) noexcept
+    {
+        return Value::of_word(type, load_word(type, source));
+    }
+
+    inline void store_scalar(std::byte* destination, const Value& value) noexcept
+    {
+        store_word(destination, value.type, value.word());
+    }
+} // namespace talos
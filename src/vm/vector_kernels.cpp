@@ -0,0 +1,184 @@
+#include "vector_kernels.h"
+
+#include "value.h"
+
+#include <concepts>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+// GCC and Clang vector extensions, other compilers run the scalar loop
+#if defined(__GNUC__) && defined(__x86_64__)
+    #define TALOS_VECTOR_KERNELS
+#endif
+
+namespace talos
+{
+    namespace
+    {
+        // Integers are computed on their unsigned counterpart, which wraps
+        // around instead of overflowing
+        template<typename T>
+        struct LaneOf {
+            using type = T;
+        };
+
+        template<std::integral T>
+        struct LaneOf<T> {
+            using type = std::make_unsigned_t<T>;
+        };
+
+        template<typename T>
+        using Lane = typename LaneOf<T>::type;
+
+        template<OpCode Op, typename T>
+        constexpr bool vectorizes = Op != OpCode::Divide || std::is_floating_point_v<T>;
+
+        // Operands are passed by reference, vectors of 256 bits are passed
+        // differently with and without AVX
+        template<OpCode Op, typename T>
+        [[gnu::always_inline]] inline void apply(T& result, const T& lhs, const T& rhs) noexcept
+        {
+            if constexpr (Op == OpCode::Add) {
+                result = lhs + rhs;
+            }
+            else if constexpr (Op == OpCode::Subtract) {
+                result = lhs - rhs;
+            }
+            else if constexpr (Op == OpCode::Multiply) {
+                result = lhs * rhs;
+            }
+            else {
+                result = lhs / rhs;
+            }
+        }
+
+#ifdef TALOS_VECTOR_KERNELS
+        // Processes whole vectors of Bytes bytes and returns how many elements
+        // that covered. Arrays in frames are 32 byte aligned, but those of
+        // globals and constants only as far as operator new aligns them, so
+        // vectors are loaded and stored unaligned
+        template<OpCode Op, typename T, std::size_t Bytes>
+        [[gnu::always_inline]] inline std::size_t vector_loop(std::byte* result, const std::byte* lhs, const std::byte* rhs, std::size_t length) noexcept
+        {
+            typedef Lane<T> Vector __attribute__((vector_size(Bytes)));
+            constexpr auto lanes = Bytes / sizeof(T);
+            auto i = std::size_t{0};
+            for (; i + lanes <= length; i += lanes) {
+                const auto offset = i * sizeof(T);
+                Vector a;
+                Vector b;
+                Vector c;
+                std::memcpy(&a, lhs + offset, sizeof(Vector));
+                std::memcpy(&b, rhs + offset, sizeof(Vector));
+                apply<Op>(c, a, b);
+                std::memcpy(result + offset, &c, sizeof(Vector));
+            }
+            return i;
+        }
+
+        template<OpCode Op, typename T>
+        [[gnu::target("avx2")]] std::size_t avx2_loop(std::byte* result, const std::byte* lhs, const std::byte* rhs, std::size_t length) noexcept
+        {
+            return vector_loop<Op, T, 32>(result, lhs, rhs, length);
+        }
+
+        template<OpCode Op, typename T>
+        std::size_t sse2_loop(std::byte* result, const std::byte* lhs, const std::byte* rhs, std::size_t length) noexcept
+        {
+            return vector_loop<Op, T, 16>(result, lhs, rhs, length);
+        }
+#endif
+
+        // The elements from start on, one at a time
+        template<OpCode Op, typename T>
+        bool scalar_loop(std::byte* result, const std::byte* lhs, const std::byte* rhs, std::size_t start, std::size_t length) noexcept
+        {
+            for (auto i = start; i < length; ++i) {
+                const auto offset = i * sizeof(T);
+                const auto a = load_bytes<T>(lhs + offset);
+                const auto b = load_bytes<T>(rhs + offset);
+                if constexpr (vectorizes<Op, T>) {
+                    // Narrow integers are promoted to int, computing in Lane<T> would overflow it
+                    using Wide = std::conditional_t<std::is_integral_v<T>, std::uint64_t, T>;
+                    auto c = Wide{};
+                    apply<Op>(c, static_cast<Wide>(a), static_cast<Wide>(b));
+                    store_bytes(result + offset, static_cast<T>(c));
+                }
+                else {
+                    if (b == 0) {
+                        return false;
+                    }
+                    // The only quotient that overflows wraps around to the dividend
+                    store_bytes(result + offset, a == std::numeric_limits<T>::min() && b == -1 ? a : static_cast<T>(a / b));
+                }
+            }
+            return true;
+        }
+
+        template<OpCode Op, typename T>
+        bool arithmetic(std::byte* result, const std::byte* lhs, const std::byte* rhs, std::size_t length, VectorIsa isa) noexcept
+        {
+            auto done = std::size_t{0};
+#ifdef TALOS_VECTOR_KERNELS
+            if constexpr (vectorizes<Op, T>) {
+                if (isa == VectorIsa::Avx2) {
+                    done = avx2_loop<Op, T>(result, lhs, rhs, length);
+                }
+                else if (isa == VectorIsa::Sse2) {
+                    done = sse2_loop<Op, T>(result, lhs, rhs, length);
+                }
+            }
+#else
+            static_cast<void>(isa);
+#endif
+            return scalar_loop<Op, T>(result, lhs, rhs, done, length);
+        }
+
+        template<OpCode Op>
+        bool arithmetic(Type element, std::byte* result, const std::byte* lhs, const std::byte* rhs, std::size_t length, VectorIsa isa) noexcept
+        {
+            switch (element) {
+                case Type::Int8:
+                    return arithmetic<Op, std::int8_t>(result, lhs, rhs, length, isa);
+                case Type::Int16:
+                    return arithmetic<Op, std::int16_t>(result, lhs, rhs, length, isa);
+                case Type::Int32:
+                    return arithmetic<Op, std::int32_t>(result, lhs, rhs, length, isa);
+                case Type::Int64:
+                    return arithmetic<Op, std::int64_t>(result, lhs, rhs, length, isa);
+                case Type::Float32:
+                    return arithmetic<Op, float>(result, lhs, rhs, length, isa);
+                default:
+                    return arithmetic<Op, double>(result, lhs, rhs, length, isa);
+            }
+        }
+    } // namespace
+
+    VectorIsa vector_isa() noexcept
+    {
+#ifdef TALOS_VECTOR_KERNELS
+        static const auto isa = [] {
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2") ? VectorIsa::Avx2 : VectorIsa::Sse2;
+        }();
+        return isa;
+#else
+        return VectorIsa::Scalar;
+#endif
+    }
+
+    bool vector_arithmetic(OpCode op, Type element, std::byte* result, const std::byte* lhs, const std::byte* rhs, std::size_t length, VectorIsa isa) noexcept
+    {
+        switch (op) {
+            case OpCode::Add:
+                return arithmetic<OpCode::Add>(element, result, lhs, rhs, length, isa);
+            case OpCode::Subtract:
+                return arithmetic<OpCode::Subtract>(element, result, lhs, rhs, length, isa);
+            case OpCode::Multiply:
+                return arithmetic<OpCode::Multiply>(element, result, lhs, rhs, length, isa);
+            default:
+                return arithmetic<OpCode::Divide>(element, result, lhs, rhs, length, isa);
+        }
+    }
+} // namespace talos
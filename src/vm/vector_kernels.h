@@ -0,0 +1,45 @@
+#pragma once
+
+#include "bytecode.h"
+#include "type.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace talos
+{
+    // Instruction sets the elementwise array kernels can be compiled for
+    enum class VectorIsa : std::uint8_t {
+        // One element at a time
+        Scalar,
+        // 128 bit vectors, the baseline of x86-64
+        Sse2,
+        // 256 bit vectors
+        Avx2,
+    };
+
+    constexpr auto format_as(VectorIsa isa)
+    {
+        switch (isa) {
+            case VectorIsa::Scalar:
+                return "scalar";
+            case VectorIsa::Sse2:
+                return "sse2";
+            case VectorIsa::Avx2:
+                return "avx2";
+        }
+        return "unknown";
+    }
+
+    // Widest instruction set the running CPU supports, detected once
+    [[nodiscard]] VectorIsa vector_isa() noexcept;
+
+    // result[i] = lhs[i] op rhs[i] for length elements of a numeric type, where
+    // op is Add, Subtract, Multiply or Divide. result may be one of the
+    // operands. Integers wrap around like scalar arithmetic does, and integer
+    // division runs one element at a time. Returns false if an integer is
+    // divided by zero, having written only some of the results. isa must be
+    // supported by the running CPU
+    [[nodiscard]] bool vector_arithmetic(OpCode op, Type element, std::byte* result, const std::byte* lhs, const std::byte* rhs, std::size_t length,
+                                         VectorIsa isa = vector_isa()) noexcept;
+} // namespace talos
@@ -0,0 +1,216 @@
+#include "frontend/ast_binary_writer.h"
+#include "frontend/ast_dump.h"
+#include "frontend/lexer.h"
+#include "frontend/node_kind.h"
+#include "frontend/parser.h"
+
+#include <gtest/gtest.h>
+
+namespace
+{
+    std::string dump(std::string_view source, talos::DumpFormat format)
+    {
+        auto lexer = talos::Lexer{source};
+        auto parser = talos::Parser{&lexer};
+        const auto program = parser.parse();
+        auto buffer = fmt::memory_buffer{};
+        talos::dump_ast(program, format, buffer);
+        return fmt::to_string(buffer);
+    }
+
+    TEST(ASTDump, Text)
+    {
+        const auto text = dump("fun main() : i32 { let x = -1; return x; }", talos::DumpFormat::Text);
+        EXPECT_EQ(text,
+                  "Program\n"
+                  " FunDecl 'main() : (Int32)'\n"
+                  "  VarDecl 'let x : (Inferred)'\n"
+                  "   UnaryExpr\n"
+                  "    UnaryOp Minus\n"
+                  "    IntLiteral 1 (suffix: None)\n"
+                  "  ReturnStatement\n"
+                  "   Identifier 'x'\n");
+    }
+
+    TEST(ASTDump, TextAllNodes)
+    {
+        const auto text = dump("a = (1 + 'c') * 2.0f32;\nfun f() { return -\"s\" / true; }", talos::DumpFormat::Text);
+        EXPECT_EQ(text,
+                  "Program\n"
+                  " ExprStatement\n"
+                  "  Assignment\n"
+                  "   Identifier 'a'\n"
+                  "   operator=\n"
+                  "   BinaryExpr\n"
+                  "    ParenExpr\n"
+                  "     BinaryExpr\n"
+                  "      IntLiteral 1 (suffix: None)\n"
+                  "      BinaryOp Plus\n"
+                  "      CharacterLiteral 'c'\n"
+                  "    BinaryOp Star\n"
+                  "    FloatingLiteral 2.0 (suffix: f32)\n"
+                  " FunDecl 'f() : (Inferred)'\n"
+                  "  ReturnStatement\n"
+                  "   BinaryExpr\n"
+                  "    UnaryExpr\n"
+                  "     UnaryOp Minus\n"
+                  "     StringLiteral \"s\"\n"
+                  "    BinaryOp Slash\n"
+                  "    BoolLiteral true\n");
+    }
+
+    TEST(ASTDump, Json)
+    {
+        const auto json = dump(R"(var s : MyType = "a\\b" + 2i8;)", talos::DumpFormat::Json);
+        EXPECT_EQ(json,
+                  R"({"kind":"Program","statements":[{"kind":"VarDeclStatement","decl":"var","name":"s","type":"MyType",)"
+                  R"("initializer":{"kind":"BinaryExpr","op":"Plus","lhs":{"kind":"StringLiteralExpr","value":"\"a\\\\b\""},)"
+                  R"("rhs":{"kind":"IntLiteralExpr","value":"2","suffix":"i8"}}}]})"
+                  "\n");
+    }
+
+    TEST(ASTDump, Calls)
+    {
+        constexpr auto source = "fun add(a : i32, b : f64) { return a; }\nadd(1, f());";
+        EXPECT_EQ(dump(source, talos::DumpFormat::Text),
+                  "Program\n"
+                  " FunDecl 'add(a : Int32, b : Float64) : (Inferred)'\n"
+                  "  ReturnStatement\n"
+                  "   Identifier 'a'\n"
+                  " ExprStatement\n"
+                  "  Call\n"
+                  "   Identifier 'add'\n"
+                  "   IntLiteral 1 (suffix: None)\n"
+                  "   Call\n"
+                  "    Identifier 'f'\n");
+        EXPECT_EQ(dump(source, talos::DumpFormat::Json),
+                  R"({"kind":"Program","statements":[{"kind":"FunDeclStatement","name":"add",)"
+                  R"("parameters":[{"name":"a","type":"i32"},{"name":"b","type":"f64"}],"return_type":null,)"
+                  R"("body":[{"kind":"ReturnStatement","value":{"kind":"IdentifierExpr","name":"a"}}]},)"
+                  R"({"kind":"ExprStatement","expr":{"kind":"CallExpr","callee":{"kind":"IdentifierExpr","name":"add"},)"
+                  R"("arguments":[{"kind":"IntLiteralExpr","value":"1","suffix":null},)"
+                  R"({"kind":"CallExpr","callee":{"kind":"IdentifierExpr","name":"f"},"arguments":[]}]}}]})"
+                  "\n");
+    }
+
+    TEST(ASTDump, ControlFlow)
+    {
+        constexpr auto source = "while !done { if a < b && c { x; } else if d { } else { y; } }\nfor ; i >= 0; { }";
+        EXPECT_EQ(dump(source, talos::DumpFormat::Text),
+                  "Program\n"
+                  " WhileStatement\n"
+                  "  UnaryExpr\n"
+                  "   UnaryOp Bang\n"
+                  "   Identifier 'done'\n"
+                  "  Block\n"
+                  "   IfStatement\n"
+                  "    BinaryExpr\n"
+                  "     BinaryExpr\n"
+                  "      Identifier 'a'\n"
+                  "      BinaryOp Less\n"
+                  "      Identifier 'b'\n"
+                  "     BinaryOp Amp Amp\n"
+                  "     Identifier 'c'\n"
+                  "    Block\n"
+                  "     ExprStatement\n"
+                  "      Identifier 'x'\n"
+                  "    IfStatement\n"
+                  "     Identifier 'd'\n"
+                  "     Block\n"
+                  "     Block\n"
+                  "      ExprStatement\n"
+                  "       Identifier 'y'\n"
+                  " ForStatement\n"
+                  "  Empty\n"
+                  "  BinaryExpr\n"
+                  "   Identifier 'i'\n"
+                  "   BinaryOp Greater Equal\n"
+                  "   IntLiteral 0 (suffix: None)\n"
+                  "  Empty\n"
+                  "  Block\n");
+        EXPECT_EQ(dump(source, talos::DumpFormat::Json),
+                  R"({"kind":"Program","statements":[{"kind":"WhileStatement","condition":{"kind":"UnaryExpr","op":"Bang",)"
+                  R"("expr":{"kind":"IdentifierExpr","name":"done"}},"body":{"kind":"BlockStatement","body":[{"kind":"IfStatement",)"
+                  R"("condition":{"kind":"BinaryExpr","op":"Amp Amp","lhs":{"kind":"BinaryExpr","op":"Less",)"
+                  R"("lhs":{"kind":"IdentifierExpr","name":"a"},"rhs":{"kind":"IdentifierExpr","name":"b"}},)"
+                  R"("rhs":{"kind":"IdentifierExpr","name":"c"}},"then":{"kind":"BlockStatement","body":[{"kind":"ExprStatement",)"
+                  R"("expr":{"kind":"IdentifierExpr","name":"x"}}]},"else":{"kind":"IfStatement","condition":{"kind":"IdentifierExpr","name":"d"},)"
+                  R"("then":{"kind":"BlockStatement","body":[]},"else":{"kind":"BlockStatement","body":[{"kind":"ExprStatement",)"
+                  R"("expr":{"kind":"IdentifierExpr","name":"y"}}]}}}]}},{"kind":"ForStatement","initializer":null,)"
+                  R"("condition":{"kind":"BinaryExpr","op":"Greater Equal","lhs":{"kind":"IdentifierExpr","name":"i"},)"
+                  R"("rhs":{"kind":"IntLiteralExpr","value":"0","suffix":null}},"increment":null,"body":{"kind":"BlockStatement","body":[]}}]})"
+                  "\n");
+    }
+
+    TEST(ASTDump, Structs)
+    {
+        constexpr auto source = "packed struct P { x : i32, next : Q, }\nline.start.x = 1;";
+        EXPECT_EQ(dump(source, talos::DumpFormat::Text),
+                  "Program\n"
+                  " StructDecl 'packed P { x : Int32, next : Q }'\n"
+                  " ExprStatement\n"
+                  "  Assignment\n"
+                  "   Field 'x'\n"
+                  "    Field 'start'\n"
+                  "     Identifier 'line'\n"
+                  "   operator=\n"
+                  "   IntLiteral 1 (suffix: None)\n");
+        EXPECT_EQ(dump(source, talos::DumpFormat::Json),
+                  R"({"kind":"Program","statements":[{"kind":"StructDeclStatement","name":"P","packed":true,"soa":false,)"
+                  R"("fields":[{"name":"x","type":"i32"},{"name":"next","type":"Q"}]},{"kind":"ExprStatement",)"
+                  R"("expr":{"kind":"AssignmentExpr","lhs":{"kind":"FieldExpr","object":{"kind":"FieldExpr",)"
+                  R"("object":{"kind":"IdentifierExpr","name":"line"},"field":"start"},"field":"x"},)"
+                  R"("rhs":{"kind":"IntLiteralExpr","value":"1","suffix":null}}}]})"
+                  "\n");
+        EXPECT_EQ(dump("soa struct S { x : f64 }", talos::DumpFormat::Text),
+                  "Program\n"
+                  " StructDecl 'soa S { x : Float64 }'\n");
+    }
+
+    TEST(ASTDump, Arrays)
+    {
+        constexpr auto source = "var a: [2]i32 = [1, 2];\na[0] = [0; 2][1];";
+        EXPECT_EQ(dump(source, talos::DumpFormat::Text),
+                  "Program\n"
+                  " VarDecl 'var a : ([2]Int32)'\n"
+                  "  ArrayLiteral (count: None)\n"
+                  "   IntLiteral 1 (suffix: None)\n"
+                  "   IntLiteral 2 (suffix: None)\n"
+                  " ExprStatement\n"
+                  "  Assignment\n"
+                  "   Index\n"
+                  "    Identifier 'a'\n"
+                  "    IntLiteral 0 (suffix: None)\n"
+                  "   operator=\n"
+                  "   Index\n"
+                  "    ArrayLiteral (count: 2)\n"
+                  "     IntLiteral 0 (suffix: None)\n"
+                  "    IntLiteral 1 (suffix: None)\n");
+        EXPECT_EQ(dump(source, talos::DumpFormat::Json),
+                  R"({"kind":"Program","statements":[{"kind":"VarDeclStatement","decl":"var","name":"a","type":"[2]i32",)"
+                  R"("initializer":{"kind":"ArrayLiteralExpr","elements":[{"kind":"IntLiteralExpr","value":"1","suffix":null},)"
+                  R"({"kind":"IntLiteralExpr","value":"2","suffix":null}],"count":null}},{"kind":"ExprStatement",)"
+                  R"("expr":{"kind":"AssignmentExpr","lhs":{"kind":"IndexExpr","array":{"kind":"IdentifierExpr","name":"a"},)"
+                  R"("index":{"kind":"IntLiteralExpr","value":"0","suffix":null}},"rhs":{"kind":"IndexExpr",)"
+                  R"("array":{"kind":"ArrayLiteralExpr","elements":[{"kind":"IntLiteralExpr","value":"0","suffix":null}],"count":2},)"
+                  R"("index":{"kind":"IntLiteralExpr","value":"1","suffix":null}}}}]})"
+                  "\n");
+    }
+
+    TEST(ASTDump, Binary)
+    {
+        const auto binary = dump("x;", talos::DumpFormat::Binary);
+        const auto expected = std::string{
+            'T', 'A', 'S', 'T', static_cast<char>(talos::ASTBinaryWriter::version),
+            static_cast<char>(talos::NodeKind::Program), 1,
+            static_cast<char>(talos::NodeKind::ExprStatement),
+            static_cast<char>(talos::NodeKind::IdentifierExpr),
+            static_cast<char>(talos::TokenType::Identifier), 1, 1, 1, 'x'};
+        EXPECT_EQ(binary, expected);
+    }
+
+    TEST(ASTDump, None)
+    {
+        EXPECT_TRUE(dump("x;", talos::DumpFormat::None).empty());
+    }
+} // namespace
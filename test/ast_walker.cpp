@@ -0,0 +1,121 @@
+#include "frontend/ast_walker.h"
+#include "frontend/lexer.h"
+#include "frontend/parser.h"
+
+#include <gtest/gtest.h>
+
+#include <fmt/format.h>
+
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace
+{
+    talos::ProgramNode parse(std::string_view source)
+    {
+        auto lexer = talos::Lexer{source};
+        auto parser = talos::Parser{&lexer};
+        return parser.parse();
+    }
+
+    // Records the order in which hooks are called
+    class Tracer : public talos::ASTWalker<Tracer>
+    {
+    public:
+        std::vector<std::string> events;
+        std::optional<talos::NodeKind> skip;
+        std::optional<talos::NodeKind> stop;
+
+    private:
+        friend class talos::ASTWalker<Tracer>;
+
+        talos::Walk pre(const talos::ASTNode& node)
+        {
+            events.push_back(fmt::format("pre {}", node.kind()));
+            if (node.kind() == stop) {
+                return talos::Walk::Stop;
+            }
+            return node.kind() == skip ? talos::Walk::SkipChildren : talos::Walk::Continue;
+        }
+
+        void post(const talos::ASTNode& node) { events.push_back(fmt::format("post {}", node.kind())); }
+    };
+
+    // Only interested in identifiers
+    class IdentifierCollector : public talos::ASTWalker<IdentifierCollector>
+    {
+    public:
+        std::vector<std::string_view> identifiers;
+
+    private:
+        friend class talos::ASTWalker<IdentifierCollector>;
+
+        void pre(const talos::IdentifierExpr& expr) { identifiers.push_back(expr.identifier().string); }
+    };
+
+    TEST(ASTWalker, PreAndPostOrder)
+    {
+        const auto program = parse("fun f() { return -x + 1; }");
+        auto tracer = Tracer{};
+        EXPECT_TRUE(tracer.walk(program));
+        EXPECT_EQ(tracer.events, (std::vector<std::string>{
+                                     "pre Program",
+                                     "pre FunDeclStatement",
+                                     "pre ReturnStatement",
+                                     "pre BinaryExpr",
+                                     "pre UnaryExpr",
+                                     "pre IdentifierExpr",
+                                     "post IdentifierExpr",
+                                     "post UnaryExpr",
+                                     "pre IntLiteralExpr",
+                                     "post IntLiteralExpr",
+                                     "post BinaryExpr",
+                                     "post ReturnStatement",
+                                     "post FunDeclStatement",
+                                     "post Program",
+                                 }));
+    }
+
+    TEST(ASTWalker, SkipChildren)
+    {
+        const auto program = parse("-x; y;");
+        auto tracer = Tracer{};
+        tracer.skip = talos::NodeKind::UnaryExpr;
+        EXPECT_TRUE(tracer.walk(program));
+        EXPECT_EQ(tracer.events, (std::vector<std::string>{
+                                     "pre Program",
+                                     "pre ExprStatement",
+                                     "pre UnaryExpr",
+                                     "post UnaryExpr",
+                                     "post ExprStatement",
+                                     "pre ExprStatement",
+                                     "pre IdentifierExpr",
+                                     "post IdentifierExpr",
+                                     "post ExprStatement",
+                                     "post Program",
+                                 }));
+    }
+
+    TEST(ASTWalker, Stop)
+    {
+        const auto program = parse("a = b; c;");
+        auto tracer = Tracer{};
+        tracer.stop = talos::NodeKind::IdentifierExpr;
+        EXPECT_FALSE(tracer.walk(program));
+        EXPECT_EQ(tracer.events, (std::vector<std::string>{
+                                     "pre Program",
+                                     "pre ExprStatement",
+                                     "pre AssignmentExpr",
+                                     "pre IdentifierExpr",
+                                 }));
+    }
+
+    TEST(ASTWalker, SelectedNodeTypes)
+    {
+        const auto program = parse("var a = b + (c * -d); fun f() { return e = 1; }");
+        auto collector = IdentifierCollector{};
+        EXPECT_TRUE(collector.walk(program));
+        EXPECT_EQ(collector.identifiers, (std::vector<std::string_view>{"b", "c", "d", "e"}));
+    }
+} // namespace
@@ -0,0 +1,191 @@
+#include "daemon/compile_server.h"
+#include "return_code.h"
+
+#include <gtest/gtest.h>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+
+namespace
+{
+    constexpr auto source = "fun main() : i32 {\n"
+                            "    var x = 1;\n"
+                            "    return x;\n"
+                            "}\n";
+
+    class CompileServerTest : public testing::Test
+    {
+    protected:
+        void SetUp() override
+        {
+            directory_ = std::filesystem::temp_directory_path() / ("talos_compile_server_" + std::to_string(::getpid()));
+            std::filesystem::create_directories(directory_);
+            socket_ = (directory_ / "socket").string();
+            file_ = (directory_ / "main.talos").string();
+            write(source);
+        }
+
+        void TearDown() override
+        {
+            std::filesystem::remove_all(directory_);
+        }
+
+        void write(std::string_view contents) const
+        {
+            std::ofstream{file_, std::ios::binary | std::ios::trunc} << contents;
+        }
+
+        // A connection to the server speaking the protocol by hand
+        [[nodiscard]] int connect_raw() const
+        {
+            const auto fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+            auto address = sockaddr_un{};
+            address.sun_family = AF_UNIX;
+            std::memcpy(address.sun_path, socket_.c_str(), socket_.size() + 1);
+            EXPECT_EQ(::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)), 0);
+            return fd;
+        }
+
+        talos::daemon::CompileRequest request() const
+        {
+            return talos::daemon::CompileRequest{.path = file_, .dump_ast = talos::DumpFormat::Json};
+        }
+
+        std::filesystem::path directory_;
+        std::string socket_;
+        std::string file_;
+    };
+
+    TEST_F(CompileServerTest, CachesUnchangedFiles)
+    {
+        auto server = talos::daemon::CompileServer{socket_};
+        const auto first = server.compile(request()).output;
+        EXPECT_NE(first.find("\"main\""), std::string::npos);
+        EXPECT_EQ(server.compile(request()).output, first);
+        EXPECT_EQ(server.cache_hits(), 1);
+
+        // Different options are compiled separately
+        auto text = request();
+        text.dump_ast = talos::DumpFormat::Text;
+        EXPECT_NE(server.compile(text).output, first);
+        EXPECT_EQ(server.cache_hits(), 1);
+
+        write("fun other() : i32 {\n    return 2;\n}\n");
+        const auto& changed = server.compile(text);
+        EXPECT_EQ(changed.exit_code, 0);
+        EXPECT_NE(changed.output.find("other"), std::string::npos);
+        EXPECT_EQ(server.cache_hits(), 1);
+    }
+
+    TEST_F(CompileServerTest, Errors)
+    {
+        auto server = talos::daemon::CompileServer{socket_};
+        write("fun main( {");
+        const auto& result = server.compile(request());
+        EXPECT_NE(result.exit_code, 0);
+        EXPECT_FALSE(result.diagnostics.empty());
+
+        auto missing = request();
+        missing.path = (directory_ / "missing.talos").string();
+        EXPECT_EQ(server.compile(missing).exit_code, static_cast<int>(talos::ReturnCode::FileNotFound));
+    }
+
+    TEST_F(CompileServerTest, ClientRoundTrip)
+    {
+        auto server = talos::daemon::CompileServer{socket_};
+        auto thread = std::thread{[&] { server.run(); }};
+
+        std::string output;
+        std::string diagnostics;
+        const auto collect = [&](talos::daemon::OutputStream stream, std::string_view data) {
+            (stream == talos::daemon::OutputStream::Stdout ? output : diagnostics) += data;
+        };
+        for (int i = 0; i < 2; ++i) {
+            output.clear();
+            EXPECT_EQ(talos::daemon::request_compile(socket_, request(), collect), 0);
+            EXPECT_NE(output.find("\"main\""), std::string::npos);
+            EXPECT_TRUE(diagnostics.empty());
+        }
+
+        auto missing = request();
+        missing.path = (directory_ / "missing.talos").string();
+        EXPECT_EQ(talos::daemon::request_compile(socket_, missing, collect), static_cast<int>(talos::ReturnCode::FileNotFound));
+        EXPECT_FALSE(diagnostics.empty());
+
+        EXPECT_TRUE(talos::daemon::request_stop(socket_));
+        thread.join();
+        EXPECT_EQ(server.cache_hits(), 1);
+    }
+
+    TEST_F(CompileServerTest, RejectsOversizedFrames)
+    {
+        auto server = talos::daemon::CompileServer{socket_};
+        auto thread = std::thread{[&] { server.run(); }};
+
+        // A compile frame claiming a payload of 4 GiB closes the connection
+        // without allocating it, and the server keeps serving others
+        const auto fd = connect_raw();
+        char header[5] = {1};
+        const auto length = std::uint32_t{0xFFFFFFFF};
+        std::memcpy(header + 1, &length, sizeof(length));
+        ASSERT_EQ(::send(fd, header, sizeof(header), MSG_NOSIGNAL), static_cast<ssize_t>(sizeof(header)));
+        char byte = 0;
+        EXPECT_EQ(::recv(fd, &byte, 1, 0), 0);
+        ::close(fd);
+
+        const auto ignore = [](talos::daemon::OutputStream, std::string_view) {};
+        EXPECT_EQ(talos::daemon::request_compile(socket_, request(), ignore), 0);
+        EXPECT_TRUE(talos::daemon::request_stop(socket_));
+        thread.join();
+    }
+
+    TEST_F(CompileServerTest, DropsStalledClients)
+    {
+        auto server = talos::daemon::CompileServer{socket_, std::chrono::milliseconds{100}};
+        auto thread = std::thread{[&] { server.run(); }};
+
+        // A client that sends part of a frame and then nothing is dropped once
+        // the timeout expires, and the clients behind it are served
+        const auto fd = connect_raw();
+        const char partial[2] = {1, 0};
+        ASSERT_EQ(::send(fd, partial, sizeof(partial), MSG_NOSIGNAL), static_cast<ssize_t>(sizeof(partial)));
+        const auto ignore = [](talos::daemon::OutputStream, std::string_view) {};
+        EXPECT_EQ(talos::daemon::request_compile(socket_, request(), ignore), 0);
+        char byte = 0;
+        EXPECT_EQ(::recv(fd, &byte, 1, 0), 0);
+        ::close(fd);
+
+        EXPECT_TRUE(talos::daemon::request_stop(socket_));
+        thread.join();
+    }
+
+    TEST_F(CompileServerTest, NoServer)
+    {
+        const auto ignore = [](talos::daemon::OutputStream, std::string_view) {};
+        EXPECT_FALSE(talos::daemon::request_compile(socket_, request(), ignore));
+        EXPECT_FALSE(talos::daemon::request_stop(socket_));
+    }
+
+    TEST_F(CompileServerTest, ReplacesStaleSocket)
+    {
+        {
+            auto server = talos::daemon::CompileServer{socket_};
+        }
+        // Left behind as by a server that was killed
+        std::ofstream{socket_} << "";
+        EXPECT_NO_THROW(talos::daemon::CompileServer{socket_});
+
+        auto running = talos::daemon::CompileServer{socket_};
+        EXPECT_THROW(talos::daemon::CompileServer{socket_}, std::system_error);
+    }
+} // namespace
@@ -0,0 +1,43 @@
+#include "frontend/lexer.h"
+#include "frontend/parser.h"
+#include "tools/corpus_generator.h"
+
+#include <gtest/gtest.h>
+
+namespace
+{
+    TEST(CorpusGenerator, Deterministic)
+    {
+        const auto options = talos::tools::CorpusOptions{.seed = 42};
+        EXPECT_EQ(talos::tools::generate_corpus(options), talos::tools::generate_corpus(options));
+
+        auto other_seed = options;
+        other_seed.seed = 43;
+        EXPECT_NE(talos::tools::generate_corpus(options), talos::tools::generate_corpus(other_seed));
+    }
+
+    TEST(CorpusGenerator, TargetSize)
+    {
+        constexpr std::size_t target_size = 64 * 1024;
+        const auto corpus = talos::tools::generate_corpus({.target_size = target_size});
+        EXPECT_GE(corpus.size(), target_size);
+        EXPECT_NE(corpus.find("fun main() : i32"), std::string::npos);
+    }
+
+    TEST(CorpusGenerator, Parses)
+    {
+        for (std::uint64_t seed = 0; seed < 8; ++seed) {
+            const auto corpus = talos::tools::generate_corpus({
+                .seed = seed,
+                .function_count = 32,
+                .expression_depth = 6,
+                .suffix_probability = 0.5,
+                .space_density = 0.5,
+                .nesting_depth = 64,
+            });
+            auto lexer = talos::Lexer{corpus};
+            auto parser = talos::Parser{&lexer};
+            EXPECT_NO_THROW((void)parser.parse()) << "seed " << seed;
+        }
+    }
+} // namespace
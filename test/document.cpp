@@ -0,0 +1,129 @@
+#include "frontend/ast_dump.h"
+#include "frontend/document.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <string>
+
+namespace
+{
+    constexpr auto source = "fun a() : i32 { return 1; }\n"
+                            "fun b() : i32 {\n"
+                            "    var x = 2;\n"
+                            "    return x;\n"
+                            "}\n"
+                            "let c = \"c\";\n";
+
+    std::string dump(const talos::Document& document)
+    {
+        auto out = fmt::memory_buffer{};
+        for (std::size_t i = 0; i < document.block_count(); ++i) {
+            const auto& block = document.block(i);
+            if (block.declaration() != nullptr) {
+                talos::dump_ast(*block.declaration(), talos::DumpFormat::Binary, out); // Includes token locations
+            }
+            else if (block.error()) {
+                fmt::format_to(std::back_inserter(out), "error {}", block.error()->location());
+            }
+            out.push_back('\n');
+        }
+        return fmt::to_string(out);
+    }
+
+    TEST(Document, Blocks)
+    {
+        const auto document = talos::Document{source};
+        EXPECT_EQ(document.text(), source);
+        ASSERT_EQ(document.block_count(), 3);
+        EXPECT_EQ(document.block(1).text(), "\nfun b() : i32 {\n    var x = 2;\n    return x;\n}");
+        EXPECT_EQ(document.block(2).text(), "\nlet c = \"c\";\n");
+        EXPECT_EQ(document.block_start(1), (talos::SourceLocation{1, 28}));
+        EXPECT_EQ(document.block_start(2), (talos::SourceLocation{5, 2}));
+        EXPECT_EQ(document.block(1).tokens().front().location, (talos::SourceLocation{2, 1}));
+    }
+
+    TEST(Document, EditInsideDeclaration)
+    {
+        auto document = talos::Document{source};
+        const auto* unchanged = document.block(0).declaration();
+        const auto offset = std::string_view{source}.find("2;");
+        const auto change = document.apply({.offset = offset, .removed = 1, .inserted = "42"});
+        EXPECT_EQ(change.first, 1);
+        EXPECT_EQ(change.removed, 1);
+        EXPECT_EQ(change.inserted, 1);
+        EXPECT_EQ(document.block(0).declaration(), unchanged);
+        EXPECT_NE(document.text().find("var x = 42;"), std::string::npos);
+    }
+
+    TEST(Document, ErrorsAndRecovery)
+    {
+        auto document = talos::Document{source};
+        const auto offset = std::string_view{source}.find("; }");
+        document.apply({.offset = offset, .removed = 1});
+        ASSERT_TRUE(document.block(0).error());
+        EXPECT_EQ(document.block(0).error()->code(), talos::ReturnCode::SyntaxError);
+
+        document.apply({.offset = offset, .inserted = ";"});
+        EXPECT_EQ(document.text(), source);
+        EXPECT_EQ(dump(document), dump(talos::Document{source}));
+    }
+
+    TEST(Document, UnterminatedString)
+    {
+        auto document = talos::Document{source};
+        // The literal swallows everything up to the next quote, so the whole document is re-parsed
+        document.apply({.offset = 0, .inserted = "let s = \"; "});
+        ASSERT_EQ(document.block_count(), 1);
+        EXPECT_TRUE(document.block(0).error());
+        EXPECT_EQ(dump(document), dump(talos::Document{document.text()}));
+
+        auto unterminated = talos::Document{source};
+        unterminated.apply({.offset = unterminated.size(), .inserted = "let t = \"unterminated"});
+        EXPECT_EQ(unterminated.block(unterminated.block_count() - 1).error()->code(), talos::ReturnCode::UnexpectedEof);
+    }
+
+    TEST(Document, MatchesFullParse)
+    {
+        // Random edits, each checked against parsing the edited text from scratch and then undone
+        auto rng = std::mt19937{42};
+        constexpr std::string_view snippets[] = {";", "}", "{", "\"", "'", "fun f() { ", "1 + 2", "\n", " ", "\t", "let v = 3;", "x"};
+        auto document = talos::Document{source};
+        const auto original = dump(document);
+        auto valid_documents = 0;
+        for (int i = 0; i < 2000; ++i) {
+            const auto offset = std::uniform_int_distribution<std::size_t>{0, document.size()}(rng);
+            const auto removed = std::uniform_int_distribution<std::size_t>{0, std::min<std::size_t>(4, document.size() - offset)}(rng);
+            const auto inserted = snippets[std::uniform_int_distribution<std::size_t>{0, std::size(snippets) - 1}(rng)];
+            const auto removed_text = document.text().substr(offset, removed);
+            document.apply({.offset = offset, .removed = removed, .inserted = inserted});
+
+            const auto reparsed = talos::Document{document.text()};
+            auto valid = true;
+            for (std::size_t b = 0; b < reparsed.block_count(); ++b) {
+                valid = valid && !reparsed.block(b).error();
+            }
+            // Error blocks may cover different regions, valid documents must be identical
+            if (valid) {
+                ASSERT_EQ(document.block_count(), reparsed.block_count());
+                for (std::size_t b = 0; b < reparsed.block_count(); ++b) {
+                    ASSERT_EQ(document.block(b).text(), reparsed.block(b).text());
+                    ASSERT_EQ(document.block_start(b), reparsed.block_start(b));
+                }
+                ASSERT_EQ(dump(document), dump(reparsed));
+                ++valid_documents;
+            }
+
+            document.apply({.offset = offset, .removed = inserted.size(), .inserted = removed_text});
+            ASSERT_EQ(document.text(), source);
+            ASSERT_EQ(dump(document), original);
+        }
+        EXPECT_GT(valid_documents, 100);
+    }
+
+    TEST(Document, OutOfRange)
+    {
+        auto document = talos::Document{"let a = 1;"};
+        EXPECT_THROW(document.apply({.offset = 5, .removed = 10}), std::out_of_range);
+    }
+} // namespace
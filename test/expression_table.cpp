@@ -0,0 +1,88 @@
+#include "frontend/ast.h"
+#include "frontend/expression_table.h"
+#include "frontend/lexer.h"
+#include "frontend/parser.h"
+#include "talos.h"
+#include "vm/codegen.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <string_view>
+
+namespace
+{
+    talos::ProgramNode parse(std::string_view source)
+    {
+        auto lexer = talos::Lexer{source};
+        auto parser = talos::Parser{&lexer};
+        return parser.parse();
+    }
+
+    // Expression of each statement of the top-level code of source
+    std::vector<const talos::Expr*> expressions(const talos::ProgramNode& program)
+    {
+        auto result = std::vector<const talos::Expr*>{};
+        for (const auto& statement : program.statements()) {
+            result.push_back(static_cast<const talos::ExprStatement&>(*statement).expr());
+        }
+        return result;
+    }
+
+    TEST(ExpressionTable, Identity)
+    {
+        const auto program = parse("(a + b) * 2;\n a + b;\n ((a) + (b)) * 2;\n a + b * 2;\n f(a) + f(a);\n x = 1;\n x = 1;\n 1.5 f32;\n 1.5;");
+        const auto exprs = expressions(program);
+        auto table = talos::ExpressionTable{};
+        for (const auto* expr : exprs) {
+            static_cast<void>(table.add(*expr));
+        }
+        // Parentheses and locations do not matter, the structure does
+        EXPECT_EQ(table.id(*exprs[0]), table.id(*exprs[2]));
+        EXPECT_EQ(table.hash(table.id(*exprs[0])), table.hash(table.id(*exprs[2])));
+        EXPECT_NE(table.id(*exprs[0]), table.id(*exprs[3]));
+        const auto& product = static_cast<const talos::BinaryExpr&>(*exprs[0]);
+        EXPECT_EQ(table.id(*product.lhs()), table.id(*exprs[1]));
+        EXPECT_EQ(&table.representative(table.id(*exprs[2])), exprs[0]);
+        EXPECT_NE(table.id(*exprs[7]), table.id(*exprs[8]));
+
+        // Calls and assignments are never shared, nor is anything containing them
+        const auto& calls = static_cast<const talos::BinaryExpr&>(*exprs[4]);
+        EXPECT_NE(table.id(*calls.lhs()), table.id(*calls.rhs()));
+        EXPECT_FALSE(table.is_pure(table.id(*exprs[4])));
+        EXPECT_NE(table.id(*exprs[5]), table.id(*exprs[6]));
+        // But have the same hash if they have the same structure
+        EXPECT_EQ(table.hash(table.id(*exprs[5])), table.hash(table.id(*exprs[6])));
+        EXPECT_LT(table.size(), table.nodes());
+        EXPECT_LT(table.unique_bytes(), table.bytes());
+
+        // Hashes are the same in every table
+        auto other = talos::ExpressionTable{};
+        EXPECT_EQ(other.hash(other.add(*exprs[2])), table.hash(table.id(*exprs[0])));
+    }
+
+    TEST(ExpressionTable, Sharing)
+    {
+        // Subtrees are only shared within each function
+        const auto sharing = talos::share_expressions(parse("fun f(x : i32) : i32 { return x * x + x * x; } fun g(x : i32) : i32 { return x * x; }"));
+        // x * x + x * x is x, x * x and the sum, x * x is x and the product
+        EXPECT_EQ(sharing.nodes, 10U);
+        EXPECT_EQ(sharing.unique_nodes, 5U);
+        EXPECT_LT(sharing.unique_bytes, sharing.bytes);
+    }
+
+    TEST(ExpressionTable, SharedInvariants)
+    {
+        constexpr auto source = "fun main() : i32 { let a = 3; let b = 4; var total = 0; "
+                                "for var i = 0; i < 10; i = i + 1 { total = total + a * b + (a * b) * i; } return total; }";
+        const auto program = talos::compile_program(parse(source));
+        const auto& code = program.functions[*program.main].code;
+        // Both a * b are computed once, before the loop, the other product is by i
+        EXPECT_EQ(std::ranges::count_if(code, [](const auto& instruction) { return instruction.op == talos::OpCode::Multiply; }), 2);
+
+        auto vm = talos::TalosVM{talos::VMOptions{.run = true}};
+        const auto result = vm.execute_string(source);
+        ASSERT_TRUE(result) << result.error().description;
+        EXPECT_EQ(result->main_result, 10 * 12 + 12 * 45);
+    }
+} // namespace
@@ -0,0 +1,367 @@
+#include "cache/function_cache.h"
+#include "talos.h"
+
+#include <fmt/format.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+    #include <sys/wait.h>
+    #include <unistd.h>
+#endif
+
+namespace
+{
+    constexpr auto source = "fun a() : i32 {\n"
+                            "    var x = 1;\n"
+                            "    return x + 2;\n"
+                            "}\n"
+                            "let c = \"c\";\n"
+                            "fun b() {\n"
+                            "    fun nested() : f64 { return 1.5; }\n"
+                            "    return 'b';\n"
+                            "}\n";
+
+    struct Run {
+        talos::VMReturn result;
+        std::string dump;
+    };
+
+    Run run(const talos::VMOptions& options, std::string_view program)
+    {
+        const auto file = std::unique_ptr<std::FILE, decltype(&std::fclose)>{std::tmpfile(), &std::fclose};
+        auto with_output = options;
+        with_output.dump_output = file.get();
+        with_output.collect_stats = true;
+        auto vm = talos::TalosVM{with_output};
+        auto result = vm.execute_string(program);
+
+        std::rewind(file.get());
+        std::string dump;
+        char buffer[4096];
+        while (const auto read = std::fread(buffer, 1, sizeof(buffer), file.get())) {
+            dump.append(buffer, read);
+        }
+        return {std::move(result), std::move(dump)};
+    }
+
+    // Contents of a file, nullopt if it cannot be opened
+    std::optional<std::string> read_file(const std::filesystem::path& path)
+    {
+        auto file = std::ifstream{path, std::ios::binary};
+        if (!file) {
+            return std::nullopt;
+        }
+        return std::string{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+    }
+
+    class FunctionCacheTest : public testing::Test
+    {
+    protected:
+        void SetUp() override
+        {
+            const auto* test = testing::UnitTest::GetInstance()->current_test_info();
+            directory_ = std::filesystem::temp_directory_path() / fmt::format("talos_function_cache_{}", test->name());
+            std::filesystem::remove_all(directory_);
+        }
+
+        void TearDown() override
+        {
+            std::filesystem::remove_all(directory_);
+        }
+
+        [[nodiscard]] std::filesystem::path entry(std::uint64_t key) const
+        {
+            return directory_ / fmt::format("{:016x}", key);
+        }
+
+        [[nodiscard]] talos::VMOptions cached(talos::DumpFormat format = talos::DumpFormat::Text) const
+        {
+            return talos::VMOptions{.dump_ast = format, .cache_directory = directory_.string()};
+        }
+
+        [[nodiscard]] std::uintmax_t directory_size() const
+        {
+            std::uintmax_t size = 0;
+            for (const auto& file : std::filesystem::directory_iterator{directory_}) {
+                size += file.file_size();
+            }
+            return size;
+        }
+
+        std::filesystem::path directory_;
+    };
+
+    TEST(CompiledDeclaration, Serialization)
+    {
+        auto declaration = talos::CompiledDeclaration{.function_name = "f", .return_type = "i32", .dump = "dump\n"};
+        declaration.nodes[3] = 300;
+        const auto data = talos::serialize(declaration);
+        EXPECT_EQ(talos::deserialize(data), declaration);
+        EXPECT_FALSE(talos::deserialize(std::string_view{data}.substr(0, data.size() - 1)));
+        EXPECT_FALSE(talos::deserialize(data + "x"));
+        EXPECT_FALSE(talos::deserialize(""));
+        // Entries of other versions of the compiled results
+        auto other_version = data;
+        other_version[4] = static_cast<char>(talos::compiled_version + 1);
+        EXPECT_FALSE(talos::deserialize(other_version));
+    }
+
+    TEST_F(FunctionCacheTest, MatchesUncached)
+    {
+        for (const auto format : {talos::DumpFormat::None, talos::DumpFormat::Text, talos::DumpFormat::Json, talos::DumpFormat::Binary}) {
+            const auto expected = run(talos::VMOptions{.dump_ast = format, .per_function = true}, source);
+            ASSERT_TRUE(expected.result);
+            // Cold and warm cache
+            for (int i = 0; i < 2; ++i) {
+                const auto cached_run = run(cached(format), source);
+                ASSERT_TRUE(cached_run.result);
+                EXPECT_EQ(cached_run.dump, expected.dump) << talos::format_as(format);
+                EXPECT_EQ(cached_run.result->stats.nodes, expected.result->stats.nodes);
+
+                const auto& functions = cached_run.result->functions;
+                ASSERT_EQ(functions.size(), 2);
+                for (std::size_t j = 0; j < functions.size(); ++j) {
+                    EXPECT_EQ(functions[j].name, expected.result->functions[j].name);
+                    EXPECT_EQ(functions[j].return_type, expected.result->functions[j].return_type);
+                    EXPECT_EQ(functions[j].location, expected.result->functions[j].location);
+                }
+            }
+        }
+    }
+
+    TEST_F(FunctionCacheTest, BracedDeclarations)
+    {
+        // Top-level statements that end at a closing brace, one of them followed by its else
+        constexpr auto braced = "packed struct P { x : i32 }\n"
+                                "var n = 0;\n"
+                                "if n > 0 { n = 1; }\n"
+                                "else { n = 2; }\n"
+                                "for ; n < 3; { n = n + 1; }\n"
+                                "let p = P(n);\n";
+        const auto expected = run(talos::VMOptions{.dump_ast = talos::DumpFormat::Text, .per_function = true}, braced);
+        ASSERT_TRUE(expected.result) << expected.result.error().description;
+        const auto cached_run = run(cached(), braced);
+        ASSERT_TRUE(cached_run.result) << cached_run.result.error().description;
+        EXPECT_EQ(cached_run.dump, expected.dump);
+    }
+
+    TEST_F(FunctionCacheTest, OnlyChangedDeclarationsAreCompiled)
+    {
+        if (!talos::stats_enabled) {
+            GTEST_SKIP() << "Built without TALOS_STATS";
+        }
+        const auto first = run(cached(), source);
+        ASSERT_TRUE(first.result);
+        EXPECT_EQ(first.result->stats.cache_hits, 0);
+        EXPECT_EQ(first.result->stats.cache_misses, 3);
+
+        // Whitespace and locations do not matter
+        auto edited = "\n\n" + std::string{source};
+        edited.replace(edited.find("x + 2"), 5, "x+2");
+        const auto reformatted = run(cached(), edited);
+        ASSERT_TRUE(reformatted.result);
+        EXPECT_EQ(reformatted.result->stats.cache_hits, 3);
+        EXPECT_EQ(reformatted.result->stats.cache_misses, 0);
+
+        edited.replace(edited.find("'b'"), 3, "'c'");
+        const auto changed = run(cached(), edited);
+        ASSERT_TRUE(changed.result);
+        EXPECT_EQ(changed.result->stats.cache_hits, 2);
+        EXPECT_EQ(changed.result->stats.cache_misses, 1);
+        EXPECT_EQ(changed.dump, run(talos::VMOptions{.dump_ast = talos::DumpFormat::Text, .per_function = true}, edited).dump);
+    }
+
+    TEST_F(FunctionCacheTest, SameErrorsAsUncached)
+    {
+        for (const auto* program : {
+                 "fun a( { return 1; }",
+                 "fun a() : i32 { return 1; }\nfun b() { return @; }",
+                 "fun a( { return @; }",
+                 "var x = 1 fun b() { return 1; }",
+                 "fun a() { return 1; } }",
+                 "fun a() { return \"unterminated; }",
+                 "fun a() { return 1;",
+             }) {
+            const auto expected = run(talos::VMOptions{.per_function = true}, program);
+            ASSERT_FALSE(expected.result) << program;
+            for (int i = 0; i < 2; ++i) {
+                const auto cached_run = run(cached(), program);
+                ASSERT_FALSE(cached_run.result) << program;
+                EXPECT_EQ(cached_run.result.error().code, expected.result.error().code) << program;
+                EXPECT_EQ(cached_run.result.error().description, expected.result.error().description) << program;
+            }
+        }
+    }
+
+    TEST_F(FunctionCacheTest, CorruptEntriesAreMisses)
+    {
+        const auto first = run(cached(), source);
+        ASSERT_TRUE(first.result);
+        for (const auto& entry : std::filesystem::directory_iterator{directory_}) {
+            std::filesystem::resize_file(entry.path(), 3);
+        }
+        const auto second = run(cached(), source);
+        ASSERT_TRUE(second.result);
+        EXPECT_EQ(second.dump, first.dump);
+    }
+
+    talos::CompiledDeclaration declaration_for(std::uint64_t key)
+    {
+        return talos::CompiledDeclaration{
+            .function_name = fmt::format("f{}", key),
+            .return_type = "i32",
+            .dump = std::string(key * 7 % 300, static_cast<char>('a' + key % 26)),
+        };
+    }
+
+    TEST_F(FunctionCacheTest, EvictsLeastRecentlyUsed)
+    {
+        const auto declaration = declaration_for(0);
+        auto writer = talos::FunctionCache{directory_, talos::VMOptions::default_cache_max_size};
+        const auto now = std::filesystem::file_time_type::clock::now();
+        for (std::uint64_t key = 0; key < 8; ++key) {
+            writer.store(key, declaration);
+            std::filesystem::last_write_time(entry(key), now - std::chrono::hours{8 - key});
+        }
+
+        const auto entry_size = std::filesystem::file_size(entry(0));
+        const auto cache = talos::FunctionCache{directory_, 4 * entry_size};
+        // Loading the oldest entry makes it the most recently used
+        ASSERT_EQ(cache.load(0), declaration);
+        cache.evict();
+
+        // Evicted down to three quarters of the limit
+        EXPECT_EQ(directory_size(), 3 * entry_size);
+        for (std::uint64_t key = 1; key < 6; ++key) {
+            EXPECT_FALSE(cache.load(key)) << key;
+        }
+        EXPECT_TRUE(cache.load(0));
+        EXPECT_TRUE(cache.load(6));
+        EXPECT_TRUE(cache.load(7));
+    }
+
+    TEST_F(FunctionCacheTest, RemovesAbandonedTemporaryFiles)
+    {
+        const auto cache = talos::FunctionCache{directory_, talos::VMOptions::default_cache_max_size};
+        const auto abandoned = directory_ / "abandoned.tmp";
+        const auto in_progress = directory_ / "in_progress.tmp";
+        std::ofstream{abandoned} << "partial";
+        std::ofstream{in_progress} << "partial";
+        std::filesystem::last_write_time(abandoned, std::filesystem::file_time_type::clock::now() - std::chrono::hours{2});
+        cache.evict();
+        EXPECT_FALSE(std::filesystem::exists(abandoned));
+        EXPECT_TRUE(std::filesystem::exists(in_progress));
+    }
+
+    TEST_F(FunctionCacheTest, ConcurrentWriters)
+    {
+        // Each thread stands in for a separate process sharing the directory,
+        // with a limit small enough for eviction to run alongside the writes
+        constexpr auto writers = 8;
+        constexpr auto iterations = 2000;
+        constexpr auto keys = 64;
+        constexpr std::uintmax_t max_size = 4096;
+
+        std::atomic<int> hits = 0;
+        std::atomic<int> corrupt = 0;
+        auto threads = std::vector<std::thread>{};
+        for (auto writer = 0; writer < writers; ++writer) {
+            threads.emplace_back([&, writer] {
+                auto cache = talos::FunctionCache{directory_, max_size};
+                auto random = std::minstd_rand{static_cast<std::minstd_rand::result_type>(writer + 1)};
+                for (auto i = 0; i < iterations; ++i) {
+                    const auto key = random() % keys;
+                    if (const auto loaded = cache.load(key)) {
+                        ++hits;
+                        corrupt += *loaded != declaration_for(key);
+                    }
+                    else {
+                        cache.store(key, declaration_for(key));
+                    }
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        EXPECT_EQ(corrupt, 0);
+        EXPECT_GT(hits, 0);
+        for (const auto& file : std::filesystem::directory_iterator{directory_}) {
+            EXPECT_NE(file.path().extension(), ".tmp") << file.path();
+        }
+        talos::FunctionCache{directory_, max_size}.evict();
+        EXPECT_LE(directory_size(), max_size);
+    }
+
+#ifndef _WIN32
+    TEST_F(FunctionCacheTest, ConcurrentProcesses)
+    {
+        // As above, with each writer a process of its own
+        constexpr auto writers = 6;
+        constexpr auto iterations = 2000;
+        constexpr auto keys = 64;
+        constexpr std::uintmax_t max_size = 4096;
+
+        auto children = std::vector<pid_t>{};
+        for (auto writer = 0; writer < writers; ++writer) {
+            const auto pid = ::fork();
+            ASSERT_GE(pid, 0);
+            if (pid == 0) {
+                // Exits with the number of corrupt entries read, without
+                // running anything of the test process. Loads skip entries
+                // that are incomplete, so the files are read directly as well
+                auto corrupt = 0;
+                auto cache = talos::FunctionCache{directory_, max_size};
+                auto random = std::minstd_rand{static_cast<std::minstd_rand::result_type>(writer + 1)};
+                for (auto i = 0; i < iterations; ++i) {
+                    const auto key = random() % keys;
+                    if (const auto data = read_file(entry(key))) {
+                        const auto declaration = talos::deserialize(*data);
+                        corrupt += !declaration || *declaration != declaration_for(key) ? 1 : 0;
+                    }
+                    if (const auto loaded = cache.load(key)) {
+                        corrupt += *loaded != declaration_for(key) ? 1 : 0;
+                    }
+                    else {
+                        cache.store(key, declaration_for(key));
+                    }
+                }
+                ::_exit(std::min(corrupt, 255));
+            }
+            children.push_back(pid);
+        }
+        for (const auto pid : children) {
+            auto status = 0;
+            ASSERT_EQ(::waitpid(pid, &status, 0), pid);
+            ASSERT_TRUE(WIFEXITED(status));
+            EXPECT_EQ(WEXITSTATUS(status), 0);
+        }
+
+        // And every entry left is complete
+        auto entries = 0;
+        for (const auto& file : std::filesystem::directory_iterator{directory_}) {
+            ASSERT_NE(file.path().extension(), ".tmp") << file.path();
+            const auto declaration = talos::deserialize(read_file(file.path()).value_or(""));
+            ASSERT_TRUE(declaration) << file.path();
+            EXPECT_EQ(*declaration, declaration_for(std::stoull(file.path().filename().string(), nullptr, 16)));
+            ++entries;
+        }
+        EXPECT_GT(entries, 0);
+    }
+#endif
+} // namespace
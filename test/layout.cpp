@@ -0,0 +1,104 @@
+#include "vm/layout.h"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <span>
+#include <string>
+#include <utility>
+
+namespace
+{
+    using talos::Type;
+
+    talos::StructLayout layout(bool packed, std::span<const talos::StructLayout> structs = {})
+    {
+        const auto fields = std::array{
+            std::pair{std::string{"flag"}, Type::Bool},
+            std::pair{std::string{"weight"}, Type::Float64},
+            std::pair{std::string{"count"}, Type::Int16},
+        };
+        return talos::layout_struct("Item", packed, fields, structs);
+    }
+
+    TEST(Layout, Natural)
+    {
+        // Each field is aligned to its size, the struct to its largest field
+        const auto item = layout(false);
+        ASSERT_EQ(item.fields.size(), 3U);
+        EXPECT_EQ(item.fields[0].offset, 0U);
+        EXPECT_EQ(item.fields[1].offset, 8U);
+        EXPECT_EQ(item.fields[2].offset, 16U);
+        EXPECT_EQ(item.size, 24U);
+        EXPECT_EQ(item.alignment, 8U);
+        EXPECT_EQ(item.find("count"), 2U);
+        EXPECT_FALSE(item.find("missing"));
+    }
+
+    TEST(Layout, Packed)
+    {
+        const auto item = layout(true);
+        EXPECT_EQ(item.fields[1].offset, 1U);
+        EXPECT_EQ(item.fields[2].offset, 9U);
+        EXPECT_EQ(item.size, 11U);
+        EXPECT_EQ(item.alignment, 1U);
+    }
+
+    TEST(Layout, Nested)
+    {
+        // Slots flatten the nested struct, at offsets within the outer one
+        const auto structs = std::array{layout(false)};
+        const auto fields = std::array{
+            std::pair{std::string{"id"}, Type::Int8},
+            std::pair{std::string{"item"}, talos::struct_type(0)},
+        };
+        const auto outer = talos::layout_struct("Slot", false, fields, structs);
+        EXPECT_EQ(outer.fields[1].offset, 8U);
+        EXPECT_EQ(outer.fields[1].slot, 1U);
+        EXPECT_EQ(outer.size, 32U);
+        ASSERT_EQ(outer.slots.size(), 4U);
+        EXPECT_EQ(outer.slots[2].type, Type::Float64);
+        EXPECT_EQ(outer.slots[2].offset, 16U);
+
+        const auto packed = talos::layout_struct("Slot", true, fields, structs);
+        EXPECT_EQ(packed.fields[1].offset, 1U);
+        EXPECT_EQ(packed.size, 25U);
+    }
+
+    TEST(Layout, Arrays)
+    {
+        // Scalars and structs are stored element by element, slot i of
+        // element j at column i's offset + j * stride
+        const auto scalars = talos::layout_array("[5]i16", Type::Int16, 5, {});
+        ASSERT_EQ(scalars.columns.size(), 1U);
+        EXPECT_EQ(scalars.columns[0].stride, 2U);
+        EXPECT_EQ(scalars.size, 10U);
+
+        auto structs = std::array{layout(false), layout(true), layout(false)};
+        structs[2].soa = true;
+        const auto natural = talos::layout_array("[3]Item", talos::struct_type(0), 3, structs);
+        ASSERT_EQ(natural.columns.size(), 3U);
+        EXPECT_EQ(natural.columns[1].type, Type::Float64);
+        EXPECT_EQ(natural.columns[1].offset, 8U);
+        EXPECT_EQ(natural.columns[2].offset, 16U);
+        EXPECT_EQ(natural.columns[2].stride, 24U);
+        EXPECT_EQ(natural.size, 72U);
+
+        const auto packed = talos::layout_array("[3]Item", talos::struct_type(1), 3, structs);
+        EXPECT_EQ(packed.columns[2].offset, 9U);
+        EXPECT_EQ(packed.columns[2].stride, 11U);
+        EXPECT_EQ(packed.size, 33U);
+
+        // A soa struct is stored a column per slot, each aligned like an array
+        const auto soa = talos::layout_array("[3]Item", talos::struct_type(2), 3, structs);
+        ASSERT_EQ(soa.columns.size(), 3U);
+        EXPECT_EQ(soa.columns[0].offset, 0U);
+        EXPECT_EQ(soa.columns[0].stride, 1U);
+        EXPECT_EQ(soa.columns[1].offset, 32U);
+        EXPECT_EQ(soa.columns[1].stride, 8U);
+        EXPECT_EQ(soa.columns[2].offset, 64U);
+        EXPECT_EQ(soa.columns[2].stride, 2U);
+        EXPECT_EQ(soa.size, 70U);
+        EXPECT_EQ(soa.aligned_size(), 96U);
+    }
+} // namespace
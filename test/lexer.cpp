@@ -1,8 +1,11 @@
 #include "frontend/lexer.h"
+#include "frontend/string_literal.h"
 #include "exceptions.h"
 
 #include <gtest/gtest.h>
 
+#include <string>
+
 #define EXPECT_TOKEN_TYPE(result, expected) \
     EXPECT_EQ((result).type, (expected))
 
@@ -27,7 +30,7 @@ namespace
 {
     TEST(Lexer, Tokens)
     {
-        constexpr const char* string = "+-/*();{}=:";
+        constexpr const char* string = "+-/*();{}=:,";
         auto lexer = talos::Lexer{string};
         using enum talos::TokenType;
         EXPECT_TOKEN_TYPE(lexer.consume_token(), Plus);
@@ -41,9 +44,40 @@ namespace
         EXPECT_TOKEN_TYPE(lexer.consume_token(), RightBrace);
         EXPECT_TOKEN_TYPE(lexer.consume_token(), Equal);
         EXPECT_TOKEN_TYPE(lexer.consume_token(), Colon);
+        EXPECT_TOKEN_TYPE(lexer.consume_token(), Comma);
         EXPECT_TOKEN_TYPE(lexer.consume_token(), Eof);
     }
 
+    TEST(Lexer, Operators)
+    {
+        constexpr const char* string = "% == = ! != < <= > >= && || . [ ] ===";
+        auto lexer = talos::Lexer{string};
+        using enum talos::TokenType;
+        EXPECT_TOKEN_TYPE(lexer.consume_token(), Percent);
+        EXPECT_TOKEN_TYPE(lexer.consume_token(), EqualEqual);
+        EXPECT_TOKEN_TYPE(lexer.consume_token(), Equal);
+        EXPECT_TOKEN_TYPE(lexer.consume_token(), Bang);
+        EXPECT_TOKEN_TYPE(lexer.consume_token(), BangEqual);
+        EXPECT_TOKEN_TYPE(lexer.consume_token(), Less);
+        EXPECT_TOKEN_TYPE(lexer.consume_token(), LessEqual);
+        EXPECT_TOKEN_TYPE(lexer.consume_token(), Greater);
+        EXPECT_TOKEN_TYPE(lexer.consume_token(), GreaterEqual);
+        EXPECT_TOKEN_TYPE(lexer.consume_token(), AmpAmp);
+        EXPECT_TOKEN_TYPE(lexer.consume_token(), PipePipe);
+        EXPECT_TOKEN_TYPE(lexer.consume_token(), Dot);
+        EXPECT_TOKEN_TYPE(lexer.consume_token(), LeftBracket);
+        EXPECT_TOKEN_TYPE(lexer.consume_token(), RightBracket);
+        // Longest match first
+        EXPECT_TOKEN_TYPE(lexer.consume_token(), EqualEqual);
+        EXPECT_TOKEN_TYPE(lexer.consume_token(), Equal);
+        EXPECT_TOKEN_TYPE(lexer.consume_token(), Eof);
+
+        // Single & and | are not operators
+        auto single = talos::Lexer{"a & b"};
+        EXPECT_TOKEN_TYPE(single.consume_token(), Identifier);
+        EXPECT_THROW(static_cast<void>(single.consume_token()), talos::TalosException);
+    }
+
     TEST(Lexer, Location)
     {
         // Whitespace
@@ -106,6 +140,81 @@ namespace
             auto lexer = talos::Lexer{string};
             EXPECT_LEXER_ERROR(lexer.consume_token(), talos::ReturnCode::UnexpectedEof);
         }
+
+        // Escaped quotes don't end the literal, which keeps its escapes
+        {
+            constexpr auto string = R"("a \"long\" string literal\\" x)";
+            auto lexer = talos::Lexer{string};
+            const auto result = lexer.consume_token();
+            EXPECT_TOKEN_TYPE(result, talos::TokenType::StringLiteral);
+            EXPECT_TOKEN_STRING(result, R"("a \"long\" string literal\\")");
+            EXPECT_TOKEN_LOCATION(lexer.consume_token(), 1, 31);
+        }
+
+        // Line breaks within a literal
+        {
+            constexpr auto string = "\"first\nsecond\" x";
+            auto lexer = talos::Lexer{string};
+            EXPECT_TOKEN_TYPE(lexer.consume_token(), talos::TokenType::StringLiteral);
+            EXPECT_TOKEN_LOCATION(lexer.consume_token(), 2, 9);
+        }
+
+        // Escaped quote at the end of the input
+        {
+            constexpr auto string = R"("string\")";
+            auto lexer = talos::Lexer{string};
+            EXPECT_LEXER_ERROR(lexer.consume_token(), talos::ReturnCode::UnexpectedEof);
+        }
+    }
+
+    TEST(Lexer, StringEscapes)
+    {
+        for (const auto* string : {R"("\n\t\\\"")", R"("\x00\xfF")", R"("\u{41}\u{10FFFF}")"}) {
+            auto lexer = talos::Lexer{string};
+            EXPECT_TOKEN_TYPE(lexer.consume_token(), talos::TokenType::StringLiteral) << string;
+        }
+        for (const auto* string : {R"("\q")", R"("\x4")", R"("\x4g")", R"("\u41")", R"("\u{}")", R"("\u{1234567}")", R"("\u{110000}")", R"("\u{D800}")", R"("\u{41")"}) {
+            auto lexer = talos::Lexer{string};
+            EXPECT_LEXER_ERROR(lexer.consume_token(), talos::ReturnCode::InvalidEscape);
+        }
+
+        // Reported at the backslash
+        try {
+            auto lexer = talos::Lexer{"x = \"abc\\z\";"};
+            static_cast<void>(lexer.consume_token());
+            static_cast<void>(lexer.consume_token());
+            static_cast<void>(lexer.consume_token());
+            ADD_FAILURE();
+        } catch (const talos::TalosException& e) {
+            EXPECT_EQ(e.location(), (talos::SourceLocation{1, 9}));
+        }
+    }
+
+    TEST(Lexer, DecodeStringLiteral)
+    {
+        EXPECT_EQ(talos::decode_string_literal(R"("")"), "");
+        EXPECT_EQ(talos::decode_string_literal(R"("plain text longer than one vector")"), "plain text longer than one vector");
+        EXPECT_EQ(talos::decode_string_literal(R"("a\nb\tc\\d\"e")"), "a\nb\tc\\d\"e");
+        EXPECT_EQ(talos::decode_string_literal(R"("\x41\xff")"), "A\xff");
+        // UTF-8 of one, two, three and four bytes
+        EXPECT_EQ(talos::decode_string_literal(R"("\u{7A}\u{e9}\u{20AC}\u{1F600}")"), "z\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80");
+        EXPECT_EQ(talos::decode_string_literal("\"two\nlines\""), "two\nlines");
+    }
+
+    TEST(Lexer, FindStringSpecial)
+    {
+        EXPECT_EQ(talos::find_string_special(""), 0U);
+        EXPECT_EQ(talos::find_string_special("abc"), 3U);
+        // Within and after the first vector, and in the tail
+        const auto text = std::string(40, 'x');
+        for (const auto special : {'"', '\\', '\n'}) {
+            for (const auto position : {0U, 15U, 16U, 31U, 35U, 39U}) {
+                auto with_special = text;
+                with_special[position] = special;
+                EXPECT_EQ(talos::find_string_special(with_special), position);
+            }
+        }
+        EXPECT_EQ(talos::find_string_special(text), text.size());
     }
 
     TEST(Lexer, CharLiterals)
@@ -164,11 +273,18 @@ namespace
 
     TEST(Lexer, Keywords)
     {
-        constexpr const char* string = "fun return var let true false";
+        constexpr const char* string = "fun return if else while for struct packed soa var let true false";
         auto lexer = talos::Lexer{string};
         using enum talos::TokenType;
         EXPECT_TOKEN_TYPE(lexer.consume_token(), Fun);
         EXPECT_TOKEN_TYPE(lexer.consume_token(), Return);
+        EXPECT_TOKEN_TYPE(lexer.consume_token(), If);
+        EXPECT_TOKEN_TYPE(lexer.consume_token(), Else);
+        EXPECT_TOKEN_TYPE(lexer.consume_token(), While);
+        EXPECT_TOKEN_TYPE(lexer.consume_token(), For);
+        EXPECT_TOKEN_TYPE(lexer.consume_token(), Struct);
+        EXPECT_TOKEN_TYPE(lexer.consume_token(), Packed);
+        EXPECT_TOKEN_TYPE(lexer.consume_token(), Soa);
         EXPECT_TOKEN_TYPE(lexer.consume_token(), Var);
         EXPECT_TOKEN_TYPE(lexer.consume_token(), Let);
         EXPECT_TOKEN_TYPE(lexer.consume_token(), TrueLiteral);
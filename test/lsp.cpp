@@ -0,0 +1,285 @@
+#include "lsp/json.h"
+#include "lsp/server.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+namespace
+{
+    using talos::lsp::JsonValue;
+
+    constexpr auto uri = "file:///a.talos";
+    constexpr auto source = "let c = 1;\n"
+                            "fun a() : i32 {\n"
+                            "    var x = 2;\n"
+                            "    let y = x;\n"
+                            "    return c;\n"
+                            "}\n";
+
+    class Client
+    {
+    public:
+        Client()
+            : server_([this](std::string_view message) { messages_.push_back(*talos::lsp::parse_json(message)); })
+        {
+        }
+
+        // Returns the messages sent in reply
+        std::vector<JsonValue> send(const JsonValue& message)
+        {
+            messages_.clear();
+            server_.handle(talos::lsp::to_json(message));
+            return std::move(messages_);
+        }
+
+        JsonValue request(std::string_view method, JsonValue params)
+        {
+            auto replies = send(JsonValue::Object{{"jsonrpc", "2.0"}, {"id", ++id_}, {"method", method}, {"params", std::move(params)}});
+            EXPECT_EQ(replies.size(), 1);
+            return replies.empty() ? JsonValue{} : replies.front();
+        }
+
+        std::vector<JsonValue> notify(std::string_view method, JsonValue params)
+        {
+            return send(JsonValue::Object{{"jsonrpc", "2.0"}, {"method", method}, {"params", std::move(params)}});
+        }
+
+        talos::lsp::LanguageServer& server() { return server_; }
+
+    private:
+        talos::lsp::LanguageServer server_;
+        std::vector<JsonValue> messages_;
+        int id_ = 0;
+    };
+
+    JsonValue position(int line, int character)
+    {
+        return JsonValue::Object{{"line", line}, {"character", character}};
+    }
+
+    JsonValue range(int start_line, int start_character, int end_line, int end_character)
+    {
+        return JsonValue::Object{{"start", position(start_line, start_character)}, {"end", position(end_line, end_character)}};
+    }
+
+    JsonValue text_document()
+    {
+        return JsonValue::Object{{"uri", uri}};
+    }
+
+    std::vector<JsonValue> open(Client& client, std::string_view text)
+    {
+        return client.notify("textDocument/didOpen", JsonValue::Object{
+                                                         {"textDocument", JsonValue::Object{{"uri", uri}, {"languageId", "talos"}, {"version", 1}, {"text", text}}},
+                                                     });
+    }
+
+    std::vector<JsonValue> change(Client& client, JsonValue range, std::string_view text)
+    {
+        return client.notify("textDocument/didChange", JsonValue::Object{
+                                                           {"textDocument", text_document()},
+                                                           {"contentChanges", JsonValue::Array{JsonValue::Object{{"range", std::move(range)}, {"text", text}}}},
+                                                       });
+    }
+
+    TEST(Json, RoundTrip)
+    {
+        constexpr auto text = R"({"a":[1,-2.5,true,false,null],"b":"q\"\\\n\u0001","c":{}})";
+        const auto value = talos::lsp::parse_json(text);
+        ASSERT_TRUE(value);
+        EXPECT_EQ(talos::lsp::to_json(*value), text);
+        EXPECT_EQ(talos::lsp::parse_json(R"("é😀")")->as_string(), "é\U0001F600");
+    }
+
+    TEST(Json, Invalid)
+    {
+        EXPECT_FALSE(talos::lsp::parse_json(""));
+        EXPECT_FALSE(talos::lsp::parse_json("{\"a\":}"));
+        EXPECT_FALSE(talos::lsp::parse_json("[1,]"));
+        EXPECT_FALSE(talos::lsp::parse_json("\"unterminated"));
+        EXPECT_FALSE(talos::lsp::parse_json("1 2"));
+        EXPECT_FALSE(talos::lsp::parse_json(std::string(1000, '[')));
+    }
+
+    TEST(LanguageServer, Initialize)
+    {
+        auto client = Client{};
+        const auto reply = client.request("initialize", JsonValue::Object{});
+        const auto* capabilities = reply.find("result")->find("capabilities");
+        ASSERT_NE(capabilities, nullptr);
+        EXPECT_EQ(capabilities->find("textDocumentSync")->find("change")->as_number(), 2);
+        EXPECT_TRUE(capabilities->find("documentSymbolProvider")->as_bool());
+        EXPECT_TRUE(capabilities->find("definitionProvider")->as_bool());
+
+        EXPECT_EQ(client.request("unknown", JsonValue::Object{}).find("error")->find("code")->as_number(), -32601);
+        EXPECT_TRUE(client.request("shutdown", JsonValue{}).find("result")->is_null());
+        client.notify("exit", JsonValue{});
+        EXPECT_TRUE(client.server().exited());
+        EXPECT_EQ(client.server().exit_code(), 0);
+    }
+
+    TEST(LanguageServer, InvalidMessages)
+    {
+        auto client = Client{};
+        client.server().handle("{");
+        ASSERT_EQ(client.send(JsonValue::Array{}).size(), 1);
+
+        // Missing parameters are reported for requests and logged for notifications
+        const auto reply = client.request("textDocument/definition", JsonValue::Object{{"textDocument", text_document()}});
+        EXPECT_EQ(reply.find("error")->find("code")->as_number(), -32602);
+        const auto logged = client.notify("textDocument/didOpen", JsonValue::Object{});
+        ASSERT_EQ(logged.size(), 1);
+        EXPECT_EQ(logged.front().find("method")->as_string(), "window/logMessage");
+        EXPECT_EQ(logged.front().find("params")->find("type")->as_number(), 1);
+    }
+
+    TEST(LanguageServer, ChangeOutOfSync)
+    {
+        auto client = Client{};
+        open(client, source);
+        // A change that cannot be applied is logged, and later incremental
+        // changes are ignored as the text is stale
+        const auto logged = change(client, range(-1, 0, 0, 1), "x");
+        ASSERT_EQ(logged.size(), 1);
+        EXPECT_EQ(logged.front().find("method")->as_string(), "window/logMessage");
+        EXPECT_TRUE(change(client, range(1, 6, 1, 7), "").empty());
+        EXPECT_EQ(client.server().document(uri)->text(), source);
+
+        // Until the client sends all of it again
+        const auto published = client.notify("textDocument/didChange", JsonValue::Object{
+                                                                           {"textDocument", text_document()},
+                                                                           {"contentChanges", JsonValue::Array{JsonValue::Object{{"text", "fun a( {"}}}},
+                                                                       });
+        ASSERT_EQ(published.size(), 1);
+        EXPECT_EQ(published.front().find("method")->as_string(), "textDocument/publishDiagnostics");
+        EXPECT_EQ(client.server().document(uri)->text(), "fun a( {");
+        EXPECT_EQ(change(client, range(0, 6, 0, 6), ")").size(), 1);
+    }
+
+    TEST(LanguageServer, Diagnostics)
+    {
+        auto client = Client{};
+        // Valid documents publish nothing
+        EXPECT_TRUE(open(client, source).empty());
+
+        // Break the second declaration by removing the closing parenthesis of "a()"
+        auto published = change(client, range(1, 6, 1, 7), "");
+        ASSERT_EQ(published.size(), 1);
+        const auto& params = *published.front().find("params");
+        EXPECT_EQ(params.find("uri")->as_string(), uri);
+        const auto& diagnostics = params.find("diagnostics")->as_array();
+        ASSERT_EQ(diagnostics.size(), 1);
+        EXPECT_EQ(talos::lsp::to_json(*diagnostics.front().find("range")), talos::lsp::to_json(range(1, 7, 1, 8)));
+        EXPECT_FALSE(diagnostics.front().find("message")->as_string().empty());
+
+        // Fixing it clears the diagnostics once
+        published = change(client, range(1, 6, 1, 6), ")");
+        ASSERT_EQ(published.size(), 1);
+        EXPECT_TRUE(published.front().find("params")->find("diagnostics")->as_array().empty());
+        EXPECT_TRUE(change(client, range(0, 8, 0, 9), "3").empty());
+        EXPECT_EQ(client.server().document(uri)->text(), "let c = 3;" + std::string{source}.substr(10));
+    }
+
+    TEST(LanguageServer, UnterminatedString)
+    {
+        auto client = Client{};
+        open(client, source);
+        const auto published = change(client, range(5, 1, 5, 1), "\nlet s = \"abc");
+        ASSERT_EQ(published.size(), 1);
+        const auto& diagnostics = published.front().find("params")->find("diagnostics")->as_array();
+        ASSERT_EQ(diagnostics.size(), 1);
+        EXPECT_EQ(talos::lsp::to_json(*diagnostics.front().find("range")->find("start")), talos::lsp::to_json(position(6, 8)));
+    }
+
+    TEST(LanguageServer, DocumentSymbols)
+    {
+        auto client = Client{};
+        open(client, source);
+        const auto reply = client.request("textDocument/documentSymbol", JsonValue::Object{{"textDocument", text_document()}});
+        const auto& symbols = reply.find("result")->as_array();
+        ASSERT_EQ(symbols.size(), 2);
+        EXPECT_EQ(symbols[0].find("name")->as_string(), "c");
+        EXPECT_EQ(symbols[0].find("kind")->as_number(), 14);
+        EXPECT_EQ(talos::lsp::to_json(*symbols[0].find("range")), talos::lsp::to_json(range(0, 0, 0, 10)));
+        EXPECT_EQ(symbols[1].find("name")->as_string(), "a");
+        EXPECT_EQ(symbols[1].find("kind")->as_number(), 12);
+        EXPECT_EQ(talos::lsp::to_json(*symbols[1].find("range")), talos::lsp::to_json(range(1, 0, 5, 1)));
+        EXPECT_EQ(talos::lsp::to_json(*symbols[1].find("selectionRange")), talos::lsp::to_json(range(1, 4, 1, 5)));
+
+        const auto& children = symbols[1].find("children")->as_array();
+        ASSERT_EQ(children.size(), 2);
+        EXPECT_EQ(children[0].find("name")->as_string(), "x");
+        EXPECT_EQ(children[0].find("kind")->as_number(), 13);
+        EXPECT_EQ(talos::lsp::to_json(*children[0].find("range")), talos::lsp::to_json(range(2, 4, 2, 14)));
+        EXPECT_EQ(children[1].find("name")->as_string(), "y");
+        EXPECT_EQ(children[1].find("kind")->as_number(), 14);
+    }
+
+    TEST(LanguageServer, StructSymbols)
+    {
+        auto client = Client{};
+        open(client, "packed struct P {\n    x : i32,\n}\n");
+        const auto reply = client.request("textDocument/documentSymbol", JsonValue::Object{{"textDocument", text_document()}});
+        const auto& symbols = reply.find("result")->as_array();
+        ASSERT_EQ(symbols.size(), 1);
+        EXPECT_EQ(symbols[0].find("name")->as_string(), "P");
+        EXPECT_EQ(symbols[0].find("kind")->as_number(), 23);
+        EXPECT_EQ(talos::lsp::to_json(*symbols[0].find("range")), talos::lsp::to_json(range(0, 0, 2, 1)));
+        const auto& fields = symbols[0].find("children")->as_array();
+        ASSERT_EQ(fields.size(), 1);
+        EXPECT_EQ(fields[0].find("kind")->as_number(), 8);
+        EXPECT_EQ(talos::lsp::to_json(*fields[0].find("range")), talos::lsp::to_json(range(1, 4, 1, 11)));
+    }
+
+    TEST(LanguageServer, Definition)
+    {
+        auto client = Client{};
+        open(client, source);
+        const auto definition = [&](int line, int character) {
+            const auto reply = client.request("textDocument/definition", JsonValue::Object{
+                                                                             {"textDocument", text_document()},
+                                                                             {"position", position(line, character)},
+                                                                         });
+            const auto& result = *reply.find("result");
+            return result.is_null() ? std::string{} : talos::lsp::to_json(*result.find("range"));
+        };
+
+        // Local variable, also with the cursor directly after the identifier
+        EXPECT_EQ(definition(3, 12), talos::lsp::to_json(range(2, 8, 2, 9)));
+        EXPECT_EQ(definition(3, 13), talos::lsp::to_json(range(2, 8, 2, 9)));
+        // Top-level declaration
+        EXPECT_EQ(definition(4, 11), talos::lsp::to_json(range(0, 4, 0, 5)));
+        // Keywords and whitespace
+        EXPECT_EQ(definition(4, 5), "");
+        EXPECT_EQ(definition(2, 0), "");
+
+        // Positions follow edits to earlier declarations
+        change(client, range(0, 0, 0, 0), "fun b() : i32 {\n    return 0;\n}\n");
+        EXPECT_EQ(definition(7, 11), talos::lsp::to_json(range(3, 4, 3, 5)));
+    }
+
+    TEST(LanguageServer, ParameterDefinition)
+    {
+        auto client = Client{};
+        open(client, "fun f(a : i32, b : i32) : i32 {\n    return b;\n}\n");
+        const auto reply = client.request("textDocument/definition", JsonValue::Object{
+                                                                         {"textDocument", text_document()},
+                                                                         {"position", position(1, 11)},
+                                                                     });
+        EXPECT_EQ(talos::lsp::to_json(*reply.find("result")->find("range")), talos::lsp::to_json(range(0, 15, 0, 16)));
+    }
+
+    TEST(LanguageServer, Utf16Positions)
+    {
+        auto client = Client{};
+        // Both the two byte character and the surrogate pair precede the identifier
+        open(client, "let s = \"é\U0001F600\"; let t = s;\n");
+        const auto reply = client.request("textDocument/definition", JsonValue::Object{
+                                                                         {"textDocument", text_document()},
+                                                                         {"position", position(0, 23)},
+                                                                     });
+        EXPECT_EQ(talos::lsp::to_json(*reply.find("result")->find("range")), talos::lsp::to_json(range(0, 4, 0, 5)));
+    }
+} // namespace
@@ -0,0 +1,215 @@
+#include "frontend/lexer.h"
+#include "frontend/parser.h"
+#include "native/assembly.h"
+#include "native/register_allocator.h"
+#include "native/toolchain.h"
+#include "talos.h"
+#include "vm/codegen.h"
+
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <cstdlib>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+    talos::Program compile(std::string_view source)
+    {
+        auto lexer = talos::Lexer{source};
+        auto parser = talos::Parser{&lexer};
+        const auto program = parser.parse();
+        return talos::compile_program(program);
+    }
+
+    bool has_toolchain()
+    {
+        static const auto found = talos::run_command(std::vector<std::string>{"as", "-o", "/dev/null", "/dev/null"}) == 0 && talos::run_command(std::vector<std::string>{"cc", "-E", "-o", "/dev/null", "-x", "c", "/dev/null"}) == 0;
+        return found;
+    }
+
+    std::optional<int> run_native(const std::string& assembly, const talos::VMOptions& options, const std::filesystem::path& executable)
+    {
+        talos::build_executable(assembly, talos::runtime_source(options.stack_size, options.max_call_depth, options.memory_size), executable);
+        const auto status = talos::run_command(std::vector<std::string>{executable.string()});
+        std::filesystem::remove(executable);
+        return status;
+    }
+
+    // Exit code of the program as the interpreter runs it, and as its native
+    // executable does, also when there are fewer machine registers to
+    // allocate than it needs
+    void expect_same_exit_code(std::string_view source, talos::VMOptions options = {})
+    {
+        options.run = true;
+        auto vm = talos::TalosVM{options};
+        const auto interpreted = vm.execute_string(source);
+        const auto expected = interpreted ? static_cast<int>(interpreted->main_result.value_or(0)) & 0xFF : static_cast<int>(interpreted.error().code);
+
+        const auto executable = std::filesystem::temp_directory_path() / fmt::format("talos-native-test-{}", ::testing::UnitTest::GetInstance()->random_seed());
+        options.run = false;
+        options.native = talos::NativeOutput::Executable;
+        options.native_output = executable.string();
+        auto compiler = talos::TalosVM{options};
+        const auto built = compiler.execute_string(source);
+        ASSERT_TRUE(built) << built.error().description;
+        const auto status = talos::run_command(std::vector<std::string>{executable.string()});
+        std::filesystem::remove(executable);
+        ASSERT_TRUE(status);
+        EXPECT_EQ(*status, expected) << source;
+
+        const auto program = compile(source);
+        for (const auto machine_registers : {std::size_t{0}, std::size_t{1}}) {
+            const auto spilled = run_native(talos::emit_assembly(program, talos::AssemblyOptions{.machine_registers = machine_registers}), options, executable);
+            ASSERT_TRUE(spilled);
+            EXPECT_EQ(*spilled, expected) << source << " with " << machine_registers << " machine registers";
+        }
+    }
+
+    // No two values live at the same position share a machine register, and
+    // only preserved ones hold values live across calls
+    void expect_valid(const talos::Function& function, const talos::RegisterAllocation& allocation, talos::RegisterFile file)
+    {
+        using Segment = talos::RegisterAllocation::Segment;
+        auto all = std::vector<Segment>{};
+        for (const auto& segments : allocation.segments) {
+            all.insert(all.end(), segments.begin(), segments.end());
+        }
+        for (std::size_t i = 0; i < all.size(); ++i) {
+            if (all[i].location == talos::RegisterAllocation::in_frame) {
+                continue;
+            }
+            EXPECT_LT(all[i].location, file.count);
+            for (std::size_t j = i + 1; j < all.size(); ++j) {
+                const auto overlap = all[i].start <= all[j].end && all[j].start <= all[i].end;
+                EXPECT_FALSE(overlap && all[i].location == all[j].location) << function.name << ": positions " << all[i].start << " and " << all[j].start;
+            }
+            for (std::size_t pc = 0; pc < function.code.size(); ++pc) {
+                const auto op = function.code[pc].op;
+                if ((op == talos::OpCode::Call || op == talos::OpCode::CopyArray) && all[i].start <= 2 * pc && 2 * pc + 1 <= all[i].end) {
+                    EXPECT_LT(all[i].location, file.preserved) << function.name << " at " << pc;
+                }
+            }
+        }
+    }
+
+    TEST(Native, EmitAssembly)
+    {
+        const auto assembly = talos::emit_assembly(compile("fun twice(a : [4]f32) : [4]f32 { return a + a; } fun main() : i32 { let s = \"hi\\n\"; return 0; }"));
+        EXPECT_NE(assembly.find("talos_start:"), std::string::npos);
+        // One symbol per function, including the initializer
+        EXPECT_NE(assembly.find("talos_fn0:"), std::string::npos);
+        EXPECT_NE(assembly.find("# fun twice\n"), std::string::npos);
+        EXPECT_NE(assembly.find("call talos_vector"), std::string::npos);
+        EXPECT_NE(assembly.find(".asciz \"hi\\012\""), std::string::npos);
+    }
+
+    TEST(Native, RegisterAllocation)
+    {
+        const auto simple = compile("fun f() : i64 { return 1; } fun main() : i64 { let a : i64 = 5; let x = a * 3; let y = x; let z = f(); return x + y + z; }");
+        const auto file = talos::RegisterFile{.count = 5, .preserved = 3};
+        const auto allocation = talos::allocate_registers(simple, simple.functions[*simple.main], file);
+        expect_valid(simple.functions[*simple.main], allocation, file);
+        EXPECT_EQ(allocation.spills, 0U);
+        EXPECT_GE(allocation.coalesced_moves, 1U);
+
+        const auto program = compile("fun f() : i64 { return 1; } "
+                                     "fun main() : i64 { let a : i64 = 5; let x = a * 3; let y = x; let z = f(); var total : i64 = 0; "
+                                     "for var i : i64 = 0; i < 10; i = i + 1 { let square = i * i; total = total + square * x + y; } return total + z; }");
+        const auto& main = program.functions[*program.main];
+        const auto loops = talos::allocate_registers(program, main, file);
+        expect_valid(main, loops, file);
+        // Registers are reused for unrelated values, each of which is allocated on its own
+        EXPECT_GT(loops.candidates, std::size_t{main.register_count});
+
+        const auto small = talos::RegisterFile{.count = 2, .preserved = 1};
+        const auto spilled = talos::allocate_registers(program, main, small);
+        expect_valid(main, spilled, small);
+        EXPECT_GT(spilled.spills, 0U);
+
+        // Without machine registers everything stays in the frame
+        const auto none = talos::allocate_registers(program, main, talos::RegisterFile{});
+        EXPECT_EQ(none.spills, none.candidates);
+        EXPECT_TRUE(none.live_in.empty());
+
+        auto with = talos::AssemblyStats{};
+        auto without = talos::AssemblyStats{};
+        static_cast<void>(talos::emit_assembly(program, {}, &with));
+        static_cast<void>(talos::emit_assembly(program, talos::AssemblyOptions{.machine_registers = 0}, &without));
+        EXPECT_LT(with.instructions, without.instructions);
+    }
+
+    TEST(Native, SameAsInterpreter)
+    {
+        if (!has_toolchain()) {
+            GTEST_SKIP() << "as and cc are unavailable";
+        }
+        // Calls, globals and integer arithmetic that wraps around
+        expect_same_exit_code("var count = 40; fun bump() : i32 { count = count + 1; return count; } var other = bump(); "
+                              "fun fib(n : i64) : i64 { if n < 2 { return n; } return fib(n - 1) + fib(n - 2); } "
+                              "fun main() : i32 { if fib(15) != 610 { return 1; } return other + bump(); }");
+        expect_same_exit_code("fun main() : i8 { let x : i8 = 100; let y : i8 = -127; let z = y - 1; return x + x - -z; }");
+        expect_same_exit_code("fun main() : i32 { let a = -7; let b = 2; let m = -1; return a / b * 10 + a % b + (a / m) * 100 + a % m; }");
+        expect_same_exit_code("fun main() : i64 { let min = -9223372036854775807i64 - 1; let m = -1i64; if min / m == min && min % m == 0 { return 3; } return 4; }");
+        // Floats, f32 rounding and NaN
+        expect_same_exit_code("fun main() : i32 { let third = 1.0 f32 / 3.0 f32; let zero = 0.0; let nan = zero / zero; var r = 0; "
+                              "if third * 3.0 f32 == 1.0 f32 { r = r + 1; } if nan < 1.0 || nan >= 1.0 || nan == nan { r = r + 2; } "
+                              "let less = nan < 1.0; let unequal = nan != nan; if !less && unequal { r = r + 4; } if -2.5 < -2.0 { r = r + 8; } return r; }");
+        // Structs returned in several registers
+        expect_same_exit_code("struct Point { x : i32, y : i32 } fun swap(p : Point) : Point { return Point(p.y, p.x); } "
+                              "fun main() : i32 { let p = swap(Point(1, 2)); return p.x * 10 + p.y; }");
+        // Arrays of every element type, global, copied, filled and elementwise
+        expect_same_exit_code("var g = [1, 10, 100]; fun scaled(v: [3]i32) : [3]i32 { return v * g; } "
+                              "fun main() : i32 { g[2] = 1000; let s = scaled([1, 2, 3]); var b = [false; 4]; b[2] = true; var c = ['a', 'b']; c[0] = c[1]; "
+                              "var total = s[0] + s[1] + s[2]; if b[2] && !b[1] && c[0] == 'b' { total = total + 1; } return total % 251; }");
+        expect_same_exit_code("fun main() : i32 { let a: [20]i8 = [100; 20]; let b = a + a; let f: [5]f32 = [1, 2, 3, 4, 5]; let h = f / [2.0 f32; 5]; "
+                              "let w: [3]i16 = [30000, 2, 3]; let x = w * w; var r = 0; if h[4] == 2.5 f32 && b[19] == -56 { r = 1; } if x[1] == 4 && x[0] == -5888 { r = r + 2; } return r; }");
+        expect_same_exit_code("fun main() : i32 { let a = [7; 9]; var b = [2; 9]; b[8] = -3; let c = a / b - a * b; return c[0] * 100 + c[8]; }");
+        expect_same_exit_code("fun main() : i32 { var total = 0; for var i = 0; i < 4; i = i + 1 { var row = [i; 4]; "
+                              "for var j = 0; j <= 3; j = j + 1 { row[j] = row[j] * j; total = total + row[j]; } } return total; }");
+        expect_same_exit_code("fun main() : i32 { let s = \"text\"; var t = \"other\"; t = s; return 5; }");
+        // Arrays of structs, element by element and a column per field
+        expect_same_exit_code("struct Point { x : i32, y : i16 } soa struct Body { mass : f32, id : i8, alive : bool, at : Point } var g = [Point(1, 2); 3]; "
+                              "fun total(b : [5]Body) : f32 { var t = 0.0 f32; for var i = 0; i < b.length; i = i + 1 { if b[i].alive { t = t + b[i].mass; } } return t; } "
+                              "fun main() : i32 { var b = [Body(1.5 f32, 1, true, Point(0, 0)); 5]; b[3] = Body(10.0 f32, 2, false, g[0]); b[4].at.y = 9; g[2].y = b[4].at.y; "
+                              "let copy = b; b[0].mass = 0.5 f32; var r = copy[3].at.x; if g[2].y == 9 { r = r + 10; } if b[3].id == 2 { r = r + 100; } if total(b) == 5.0 f32 && total(copy) == 6.0 f32 { r = r + 50; } return r; }");
+    }
+
+    TEST(Native, CompilerWithArguments)
+    {
+        if (!has_toolchain()) {
+            GTEST_SKIP() << "as and cc are unavailable";
+        }
+        // $CC may hold arguments, or a wrapper such as ccache before the compiler
+        const char* previous = std::getenv("CC");
+        const auto restore = previous != nullptr ? std::optional<std::string>{previous} : std::nullopt;
+        ::setenv("CC", " cc\t-O0  -g ", 1);
+        const auto assembly = talos::emit_assembly(compile("fun main() : i32 { return 42; }"), {});
+        const auto executable = std::filesystem::temp_directory_path() / fmt::format("talos-native-cc-{}", ::testing::UnitTest::GetInstance()->random_seed());
+        const auto status = run_native(assembly, talos::VMOptions{}, executable);
+        if (restore) {
+            ::setenv("CC", restore->c_str(), 1);
+        }
+        else {
+            ::unsetenv("CC");
+        }
+        EXPECT_EQ(status, 42);
+    }
+
+    TEST(Native, RuntimeErrors)
+    {
+        if (!has_toolchain()) {
+            GTEST_SKIP() << "as and cc are unavailable";
+        }
+        expect_same_exit_code("fun main() : i32 { let zero = 0; return 1 / zero; }");
+        expect_same_exit_code("fun main() : i32 { var a = [1, 2, 3]; var i = 2; i = i + 1; return a[i]; }");
+        expect_same_exit_code("soa struct P { x : i64, y : i8 } fun main() : i8 { var a = [P(1, 2); 3]; var i = 2; i = i + 1; return a[i].y; }");
+        expect_same_exit_code("fun main() : i32 { let a = [4; 3]; var b = [1; 3]; b[1] = 0; let c = a / b; return c[0]; }");
+        expect_same_exit_code("fun f(n : i64) : i64 { return f(n + 1); } fun main() : i64 { return f(0); }");
+        expect_same_exit_code("fun f(n : i64) : i64 { return f(n + 1); } fun main() : i64 { return f(0); }", talos::VMOptions{.stack_size = 64, .max_call_depth = 1000000});
+    }
+} // namespace
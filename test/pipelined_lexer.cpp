@@ -0,0 +1,73 @@
+#include "exceptions.h"
+#include "frontend/lexer.h"
+#include "frontend/pipelined_lexer.h"
+#include "talos.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+namespace
+{
+    // Large enough to span many batches and fill the ring several times
+    std::string repeat_source(std::string_view line, std::size_t count)
+    {
+        std::string source;
+        for (std::size_t i = 0; i < count; ++i) {
+            source += line;
+        }
+        return source;
+    }
+
+    TEST(PipelinedLexer, SameTokens)
+    {
+        const auto source = repeat_source("var x : i32 = (1 + 2.5) * 'c';\nlet y = \"s\";\n", 10000);
+        auto lexer = talos::Lexer{source};
+        auto pipelined = talos::PipelinedLexer{source};
+        for (;;) {
+            const auto expected = lexer.consume_token();
+            const auto result = pipelined.consume_token();
+            ASSERT_EQ(result.type, expected.type);
+            ASSERT_EQ(result.location, expected.location);
+            ASSERT_EQ(result.string, expected.string);
+            if (expected.type == talos::TokenType::Eof) {
+                break;
+            }
+        }
+        EXPECT_EQ(pipelined.consume_token().type, talos::TokenType::Eof);
+    }
+
+    TEST(PipelinedLexer, Error)
+    {
+        const auto source = repeat_source("a ", 5000) + "\"unterminated";
+        auto pipelined = talos::PipelinedLexer{source};
+        for (int i = 0; i < 5000; ++i) {
+            ASSERT_EQ(pipelined.consume_token().type, talos::TokenType::Identifier);
+        }
+        for (int i = 0; i < 2; ++i) {
+            try {
+                (void)pipelined.consume_token();
+                FAIL() << "Expected a lexer error";
+            } catch (const talos::TalosException& e) {
+                EXPECT_EQ(e.code(), talos::ReturnCode::UnexpectedEof);
+            }
+        }
+    }
+
+    TEST(PipelinedLexer, EarlyDestruction)
+    {
+        // The lexer thread blocks on the full ring and must still be joinable
+        const auto source = repeat_source("a ", 1000000);
+        auto pipelined = talos::PipelinedLexer{source};
+        EXPECT_EQ(pipelined.consume_token().type, talos::TokenType::Identifier);
+    }
+
+    TEST(PipelinedLexer, TalosVM)
+    {
+        auto talos_vm = talos::TalosVM{talos::VMOptions{.pipeline_lexer = true}};
+        EXPECT_TRUE(talos_vm.execute_string("fun main() : i32 { return 1 + 2; }"));
+        const auto result = talos_vm.execute_string(repeat_source("fun f() : i32 { return 1; }\n", 2000) + "fun main() : i32 { return }");
+        ASSERT_FALSE(result);
+        EXPECT_EQ(result.error().code, talos::ReturnCode::SyntaxError);
+    }
+} // namespace
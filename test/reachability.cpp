@@ -0,0 +1,113 @@
+#include "frontend/declaration_splitter.h"
+#include "frontend/lexer.h"
+#include "frontend/parser.h"
+#include "frontend/reachability.h"
+#include "talos.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+    constexpr auto library = "struct Unused { x : i32 } struct Pair { a : i32, b : i32 } "
+                             "var table = 3; var counter = 0; var initialized = bump(); var quotient = 10 / table; var spare = table + 1; "
+                             "fun bump() : i32 { counter = counter + 1; return counter; } "
+                             "fun helper(p : Pair) : i32 { return p.a + table; } "
+                             "fun unused() : i32 { return unused_too(); } fun unused_too() : i32 { return 1; } "
+                             "fun exported() : i32 { return 2; } "
+                             "fun main() : i32 { return helper(Pair(1, 2)) + counter; }";
+
+    // Names of the reachable declarations of source, as found from the
+    // parsed statements and from their tokens
+    std::vector<std::string> reachable(std::string_view source, const std::vector<std::string>& entry_points = {})
+    {
+        auto lexer = talos::Lexer{source};
+        auto parser = talos::Parser{&lexer};
+        const auto program = parser.parse();
+        auto uses = std::vector<talos::DeclarationUses>{};
+        for (const auto& statement : program.statements()) {
+            uses.push_back(talos::declaration_uses(*statement));
+        }
+
+        auto token_lexer = talos::Lexer{source};
+        auto splitter = talos::DeclarationSplitter{token_lexer};
+        auto token_uses = std::vector<talos::DeclarationUses>{};
+        for (auto declaration = talos::DeclarationTokens{}; splitter.next(declaration);) {
+            token_uses.push_back(talos::declaration_uses(declaration));
+        }
+
+        const auto from_statements = talos::reachable_declarations(uses, entry_points);
+        const auto from_tokens = talos::reachable_declarations(token_uses, entry_points);
+        EXPECT_EQ(from_statements, from_tokens) << source;
+        auto names = std::vector<std::string>{};
+        for (std::size_t i = 0; i < uses.size(); ++i) {
+            if (from_statements[i]) {
+                names.emplace_back(uses[i].name);
+            }
+        }
+        return names;
+    }
+
+    talos::VMReturn run(std::string_view source, talos::Pruning prune, std::vector<std::string> entry_points = {})
+    {
+        auto vm = talos::TalosVM{talos::VMOptions{.collect_stats = true, .run = true, .prune = prune, .entry_points = std::move(entry_points)}};
+        return vm.execute_string(source);
+    }
+
+    TEST(Reachability, Declarations)
+    {
+        // Globals whose initializers call or divide are kept with what they use
+        EXPECT_EQ(reachable(library), (std::vector<std::string>{"Pair", "table", "counter", "initialized", "quotient", "bump", "helper", "main"}));
+        EXPECT_EQ(reachable(library, {"exported", "unused"}).size(), 11U);
+        // Without main or entry points only the roots are kept
+        EXPECT_EQ(reachable("var a = 1; var b = a; fun f() : i32 { return b; }"), std::vector<std::string>{});
+        // Top-level statements always run
+        EXPECT_EQ(reachable("var a = 1; fun f() : i32 { return a; } f();"), (std::vector<std::string>{"a", "f", ""}));
+        // Every declaration of a name is kept, so that redefinitions are still reported
+        EXPECT_EQ(reachable("fun f() : i32 { return 1; } fun f() : i32 { return 2; } fun main() : i32 { return f(); }").size(), 3U);
+    }
+
+    TEST(Reachability, Pruning)
+    {
+        for (const auto prune : {talos::Pruning::None, talos::Pruning::Unreachable, talos::Pruning::BeforeParsing}) {
+            const auto result = run(library, prune);
+            ASSERT_TRUE(result) << result.error().description;
+            // bump ran once in the initializer
+            EXPECT_EQ(result->main_result, 1 + 3 + 1);
+            const auto kept = prune == talos::Pruning::None ? 6U : 3U;
+            EXPECT_EQ(result->functions.size(), kept);
+            if constexpr (talos::stats_enabled) {
+                EXPECT_EQ(result->stats.functions_pruned, 6U - kept);
+                EXPECT_EQ(result->stats.structs_pruned, prune == talos::Pruning::None ? 0U : 1U);
+                EXPECT_EQ(result->stats.globals_pruned, prune == talos::Pruning::None ? 0U : 1U);
+            }
+        }
+        const auto exported = run(library, talos::Pruning::Unreachable, {"exported"});
+        ASSERT_TRUE(exported);
+        EXPECT_EQ(exported->functions.size(), 4U);
+    }
+
+    TEST(Reachability, Errors)
+    {
+        // Type errors in unreachable functions are only reported without pruning
+        constexpr auto type_error = "fun broken() : i32 { return true; } fun main() : i32 { return 0; }";
+        EXPECT_EQ(run(type_error, talos::Pruning::None).error().code, talos::ReturnCode::TypeError);
+        EXPECT_TRUE(run(type_error, talos::Pruning::Unreachable));
+        EXPECT_TRUE(run(type_error, talos::Pruning::BeforeParsing));
+        EXPECT_EQ(run(type_error, talos::Pruning::Unreachable, {"broken"}).error().code, talos::ReturnCode::TypeError);
+
+        // Syntax errors only when all of the program is parsed
+        constexpr auto syntax_error = "fun broken() : i32 { return 1 +; } fun main() : i32 { return 0; }";
+        EXPECT_FALSE(run(syntax_error, talos::Pruning::Unreachable));
+        EXPECT_TRUE(run(syntax_error, talos::Pruning::BeforeParsing));
+
+        // Failing initializers still fail
+        EXPECT_EQ(run("var zero = 0; var never = 1 / zero; fun main() : i32 { return 0; }", talos::Pruning::BeforeParsing).error().code,
+                  talos::ReturnCode::DivisionByZero);
+        // And uses of missing declarations are reported
+        EXPECT_FALSE(run("fun main() : i32 { return missing(); }", talos::Pruning::BeforeParsing));
+    }
+} // namespace
@@ -0,0 +1,90 @@
+#include "exceptions.h"
+#include "frontend/lexer.h"
+#include "frontend/streaming_lexer.h"
+#include "talos.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <memory>
+#include <string>
+
+namespace
+{
+    using FilePtr = std::unique_ptr<std::FILE, decltype(&std::fclose)>;
+
+    FilePtr make_file(std::string_view contents)
+    {
+        auto file = FilePtr{std::tmpfile(), &std::fclose};
+        std::fwrite(contents.data(), 1, contents.size(), file.get());
+        std::rewind(file.get());
+        return file;
+    }
+
+    constexpr auto source = "fun main() : i32 {\n"
+                            "\tvar s : MyType = \"a string with  spaces\tand tabs, \\\"escaped quotes\\\" \\\\\";\n"
+                            "\tlet c = ' ';\n"
+                            "  let d = 'x'; 1234567 + 3.14159 * identifier_name;\n"
+                            "  return 42;\n"
+                            "}\n";
+
+    TEST(StreamingLexer, SameTokens)
+    {
+        // Small chunks put every token and literal across a chunk boundary
+        for (const std::size_t chunk_size : {1, 2, 3, 7, 64, 4096}) {
+            const auto file = make_file(source);
+            auto streaming = talos::StreamingLexer{file.get(), chunk_size};
+            auto lexer = talos::Lexer{source};
+            for (;;) {
+                const auto expected = lexer.consume_token();
+                const auto result = streaming.consume_token();
+                ASSERT_EQ(result.type, expected.type) << "chunk size " << chunk_size;
+                ASSERT_EQ(result.location, expected.location) << "chunk size " << chunk_size;
+                ASSERT_EQ(result.string, expected.string) << "chunk size " << chunk_size;
+                if (expected.type == talos::TokenType::Eof) {
+                    break;
+                }
+            }
+            EXPECT_EQ(streaming.consume_token().type, talos::TokenType::Eof);
+        }
+    }
+
+    TEST(StreamingLexer, Error)
+    {
+        const auto file = make_file("let a = 1;\nlet b = \"unterminated string");
+        auto streaming = talos::StreamingLexer{file.get(), 4};
+        for (int i = 0; i < 8; ++i) {
+            (void)streaming.consume_token();
+        }
+        try {
+            (void)streaming.consume_token();
+            FAIL() << "Expected a lexer error";
+        } catch (const talos::TalosException& e) {
+            EXPECT_EQ(e.code(), talos::ReturnCode::UnexpectedEof);
+            EXPECT_EQ(e.location(), (talos::SourceLocation{2, 9}));
+        }
+    }
+
+    TEST(StreamingLexer, ReleaseConsumed)
+    {
+        std::string contents;
+        for (int i = 0; i < 1000; ++i) {
+            contents += "let a = 1;\n";
+        }
+        const auto file = make_file(contents);
+        auto streaming = talos::StreamingLexer{file.get(), 256};
+        std::size_t peak = 0;
+        while (streaming.consume_token().type != talos::TokenType::Eof) {
+            streaming.release_consumed();
+            peak = std::max(peak, streaming.resident_bytes());
+        }
+        EXPECT_LE(peak, 512);
+    }
+
+    TEST(StreamingLexer, TalosVM)
+    {
+        const auto file = make_file(source);
+        auto talos_vm = talos::TalosVM{};
+        EXPECT_TRUE(talos_vm.execute_stream(file.get()));
+    }
+} // namespace
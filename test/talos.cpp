@@ -1,7 +1,14 @@
+#include "frontend/ast.h"
+#include "frontend/node_counter.h"
 #include "talos.h"
 
 #include <gtest/gtest.h>
 
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
 namespace
 {
     TEST(TalosVM, File)
@@ -15,4 +22,153 @@ namespace
             EXPECT_EQ(error.code, talos::ReturnCode::FileNotFound);
         }
     }
+
+    TEST(TalosVM, Stats)
+    {
+        if (!talos::stats_enabled) {
+            GTEST_SKIP() << "Built without TALOS_STATS";
+        }
+
+        // Collection is opt-in
+        {
+            auto vm = talos::TalosVM{};
+            const auto result = vm.execute_string("1 + 2;");
+            ASSERT_TRUE(result);
+            EXPECT_EQ(result->stats.tokens, 0);
+        }
+
+        {
+            auto vm = talos::TalosVM{talos::VMOptions{.collect_stats = true}};
+            const auto result = vm.execute_string("fun main() : i32 { return 1 + 2; }");
+            ASSERT_TRUE(result);
+            const auto& stats = result->stats;
+            EXPECT_EQ(stats.tokens, 14); // Including Eof
+            EXPECT_EQ(stats.nodes[static_cast<std::size_t>(talos::NodeKind::FunDeclStatement)], 1);
+            EXPECT_EQ(stats.nodes[static_cast<std::size_t>(talos::NodeKind::BinaryExpr)], 1);
+            EXPECT_EQ(stats.nodes[static_cast<std::size_t>(talos::NodeKind::IntLiteralExpr)], 2);
+            EXPECT_GT(stats.peak_rss, 0);
+        }
+    }
+
+    TEST(TalosVM, Signatures)
+    {
+        constexpr auto source = "fun f() : i64 { return 1; } var x = 2; fun main() { return 0; }";
+        for (const auto per_function : {false, true}) {
+            auto vm = talos::TalosVM{talos::VMOptions{.per_function = per_function}};
+            const auto result = vm.execute_string(source);
+            ASSERT_TRUE(result);
+            const auto& functions = result->functions;
+            ASSERT_EQ(functions.size(), 2);
+            EXPECT_EQ(functions[0].name, "f");
+            EXPECT_EQ(functions[0].return_type, "Int64");
+            EXPECT_EQ(functions[0].location, (talos::SourceLocation{1, 5}));
+            EXPECT_EQ(functions[1].name, "main");
+            EXPECT_EQ(functions[1].return_type, "Inferred");
+        }
+    }
+
+    TEST(TalosVM, PerFunctionMemory)
+    {
+        if (!talos::stats_enabled) {
+            GTEST_SKIP() << "Built without TALOS_STATS";
+        }
+
+        std::string source;
+        for (int i = 0; i < 1000; ++i) {
+            source += "fun f() : i32 { var a = 1 + 2 * 3; return a; }\n";
+        }
+        const auto file = std::unique_ptr<std::FILE, decltype(&std::fclose)>{std::tmpfile(), &std::fclose};
+        std::fwrite(source.data(), 1, source.size(), file.get());
+
+        auto run = [&](bool per_function) {
+            std::rewind(file.get());
+            auto vm = talos::TalosVM{talos::VMOptions{
+                .collect_stats = true,
+                .stream_chunk_size = 1024,
+                .per_function = per_function,
+            }};
+            const auto result = vm.execute_stream(file.get());
+            EXPECT_TRUE(result);
+            return result->stats;
+        };
+
+        const auto whole = run(false);
+        const auto per_function = run(true);
+        EXPECT_EQ(per_function.tokens, whole.tokens);
+        EXPECT_EQ(talos::total_nodes(per_function.nodes) + 1, talos::total_nodes(whole.nodes)); // No Program node
+        EXPECT_EQ(whole.peak_ast_nodes, talos::total_nodes(whole.nodes));
+        EXPECT_EQ(per_function.peak_ast_nodes, 9);
+        EXPECT_GE(whole.peak_source_bytes, source.size());
+        EXPECT_LE(per_function.peak_source_bytes, 4096);
+    }
+
+    std::string repeat(std::string_view string, int count)
+    {
+        std::string repeated;
+        for (int i = 0; i < count; ++i) {
+            repeated += string;
+        }
+        return repeated;
+    }
+
+    std::vector<std::string> nested_programs(int depth)
+    {
+        return {
+            repeat("(", depth) + "1" + repeat(")", depth) + ";",
+            repeat("- ", depth) + "x;",
+            "1" + repeat(" + 2 * 3", depth / 2) + ";",
+            repeat("a = ", depth) + "1;",
+            repeat("fun f() { ", depth) + repeat("}", depth),
+            // Binary chains inside parentheses count towards the same limit
+            repeat("(", depth / 2) + "1" + repeat(" - 1", depth / 2) + repeat(")", depth / 2) + ";",
+        };
+    }
+
+    TEST(TalosVM, DeepNesting)
+    {
+        const auto file = std::unique_ptr<std::FILE, decltype(&std::fclose)>{std::tmpfile(), &std::fclose};
+        for (const auto& program : nested_programs(talos::VMOptions::default_max_nesting_depth - 8)) {
+            for (const auto format : {talos::DumpFormat::Text, talos::DumpFormat::Json, talos::DumpFormat::Binary}) {
+                auto vm = talos::TalosVM{talos::VMOptions{.dump_ast = format, .dump_output = file.get()}};
+                EXPECT_TRUE(vm.execute_string(program)) << program.substr(0, 20);
+            }
+        }
+
+        // Far too deep for the stack, but rejected before it runs out
+        for (const auto& program : nested_programs(100'000)) {
+            auto vm = talos::TalosVM{};
+            const auto result = vm.execute_string(program);
+            ASSERT_FALSE(result) << program.substr(0, 20);
+            EXPECT_EQ(result.error().code, talos::ReturnCode::NestingTooDeep);
+        }
+    }
+
+    TEST(TalosVM, MaxNestingDepth)
+    {
+        for (const auto& program : nested_programs(20)) {
+            auto shallow = talos::TalosVM{talos::VMOptions{.max_nesting_depth = 10}};
+            const auto result = shallow.execute_string(program);
+            ASSERT_FALSE(result) << program;
+            EXPECT_EQ(result.error().code, talos::ReturnCode::NestingTooDeep);
+
+            auto deep = talos::TalosVM{talos::VMOptions{.max_nesting_depth = 30}};
+            EXPECT_TRUE(deep.execute_string(program)) << program;
+        }
+    }
+
+    TEST(AST, DeepTreeDestruction)
+    {
+        // Deeper than the stack allows destroying recursively
+        constexpr auto depth = 1'000'000;
+        auto expr = talos::ExprPtr{std::make_unique<talos::IntLiteralExpr>(talos::Token{}, std::nullopt)};
+        for (int i = 0; i < depth; ++i) {
+            if (i % 2 == 0) {
+                expr = std::make_unique<talos::UnaryExpr>(talos::Token{}, std::move(expr));
+            }
+            else {
+                expr = std::make_unique<talos::BinaryExpr>(std::move(expr), talos::Token{}, std::make_unique<talos::ParenExpr>(nullptr));
+            }
+        }
+        expr.reset();
+    }
 } // namespace
@@ -0,0 +1,87 @@
+#include "trace.h"
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+namespace
+{
+    std::string read_file(const std::filesystem::path& path)
+    {
+        auto file = std::ifstream{path};
+        std::stringstream sstream;
+        sstream << file.rdbuf();
+        return std::move(sstream).str();
+    }
+
+    TEST(Trace, ChromeJson)
+    {
+        const auto path = std::filesystem::temp_directory_path() / "talos_trace_test.json";
+        talos::trace::start();
+        talos::trace::set_thread_name("test main");
+        {
+            const auto scope = talos::trace::Scope{"outer"};
+            auto worker = std::thread{[]() {
+                talos::trace::set_thread_name("test worker");
+                const auto scope = talos::trace::Scope{"worker"};
+            }};
+            worker.join();
+        }
+        ASSERT_TRUE(talos::trace::stop(path.string()));
+
+        const auto json = read_file(path);
+        std::filesystem::remove(path);
+        EXPECT_TRUE(json.starts_with(R"({"displayTimeUnit":"ns","traceEvents":[)"));
+        EXPECT_NE(json.find(R"("args":{"name":"test main"})"), std::string::npos);
+        EXPECT_NE(json.find(R"("args":{"name":"test worker"})"), std::string::npos);
+        EXPECT_NE(json.find(R"({"name":"outer","ph":"B")"), std::string::npos);
+        EXPECT_NE(json.find(R"({"name":"outer","ph":"E")"), std::string::npos);
+        EXPECT_NE(json.find(R"({"name":"worker","ph":"B")"), std::string::npos);
+        EXPECT_NE(json.find(R"({"name":"worker","ph":"E")"), std::string::npos);
+    }
+
+    TEST(Trace, ReusesBuffers)
+    {
+        // Threads started one after another, as PipelinedLexer does for every
+        // execution, share one buffer and their events are still written
+        const auto path = std::filesystem::temp_directory_path() / "talos_trace_reuse.json";
+        talos::trace::start();
+        const auto record = [] {
+            talos::trace::set_thread_name("short lived");
+            const auto scope = talos::trace::Scope{"short"};
+        };
+        std::thread{record}.join();
+        const auto allocated = talos::trace::allocated_buffers();
+        for (int i = 0; i < 20; ++i) {
+            std::thread{record}.join();
+        }
+        EXPECT_EQ(talos::trace::allocated_buffers(), allocated);
+        ASSERT_TRUE(talos::trace::stop(path.string()));
+
+        const auto json = read_file(path);
+        std::filesystem::remove(path);
+        auto begins = 0;
+        for (auto at = json.find(R"({"name":"short","ph":"B")"); at != std::string::npos; at = json.find(R"({"name":"short","ph":"B")", at + 1)) {
+            ++begins;
+        }
+        EXPECT_EQ(begins, 21);
+        EXPECT_NE(json.find(R"("args":{"name":"short lived"})"), std::string::npos);
+    }
+
+    TEST(Trace, Inactive)
+    {
+        // Scopes outside of start/stop are not recorded
+        {
+            const auto scope = talos::trace::Scope{"ignored"};
+        }
+        const auto path = std::filesystem::temp_directory_path() / "talos_trace_inactive.json";
+        talos::trace::start();
+        ASSERT_TRUE(talos::trace::stop(path.string()));
+        const auto json = read_file(path);
+        std::filesystem::remove(path);
+        EXPECT_EQ(json.find("ignored"), std::string::npos);
+    }
+} // namespace
@@ -0,0 +1,95 @@
+#include "vm/value.h"
+#include "vm/vector_kernels.h"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace
+{
+    using talos::OpCode;
+    using talos::Type;
+    using talos::VectorIsa;
+
+    // Not a multiple of any vector width, so every kernel also has a tail
+    constexpr std::size_t length = 37;
+
+    template<typename T>
+    std::vector<std::byte> elements(T first, T step)
+    {
+        auto bytes = std::vector<std::byte>(length * sizeof(T));
+        auto value = first;
+        for (std::size_t i = 0; i < length; ++i) {
+            talos::store_bytes(bytes.data() + (i * sizeof(T)), value);
+            value = static_cast<T>(value + step);
+        }
+        return bytes;
+    }
+
+    // Every instruction set the running CPU supports gives the results of the
+    // scalar loop
+    template<typename T>
+    void expect_same(Type type, T first, T step)
+    {
+        const auto lhs = elements<T>(first, step);
+        const auto rhs = elements<T>(static_cast<T>(step + 1), step);
+        for (const auto op : {OpCode::Add, OpCode::Subtract, OpCode::Multiply, OpCode::Divide}) {
+            auto expected = std::vector<std::byte>(lhs.size());
+            ASSERT_TRUE(talos::vector_arithmetic(op, type, expected.data(), lhs.data(), rhs.data(), length, VectorIsa::Scalar));
+            for (const auto isa : {VectorIsa::Sse2, VectorIsa::Avx2}) {
+                if (isa > talos::vector_isa()) {
+                    continue;
+                }
+                auto result = std::vector<std::byte>(lhs.size());
+                ASSERT_TRUE(talos::vector_arithmetic(op, type, result.data(), lhs.data(), rhs.data(), length, isa));
+                EXPECT_EQ(result, expected) << talos::format_as(isa) << ' ' << static_cast<int>(op) << ' ' << talos::format_as(type);
+            }
+        }
+    }
+
+    TEST(VectorKernels, SameAsScalar)
+    {
+        expect_same<std::int8_t>(Type::Int8, -100, 7);
+        expect_same<std::int16_t>(Type::Int16, -30000, 1234);
+        expect_same<std::int32_t>(Type::Int32, -5, 3);
+        expect_same<std::int64_t>(Type::Int64, std::numeric_limits<std::int64_t>::max() - 40, 1);
+        expect_same<float>(Type::Float32, -2.5F, 0.75F);
+        expect_same<double>(Type::Float64, 1.0, -0.125);
+    }
+
+    TEST(VectorKernels, Wraps)
+    {
+        const auto lhs = elements<std::int8_t>(100, 0);
+        auto result = std::vector<std::byte>(lhs.size());
+        ASSERT_TRUE(talos::vector_arithmetic(OpCode::Add, Type::Int8, result.data(), lhs.data(), lhs.data(), length));
+        EXPECT_EQ(talos::load_bytes<std::int8_t>(result.data()), -56);
+        EXPECT_EQ(talos::load_bytes<std::int8_t>(result.data() + length - 1), -56);
+    }
+
+    TEST(VectorKernels, InPlace)
+    {
+        auto values = elements<float>(1.0F, 1.0F);
+        ASSERT_TRUE(talos::vector_arithmetic(OpCode::Multiply, Type::Float32, values.data(), values.data(), values.data(), length));
+        EXPECT_EQ(talos::load_bytes<float>(values.data() + (36 * sizeof(float))), 37.0F * 37.0F);
+    }
+
+    TEST(VectorKernels, DivideByZero)
+    {
+        const auto lhs = elements<std::int32_t>(10, 1);
+        auto rhs = elements<std::int32_t>(1, 0);
+        talos::store_bytes(rhs.data() + (20 * sizeof(std::int32_t)), std::int32_t{0});
+        auto result = std::vector<std::byte>(lhs.size());
+        EXPECT_FALSE(talos::vector_arithmetic(OpCode::Divide, Type::Int32, result.data(), lhs.data(), rhs.data(), length));
+
+        // Floats divide to infinity instead
+        const auto ones = elements<double>(1.0, 0.0);
+        const auto zeros = elements<double>(0.0, 0.0);
+        auto quotients = std::vector<std::byte>(ones.size());
+        EXPECT_TRUE(talos::vector_arithmetic(OpCode::Divide, Type::Float64, quotients.data(), ones.data(), zeros.data(), length));
+        EXPECT_EQ(talos::load_bytes<double>(quotients.data()), std::numeric_limits<double>::infinity());
+    }
+} // namespace
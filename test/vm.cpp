@@ -0,0 +1,453 @@
+#include "frontend/lexer.h"
+#include "frontend/parser.h"
+#include "talos.h"
+#include "vm/codegen.h"
+#include "vm/interpreter.h"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <string>
+#include <string_view>
+
+namespace
+{
+    talos::Program compile(std::string_view source)
+    {
+        auto lexer = talos::Lexer{source};
+        auto parser = talos::Parser{&lexer};
+        const auto program = parser.parse();
+        return talos::compile_program(program);
+    }
+
+    talos::VMReturn run(std::string_view source, talos::VMOptions options = {})
+    {
+        options.run = true;
+        auto vm = talos::TalosVM{options};
+        return vm.execute_string(source);
+    }
+
+    std::int64_t main_result(std::string_view source)
+    {
+        const auto result = run(source);
+        EXPECT_TRUE(result) << result.error().description;
+        return result && result->main_result ? *result->main_result : -1;
+    }
+
+    talos::ReturnCode error_code(std::string_view source)
+    {
+        const auto result = run(source);
+        EXPECT_FALSE(result);
+        return result ? talos::ReturnCode::Ok : result.error().code;
+    }
+
+    TEST(VM, Calls)
+    {
+        EXPECT_EQ(main_result("fun add(a : i32, b : i32) : i32 { return a + b; } fun main() : i32 { return add(2, 3) * 2; }"), 10);
+        // Arguments that are calls themselves
+        EXPECT_EQ(main_result("fun sub(a : i32, b : i32) : i32 { return a - b; } fun main() : i32 { return sub(sub(10, 3), sub(2, 1)); }"), 6);
+        // Functions may be called before their declaration and infer their return type
+        EXPECT_EQ(main_result("fun main() : i64 { var x = twice(4); x = x + 1; return x; } fun twice(n : i64) { return n * 2; }"), 9);
+        // Nested functions
+        EXPECT_EQ(main_result("fun main() : i32 { fun one() : i32 { return 1; } return one() + one(); }"), 2);
+        // Without main nothing runs
+        const auto result = run("fun f() : i32 { return 1; }");
+        ASSERT_TRUE(result);
+        EXPECT_FALSE(result->main_result);
+    }
+
+    TEST(VM, Globals)
+    {
+        // Globals are initialized in source order before main runs
+        EXPECT_EQ(main_result("var count = 40; fun bump() : i32 { count = count + 1; return count; } var other = bump(); fun main() : i32 { return other + bump(); }"), 83);
+        // and can be used by functions declared before them
+        EXPECT_EQ(main_result("fun main() : i32 { return limit; } let limit = 7;"), 7);
+    }
+
+    TEST(VM, Arithmetic)
+    {
+        // Integers wrap around at the width of their type
+        EXPECT_EQ(main_result("fun main() : i8 { let x : i8 = 100; return x + x; }"), -56);
+        EXPECT_EQ(main_result("fun main() : i32 { return -7 / 2; }"), -3);
+        // Unsuffixed literals take the type of the other operand
+        EXPECT_EQ(main_result("fun main() : i64 { let x = 3000000000i64; return x * 2 - x; }"), 3000000000);
+
+        const auto program = compile("fun half(x : f64) : f64 { return x / 2; } fun third(x : f32) { return x / 3; }");
+        const auto arguments = std::array{talos::Value::of_floating(talos::Type::Float64, 5.0)};
+        auto interpreter = talos::Interpreter{};
+        EXPECT_EQ(interpreter.call(program, 1, arguments), talos::Value::of_floating(talos::Type::Float64, 2.5));
+        const auto single = std::array{talos::Value::of_floating(talos::Type::Float32, 1.0)};
+        EXPECT_EQ(interpreter.call(program, 2, single), talos::Value::of_floating(talos::Type::Float32, static_cast<double>(1.0F / 3.0F)));
+    }
+
+    TEST(VM, ControlFlow)
+    {
+        constexpr auto sign = "fun sign(x : i32) : i32 { if x < 0 { return -1; } else if x == 0 { return 0; } return 1; } ";
+        EXPECT_EQ(main_result(std::string{sign} + "fun main() : i32 { return sign(-5) * 100 + sign(0) * 10 + sign(7); }"), -99);
+        // Comparisons of every type, and as values
+        EXPECT_EQ(main_result("fun main() : i32 { let b = 2.5 >= 2.5 && 'a' < 'b' && true != false && 3i8 > -3i8; if b { return 1; } return 0; }"), 1);
+        // NaN is unordered
+        EXPECT_EQ(main_result("fun main() : i32 { let zero = 0.0; let nan = zero / zero; if nan < 1.0 || nan >= 1.0 || nan == nan { return 1; } return 0; }"), 0);
+        // The right operand of a logical operator only runs if it decides the result
+        EXPECT_EQ(main_result("var calls = 0; fun t() : bool { calls = calls + 1; return true; } "
+                              "fun main() : i32 { let a = false && t(); let b = true || t(); let c = true && t(); if !a && b && c { return calls; } return -1; }"),
+                  1);
+        EXPECT_EQ(main_result("fun main() : i32 { return 17 % 5 + -7 % 2 * 10; }"), -8);
+        EXPECT_EQ(error_code("fun main() : i32 { let zero = 0; return 1 % zero; }"), talos::ReturnCode::DivisionByZero);
+    }
+
+    TEST(VM, Loops)
+    {
+        EXPECT_EQ(main_result("fun main() : i64 { var total : i64 = 0; for var i : i64 = 1; i <= 100; i = i + 1 { total = total + i; } return total; }"), 5050);
+        EXPECT_EQ(main_result("fun main() : i32 { var n = 27; var steps = 0; while n != 1 { if n % 2 == 0 { n = n / 2; } else { n = 3 * n + 1; } steps = steps + 1; } return steps; }"), 111);
+        // Nested loops, with invariant values and products of the induction variable
+        EXPECT_EQ(main_result("fun main() : i32 { var total = 0; let k = 3; for var i = 0; i < 10; i = i + 2 { for var j = 10; j > 0; j = j - 1 { total = total + i * 3 + j * 2 + k * k; } } return total; }"),
+                  1600);
+        // Loops without a condition end by returning
+        EXPECT_EQ(main_result("fun main() : i32 { var i = 0; for ;; { i = i + 1; if i * i > 50 { return i; } } }"), 8);
+        EXPECT_EQ(main_result("fun main() : i32 { var i = 0; while true { i = i + 1; if i == 5 { return i; } } }"), 5);
+        // An invariant division by zero only fails if the loop runs
+        EXPECT_EQ(main_result("fun main() : i32 { var x = 0; let zero = 0; while x > 0 { x = 10 / zero; } return x; }"), 0);
+        // Blocks scope their variables and top-level control flow runs in the initializer
+        EXPECT_EQ(main_result("var total = 0; for var i = 0; i < 4; i = i + 1 { let twice = i * 2; total = total + twice; } { let x = 1; total = total + x; } fun main() : i32 { return total; }"), 13);
+    }
+
+    TEST(VM, ControlFlowErrors)
+    {
+        EXPECT_EQ(error_code("fun main() : i32 { if 1 { return 1; } return 0; }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code("fun main() : i32 { while 1.5 { } return 0; }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code("fun main() : i32 { return 1 && true; }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code("fun main() : i32 { return true < false; }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code("fun main() : f64 { return 2.5 % 2.0; }"), talos::ReturnCode::TypeError);
+        // Every path must return a value
+        EXPECT_EQ(error_code("fun main() : i32 { let x = 1; if x > 0 { return 1; } }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code("fun main() : i32 { let x = 1; while x > 0 { return 1; } }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(main_result("fun main() : i32 { let x = 1; if x > 0 { return 1; } else { return 2; } }"), 1);
+        // Variables of a block end with it
+        EXPECT_EQ(error_code("fun main() : i32 { { let x = 1; } return x; }"), talos::ReturnCode::UndefinedName);
+        EXPECT_EQ(error_code("fun main() : i32 { for var i = 0; i < 1; i = i + 1 { } return i; }"), talos::ReturnCode::UndefinedName);
+        EXPECT_EQ(error_code("if true { return 1; }"), talos::ReturnCode::TypeError);
+    }
+
+    TEST(VM, TypeErrors)
+    {
+        EXPECT_EQ(error_code("fun main() : i32 { return y; }"), talos::ReturnCode::UndefinedName);
+        EXPECT_EQ(error_code("fun f(a : i32) : i32 { return a; } fun main() : i32 { return f(1, 2); }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code("fun f(a : i32) : i32 { return a; } fun main() : i32 { return f(1.5); }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code("fun f(a : i32) : i32 { return a; } fun main() : i64 { return f(1); }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code("fun f(a : i32) { a = 2; }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code("let x = 1; fun main() { x = 2; }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code("let x = 1; fun main() { x(); }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code("fun f() { return f(); }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code("fun main(argc : i32) : i32 { return argc; }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code("fun f() : i32 { 1; }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code("fun f() {} var f = 1;"), talos::ReturnCode::Redefinition);
+        EXPECT_EQ(error_code("fun f(a : i32, a : i32) {}"), talos::ReturnCode::Redefinition);
+        // Locals of the enclosing function are not visible in nested functions
+        EXPECT_EQ(error_code("fun f() { let x = 1; fun g() : i32 { return x; } }"), talos::ReturnCode::UndefinedName);
+    }
+
+    // Literals must be values of the type their context gives them
+    TEST(VM, LiteralRanges)
+    {
+        EXPECT_EQ(main_result("fun main() : i8 { let x : i8 = 127; let y : i8 = -128; return x + y; }"), -1);
+        EXPECT_EQ(main_result("fun main() : i8 { return -128i8; }"), -128);
+        EXPECT_EQ(main_result("fun main() : i16 { let x : i16 = -32768; return x + 32767i16; }"), -1);
+        EXPECT_EQ(main_result("fun main() : i32 { let x = 2147483647; let y = -2147483648; return x + y; }"), -1);
+        EXPECT_EQ(main_result("fun main() : i64 { let x : i64 = 2147483648; return x; }"), 2147483648);
+        EXPECT_EQ(error_code("fun main() { var x : i8 = 300; }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code("fun main() { var x : i8 = 128; }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code("fun main() { var x : i8 = -129; }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code("fun main() { let x = 300i8; }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code("fun main() { let x = -129i8; }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code("fun main() { var x : i16 = 32768; }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code("fun main() { var x : i16 = -32769; }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code("fun main() { let x = 40000i16; }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code("fun main() { let x = 2147483648; }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code("fun main() { let x = -2147483649; }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code("fun main() { let x = 3000000000i32; }"), talos::ReturnCode::TypeError);
+        // In arithmetic, and in arrays
+        EXPECT_EQ(error_code("fun main() { var x : i8 = 1; x = x + 200; }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code("fun main() { let a : [2]i8 = [1, 255]; }"), talos::ReturnCode::TypeError);
+    }
+
+    TEST(VM, RuntimeErrors)
+    {
+        EXPECT_EQ(error_code("fun main() : i32 { let zero = 0; return 1 / zero; }"), talos::ReturnCode::DivisionByZero);
+
+        constexpr auto recursive = "fun f(n : i64) : i64 { return f(n + 1); } fun main() : i64 { return f(0); }";
+        EXPECT_EQ(error_code(recursive), talos::ReturnCode::StackOverflow);
+        const auto result = run(recursive, talos::VMOptions{.stack_size = 64, .max_call_depth = 1000000});
+        ASSERT_FALSE(result);
+        EXPECT_EQ(result.error().code, talos::ReturnCode::StackOverflow);
+    }
+
+    TEST(VM, Disassemble)
+    {
+        const auto program = compile("var g = 1; fun add(a : i32, b : i32) : i32 { let c = a + b; return c * g; } fun main() : i32 { return add(2, 3); }");
+        EXPECT_EQ(talos::disassemble(program),
+                  "fun <init> (0 parameters, 1 registers)\n"
+                  "     0  LoadConst   r0, 1\n"
+                  "     1  StoreGlobal g0, r0\n"
+                  "     2  ReturnVoid\n"
+                  "fun add (2 parameters, 4 registers)\n"
+                  "     0  Add         r2, r0, r1\n"
+                  "     1  LoadGlobal  r3, g0\n"
+                  "     2  Multiply    r3, r2, r3\n"
+                  "     3  Return      r3\n"
+                  "fun main (0 parameters, 2 registers)\n"
+                  "     0  LoadConst   r0, 2\n"
+                  "     1  LoadConst   r1, 3\n"
+                  "     2  Call        r0, add, 2\n"
+                  "     3  Return      r0\n");
+    }
+    TEST(VM, DisassembleLoop)
+    {
+        // k * 2 is computed once and i * 4 stepped by 4, the loop is entered at
+        // its condition, which is fused with the jump back
+        const auto program = compile("fun f(n : i32, k : i32) : i32 { var total = 0; for var i = 0; i < n; i = i + 1 { total = total + i * 4 + k * 2; } return total; }");
+        EXPECT_EQ(talos::disassemble(program),
+                  "fun <init> (0 parameters, 1 registers)\n"
+                  "     0  ReturnVoid\n"
+                  "fun f (2 parameters, 9 registers)\n"
+                  "     0  LoadConst   r2, 0\n"
+                  "     1  LoadConst   r3, 0\n"
+                  "     2  LoadConst   r4, 1\n"
+                  "     3  LoadConst   r6, 2\n"
+                  "     4  Multiply    r5, r1, r6\n"
+                  "     5  LoadConst   r7, 4\n"
+                  "     6  Multiply    r6, r3, r7\n"
+                  "     7  LoadConst   r7, 4\n"
+                  "     8  Jump        13\n"
+                  "     9  Add         r8, r2, r6\n"
+                  "    10  Add         r2, r8, r5\n"
+                  "    11  Add         r3, r3, r4\n"
+                  "    12  Add         r6, r6, r7\n"
+                  "    13  JumpIfLess  r3, r0, 9\n"
+                  "    14  Return      r2\n");
+    }
+
+    TEST(VM, Structs)
+    {
+        constexpr auto point = "struct Point { x : i32, y : i32 } ";
+        EXPECT_EQ(main_result(std::string{point} + "fun main() : i32 { var p = Point(1, 2); p.x = p.x + 10; return p.x * 10 + p.y; }"), 112);
+        // Structs are values, copies are independent
+        EXPECT_EQ(main_result(std::string{point} + "fun main() : i32 { var p = Point(1, 2); var q = p; q.x = 5; return p.x * 10 + q.x; }"), 15);
+        // The constructor reads the fields it replaces before they are written
+        EXPECT_EQ(main_result(std::string{point} + "fun main() : i32 { var p = Point(1, 2); p = Point(p.y, p.x); return p.x * 10 + p.y; }"), 21);
+        // Passed to and returned from functions
+        EXPECT_EQ(main_result(std::string{point} +
+                              "fun swap(p : Point) : Point { return Point(p.y, p.x); } fun dot(a : Point, b : Point) : i32 { return a.x * b.x + a.y * b.y; } "
+                              "fun main() : i32 { return dot(swap(Point(1, 2)), Point(3, 4)); }"),
+                  10);
+        // Nested, declared after their use, and global
+        EXPECT_EQ(main_result("var line = Line(Point(1, 2), Point(3, 4)); fun main() : i32 { line.end.y = 10; let copy = line; return copy.end.y - copy.start.x; } "
+                              "struct Line { start : Point, end : Point } struct Point { x : i32, y : i32 }"),
+                  9);
+        // Fields of different types, and fields read in loops
+        EXPECT_EQ(main_result("packed struct Item { weight : f64, count : i8, heavy : bool } "
+                              "fun main() : i32 { let item = Item(2.5, 3, true); var total = 0; for var i = 0; i < 4; i = i + 1 { if item.heavy { total = total + i; } } return total; }"),
+                  6);
+    }
+
+    TEST(VM, StructErrors)
+    {
+        constexpr auto point = "struct Point { x : i32, y : i32 } ";
+        EXPECT_EQ(error_code(std::string{point} + "fun main() { let p = Point(1); }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code(std::string{point} + "fun main() { let p = Point(1, 2.5); }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code(std::string{point} + "fun main() : i32 { let p = Point(1, 2); return p.z; }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code(std::string{point} + "fun main() { let p = Point(1, 2); p.x = 3; }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code(std::string{point} + "fun main() : bool { return Point(1, 2) == Point(1, 2); }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code(std::string{point} + "fun main() { let p = Point; }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code("fun main() : i32 { let x = 1; return x.y; }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code("struct A { b : B } struct B { a : A }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code("struct A { x : i32, x : i32 }"), talos::ReturnCode::Redefinition);
+        EXPECT_EQ(error_code("struct A { x : i32 } fun A() {}"), talos::ReturnCode::Redefinition);
+        EXPECT_EQ(error_code("struct A { x : Missing }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code("fun f() { struct A { x : i32 } }"), talos::ReturnCode::SyntaxError);
+    }
+
+    TEST(VM, DisassembleStruct)
+    {
+        // Fields of locals are registers, a struct result takes a register per field
+        const auto program = compile("struct Point { x : i32, y : i32 } fun swap(p : Point) : Point { return Point(p.y, p.x); } "
+                                     "fun main() : i32 { var p = swap(Point(1, 2)); p.x = p.x + 1; return p.x; }");
+        EXPECT_EQ(talos::disassemble(program),
+                  "fun <init> (0 parameters, 1 registers)\n"
+                  "     0  ReturnVoid\n"
+                  "fun swap (2 parameters, 4 registers)\n"
+                  "     0  Move        r2, r1\n"
+                  "     1  Move        r3, r0\n"
+                  "     2  ReturnSlots r2, 2\n"
+                  "fun main (0 parameters, 4 registers)\n"
+                  "     0  LoadConst   r2, 1\n"
+                  "     1  LoadConst   r3, 2\n"
+                  "     2  Call        r2, swap, 2\n"
+                  "     3  Move        r0, r2\n"
+                  "     4  Move        r1, r3\n"
+                  "     5  LoadConst   r2, 1\n"
+                  "     6  Add         r0, r0, r2\n"
+                  "     7  Return      r0\n");
+    }
+
+    TEST(VM, InternedStrings)
+    {
+        // Equal literals share one decoded constant, however they are written
+        const auto program = compile(R"(let a = "tab\t\x41"; let b = "tab\u{9}A"; let c = "other"; fun f() { let d = "other"; })");
+        EXPECT_EQ(program.strings.size(), 2U);
+        EXPECT_TRUE(program.strings.contains("tab\tA"));
+        const auto& constants = program.functions[program.initializer].constants;
+        ASSERT_EQ(constants.size(), 3U);
+        EXPECT_EQ(constants[0].string, constants[1].string);
+        EXPECT_EQ(constants[2].string, program.functions[program.initializer + 1].constants[0].string);
+    }
+
+    TEST(VM, Arrays)
+    {
+        EXPECT_EQ(main_result("fun main() : i32 { var a = [1, 2, 3]; a[1] = 7; return a[0] + a[1] * 10 + a.length * 100; }"), 371);
+        // Arrays are values, copies are independent
+        EXPECT_EQ(main_result("fun main() : i32 { var a = [1, 2, 3]; var b = a; b[0] = 5; return a[0] * 10 + b[0]; }"), 15);
+        // The literal reads the elements it replaces before they are written
+        EXPECT_EQ(main_result("fun main() : i32 { var a = [1, 2, 3]; a = [a[2], a[1], a[0]]; return a[0] * 100 + a[1] * 10 + a[2]; }"), 321);
+        // Repeated elements, and literals that take the element type of their context
+        EXPECT_EQ(main_result("fun main() : i32 { let a: [4]f32 = [1, 2, 3, 4]; let b = [0.5 f32; 4]; let c = a * b; if c[3] == 2.0 f32 { return 1; } return 0; }"), 1);
+        // Elementwise arithmetic wraps around like scalar arithmetic
+        EXPECT_EQ(main_result("fun main() : i8 { let a: [20]i8 = [100; 20]; let b = a + a; return b[19]; }"), -56);
+        EXPECT_EQ(main_result("fun main() : i32 { let a = [7; 9]; var b = [2; 9]; b[8] = -3; let c = a / b - a * b; return c[0] * 100 + c[8]; }"), -1081);
+        // Passed to and returned from functions, and global
+        EXPECT_EQ(main_result("var scale = [1, 10, 100]; fun scaled(v: [3]i32) : [3]i32 { return v * scale; } "
+                              "fun main() : i32 { scale[2] = 1000; let s = scaled([1, 2, 3]); return s[0] + s[1] + s[2]; }"),
+                  3021);
+        // Arguments are copied if the callee or a later argument may change them
+        EXPECT_EQ(main_result("var g = [1, 2, 3]; fun h(a: [3]i32) : i32 { g[0] = 9; return a[0]; } fun main() : i32 { return h(g) * 10 + g[0]; }"), 19);
+        EXPECT_EQ(main_result("fun f(a: [3]i32, b: [3]i32) : i32 { return a[0] * 10 + b[0]; } fun main() : i32 { var a = [1, 2, 3]; return f(a, (a = [5, 5, 5])); }"), 15);
+        // Arrays of the locals of a loop, indexed by nested induction variables
+        EXPECT_EQ(main_result("fun main() : i32 { var total = 0; for var i = 0; i < 4; i = i + 1 { var row = [i; 4]; "
+                              "for var j = 0; j <= 3; j = j + 1 { row[j] = row[j] * j; total = total + row[j]; } } return total; }"),
+                  36);
+    }
+
+    TEST(VM, StructArrays)
+    {
+        constexpr auto point = "struct Point { x : i32, y : i32 } ";
+        EXPECT_EQ(main_result(std::string{point} + "fun main() : i32 { var a = [Point(1, 2), Point(3, 4)]; a[1].x = a[1].x + 10; return a[1].x * 10 + a[0].y; }"), 132);
+        // Elements are values, copies are independent
+        EXPECT_EQ(main_result(std::string{point} + "fun main() : i32 { var a = [Point(1, 2); 3]; let p = a[2]; var b = a; b[2].x = 5; a[2] = Point(7, 8); return p.x * 100 + b[2].x * 10 + a[2].x; }"), 157);
+        // The constructor reads the fields it replaces before they are written
+        EXPECT_EQ(main_result(std::string{point} + "fun main() : i32 { var a = [Point(1, 2); 2]; a[0] = Point(a[0].y, a[0].x); return a[0].x * 10 + a[0].y; }"), 21);
+        // Nested structs, soa structs, function arguments and globals
+        EXPECT_EQ(main_result(std::string{point} +
+                              "soa struct Body { mass : f64, alive : bool, at : Point } var bodies = [Body(1.5, true, Point(0, 0)); 4]; "
+                              "fun total(b : [4]Body) : f64 { var t = 0.0; for var i = 0; i < b.length; i = i + 1 { if b[i].alive { t = t + b[i].mass; } } return t; } "
+                              "fun main() : i32 { bodies[1] = Body(10.0, false, Point(3, 4)); bodies[2].at.y = 9; let at = bodies[1].at; "
+                              "if total(bodies) != 4.5 { return -1; } return at.x * 100 + at.y * 10 + bodies[2].at.y; }"),
+                  349);
+    }
+
+    // Registers hold untyped words, the instructions know what is in them
+    TEST(VM, TypedInstructions)
+    {
+        EXPECT_EQ(main_result("fun main() : i32 { var flags = [false; 5]; flags[3] = true; var count = 0; "
+                              "for var i = 0; i < 5; i = i + 1 { if flags[i] { count = count + i; } } return count; }"),
+                  3);
+        EXPECT_EQ(main_result("fun main() : i32 { let word = ['t', 'a', 'l', 'o', 's']; if word[4] == 's' && word[0] > word[1] { return 1; } return 0; }"), 1);
+        EXPECT_EQ(main_result("fun main() : i8 { let x : i8 = -127; let y = x - 1; return -y; }"), -128);
+        EXPECT_EQ(main_result("fun main() : i16 { var x : i16 = 0; for var i = 0; i < 3; i = i + 1 { x = x + 30000i16; } return x; }"), 24464);
+
+        // Results leave the VM with their type
+        const auto program = compile("fun positive(x : f32) : bool { return x > 0.0 f32; } fun letter() { return 'q'; }");
+        const auto arguments = std::array{talos::Value::of_floating(talos::Type::Float32, 0.5)};
+        auto interpreter = talos::Interpreter{};
+        EXPECT_EQ(interpreter.call(program, 1, arguments), talos::Value::of_bool(true));
+        EXPECT_EQ(interpreter.call(program, 2, {}), talos::Value::of_char('q'));
+    }
+
+    TEST(VM, ArrayErrors)
+    {
+        EXPECT_EQ(error_code("fun main() : i32 { var a = [1, 2, 3]; let i = 3; return a[i]; }"), talos::ReturnCode::IndexOutOfBounds);
+        EXPECT_EQ(error_code("fun main() { var a = [1, 2, 3]; for var i = 0; i <= a.length; i = i + 1 { a[i] = 0; } }"), talos::ReturnCode::IndexOutOfBounds);
+        EXPECT_EQ(error_code("fun main() { let a = [1, 2]; let b = a / [1, 0]; }"), talos::ReturnCode::DivisionByZero);
+        EXPECT_EQ(error_code("fun main() { var a = [0; 100000000]; }"), talos::ReturnCode::StackOverflow);
+        EXPECT_EQ(error_code("fun main() { let a = [1, 2, 3]; a[0] = 4; }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code("fun main() { var a = [1, 2, 3]; a.length = 4; }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code("fun main() { let c = [1, 2, 3] + [1, 2]; }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code("fun main() { let c = [true] + [false]; }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code("fun main() : i32 { let a = [1, 2]; return a[true]; }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code("fun main() : i32 { let a = 3; return a[0]; }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code("fun main() { let a = [[1], [2]]; }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code("fun main() { let a: [0]i32 = [1]; }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code("fun main() { let a: [2]i32 = [1, 2, 3]; }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code("fun main() : i32 { let a = [1]; return a.size; }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code("struct S { a : [3]i32 }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code("struct P { x : i32 } fun main() : i32 { var a = [P(1); 3]; let i = 3; return a[i].x; }"), talos::ReturnCode::IndexOutOfBounds);
+        EXPECT_EQ(error_code("soa struct P { x : i32 } fun main() { var a = [P(1); 3]; let i = 5; a[i] = P(2); }"), talos::ReturnCode::IndexOutOfBounds);
+        EXPECT_EQ(error_code("struct P { x : i32 } fun main() { let a = [P(1); 3]; a[0].x = 2; }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code("struct P { x : i32 } fun main() { let a = [P(1), 2]; }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code("struct P { x : i32 } fun main() { let a = [P(1)] + [P(2)]; }"), talos::ReturnCode::TypeError);
+        EXPECT_EQ(error_code("packed soa struct P { x : i32 }"), talos::ReturnCode::SyntaxError);
+        EXPECT_EQ(error_code("fun main() { let a = []; }"), talos::ReturnCode::SyntaxError);
+    }
+
+    TEST(VM, DisassembleArray)
+    {
+        // The loop bounds the index by the length, so it is not checked, and
+        // arithmetic on whole arrays is one instruction
+        const auto program = compile("fun sum(v: [8]f64) : f64 { var total = 0.0; for var i = 0; i < v.length; i = i + 1 { total = total + v[i]; } return total; } "
+                                     "fun main() { var a = [1.0; 8]; let i = 7; a[i] = sum(a + a); }");
+        EXPECT_EQ(talos::disassemble(program),
+                  "fun <init> (0 parameters, 1 registers)\n"
+                  "     0  ReturnVoid\n"
+                  "fun sum (1 parameters, 5 registers)\n"
+                  "     0  LoadConst   r1, 0\n"
+                  "     1  LoadConst   r2, 0\n"
+                  "     2  LoadConst   r3, 1\n"
+                  "     3  Jump        7\n"
+                  "     4  LoadIndex   r4, r0, r2\n"
+                  "     5  Add         r1, r1, r4\n"
+                  "     6  Add         r2, r2, r3\n"
+                  "     7  LoadConst   r4, 8\n"
+                  "     8  JumpIfLess  r2, r4, 4\n"
+                  "     9  Return      r1\n"
+                  "fun main (0 parameters, 4 registers, 128 bytes)\n"
+                  "     0  FrameArray  r0, [8]f64, 0\n"
+                  "     1  LoadConst   r2, 1\n"
+                  "     2  FillArray   r0, r2, [8]f64\n"
+                  "     3  LoadConst   r1, 7\n"
+                  "     4  FrameArray  r3, [8]f64, 64\n"
+                  "     5  VecAdd      r3, r0, r0\n"
+                  "     6  ExtraArg    [8]f64\n"
+                  "     7  Move        r2, r3\n"
+                  "     8  Call        r2, sum, 1\n"
+                  "     9  CheckIndex  r0, r1, [8]f64\n"
+                  "    10  StoreIndex  r0, r1, r2\n"
+                  "    11  ReturnVoid\n");
+    }
+
+    TEST(VM, DisassembleStructArray)
+    {
+        // A field of an element is read and written through its column, and
+        // a repeated element fills each column
+        const auto program = compile("soa struct Body { mass : f64, id : i8 } "
+                                     "fun main() : i8 { var a = [Body(1.0, 2); 4]; let i = 3; a[i].mass = 2.0; return a[i].id; }");
+        EXPECT_EQ(talos::disassemble(program),
+                  "fun <init> (0 parameters, 1 registers)\n"
+                  "     0  ReturnVoid\n"
+                  "fun main (0 parameters, 4 registers, 64 bytes)\n"
+                  "     0  FrameArray  r0, [4]Body, 0\n"
+                  "     1  LoadConst   r2, 1\n"
+                  "     2  LoadConst   r3, 2\n"
+                  "     3  FillColumn  r0, r2\n"
+                  "     4  ExtraArg    [4]Body, 0\n"
+                  "     5  FillColumn  r0, r3\n"
+                  "     6  ExtraArg    [4]Body, 1\n"
+                  "     7  LoadConst   r1, 3\n"
+                  "     8  LoadConst   r2, 2\n"
+                  "     9  CheckIndex  r0, r1, [4]Body\n"
+                  "    10  StoreColumn r0, r1, r2\n"
+                  "    11  ExtraArg    [4]Body, 0\n"
+                  "    12  CheckIndex  r0, r1, [4]Body\n"
+                  "    13  LoadColumn  r2, r0, r1\n"
+                  "    14  ExtraArg    [4]Body, 1\n"
+                  "    15  Return      r2\n");
+    }
+} // namespace
@@ -0,0 +1,193 @@
+#include "tools/corpus_generator.h"
+
+#include <charconv>
+#include <cstdio>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace
+{
+    constexpr std::size_t flush_threshold = 1024 * 1024;
+
+    constexpr const char* usage =
+        "Usage: talos_corpus_gen [options]\n"
+        "  --seed=N                         Seed of the generator (default 0)\n"
+        "  --size=N[K|M|G]                  Generate until the corpus reaches N bytes\n"
+        "  --functions=N                    Number of functions when no size is given\n"
+        "  --statements=MIN:MAX             Statements per function\n"
+        "  --depth=N                        Maximum expression depth\n"
+        "  --weights=INT:FLOAT:BOOL:STR:CHR Relative weights of declaration types\n"
+        "  --suffix-probability=P           Probability of suffixed numeric literals\n"
+        "  --identifier-length=MIN:MAX      Length of the random part of identifiers\n"
+        "  --tab-probability=P              Probability of tab indented functions\n"
+        "  --space-density=P                Probability of extra blanks between tokens\n"
+        "  --nesting=N                      Add an expression nested N levels to every function\n"
+        "  --output=FILE                    Write to FILE instead of stdout\n";
+
+    template<typename T>
+    std::optional<T> parse_number(std::string_view string)
+    {
+        T value{};
+        const auto* end = string.data() + string.size();
+        if (auto [ptr, error] = std::from_chars(string.data(), end, value); error != std::errc{} || ptr != end) {
+            return std::nullopt;
+        }
+        return value;
+    }
+
+    std::optional<std::size_t> parse_size(std::string_view string)
+    {
+        std::size_t multiplier = 1;
+        if (!string.empty()) {
+            switch (string.back()) {
+                case 'K':
+                case 'k':
+                    multiplier = std::size_t{1} << 10U;
+                    break;
+                case 'M':
+                case 'm':
+                    multiplier = std::size_t{1} << 20U;
+                    break;
+                case 'G':
+                case 'g':
+                    multiplier = std::size_t{1} << 30U;
+                    break;
+                default:
+                    break;
+            }
+        }
+        if (multiplier != 1) {
+            string.remove_suffix(1);
+        }
+        const auto value = parse_number<std::size_t>(string);
+        if (!value) {
+            return std::nullopt;
+        }
+        return *value * multiplier;
+    }
+
+    std::optional<talos::tools::Range> parse_range(std::string_view string)
+    {
+        const auto separator = string.find(':');
+        if (separator == std::string_view::npos) {
+            return std::nullopt;
+        }
+        const auto min = parse_number<int>(string.substr(0, separator));
+        const auto max = parse_number<int>(string.substr(separator + 1));
+        if (!min || !max || *min > *max) {
+            return std::nullopt;
+        }
+        return talos::tools::Range{*min, *max};
+    }
+
+    bool parse_weights(std::string_view string, talos::tools::CorpusOptions& options)
+    {
+        int* weights[] = {&options.int_weight, &options.float_weight, &options.bool_weight,
+                          &options.string_weight, &options.char_weight};
+        for (auto* weight : weights) {
+            const auto separator = string.find(':');
+            const auto value = parse_number<int>(string.substr(0, separator));
+            if (!value || *value < 0) {
+                return false;
+            }
+            *weight = *value;
+            string = separator == std::string_view::npos ? std::string_view{} : string.substr(separator + 1);
+        }
+        return true;
+    }
+
+    bool parse_option(std::string_view arg, talos::tools::CorpusOptions& options, std::string& output)
+    {
+        const auto separator = arg.find('=');
+        if (!arg.starts_with("--") || separator == std::string_view::npos) {
+            return false;
+        }
+        const auto name = arg.substr(2, separator - 2);
+        const auto value = arg.substr(separator + 1);
+
+        auto assign = [](auto& target, auto parsed) {
+            if (!parsed) {
+                return false;
+            }
+            target = *parsed;
+            return true;
+        };
+
+        if (name == "seed") {
+            return assign(options.seed, parse_number<std::uint64_t>(value));
+        }
+        if (name == "size") {
+            return assign(options.target_size, parse_size(value));
+        }
+        if (name == "functions") {
+            return assign(options.function_count, parse_number<int>(value));
+        }
+        if (name == "statements") {
+            return assign(options.statements_per_function, parse_range(value));
+        }
+        if (name == "depth") {
+            return assign(options.expression_depth, parse_number<int>(value));
+        }
+        if (name == "weights") {
+            return parse_weights(value, options);
+        }
+        if (name == "suffix-probability") {
+            return assign(options.suffix_probability, parse_number<double>(value));
+        }
+        if (name == "identifier-length") {
+            return assign(options.identifier_length, parse_range(value));
+        }
+        if (name == "tab-probability") {
+            return assign(options.tab_probability, parse_number<double>(value));
+        }
+        if (name == "space-density") {
+            return assign(options.space_density, parse_number<double>(value));
+        }
+        if (name == "nesting") {
+            return assign(options.nesting_depth, parse_number<int>(value));
+        }
+        if (name == "output") {
+            output = value;
+            return true;
+        }
+        return false;
+    }
+} // namespace
+
+int main(int argc, const char* argv[])
+{
+    auto options = talos::tools::CorpusOptions{};
+    std::string output;
+    for (int i = 1; i < argc; ++i) {
+        if (!parse_option(argv[i], options, output)) {
+            std::cerr << "Invalid argument '" << argv[i] << "'\n"
+                      << usage;
+            return -1;
+        }
+    }
+
+    std::FILE* file = output.empty() ? stdout : std::fopen(output.c_str(), "wb");
+    if (file == nullptr) {
+        std::cerr << "Could not open '" << output << "' for writing\n";
+        return -1;
+    }
+
+    // Corpora can be far larger than memory, so they are streamed out in chunks
+    auto generator = talos::tools::CorpusGenerator{options};
+    std::string buffer;
+    buffer.reserve(flush_threshold * 2);
+    while (generator.next_function(buffer)) {
+        if (buffer.size() >= flush_threshold) {
+            std::fwrite(buffer.data(), 1, buffer.size(), file);
+            buffer.clear();
+        }
+    }
+    std::fwrite(buffer.data(), 1, buffer.size(), file);
+
+    if (file != stdout) {
+        std::fclose(file);
+    }
+    return 0;
+}
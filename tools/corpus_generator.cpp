@@ -0,0 +1,357 @@
+#include "corpus_generator.h"
+
+#include <algorithm>
+#include <array>
+#include <utility>
+
+namespace talos::tools
+{
+    namespace
+    {
+        constexpr std::uint64_t splitmix64(std::uint64_t& state) noexcept
+        {
+            auto result = (state += 0x9E3779B97F4A7C15ULL);
+            result = (result ^ (result >> 30U)) * 0xBF58476D1CE4E5B9ULL;
+            result = (result ^ (result >> 27U)) * 0x94D049BB133111EBULL;
+            return result ^ (result >> 31U);
+        }
+
+        constexpr std::uint64_t rotl(std::uint64_t value, int shift) noexcept
+        {
+            return (value << shift) | (value >> (64 - shift));
+        }
+
+        constexpr std::string_view identifier_chars = "abcdefghijklmnopqrstuvwxyz_";
+        constexpr auto escapes = std::array<std::string_view, 6>{"\\n", "\\t", "\\\\", "\\\"", "\\x41", "\\u{e9}"};
+    } // namespace
+
+    CorpusGenerator::CorpusGenerator(CorpusOptions options)
+        : options_(options)
+    {
+        // Seed xoshiro256** through splitmix64 as recommended by its authors
+        auto seed = options_.seed;
+        for (auto& word : state_) {
+            word = splitmix64(seed);
+        }
+    }
+
+    bool CorpusGenerator::next_function(std::string& out)
+    {
+        const bool is_complete = options_.target_size == 0
+                                     ? functions_generated_ >= options_.function_count
+                                     : bytes_generated_ >= options_.target_size && functions_generated_ > 0;
+        if (is_complete) {
+            return false;
+        }
+
+        // The last function of every corpus is main so that the program is runnable
+        const bool is_main = options_.target_size == 0
+                                 ? functions_generated_ == options_.function_count - 1
+                                 : false;
+
+        const auto size_before = out.size();
+        function(out, is_main);
+        bytes_generated_ += out.size() - size_before;
+        ++functions_generated_;
+
+        if (options_.target_size != 0 && bytes_generated_ >= options_.target_size) {
+            const auto main_before = out.size();
+            function(out, true);
+            bytes_generated_ += out.size() - main_before;
+        }
+        return true;
+    }
+
+    std::uint64_t CorpusGenerator::next() noexcept
+    {
+        // xoshiro256**
+        const auto result = rotl(state_[1] * 5, 7) * 9;
+        const auto shifted = state_[1] << 17U;
+        state_[2] ^= state_[0];
+        state_[3] ^= state_[1];
+        state_[1] ^= state_[2];
+        state_[0] ^= state_[3];
+        state_[2] ^= shifted;
+        state_[3] = rotl(state_[3], 45);
+        return result;
+    }
+
+    int CorpusGenerator::uniform(int min, int max) noexcept
+    {
+        if (max <= min) {
+            return min;
+        }
+        const auto range = static_cast<std::uint64_t>(max - min) + 1;
+        return min + static_cast<int>(next() % range);
+    }
+
+    bool CorpusGenerator::chance(double probability) noexcept
+    {
+        constexpr auto scale = 1.0 / static_cast<double>(1ULL << 53U);
+        return static_cast<double>(next() >> 11U) * scale < probability;
+    }
+
+    CorpusGenerator::Type CorpusGenerator::random_type() noexcept
+    {
+        const auto total = options_.int_weight + options_.float_weight + options_.bool_weight
+                           + options_.string_weight + options_.char_weight;
+        auto pick = uniform(0, std::max(total, 1) - 1);
+        if ((pick -= options_.int_weight) < 0) {
+            return static_cast<Type>(uniform(static_cast<int>(Type::Int8), static_cast<int>(Type::Int64)));
+        }
+        if ((pick -= options_.float_weight) < 0) {
+            return chance(0.5) ? Type::Float32 : Type::Float64;
+        }
+        if ((pick -= options_.bool_weight) < 0) {
+            return Type::Bool;
+        }
+        if ((pick -= options_.string_weight) < 0) {
+            return Type::String;
+        }
+        return Type::Char;
+    }
+
+    std::string CorpusGenerator::identifier(std::string_view prefix)
+    {
+        // A numeric tail keeps identifiers unique and clear of keywords
+        auto name = std::string{prefix};
+        const auto length = uniform(options_.identifier_length);
+        for (int i = 0; i < length; ++i) {
+            name += identifier_chars[next() % identifier_chars.size()];
+        }
+        name += '_';
+        name += std::to_string(identifier_index_++);
+        return name;
+    }
+
+    void CorpusGenerator::blank(std::string& out)
+    {
+        out += ' ';
+        if (chance(options_.space_density)) {
+            out.append(static_cast<std::size_t>(uniform(1, 3)), chance(0.5) ? ' ' : '\t');
+        }
+    }
+
+    void CorpusGenerator::indent(std::string& out)
+    {
+        out += use_tabs_ ? "\t" : "    ";
+    }
+
+    void CorpusGenerator::literal(std::string& out, Type type)
+    {
+        static constexpr auto suffixes = std::array<std::string_view, 6>{"i8", "i16", "i32", "i64", "f32", "f64"};
+        switch (type) {
+            case Type::Int8:
+            case Type::Int16:
+            case Type::Int32:
+            case Type::Int64:
+            case Type::Float32:
+            case Type::Float64:
+                out += std::to_string(uniform(0, 100));
+                if (type == Type::Float32 || type == Type::Float64) {
+                    out += '.';
+                    out += std::to_string(uniform(0, 99));
+                }
+                if (chance(options_.suffix_probability)) {
+                    out += suffixes.at(static_cast<std::size_t>(type));
+                }
+                break;
+            case Type::Bool:
+                out += chance(0.5) ? "true" : "false";
+                break;
+            case Type::String: {
+                out += '"';
+                const auto length = uniform(options_.string_length);
+                for (int i = 0; i < length; ++i) {
+                    if (options_.escape_probability > 0.0 && chance(options_.escape_probability)) {
+                        out += escapes.at(next() % escapes.size());
+                        continue;
+                    }
+                    out += chance(0.15) ? ' ' : identifier_chars[next() % (identifier_chars.size() - 1)];
+                }
+                out += '"';
+                break;
+            }
+            case Type::Char:
+                out += '\'';
+                out += identifier_chars[next() % (identifier_chars.size() - 1)];
+                out += '\'';
+                break;
+        }
+    }
+
+    void CorpusGenerator::expression(std::string& out, Type type, int depth)
+    {
+        const bool is_numeric = type <= Type::Float64;
+        if (!is_numeric || depth <= 0 || chance(0.3)) {
+            std::vector<const Variable*> candidates;
+            for (const auto& variable : variables_) {
+                if (variable.type == type) {
+                    candidates.push_back(&variable);
+                }
+            }
+            if (!candidates.empty() && chance(0.5)) {
+                out += candidates[next() % candidates.size()]->name;
+            }
+            else {
+                literal(out, type);
+            }
+            return;
+        }
+
+        switch (uniform(0, 5)) {
+            case 0:
+            case 1:
+            case 2:
+                expression(out, type, depth - 1);
+                blank(out);
+                out += "+-*"[uniform(0, 2)];
+                blank(out);
+                expression(out, type, depth - 1);
+                break;
+            case 3:
+                // Only divide by non-zero literals so generated programs never trap
+                expression(out, type, depth - 1);
+                blank(out);
+                out += '/';
+                blank(out);
+                out += std::to_string(uniform(1, 9));
+                if (type == Type::Float32 || type == Type::Float64) {
+                    out += ".0";
+                }
+                break;
+            case 4:
+                out += '-';
+                expression(out, type, depth - 1);
+                break;
+            default:
+                out += '(';
+                expression(out, type, depth - 1);
+                out += ')';
+                break;
+        }
+    }
+
+    void CorpusGenerator::nested_expression(std::string& out, int depth)
+    {
+        int open_parens = 0;
+        for (int i = 0; i < depth; ++i) {
+            if (i % 2 == 0) {
+                out += '(';
+                ++open_parens;
+            }
+            else {
+                out += '-';
+            }
+        }
+        out += '1';
+        out.append(static_cast<std::size_t>(open_parens), ')');
+    }
+
+    void CorpusGenerator::declaration(std::string& out)
+    {
+        static constexpr auto type_names = std::array<std::string_view, 7>{
+            "i8", "i16", "i32", "i64", "f32", "f64", "bool"};
+
+        const auto type = random_type();
+        const bool is_mutable = chance(0.5);
+        auto name = identifier("");
+
+        indent(out);
+        out += is_mutable ? "var" : "let";
+        blank(out);
+        out += name;
+
+        // String and char have no type keyword yet. Other declarations are only left
+        // untyped where inference picks the intended type, keeping the corpus type-correct
+        const bool has_type_keyword = type <= Type::Bool;
+        const bool is_inferable = type == Type::Int32 || type == Type::Float64 || type == Type::Bool;
+        if (has_type_keyword && (!is_inferable || chance(0.5))) {
+            blank(out);
+            out += ':';
+            blank(out);
+            out += type_names.at(static_cast<std::size_t>(type));
+        }
+        blank(out);
+        out += '=';
+        blank(out);
+        expression(out, type, options_.expression_depth);
+        out += ";\n";
+
+        variables_.push_back(Variable{.name = std::move(name), .type = type, .is_mutable = is_mutable});
+    }
+
+    void CorpusGenerator::assignment(std::string& out)
+    {
+        std::vector<const Variable*> candidates;
+        for (const auto& variable : variables_) {
+            if (variable.is_mutable) {
+                candidates.push_back(&variable);
+            }
+        }
+        if (candidates.empty()) {
+            declaration(out);
+            return;
+        }
+        const auto& target = *candidates[next() % candidates.size()];
+        indent(out);
+        out += target.name;
+        blank(out);
+        out += '=';
+        blank(out);
+        expression(out, target.type, options_.expression_depth);
+        out += ";\n";
+    }
+
+    void CorpusGenerator::function(std::string& out, bool is_main)
+    {
+        variables_.clear();
+        use_tabs_ = chance(options_.tab_probability);
+        const bool returns_value = is_main || chance(0.7);
+
+        out += "fun ";
+        out += is_main ? std::string{"main"} : identifier("fn_");
+        out += "()";
+        if (returns_value) {
+            out += " : i32";
+        }
+        out += "\n{\n";
+
+        const auto statements = uniform(options_.statements_per_function);
+        for (int i = 0; i < statements; ++i) {
+            if (i == 0 || chance(0.7)) {
+                declaration(out);
+            }
+            else {
+                assignment(out);
+            }
+        }
+
+        if (options_.nesting_depth > 0) {
+            indent(out);
+            out += "let ";
+            out += identifier("deep_");
+            out += " : i32 = ";
+            nested_expression(out, options_.nesting_depth);
+            out += ";\n";
+        }
+
+        if (returns_value) {
+            indent(out);
+            out += "return ";
+            expression(out, Type::Int32, options_.expression_depth);
+            out += ";\n";
+        }
+        out += "}\n\n";
+    }
+
+    std::string generate_corpus(const CorpusOptions& options)
+    {
+        std::string corpus;
+        corpus.reserve(options.target_size);
+        auto generator = CorpusGenerator{options};
+        while (generator.next_function(corpus)) {
+        }
+        return corpus;
+    }
+} // namespace talos::tools
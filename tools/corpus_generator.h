@@ -0,0 +1,114 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace talos::tools
+{
+    struct Range {
+        int min = 0;
+        int max = 0;
+    };
+
+    struct CorpusOptions {
+        std::uint64_t seed = 0;
+
+        // Stop once the corpus reaches this many bytes. When zero, exactly
+        // function_count functions are generated instead
+        std::size_t target_size = 0;
+        int function_count = 16;
+
+        Range statements_per_function{4, 12};
+        int expression_depth = 3;
+
+        // Relative weights used when picking the type of a declaration
+        int int_weight = 6;
+        int float_weight = 3;
+        int bool_weight = 1;
+        int string_weight = 1;
+        int char_weight = 1;
+        // Probability that a numeric literal carries a type suffix (1i8, 2.0f64)
+        double suffix_probability = 0.25;
+
+        Range identifier_length{3, 12};
+        Range string_length{0, 16};
+        // Probability that a character of a string literal is an escape sequence
+        double escape_probability = 0.0;
+
+        // Probability that a function body is indented with tabs instead of spaces
+        double tab_probability = 0.25;
+        // Probability of extra blanks between two tokens
+        double space_density = 0.05;
+
+        // When non-zero every function contains an expression nested this deep,
+        // alternating parentheses and unary minus
+        int nesting_depth = 0;
+    };
+
+    // Deterministic generator of syntactically and type-wise valid Talos programs.
+    // The same options always produce the same byte stream, independent of the
+    // platform or standard library in use.
+    class CorpusGenerator
+    {
+    public:
+        explicit CorpusGenerator(CorpusOptions options);
+
+        // Appends the next function to out. Returns false once the corpus is complete
+        bool next_function(std::string& out);
+
+        [[nodiscard]] std::size_t bytes_generated() const noexcept { return bytes_generated_; }
+
+    private:
+        enum class Type {
+            Int8,
+            Int16,
+            Int32,
+            Int64,
+            Float32,
+            Float64,
+            Bool,
+            String,
+            Char,
+        };
+
+        struct Variable {
+            std::string name;
+            Type type;
+            bool is_mutable;
+        };
+
+        std::uint64_t next() noexcept;
+        int uniform(int min, int max) noexcept;
+        int uniform(Range range) noexcept { return uniform(range.min, range.max); }
+        bool chance(double probability) noexcept;
+
+        Type random_type() noexcept;
+        std::string identifier(std::string_view prefix);
+
+        void blank(std::string& out);
+        void indent(std::string& out);
+        void literal(std::string& out, Type type);
+        void expression(std::string& out, Type type, int depth);
+        void nested_expression(std::string& out, int depth);
+        void declaration(std::string& out);
+        void assignment(std::string& out);
+        void function(std::string& out, bool is_main);
+
+        CorpusOptions options_;
+        std::array<std::uint64_t, 4> state_ = {};
+        std::size_t bytes_generated_ = 0;
+        int functions_generated_ = 0;
+        int identifier_index_ = 0;
+
+        // Per function state
+        std::vector<Variable> variables_;
+        bool use_tabs_ = false;
+    };
+
+    // Convenience wrapper generating the whole corpus in memory
+    [[nodiscard]] std::string generate_corpus(const CorpusOptions& options);
+} // namespace talos::tools